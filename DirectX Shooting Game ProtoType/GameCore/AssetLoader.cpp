@@ -0,0 +1,108 @@
+//-----------------------------------------------------------------------------
+// File: AssetLoader.cpp
+//
+// Desc: Decode jobs and the upload pump.
+//-----------------------------------------------------------------------------
+#include <thread>
+
+#include "AssetLoader.h"
+#include "ImageFile.h"
+
+
+AssetLoader::AssetLoader()
+	: jobs(NULL), capacity(0), used(0), settled(0)
+{
+}
+
+
+void AssetLoader::init(JobSystem* jobs_, int max_assets)
+{
+	jobs = jobs_;
+	assets.reset(new Asset[max_assets]);
+	capacity = max_assets;
+	used = 0;
+	settled = 0;
+}
+
+
+void AssetLoader::decode(Asset& asset)
+{
+	bool ok = load_png(asset.path.c_str(), asset.argb, asset.w, asset.h);
+	if (ok)
+		apply_color_key(asset.argb, asset.color_key);
+	asset.state.store(ok ? ASSET_DECODED : ASSET_FAILED, std::memory_order_release);
+}
+
+
+void AssetLoader::decode_job(void* loader, int begin, int end)
+{
+	AssetLoader* self = (AssetLoader*)loader;
+	for (int i = begin; i < end; i++)
+		self->decode(self->assets[i]);
+}
+
+
+int AssetLoader::load(const char* path, int color_key)
+{
+	if (used == capacity)
+		return -1;
+
+	int handle = used++;
+	Asset& asset = assets[handle];
+	asset.path = path;
+	asset.color_key = color_key;
+	asset.settled = false;
+	asset.state.store(ASSET_QUEUED, std::memory_order_relaxed);
+
+	if (!jobs)
+	{
+		decode(asset);
+		return handle;
+	}
+
+	Job job = { decode_job, this, handle, handle + 1, NULL };
+	jobs->push(job);
+	return handle;
+}
+
+
+int AssetLoader::pump(TextureSink& sink)
+{
+	int n = 0;
+	for (int i = 0; i < used; i++)
+	{
+		Asset& asset = assets[i];
+		if (asset.settled)
+			continue;
+
+		int s = asset.state.load(std::memory_order_acquire);
+		if (s == ASSET_DECODED)
+		{
+			sink.upload(i, asset.argb.data(), asset.w, asset.h);
+			std::vector<unsigned int>().swap(asset.argb);
+			asset.state.store(ASSET_UPLOADED, std::memory_order_relaxed);
+			n++;
+		}
+		if (s != ASSET_QUEUED)
+		{
+			asset.settled = true;
+			settled++;
+		}
+	}
+	return n;
+}
+
+
+bool AssetLoader::finish(TextureSink& sink)
+{
+	while (settled < used)
+	{
+		if (pump(sink) == 0 && !(jobs && jobs->help()))
+			std::this_thread::yield();
+	}
+
+	bool ok = true;
+	for (int i = 0; i < used; i++)
+		ok = ok && state(i) == ASSET_UPLOADED;
+	return ok;
+}
@@ -0,0 +1,89 @@
+//-----------------------------------------------------------------------------
+// File: AssetLoader.h
+//
+// Desc: Startup image loading off the main thread. load() queues a PNG
+//       decode on the job system and hands back a handle straight away, so
+//       the caller can go on creating the device, fonts and game state while
+//       workers decode. Finished images are passed, one at a time and on
+//       the caller's thread, to a TextureSink: the single place that talks
+//       to the graphics API. Direct3D 9 devices aren't free-threaded, so
+//       uploads must not happen on the workers.
+//
+//       Each asset moves QUEUED -> DECODED -> UPLOADED, or ends FAILED. The
+//       decoded pixels are freed once the sink has taken them.
+//-----------------------------------------------------------------------------
+#ifndef __AssetLoader_h_
+#define __AssetLoader_h_
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "JobSystem.h"
+
+#define ASSET_QUEUED 0
+#define ASSET_DECODED 1
+#define ASSET_UPLOADED 2
+#define ASSET_FAILED 3
+
+
+// the upload stage; turns decoded pixels into whatever the renderer uses
+class TextureSink {
+
+public:
+	virtual ~TextureSink() {}
+
+	virtual void upload(int handle, const unsigned int* argb, int w, int h) = 0;
+};
+
+
+class AssetLoader {
+
+public:
+	AssetLoader();
+
+	// room for max_assets loads. With jobs NULL every image is decoded
+	// inside load(), the way a plain loader would.
+	void init(JobSystem* jobs, int max_assets);
+
+	// queue a PNG, made transparent where it is color_key (< 0 for none);
+	// returns its handle, or -1 when the loader is full
+	int load(const char* path, int color_key);
+
+	int state(int handle) const { return assets[handle].state.load(std::memory_order_acquire); }
+	const char* path(int handle) const { return assets[handle].path.c_str(); }
+	int count() const { return used; }
+
+	// give every image decoded so far to the sink; returns how many
+	int pump(TextureSink& sink);
+
+	// decode alongside the workers and upload as images finish, until
+	// every asset is in; false if any failed to decode. Must be called
+	// before the loader goes away, as queued jobs point into it.
+	bool finish(TextureSink& sink);
+
+private:
+	AssetLoader(const AssetLoader&);
+	AssetLoader& operator=(const AssetLoader&);
+
+	struct Asset {
+		std::string path;
+		int color_key;
+		std::atomic<int> state;
+		int w, h;
+		std::vector<unsigned int> argb;
+		bool settled;           // uploaded or failed, as seen by pump()
+	};
+
+	static void decode_job(void* loader, int begin, int end);
+	void decode(Asset& asset);
+
+	JobSystem* jobs;
+	std::unique_ptr<Asset[]> assets;
+	int capacity;
+	int used;
+	int settled;
+};
+
+#endif // __AssetLoader_h_
@@ -0,0 +1,311 @@
+//-----------------------------------------------------------------------------
+// File: Atlas.cpp
+//
+// Desc: MaxRects packing, page assembly and the sprite table.
+//-----------------------------------------------------------------------------
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Atlas.h"
+#include "ImageFile.h"
+
+
+void MaxRectsPacker::init(int w, int h)
+{
+	free_rects.clear();
+	AtlasRect all = { 0, 0, w, h };
+	free_rects.push_back(all);
+}
+
+
+bool MaxRectsPacker::insert(int w, int h, AtlasRect& placed)
+{
+	// best short side fit, ties broken by the long side
+	int best = -1;
+	int best_short = 0, best_long = 0;
+	for (size_t i = 0; i < free_rects.size(); i++)
+	{
+		const AtlasRect& f = free_rects[i];
+		if (f.w < w || f.h < h)
+			continue;
+		int short_side = std::min(f.w - w, f.h - h);
+		int long_side = std::max(f.w - w, f.h - h);
+		if (best < 0 || short_side < best_short || (short_side == best_short && long_side < best_long))
+		{
+			best = (int)i;
+			best_short = short_side;
+			best_long = long_side;
+		}
+	}
+	if (best < 0)
+		return false;
+
+	placed.x = free_rects[best].x;
+	placed.y = free_rects[best].y;
+	placed.w = w;
+	placed.h = h;
+	split(placed);
+	prune();
+	return true;
+}
+
+
+// every free rectangle the new one overlaps is replaced by the up to four
+// maximal rectangles around it
+void MaxRectsPacker::split(const AtlasRect& used)
+{
+	size_t n = free_rects.size();
+	for (size_t i = 0; i < n;)
+	{
+		AtlasRect f = free_rects[i];
+		if (used.x >= f.x + f.w || used.x + used.w <= f.x || used.y >= f.y + f.h || used.y + used.h <= f.y)
+		{
+			i++;
+			continue;
+		}
+
+		if (used.x > f.x)
+		{
+			AtlasRect r = { f.x, f.y, used.x - f.x, f.h };
+			free_rects.push_back(r);
+		}
+		if (used.x + used.w < f.x + f.w)
+		{
+			AtlasRect r = { used.x + used.w, f.y, f.x + f.w - used.x - used.w, f.h };
+			free_rects.push_back(r);
+		}
+		if (used.y > f.y)
+		{
+			AtlasRect r = { f.x, f.y, f.w, used.y - f.y };
+			free_rects.push_back(r);
+		}
+		if (used.y + used.h < f.y + f.h)
+		{
+			AtlasRect r = { f.x, used.y + used.h, f.w, f.y + f.h - used.y - used.h };
+			free_rects.push_back(r);
+		}
+
+		free_rects[i] = free_rects[n - 1];
+		free_rects[n - 1] = free_rects.back();
+		free_rects.pop_back();
+		n--;
+	}
+}
+
+
+static bool contains(const AtlasRect& a, const AtlasRect& b)
+{
+	return b.x >= a.x && b.y >= a.y && b.x + b.w <= a.x + a.w && b.y + b.h <= a.y + a.h;
+}
+
+
+// drop free rectangles that lie inside another one
+void MaxRectsPacker::prune()
+{
+	for (size_t i = 0; i < free_rects.size(); i++)
+	{
+		for (size_t j = i + 1; j < free_rects.size();)
+		{
+			if (contains(free_rects[i], free_rects[j]))
+			{
+				free_rects[j] = free_rects.back();
+				free_rects.pop_back();
+			}
+			else if (contains(free_rects[j], free_rects[i]))
+			{
+				free_rects[i] = free_rects[j];
+				free_rects[j] = free_rects.back();
+				free_rects.pop_back();
+				j = i + 1;
+			}
+			else
+				j++;
+		}
+	}
+}
+
+
+bool load_atlas_image(const char* path, int color_key, AtlasImage& image)
+{
+	if (!load_png(path, image.argb, image.w, image.h))
+		return false;
+
+	apply_color_key(image.argb, color_key);
+
+	const char* base = path;
+	for (const char* p = path; *p; p++)
+	{
+		if (*p == '/' || *p == '\\')
+			base = p + 1;
+	}
+	const char* dot = strrchr(base, '.');
+	image.name.assign(base, dot ? dot : base + strlen(base));
+	return true;
+}
+
+
+static bool try_page(const std::vector<AtlasImage>& images, const std::vector<int>& order, int padding,
+	int w, int h, std::vector<AtlasRect>& rects)
+{
+	MaxRectsPacker packer;
+	packer.init(w, h);
+	for (size_t i = 0; i < order.size(); i++)
+	{
+		const AtlasImage& im = images[order[i]];
+		AtlasRect r;
+		if (!packer.insert(im.w + 2 * padding, im.h + 2 * padding, r))
+			return false;
+		r.x += padding;
+		r.y += padding;
+		r.w = im.w;
+		r.h = im.h;
+		rects[order[i]] = r;
+	}
+	return true;
+}
+
+
+// copy an image in and repeat its edge pixels out into the border
+static void blit_padded(AtlasPage& page, const AtlasImage& im, const AtlasRect& r, int padding)
+{
+	for (int y = -padding; y < im.h + padding; y++)
+	{
+		int sy = std::min(std::max(y, 0), im.h - 1);
+		unsigned int* dst = &page.argb[(size_t)(r.y + y) * page.w + r.x];
+		const unsigned int* src = &im.argb[(size_t)sy * im.w];
+		for (int x = -padding; x < im.w + padding; x++)
+			dst[x] = src[std::min(std::max(x, 0), im.w - 1)];
+	}
+}
+
+
+bool pack_atlas(const std::vector<AtlasImage>& images, int padding, int max_size, AtlasPage& page)
+{
+	// largest first, by the longer side and then by area
+	std::vector<int> order(images.size());
+	long long area = 0;
+	int widest = 1, tallest = 1;
+	for (size_t i = 0; i < images.size(); i++)
+	{
+		order[i] = (int)i;
+		area += (long long)(images[i].w + 2 * padding) * (images[i].h + 2 * padding);
+		widest = std::max(widest, images[i].w + 2 * padding);
+		tallest = std::max(tallest, images[i].h + 2 * padding);
+	}
+	std::stable_sort(order.begin(), order.end(), [&](int a, int b) {
+		int sa = std::max(images[a].w, images[a].h), sb = std::max(images[b].w, images[b].h);
+		if (sa != sb)
+			return sa > sb;
+		return images[a].w * images[a].h > images[b].w * images[b].h;
+	});
+
+	// power-of-two pages big enough in total, smallest first, squarer first
+	struct Size { int w, h; };
+	std::vector<Size> sizes;
+	for (int w = 1; w <= max_size; w *= 2)
+	{
+		for (int h = 1; h <= max_size; h *= 2)
+		{
+			if (w >= widest && h >= tallest && (long long)w * h >= area)
+			{
+				Size s = { w, h };
+				sizes.push_back(s);
+			}
+		}
+	}
+	std::stable_sort(sizes.begin(), sizes.end(), [](const Size& a, const Size& b) {
+		if ((long long)a.w * a.h != (long long)b.w * b.h)
+			return (long long)a.w * a.h < (long long)b.w * b.h;
+		return std::abs(a.w - a.h) < std::abs(b.w - b.h) || (std::abs(a.w - a.h) == std::abs(b.w - b.h) && a.w > b.w);
+	});
+
+	page.rects.resize(images.size());
+	for (size_t s = 0; s < sizes.size(); s++)
+	{
+		if (!try_page(images, order, padding, sizes[s].w, sizes[s].h, page.rects))
+			continue;
+
+		page.w = sizes[s].w;
+		page.h = sizes[s].h;
+		page.argb.assign((size_t)page.w * page.h, 0);
+		for (size_t i = 0; i < images.size(); i++)
+			blit_padded(page, images[i], page.rects[i], padding);
+		return true;
+	}
+	return false;
+}
+
+
+double atlas_density(const std::vector<AtlasImage>& images, const AtlasPage& page)
+{
+	double used = 0;
+	for (size_t i = 0; i < images.size(); i++)
+		used += (double)images[i].w * images[i].h;
+	return page.w > 0 && page.h > 0 ? used / ((double)page.w * page.h) : 0.0;
+}
+
+
+bool save_atlas_table(const char* path, const char* page_file, const std::vector<AtlasImage>& images, const AtlasPage& page)
+{
+	FILE* f = fopen(path, "w");
+	if (!f)
+		return false;
+
+	fprintf(f, "page %s %d %d\n", page_file, page.w, page.h);
+	for (size_t i = 0; i < images.size(); i++)
+	{
+		const AtlasRect& r = page.rects[i];
+		fprintf(f, "sprite %s %d %d %d %d\n", images[i].name.c_str(), r.x, r.y, r.w, r.h);
+	}
+	return fclose(f) == 0;
+}
+
+
+bool AtlasTable::load(const char* path)
+{
+	page.clear();
+	page_w = page_h = 0;
+	entries.clear();
+
+	FILE* f = fopen(path, "r");
+	if (!f)
+		return false;
+
+	char name[ATLAS_NAME_MAX];
+	bool ok = fscanf(f, " page %63s %d %d", name, &page_w, &page_h) == 3 && page_w > 0 && page_h > 0;
+	if (ok)
+		page = name;
+
+	Entry e;
+	while (ok && fscanf(f, " sprite %63s %d %d %d %d", name, &e.rect.x, &e.rect.y, &e.rect.w, &e.rect.h) == 5)
+	{
+		e.name = name;
+		entries.push_back(e);
+	}
+	ok = ok && feof(f);
+	fclose(f);
+	return ok;
+}
+
+
+bool AtlasTable::find(const char* name, int texture, SpriteFrame& frame) const
+{
+	for (size_t i = 0; i < entries.size(); i++)
+	{
+		if (entries[i].name != name)
+			continue;
+
+		const AtlasRect& r = entries[i].rect;
+		frame.texture = texture;
+		frame.w = (float)r.w;
+		frame.h = (float)r.h;
+		frame.u0 = (float)r.x / page_w;
+		frame.v0 = (float)r.y / page_h;
+		frame.u1 = (float)(r.x + r.w) / page_w;
+		frame.v1 = (float)(r.y + r.h) / page_h;
+		return true;
+	}
+	return false;
+}
@@ -0,0 +1,111 @@
+//-----------------------------------------------------------------------------
+// File: Atlas.h
+//
+// Desc: Texture atlases. Every sprite image is packed onto one page offline
+//       (tools/atlas_pack), so the game binds a single texture per frame
+//       and each sprite is a sub-rectangle of it.
+//
+//       Packing is MaxRects with the best short side fit rule: the free
+//       space is kept as a list of maximal, possibly overlapping empty
+//       rectangles, and each image goes where it leaves the least slack on
+//       its shorter side. Images are placed largest first on the smallest
+//       power-of-two page that holds them all.
+//
+//       Each image gets a border of its own edge pixels repeated, so linear
+//       filtering at a sprite's edge never picks up its neighbour.
+//
+//       The packer writes the page as a PNG and a text table next to it:
+//
+//           page <png file> <width> <height>
+//           sprite <name> <x> <y> <width> <height>
+//           ...
+//
+//       which AtlasTable reads at run time to turn names into UVs.
+//-----------------------------------------------------------------------------
+#ifndef __Atlas_h_
+#define __Atlas_h_
+
+#include <string>
+#include <vector>
+
+#include "SpriteBatch.h"
+
+#define ATLAS_MAX_SIZE 4096
+#define ATLAS_NAME_MAX 64     // longest sprite name the table reader takes
+
+struct AtlasRect {
+	int x, y, w, h;
+};
+
+struct AtlasImage {
+	std::string name;
+	int w, h;
+	std::vector<unsigned int> argb;
+};
+
+struct AtlasPage {
+	int w, h;
+	std::vector<unsigned int> argb;
+	std::vector<AtlasRect> rects;   // where each image went, in input order
+};
+
+
+// free-space bookkeeping of one page
+class MaxRectsPacker {
+
+public:
+	void init(int w, int h);
+
+	// false if there is no room left for a w x h rectangle
+	bool insert(int w, int h, AtlasRect& placed);
+
+private:
+	void split(const AtlasRect& used);
+	void prune();
+
+	std::vector<AtlasRect> free_rects;
+};
+
+
+// an image read from a PNG and named after its file, without directory and
+// extension, with apply_color_key() done
+bool load_atlas_image(const char* path, int color_key, AtlasImage& image);
+
+// pack every image with padding pixels of border onto the smallest page
+// that fits; false if they need more than max_size x max_size
+bool pack_atlas(const std::vector<AtlasImage>& images, int padding, int max_size, AtlasPage& page);
+
+// image pixels over page pixels
+double atlas_density(const std::vector<AtlasImage>& images, const AtlasPage& page);
+
+// the table that goes with a page saved as page_file
+bool save_atlas_table(const char* path, const char* page_file, const std::vector<AtlasImage>& images, const AtlasPage& page);
+
+
+// the sprite table at run time
+class AtlasTable {
+
+public:
+	bool load(const char* path);
+
+	// the frame of a named sprite on the page bound as texture; false if
+	// there is no such sprite
+	bool find(const char* name, int texture, SpriteFrame& frame) const;
+
+	const char* page_file() const { return page.c_str(); }
+	int width() const { return page_w; }
+	int height() const { return page_h; }
+	int count() const { return (int)entries.size(); }
+
+private:
+	struct Entry {
+		std::string name;
+		AtlasRect rect;
+	};
+
+	std::string page;
+	int page_w, page_h;
+	std::vector<Entry> entries;
+};
+
+#endif // __Atlas_h_
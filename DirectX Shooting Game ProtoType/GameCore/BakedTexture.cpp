@@ -0,0 +1,179 @@
+//-----------------------------------------------------------------------------
+// File: BakedTexture.cpp
+//
+// Desc: Baking (premultiply, mip chain, file writing) and the mapped reader.
+//-----------------------------------------------------------------------------
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+#include "BakedTexture.h"
+#include "ImageFile.h"
+
+
+unsigned long long baked_source_hash(const unsigned char* data, size_t size)
+{
+	unsigned long long h = 14695981039346656037ull;
+	for (size_t i = 0; i < size; i++)
+		h = (h ^ data[i]) * 1099511628211ull;
+	return h;
+}
+
+
+static void premultiply_alpha(std::vector<unsigned int>& argb)
+{
+	for (size_t i = 0; i < argb.size(); i++)
+	{
+		unsigned int c = argb[i];
+		unsigned int a = c >> 24;
+		unsigned int r = div255(((c >> 16) & 0xff) * a);
+		unsigned int g = div255(((c >> 8) & 0xff) * a);
+		unsigned int b = div255((c & 0xff) * a);
+		argb[i] = (a << 24) | (r << 16) | (g << 8) | b;
+	}
+}
+
+
+// the next mip level: each pixel the rounded mean of a 2x2 block, with odd
+// edges reusing their last row or column
+static void half_size(const std::vector<unsigned int>& src, int w, int h, std::vector<unsigned int>& dst, int& dw, int& dh)
+{
+	dw = w > 1 ? w / 2 : 1;
+	dh = h > 1 ? h / 2 : 1;
+	dst.resize((size_t)dw * dh);
+	for (int y = 0; y < dh; y++)
+	{
+		int y0 = 2 * y < h ? 2 * y : h - 1;
+		int y1 = 2 * y + 1 < h ? 2 * y + 1 : h - 1;
+		for (int x = 0; x < dw; x++)
+		{
+			int x0 = 2 * x < w ? 2 * x : w - 1;
+			int x1 = 2 * x + 1 < w ? 2 * x + 1 : w - 1;
+			unsigned int p[4] = { src[(size_t)y0 * w + x0], src[(size_t)y0 * w + x1], src[(size_t)y1 * w + x0], src[(size_t)y1 * w + x1] };
+			unsigned int out = 0;
+			for (int shift = 0; shift < 32; shift += 8)
+			{
+				unsigned int sum = 2;
+				for (int k = 0; k < 4; k++)
+					sum += (p[k] >> shift) & 0xff;
+				out |= (sum >> 2) << shift;
+			}
+			dst[(size_t)y * dw + x] = out;
+		}
+	}
+}
+
+
+bool bake_texture(const char* png_path, const char* out_path, int color_key, bool premultiply, int max_levels)
+{
+	MappedFile source;
+	std::vector<unsigned int> argb;
+	int w, h;
+	if (!source.open(png_path) || !decode_png(source.data(), source.size(), argb, w, h))
+		return false;
+
+	apply_color_key(argb, color_key);
+	if (premultiply)
+		premultiply_alpha(argb);
+
+	BakedHeader head;
+	memset(&head, 0, sizeof(head));
+	memcpy(head.magic, BAKED_MAGIC, 4);
+	head.version = BAKED_VERSION;
+	head.format = premultiply ? BAKED_ARGB_PREMULTIPLIED : BAKED_ARGB;
+	head.color_key = color_key < 0 ? -1 : color_key;
+	head.source_size = (unsigned int)source.size();
+	head.source_hash = baked_source_hash(source.data(), source.size());
+
+	if (max_levels <= 0 || max_levels > BAKED_MAX_LEVELS)
+		max_levels = BAKED_MAX_LEVELS;
+
+	// premultiplied pixels filter correctly; straight ones bleed the color
+	// of transparent texels into the edges, as D3DX's own box filter does
+	std::vector<std::vector<unsigned int> > chain(1);
+	chain[0].swap(argb);
+	size_t offset = (sizeof(BakedHeader) + BAKED_ALIGN - 1) & ~(size_t)(BAKED_ALIGN - 1);
+	for (int level = 0;; level++)
+	{
+		head.level[level].offset = (unsigned int)offset;
+		head.level[level].width = (unsigned int)w;
+		head.level[level].height = (unsigned int)h;
+		head.levels = level + 1;
+		offset += ((size_t)w * h * 4 + BAKED_ALIGN - 1) & ~(size_t)(BAKED_ALIGN - 1);
+
+		if ((w == 1 && h == 1) || level + 1 == max_levels)
+			break;
+		chain.push_back(std::vector<unsigned int>());
+		half_size(chain[level], w, h, chain[level + 1], w, h);
+	}
+
+	FILE* f = fopen(out_path, "wb");
+	if (!f)
+		return false;
+
+	static const unsigned char zeros[BAKED_ALIGN] = { 0 };
+	bool ok = fwrite(&head, sizeof(head), 1, f) == 1;
+	size_t written = sizeof(head);
+	for (unsigned int level = 0; ok && level < head.levels; level++)
+	{
+		ok = fwrite(zeros, 1, head.level[level].offset - written, f) == head.level[level].offset - written;
+		size_t bytes = chain[level].size() * 4;
+		ok = ok && fwrite(chain[level].data(), 1, bytes, f) == bytes;
+		written = head.level[level].offset + bytes;
+	}
+	return fclose(f) == 0 && ok;
+}
+
+
+BakedTexture::BakedTexture()
+	: head(NULL)
+{
+}
+
+
+bool BakedTexture::open(const char* path)
+{
+	close();
+	if (!file.open(path) || file.size() < sizeof(BakedHeader))
+	{
+		close();
+		return false;
+	}
+
+	const BakedHeader* h = (const BakedHeader*)file.data();
+	bool ok = memcmp(h->magic, BAKED_MAGIC, 4) == 0 && h->version == BAKED_VERSION
+		&& h->format <= BAKED_ARGB_PREMULTIPLIED && h->levels >= 1 && h->levels <= BAKED_MAX_LEVELS;
+	for (unsigned int i = 0; ok && i < h->levels; i++)
+	{
+		const BakedLevel& l = h->level[i];
+		ok = l.width >= 1 && l.height >= 1 && l.width <= 16384 && l.height <= 16384 && l.offset % BAKED_ALIGN == 0
+			&& l.offset >= sizeof(BakedHeader) && l.offset <= file.size()
+			&& (unsigned long long)l.width * l.height * 4 <= file.size() - l.offset;
+	}
+	if (!ok)
+	{
+		close();
+		return false;
+	}
+
+	head = h;
+	return true;
+}
+
+
+void BakedTexture::close()
+{
+	file.close();
+	head = NULL;
+}
+
+
+bool BakedTexture::matches(const char* source_path, int color_key) const
+{
+	if (!head || head->color_key != (color_key < 0 ? -1 : color_key))
+		return false;
+
+	MappedFile source;
+	return source.open(source_path) && source.size() == head->source_size
+		&& baked_source_hash(source.data(), source.size()) == head->source_hash;
+}
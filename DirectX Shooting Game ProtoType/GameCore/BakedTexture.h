@@ -0,0 +1,83 @@
+//-----------------------------------------------------------------------------
+// File: BakedTexture.h
+//
+// Desc: Textures baked ahead of time (tools/texture_bake) so that loading
+//       one is a file mapping rather than a PNG decode. The color key is
+//       already turned into alpha, the pixels are premultiplied by it, and
+//       the whole mip chain is there, so the renderer copies the levels
+//       straight out of the mapping.
+//
+//       File layout (little-endian):
+//           BakedHeader
+//           level 0 pixels, level 1 pixels, ...   each at a 64-byte aligned
+//                                                 offset, rows packed tight
+//
+//       Pixels are 32-bit ARGB. The header keeps a hash and the size of the
+//       source file and the color key used, so a stale bake can be spotted
+//       without decoding the source.
+//-----------------------------------------------------------------------------
+#ifndef __BakedTexture_h_
+#define __BakedTexture_h_
+
+#include "MappedFile.h"
+
+#define BAKED_MAGIC "BTEX"
+#define BAKED_VERSION 1
+#define BAKED_MAX_LEVELS 16
+#define BAKED_ALIGN 64
+
+#define BAKED_ARGB 0                  // straight alpha
+#define BAKED_ARGB_PREMULTIPLIED 1    // color channels multiplied by alpha
+
+struct BakedLevel {
+	unsigned int offset;       // from the start of the file
+	unsigned int width;
+	unsigned int height;
+	unsigned int reserved;
+};
+
+struct BakedHeader {
+	char magic[4];
+	unsigned int version;
+	unsigned int format;
+	unsigned int levels;
+	int color_key;                     // RGB made transparent, or -1
+	unsigned int source_size;
+	unsigned long long source_hash;    // FNV-1a of the source file
+	BakedLevel level[BAKED_MAX_LEVELS];
+};
+
+// FNV-1a over a file's bytes, as stored in source_hash
+unsigned long long baked_source_hash(const unsigned char* data, size_t size);
+
+// decode a PNG, apply the color key (< 0 for none), premultiply if asked
+// and write it with up to max_levels mip levels (0 for the full chain)
+bool bake_texture(const char* png_path, const char* out_path, int color_key, bool premultiply, int max_levels);
+
+
+// a baked texture, read in place from its mapping
+class BakedTexture {
+
+public:
+	BakedTexture();
+
+	// false if the file is missing, damaged or from another version
+	bool open(const char* path);
+	void close();
+
+	// whether this was baked from the file at source_path as it is now,
+	// with this color key
+	bool matches(const char* source_path, int color_key) const;
+
+	int levels() const { return (int)head->levels; }
+	int width(int level) const { return (int)head->level[level].width; }
+	int height(int level) const { return (int)head->level[level].height; }
+	bool premultiplied() const { return head->format == BAKED_ARGB_PREMULTIPLIED; }
+	const unsigned int* pixels(int level) const { return (const unsigned int*)(file.data() + head->level[level].offset); }
+
+private:
+	MappedFile file;
+	const BakedHeader* head;
+};
+
+#endif // __BakedTexture_h_
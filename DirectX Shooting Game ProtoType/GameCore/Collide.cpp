@@ -0,0 +1,246 @@
+//-----------------------------------------------------------------------------
+// File: Collide.cpp
+//
+// Desc: Scalar and SSE2 circle batch kernels and the runtime dispatch. The
+//       AVX2 kernel lives in Collide_avx2.cpp so only that file needs to be
+//       compiled for AVX2.
+//
+//       Every path evaluates dx*dx + dy*dy < (pr + r) * (pr + r) with the
+//       same operations in the same order as sphere_collision_check(), and
+//       never fuses the multiply and add, so all of them agree bit for bit.
+//       The swept kernels do the same for swept_collision_check().
+//-----------------------------------------------------------------------------
+#include <float.h>
+#include <string.h>
+
+#include "Collide.h"
+#include "Cpu.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define COLLIDE_SSE2 1
+#include <emmintrin.h>
+#endif
+
+
+typedef void (*CollideKernel)(float, float, float, const float*, const float*, float, int, unsigned int*);
+typedef void (*SweptKernel)(float, float, float, const float*, const float*, const float*, const float*, float,
+	float, int, unsigned int*);
+
+// the SIMD path and its kernels
+struct CollideDispatch {
+	int level;
+	CollideKernel circle;
+	SweptKernel swept;
+};
+
+
+void collide_circle_batch_scalar(float px, float py, float pr,
+	const float* x, const float* y, float r, int n, unsigned int* hits)
+{
+	float size = (pr + r) * (pr + r);
+
+	memset(hits, 0, collide_mask_words(n) * sizeof(unsigned int));
+	for (int i = 0; i < n; i++)
+	{
+		float dx = px - x[i];
+		float dy = py - y[i];
+		float dx2 = dx * dx;
+		float dy2 = dy * dy;
+		if (dx2 + dy2 < size)
+			hits[i >> 5] |= 1u << (i & 31);
+	}
+}
+
+
+// the circle moved by (sx, sy) and ended e = (px, py) - (x, y) away. t is
+// the closest approach as a fraction of the move back from the end, in
+// [-1, 0]; the clamps are written the way minps/maxps work so the SIMD
+// paths round the same way. At t = 0 the distance is exactly the one
+// collide_circle_batch_scalar() takes, and the end point is tested on its
+// own as well, so no rounding in the sweep can lose a hit at the end.
+void collide_swept_batch_scalar(float px, float py, float pr,
+	const float* x, const float* y, const float* vx, const float* vy, float dt,
+	float r, int n, unsigned int* hits)
+{
+	float size = (pr + r) * (pr + r);
+
+	memset(hits, 0, collide_mask_words(n) * sizeof(unsigned int));
+	for (int i = 0; i < n; i++)
+	{
+		float sx = vx[i] * dt;
+		float sy = vy[i] * dt;
+		float ex = px - x[i];
+		float ey = py - y[i];
+		float len2 = sx * sx + sy * sy;
+		float t = (ex * sx + ey * sy) / (len2 > FLT_MIN ? len2 : FLT_MIN);
+		t = t > -1.0f ? t : -1.0f;
+		t = t < 0.0f ? t : 0.0f;
+		float qx = ex - t * sx;
+		float qy = ey - t * sy;
+		float d2 = qx * qx + qy * qy;
+		float end = ex * ex + ey * ey;
+		if (d2 < size || end < size)
+			hits[i >> 5] |= 1u << (i & 31);
+	}
+}
+
+
+#if defined(COLLIDE_SSE2)
+
+void collide_circle_batch_sse2(float px, float py, float pr,
+	const float* x, const float* y, float r, int n, unsigned int* hits)
+{
+	__m128 vpx = _mm_set1_ps(px);
+	__m128 vpy = _mm_set1_ps(py);
+	__m128 vsize = _mm_set1_ps((pr + r) * (pr + r));
+
+	memset(hits, 0, collide_mask_words(n) * sizeof(unsigned int));
+
+	int i = 0;
+	for (; i + 4 <= n; i += 4)
+	{
+		__m128 dx = _mm_sub_ps(vpx, _mm_loadu_ps(x + i));
+		__m128 dy = _mm_sub_ps(vpy, _mm_loadu_ps(y + i));
+		__m128 d2 = _mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy));
+		unsigned int mask = (unsigned int)_mm_movemask_ps(_mm_cmplt_ps(d2, vsize));
+		hits[i >> 5] |= mask << (i & 31);
+	}
+
+	if (i < n)
+	{
+		unsigned int tail[1];
+		collide_circle_batch_scalar(px, py, pr, x + i, y + i, r, n - i, tail);
+		hits[i >> 5] |= tail[0] << (i & 31);
+	}
+}
+
+
+void collide_swept_batch_sse2(float px, float py, float pr,
+	const float* x, const float* y, const float* vx, const float* vy, float dt,
+	float r, int n, unsigned int* hits)
+{
+	__m128 vpx = _mm_set1_ps(px);
+	__m128 vpy = _mm_set1_ps(py);
+	__m128 vdt = _mm_set1_ps(dt);
+	__m128 vsize = _mm_set1_ps((pr + r) * (pr + r));
+	__m128 vtiny = _mm_set1_ps(FLT_MIN);
+	__m128 vminus_one = _mm_set1_ps(-1.0f);
+	__m128 vzero = _mm_setzero_ps();
+
+	memset(hits, 0, collide_mask_words(n) * sizeof(unsigned int));
+
+	int i = 0;
+	for (; i + 4 <= n; i += 4)
+	{
+		__m128 sx = _mm_mul_ps(_mm_loadu_ps(vx + i), vdt);
+		__m128 sy = _mm_mul_ps(_mm_loadu_ps(vy + i), vdt);
+		__m128 ex = _mm_sub_ps(vpx, _mm_loadu_ps(x + i));
+		__m128 ey = _mm_sub_ps(vpy, _mm_loadu_ps(y + i));
+		__m128 len2 = _mm_add_ps(_mm_mul_ps(sx, sx), _mm_mul_ps(sy, sy));
+		__m128 t = _mm_div_ps(_mm_add_ps(_mm_mul_ps(ex, sx), _mm_mul_ps(ey, sy)), _mm_max_ps(len2, vtiny));
+		t = _mm_min_ps(_mm_max_ps(t, vminus_one), vzero);
+		__m128 qx = _mm_sub_ps(ex, _mm_mul_ps(t, sx));
+		__m128 qy = _mm_sub_ps(ey, _mm_mul_ps(t, sy));
+		__m128 d2 = _mm_add_ps(_mm_mul_ps(qx, qx), _mm_mul_ps(qy, qy));
+		__m128 end = _mm_add_ps(_mm_mul_ps(ex, ex), _mm_mul_ps(ey, ey));
+		__m128 hit = _mm_or_ps(_mm_cmplt_ps(d2, vsize), _mm_cmplt_ps(end, vsize));
+		hits[i >> 5] |= (unsigned int)_mm_movemask_ps(hit) << (i & 31);
+	}
+
+	if (i < n)
+	{
+		unsigned int tail[1];
+		collide_swept_batch_scalar(px, py, pr, x + i, y + i, vx + i, vy + i, dt, r, n - i, tail);
+		hits[i >> 5] |= tail[0] << (i & 31);
+	}
+}
+
+#else
+
+void collide_circle_batch_sse2(float px, float py, float pr,
+	const float* x, const float* y, float r, int n, unsigned int* hits)
+{
+	collide_circle_batch_scalar(px, py, pr, x, y, r, n, hits);
+}
+
+
+void collide_swept_batch_sse2(float px, float py, float pr,
+	const float* x, const float* y, const float* vx, const float* vy, float dt,
+	float r, int n, unsigned int* hits)
+{
+	collide_swept_batch_scalar(px, py, pr, x, y, vx, vy, dt, r, n, hits);
+}
+
+#endif
+
+
+static CollideDispatch collide_dispatch(int level)
+{
+	if (level > cpu_simd_level())
+		level = cpu_simd_level();
+
+	CollideDispatch d;
+	d.level = level;
+	switch (level)
+	{
+	case SIMD_AVX2:
+		d.circle = collide_circle_batch_avx2;
+		d.swept = collide_swept_batch_avx2;
+		break;
+	case SIMD_SSE2:
+		d.circle = collide_circle_batch_sse2;
+		d.swept = collide_swept_batch_sse2;
+		break;
+	default:
+		d.circle = collide_circle_batch_scalar;
+		d.swept = collide_swept_batch_scalar;
+		break;
+	}
+	return d;
+}
+
+
+// picked for the CPU on first use; a function-local static is set up once
+// even when the first calls come from several jobs at the same time
+static CollideDispatch& dispatch()
+{
+	static CollideDispatch d = collide_dispatch(cpu_simd_level());
+	return d;
+}
+
+
+int collide_simd_level()
+{
+	return dispatch().level;
+}
+
+
+void collide_set_simd_level(int level)
+{
+	dispatch() = collide_dispatch(level);
+}
+
+
+void collide_circle_batch(float px, float py, float pr,
+	const float* x, const float* y, float r, int n, unsigned int* hits)
+{
+	dispatch().circle(px, py, pr, x, y, r, n, hits);
+}
+
+
+void collide_circles_batch(const float* px, const float* py, int m, float pr,
+	const float* x, const float* y, float r, int n, unsigned int* hits)
+{
+	CollideKernel kernel = dispatch().circle;
+	int stride = collide_mask_words(n);
+	for (int j = 0; j < m; j++)
+		kernel(px[j], py[j], pr, x, y, r, n, hits + j * stride);
+}
+
+
+void collide_swept_batch(float px, float py, float pr,
+	const float* x, const float* y, const float* vx, const float* vy, float dt,
+	float r, int n, unsigned int* hits)
+{
+	dispatch().swept(px, py, pr, x, y, vx, vy, dt, r, n, hits);
+}
@@ -0,0 +1,66 @@
+//-----------------------------------------------------------------------------
+// File: Collide.h
+//
+// Desc: Batched circle overlap tests. Each kernel gives exactly the answer
+//       sphere_collision_check() (or swept_collision_check()) would give for
+//       every pair, but tests 4 or 8 circles per instruction and reports the
+//       result as a bitmask: bit (i % 32) of word (i / 32) is set when
+//       circle i is hit.
+//-----------------------------------------------------------------------------
+#ifndef __Collide_h_
+#define __Collide_h_
+
+// number of 32-bit mask words needed for n circles
+inline int collide_mask_words(int n)
+{
+	return (n + 31) / 32;
+}
+
+// test circle (px, py, pr) against n circles of radius r
+void collide_circle_batch(float px, float py, float pr,
+	const float* x, const float* y, float r, int n, unsigned int* hits);
+
+// test m circles against n circles; row j of hits starts at
+// hits + j * collide_mask_words(n)
+void collide_circles_batch(const float* px, const float* py, int m, float pr,
+	const float* x, const float* y, float r, int n, unsigned int* hits);
+
+
+// swept test for moving circles: circle i moved at (vx[i], vy[i]) for dt
+// seconds and is now at (x[i], y[i]). Bit i is set when it came closer than
+// pr + r to (px, py) anywhere along that move, so a circle too fast to be
+// caught at the end of a tick can't pass through. The target is taken where
+// it stands; only the circles' own motion is swept. Whenever the end point
+// is the closest point this is exactly collide_circle_batch(), and it never
+// misses a circle collide_circle_batch() hits.
+void collide_swept_batch(float px, float py, float pr,
+	const float* x, const float* y, const float* vx, const float* vy, float dt,
+	float r, int n, unsigned int* hits);
+
+
+// SIMD path used by the batch kernels; defaults to cpu_simd_level() and can
+// be lowered to compare paths while no kernel is running. Requests above what
+// the CPU supports are clamped.
+int collide_simd_level();
+void collide_set_simd_level(int level);
+
+
+// per-ISA kernels, exposed for the benchmarks
+void collide_circle_batch_scalar(float px, float py, float pr,
+	const float* x, const float* y, float r, int n, unsigned int* hits);
+void collide_circle_batch_sse2(float px, float py, float pr,
+	const float* x, const float* y, float r, int n, unsigned int* hits);
+void collide_circle_batch_avx2(float px, float py, float pr,
+	const float* x, const float* y, float r, int n, unsigned int* hits);
+
+void collide_swept_batch_scalar(float px, float py, float pr,
+	const float* x, const float* y, const float* vx, const float* vy, float dt,
+	float r, int n, unsigned int* hits);
+void collide_swept_batch_sse2(float px, float py, float pr,
+	const float* x, const float* y, const float* vx, const float* vy, float dt,
+	float r, int n, unsigned int* hits);
+void collide_swept_batch_avx2(float px, float py, float pr,
+	const float* x, const float* y, const float* vx, const float* vy, float dt,
+	float r, int n, unsigned int* hits);
+
+#endif // __Collide_h_
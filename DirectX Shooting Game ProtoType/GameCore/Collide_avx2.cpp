@@ -0,0 +1,106 @@
+//-----------------------------------------------------------------------------
+// File: Collide_avx2.cpp
+//
+// Desc: AVX2 circle batch kernels. Built with AVX2 enabled (but not FMA, which
+//       would change the rounding); only called when cpu_simd_level() says
+//       the machine has it.
+//-----------------------------------------------------------------------------
+#include <float.h>
+#include <string.h>
+
+#include "Collide.h"
+
+#if defined(__AVX2__) || defined(_MSC_VER)
+#define COLLIDE_AVX2 1
+#include <immintrin.h>
+#endif
+
+
+#if defined(COLLIDE_AVX2)
+
+void collide_circle_batch_avx2(float px, float py, float pr,
+	const float* x, const float* y, float r, int n, unsigned int* hits)
+{
+	__m256 vpx = _mm256_set1_ps(px);
+	__m256 vpy = _mm256_set1_ps(py);
+	__m256 vsize = _mm256_set1_ps((pr + r) * (pr + r));
+
+	memset(hits, 0, collide_mask_words(n) * sizeof(unsigned int));
+
+	int i = 0;
+	for (; i + 8 <= n; i += 8)
+	{
+		__m256 dx = _mm256_sub_ps(vpx, _mm256_loadu_ps(x + i));
+		__m256 dy = _mm256_sub_ps(vpy, _mm256_loadu_ps(y + i));
+		__m256 d2 = _mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy));
+		unsigned int mask = (unsigned int)_mm256_movemask_ps(_mm256_cmp_ps(d2, vsize, _CMP_LT_OQ));
+		hits[i >> 5] |= mask << (i & 31);
+	}
+
+	if (i < n)
+	{
+		unsigned int tail[1];
+		collide_circle_batch_sse2(px, py, pr, x + i, y + i, r, n - i, tail);
+		hits[i >> 5] |= tail[0] << (i & 31);
+	}
+}
+
+
+
+void collide_swept_batch_avx2(float px, float py, float pr,
+	const float* x, const float* y, const float* vx, const float* vy, float dt,
+	float r, int n, unsigned int* hits)
+{
+	__m256 vpx = _mm256_set1_ps(px);
+	__m256 vpy = _mm256_set1_ps(py);
+	__m256 vdt = _mm256_set1_ps(dt);
+	__m256 vsize = _mm256_set1_ps((pr + r) * (pr + r));
+	__m256 vtiny = _mm256_set1_ps(FLT_MIN);
+	__m256 vminus_one = _mm256_set1_ps(-1.0f);
+	__m256 vzero = _mm256_setzero_ps();
+
+	memset(hits, 0, collide_mask_words(n) * sizeof(unsigned int));
+
+	int i = 0;
+	for (; i + 8 <= n; i += 8)
+	{
+		__m256 sx = _mm256_mul_ps(_mm256_loadu_ps(vx + i), vdt);
+		__m256 sy = _mm256_mul_ps(_mm256_loadu_ps(vy + i), vdt);
+		__m256 ex = _mm256_sub_ps(vpx, _mm256_loadu_ps(x + i));
+		__m256 ey = _mm256_sub_ps(vpy, _mm256_loadu_ps(y + i));
+		__m256 len2 = _mm256_add_ps(_mm256_mul_ps(sx, sx), _mm256_mul_ps(sy, sy));
+		__m256 t = _mm256_div_ps(_mm256_add_ps(_mm256_mul_ps(ex, sx), _mm256_mul_ps(ey, sy)), _mm256_max_ps(len2, vtiny));
+		t = _mm256_min_ps(_mm256_max_ps(t, vminus_one), vzero);
+		__m256 qx = _mm256_sub_ps(ex, _mm256_mul_ps(t, sx));
+		__m256 qy = _mm256_sub_ps(ey, _mm256_mul_ps(t, sy));
+		__m256 d2 = _mm256_add_ps(_mm256_mul_ps(qx, qx), _mm256_mul_ps(qy, qy));
+		__m256 end = _mm256_add_ps(_mm256_mul_ps(ex, ex), _mm256_mul_ps(ey, ey));
+		__m256 hit = _mm256_or_ps(_mm256_cmp_ps(d2, vsize, _CMP_LT_OQ), _mm256_cmp_ps(end, vsize, _CMP_LT_OQ));
+		hits[i >> 5] |= (unsigned int)_mm256_movemask_ps(hit) << (i & 31);
+	}
+
+	if (i < n)
+	{
+		unsigned int tail[1];
+		collide_swept_batch_sse2(px, py, pr, x + i, y + i, vx + i, vy + i, dt, r, n - i, tail);
+		hits[i >> 5] |= tail[0] << (i & 31);
+	}
+}
+
+#else
+
+void collide_circle_batch_avx2(float px, float py, float pr,
+	const float* x, const float* y, float r, int n, unsigned int* hits)
+{
+	collide_circle_batch_sse2(px, py, pr, x, y, r, n, hits);
+}
+
+
+void collide_swept_batch_avx2(float px, float py, float pr,
+	const float* x, const float* y, const float* vx, const float* vy, float dt,
+	float r, int n, unsigned int* hits)
+{
+	collide_swept_batch_sse2(px, py, pr, x, y, vx, vy, dt, r, n, hits);
+}
+
+#endif
@@ -0,0 +1,92 @@
+//-----------------------------------------------------------------------------
+// File: Cpu.cpp
+//
+// Desc: CPUID based SIMD detection.
+//-----------------------------------------------------------------------------
+#include "Cpu.h"
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+#define CPU_X86 1
+#endif
+
+#if defined(CPU_X86) && !defined(_MSC_VER)
+#include <cpuid.h>
+#endif
+
+
+#if defined(CPU_X86)
+
+static void cpuid(int leaf, int subleaf, unsigned int regs[4])
+{
+#if defined(_MSC_VER)
+	int r[4];
+	__cpuidex(r, leaf, subleaf);
+	for (int i = 0; i < 4; i++)
+		regs[i] = (unsigned int)r[i];
+#else
+	__cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+// XCR0, so we know the OS saves the YMM registers on a context switch
+static unsigned long long read_xcr0()
+{
+#if defined(_MSC_VER)
+	return _xgetbv(0);
+#else
+	unsigned int lo, hi;
+	__asm__ volatile ("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+	return ((unsigned long long)hi << 32) | lo;
+#endif
+}
+
+static int detect_simd_level()
+{
+	unsigned int regs[4];
+	cpuid(0, 0, regs);
+	unsigned int max_leaf = regs[0];
+
+	cpuid(1, 0, regs);
+	bool sse2 = (regs[3] & (1u << 26)) != 0;
+	bool osxsave = (regs[2] & (1u << 27)) != 0;
+	bool avx = (regs[2] & (1u << 28)) != 0;
+	if (!sse2)
+		return SIMD_SCALAR;
+
+	if (max_leaf >= 7 && osxsave && avx && (read_xcr0() & 6) == 6)
+	{
+		cpuid(7, 0, regs);
+		if (regs[1] & (1u << 5))
+			return SIMD_AVX2;
+	}
+	return SIMD_SSE2;
+}
+
+#else
+
+static int detect_simd_level()
+{
+	return SIMD_SCALAR;
+}
+
+#endif
+
+
+int cpu_simd_level()
+{
+	static int level = detect_simd_level();
+	return level;
+}
+
+
+const char* simd_level_name(int level)
+{
+	switch (level)
+	{
+	case SIMD_SSE2:
+		return "sse2";
+	case SIMD_AVX2:
+		return "avx2";
+	}
+	return "scalar";
+}
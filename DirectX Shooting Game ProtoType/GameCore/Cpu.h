@@ -0,0 +1,35 @@
+//-----------------------------------------------------------------------------
+// File: Cpu.h
+//
+// Desc: Runtime detection of the SIMD instruction sets the kernels can use,
+//       plus a couple of bit helpers shared by them.
+//-----------------------------------------------------------------------------
+#ifndef __Cpu_h_
+#define __Cpu_h_
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+// SIMD paths, ordered so a higher level can run everything below it
+enum { SIMD_SCALAR, SIMD_SSE2, SIMD_AVX2, SIMD_LEVEL_COUNT };
+
+// best level both the CPU and the OS support
+int cpu_simd_level();
+
+const char* simd_level_name(int level);
+
+
+// index of the lowest set bit; bits must not be zero
+inline int lowest_bit_index(unsigned int bits)
+{
+#if defined(_MSC_VER)
+	unsigned long index;
+	_BitScanForward(&index, bits);
+	return (int)index;
+#else
+	return __builtin_ctz(bits);
+#endif
+}
+
+#endif // __Cpu_h_
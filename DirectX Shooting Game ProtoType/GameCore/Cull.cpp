@@ -0,0 +1,170 @@
+//-----------------------------------------------------------------------------
+// File: Cull.cpp
+//
+// Desc: Scalar and SSE2 culling kernels, the runtime dispatch and the
+//       sprite culler. The AVX2 kernel lives in Cull_avx2.cpp so only that
+//       file needs to be compiled for AVX2. Every path makes the same four
+//       comparisons, so all of them keep exactly the same sprites.
+//-----------------------------------------------------------------------------
+#include "Cull.h"
+#include "Cpu.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CULL_SSE2 1
+#include <emmintrin.h>
+#endif
+
+
+typedef int (*CullKernel)(const float*, const float*, int, float, float, const CullRect&, int*);
+
+// the SIMD path and its kernel
+struct CullDispatch {
+	int level;
+	CullKernel kernel;
+};
+
+
+// a sprite overlaps the view when its corner is inside the view grown by
+// the sprite's size to the top and left; the index is always written and
+// only kept when it counts, so there is no branch to mispredict
+int cull_sprites_scalar(const float* x, const float* y, int n, float w, float h, const CullRect& view, int* visible)
+{
+	float x0 = view.left - w;
+	float y0 = view.top - h;
+	int count = 0;
+
+	for (int i = 0; i < n; i++)
+	{
+		int keep = (x[i] > x0) & (x[i] < view.right) & (y[i] > y0) & (y[i] < view.bottom);
+		visible[count] = i;
+		count += keep;
+	}
+	return count;
+}
+
+
+#if defined(CULL_SSE2)
+
+int cull_sprites_sse2(const float* x, const float* y, int n, float w, float h, const CullRect& view, int* visible)
+{
+	__m128 vx0 = _mm_set1_ps(view.left - w);
+	__m128 vy0 = _mm_set1_ps(view.top - h);
+	__m128 vx1 = _mm_set1_ps(view.right);
+	__m128 vy1 = _mm_set1_ps(view.bottom);
+	int count = 0;
+
+	int i = 0;
+	for (; i + 4 <= n; i += 4)
+	{
+		__m128 px = _mm_loadu_ps(x + i);
+		__m128 py = _mm_loadu_ps(y + i);
+		__m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpgt_ps(px, vx0), _mm_cmplt_ps(px, vx1)),
+			_mm_and_ps(_mm_cmpgt_ps(py, vy0), _mm_cmplt_ps(py, vy1)));
+		for (unsigned int bits = (unsigned int)_mm_movemask_ps(inside); bits != 0; bits &= bits - 1)
+			visible[count++] = i + lowest_bit_index(bits);
+	}
+
+	int tail = cull_sprites_scalar(x + i, y + i, n - i, w, h, view, visible + count);
+	for (int k = 0; k < tail; k++)
+		visible[count + k] += i;
+	return count + tail;
+}
+
+#else
+
+int cull_sprites_sse2(const float* x, const float* y, int n, float w, float h, const CullRect& view, int* visible)
+{
+	return cull_sprites_scalar(x, y, n, w, h, view, visible);
+}
+
+#endif
+
+
+static CullDispatch cull_dispatch(int level)
+{
+	if (level > cpu_simd_level())
+		level = cpu_simd_level();
+
+	CullDispatch d;
+	d.level = level;
+	switch (level)
+	{
+	case SIMD_AVX2:
+		d.kernel = cull_sprites_avx2;
+		break;
+	case SIMD_SSE2:
+		d.kernel = cull_sprites_sse2;
+		break;
+	default:
+		d.kernel = cull_sprites_scalar;
+		break;
+	}
+	return d;
+}
+
+
+// set up on the first cull, once, whichever thread gets there first
+static CullDispatch& dispatch()
+{
+	static CullDispatch d = cull_dispatch(cpu_simd_level());
+	return d;
+}
+
+
+int cull_simd_level()
+{
+	return dispatch().level;
+}
+
+
+void cull_set_simd_level(int level)
+{
+	dispatch() = cull_dispatch(level);
+}
+
+
+int cull_sprites(const float* x, const float* y, int n, float w, float h, const CullRect& view, int* visible)
+{
+	return dispatch().kernel(x, y, n, w, h, view, visible);
+}
+
+
+SpriteCuller::SpriteCuller()
+{
+	rect.left = 0;
+	rect.top = 0;
+	rect.right = 0;
+	rect.bottom = 0;
+	counts.tested = 0;
+	counts.visible = 0;
+}
+
+
+void SpriteCuller::reserve(int n)
+{
+	if ((int)indices.size() < n)
+		indices.resize(n);
+}
+
+
+void SpriteCuller::begin()
+{
+	counts.tested = 0;
+	counts.visible = 0;
+}
+
+
+const int* SpriteCuller::visible(const float* x, const float* y, int n, float w, float h, int* count)
+{
+	reserve(n);
+	*count = n > 0 ? cull_sprites(x, y, n, w, h, rect, indices.data()) : 0;
+	counts.tested += n;
+	counts.visible += *count;
+	return indices.data();
+}
+
+
+float SpriteCuller::culled_ratio() const
+{
+	return counts.tested > 0 ? (float)(counts.tested - counts.visible) / counts.tested : 0.0f;
+}
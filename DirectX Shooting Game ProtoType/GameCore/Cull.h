@@ -0,0 +1,73 @@
+//-----------------------------------------------------------------------------
+// File: Cull.h
+//
+// Desc: View culling for sprites. The kernels test the boxes of n sprites of
+//       one size against a view rectangle, 4 or 8 per instruction, and write
+//       the indices of the ones that overlap it, ascending, so the draw list
+//       only ever touches what can be seen. A sprite that only touches the
+//       edge of the view is culled.
+//-----------------------------------------------------------------------------
+#ifndef __Cull_h_
+#define __Cull_h_
+
+#include <vector>
+
+struct CullRect {
+	float left, top, right, bottom;
+};
+
+// sprites w x h with top-left corners at (x[i], y[i]); visible needs room
+// for n indices. Returns how many were written.
+int cull_sprites(const float* x, const float* y, int n, float w, float h, const CullRect& view, int* visible);
+
+
+// SIMD path used by cull_sprites(); defaults to cpu_simd_level() and can be
+// lowered to compare paths while nothing is culling. Requests above what the
+// CPU supports are clamped.
+int cull_simd_level();
+void cull_set_simd_level(int level);
+
+
+// per-ISA kernels, exposed for the benchmarks
+int cull_sprites_scalar(const float* x, const float* y, int n, float w, float h, const CullRect& view, int* visible);
+int cull_sprites_sse2(const float* x, const float* y, int n, float w, float h, const CullRect& view, int* visible);
+int cull_sprites_avx2(const float* x, const float* y, int n, float w, float h, const CullRect& view, int* visible);
+
+
+struct CullStats {
+	int tested;
+	int visible;
+};
+
+
+// the view, the index buffer and the counts of one frame
+class SpriteCuller {
+
+public:
+	SpriteCuller();
+
+	// room for up to n sprites per call, so visible() never allocates
+	void reserve(int n);
+
+	void set_view(const CullRect& view) { rect = view; }
+	const CullRect& view() const { return rect; }
+
+	// start counting a new frame
+	void begin();
+
+	// indices of the sprites that overlap the view, ascending, and how many
+	// there are in *count; good until the next call
+	const int* visible(const float* x, const float* y, int n, float w, float h, int* count);
+
+	const CullStats& stats() const { return counts; }
+
+	// share of this frame's sprites that were culled, 0 to 1
+	float culled_ratio() const;
+
+private:
+	CullRect rect;
+	std::vector<int> indices;
+	CullStats counts;
+};
+
+#endif // __Cull_h_
@@ -0,0 +1,51 @@
+//-----------------------------------------------------------------------------
+// File: Cull_avx2.cpp
+//
+// Desc: AVX2 culling kernel. Built with AVX2 enabled; only called when
+//       cpu_simd_level() says the machine has it.
+//-----------------------------------------------------------------------------
+#include "Cull.h"
+#include "Cpu.h"
+
+#if defined(__AVX2__) || defined(_MSC_VER)
+#define CULL_AVX2 1
+#include <immintrin.h>
+#endif
+
+
+#if defined(CULL_AVX2)
+
+int cull_sprites_avx2(const float* x, const float* y, int n, float w, float h, const CullRect& view, int* visible)
+{
+	__m256 vx0 = _mm256_set1_ps(view.left - w);
+	__m256 vy0 = _mm256_set1_ps(view.top - h);
+	__m256 vx1 = _mm256_set1_ps(view.right);
+	__m256 vy1 = _mm256_set1_ps(view.bottom);
+	int count = 0;
+
+	int i = 0;
+	for (; i + 8 <= n; i += 8)
+	{
+		__m256 px = _mm256_loadu_ps(x + i);
+		__m256 py = _mm256_loadu_ps(y + i);
+		__m256 inside = _mm256_and_ps(
+			_mm256_and_ps(_mm256_cmp_ps(px, vx0, _CMP_GT_OQ), _mm256_cmp_ps(px, vx1, _CMP_LT_OQ)),
+			_mm256_and_ps(_mm256_cmp_ps(py, vy0, _CMP_GT_OQ), _mm256_cmp_ps(py, vy1, _CMP_LT_OQ)));
+		for (unsigned int bits = (unsigned int)_mm256_movemask_ps(inside); bits != 0; bits &= bits - 1)
+			visible[count++] = i + lowest_bit_index(bits);
+	}
+
+	int tail = cull_sprites_sse2(x + i, y + i, n - i, w, h, view, visible + count);
+	for (int k = 0; k < tail; k++)
+		visible[count + k] += i;
+	return count + tail;
+}
+
+#else
+
+int cull_sprites_avx2(const float* x, const float* y, int n, float w, float h, const CullRect& view, int* visible)
+{
+	return cull_sprites_sse2(x, y, n, w, h, view, visible);
+}
+
+#endif
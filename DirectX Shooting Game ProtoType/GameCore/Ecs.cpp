@@ -0,0 +1,324 @@
+//-----------------------------------------------------------------------------
+// File: Ecs.cpp
+//
+// Desc: Archetype entity store: archetype lookup, chunk layout, handles.
+//-----------------------------------------------------------------------------
+#include <stdlib.h>
+#include <string.h>
+
+#include "Ecs.h"
+
+
+static int round_up(int bytes)
+{
+	return (bytes + ECS_CACHE_LINE - 1) & ~(ECS_CACHE_LINE - 1);
+}
+
+
+EcsWorld::EcsWorld() : component_count(0), free_head(-1), live(0)
+{
+	memset(sizes, 0, sizeof(sizes));
+}
+
+
+EcsWorld::~EcsWorld()
+{
+	for (size_t a = 0; a < archetypes.size(); a++)
+	{
+		for (size_t c = 0; c < archetypes[a].chunks.size(); c++)
+			free(archetypes[a].chunks[c].memory);
+		free(archetypes[a].spare);
+	}
+}
+
+
+int EcsWorld::add_component_type(int size)
+{
+	if (component_count == ECS_MAX_COMPONENTS || size < 0)
+		return -1;
+	sizes[component_count] = size;
+	return component_count++;
+}
+
+
+// bytes of a chunk of capacity entities: every column, handles included,
+// rounded up to whole cache lines
+static int chunk_layout(const int* sizes, int count, EcsMask mask, int capacity, int* offset, int* handles_offset)
+{
+	int bytes = 0;
+	for (int c = 0; c < count; c++)
+	{
+		offset[c] = -1;
+		if ((mask & ECS_BIT(c)) && sizes[c] > 0)
+		{
+			offset[c] = bytes;
+			bytes += round_up(sizes[c] * capacity);
+		}
+	}
+	*handles_offset = bytes;
+	return bytes + round_up((int)sizeof(EcsHandle) * capacity);
+}
+
+
+int EcsWorld::find_archetype(EcsMask mask)
+{
+	for (size_t a = 0; a < archetypes.size(); a++)
+	{
+		if (archetypes[a].mask == mask)
+			return (int)a;
+	}
+
+	Archetype a;
+	a.mask = mask;
+	for (int c = 0; c < ECS_MAX_COMPONENTS; c++)
+		a.offset[c] = -1;
+
+	// as many as fit in a chunk once the columns are padded; an entity too
+	// big for a chunk gets a chunk to itself
+	int per_entity = (int)sizeof(EcsHandle);
+	for (int c = 0; c < component_count; c++)
+	{
+		if (mask & ECS_BIT(c))
+			per_entity += sizes[c];
+	}
+	a.capacity = ECS_CHUNK_BYTES / per_entity;
+	while (a.capacity > 1 && chunk_layout(sizes, component_count, mask, a.capacity, a.offset, &a.handles_offset) > ECS_CHUNK_BYTES)
+		a.capacity--;
+	if (a.capacity < 1)
+		a.capacity = 1;
+	a.bytes = chunk_layout(sizes, component_count, mask, a.capacity, a.offset, &a.handles_offset);
+	a.spare = NULL;
+
+	archetypes.push_back(a);
+	return (int)archetypes.size() - 1;
+}
+
+
+unsigned char* EcsWorld::at(const Archetype& a, const Chunk& c, int component, int row) const
+{
+	return c.base + a.offset[component] + sizes[component] * row;
+}
+
+
+EcsHandle* EcsWorld::handles(const Archetype& a, const Chunk& c) const
+{
+	return (EcsHandle*)(c.base + a.handles_offset);
+}
+
+
+// the entity at index goes at the end of the archetype, all zero
+void EcsWorld::append(int index, int archetype)
+{
+	Archetype& a = archetypes[archetype];
+	if (a.chunks.empty() || a.chunks.back().count == a.capacity)
+	{
+		Chunk c;
+		if (a.spare)
+		{
+			c.memory = a.spare;
+			a.spare = NULL;
+		}
+		else
+			c.memory = (unsigned char*)malloc(a.bytes + ECS_CACHE_LINE - 1);
+		c.base = (unsigned char*)(((size_t)c.memory + ECS_CACHE_LINE - 1) & ~(size_t)(ECS_CACHE_LINE - 1));
+		c.count = 0;
+		a.chunks.push_back(c);
+	}
+
+	Chunk& c = a.chunks.back();
+	int row = c.count++;
+	for (int k = 0; k < component_count; k++)
+	{
+		if (a.offset[k] >= 0)
+			memset(at(a, c, k, row), 0, sizes[k]);
+	}
+	Record& r = records[index];
+	handles(a, c)[row] = (r.generation << ECS_INDEX_BITS) | (EcsHandle)index;
+	r.archetype = archetype;
+	r.chunk = (int)a.chunks.size() - 1;
+	r.row = row;
+}
+
+
+// fill the hole at (chunk, row) with the archetype's last entity
+void EcsWorld::remove_row(int archetype, int chunk, int row)
+{
+	Archetype& a = archetypes[archetype];
+	Chunk& last = a.chunks.back();
+	int last_row = last.count - 1;
+	if (chunk != (int)a.chunks.size() - 1 || row != last_row)
+	{
+		Chunk& c = a.chunks[chunk];
+		for (int k = 0; k < component_count; k++)
+		{
+			if (a.offset[k] >= 0)
+				memcpy(at(a, c, k, row), at(a, last, k, last_row), sizes[k]);
+		}
+		EcsHandle moved = handles(a, last)[last_row];
+		handles(a, c)[row] = moved;
+		Record& r = records[moved & (ECS_MAX_ENTITIES - 1)];
+		r.chunk = chunk;
+		r.row = row;
+	}
+
+	// an emptied chunk is kept for the next one the archetype needs, so an
+	// entity going back and forth across a chunk boundary doesn't allocate
+	if (--last.count == 0)
+	{
+		if (a.spare)
+			free(last.memory);
+		else
+			a.spare = last.memory;
+		a.chunks.pop_back();
+	}
+}
+
+
+const EcsWorld::Record* EcsWorld::record(EcsHandle h) const
+{
+	unsigned int index = h & (ECS_MAX_ENTITIES - 1);
+	if (index >= records.size())
+		return NULL;
+	const Record& r = records[index];
+	if (r.archetype < 0 || r.generation != h >> ECS_INDEX_BITS)
+		return NULL;
+	return &r;
+}
+
+
+EcsHandle EcsWorld::create(EcsMask mask)
+{
+	int index = free_head;
+	if (index >= 0)
+		free_head = records[index].row;
+	else
+	{
+		if ((int)records.size() == ECS_MAX_ENTITIES)
+			return ECS_NULL;
+		Record r;
+		r.generation = 1;
+		records.push_back(r);
+		index = (int)records.size() - 1;
+	}
+
+	append(index, find_archetype(mask));
+	live++;
+	return (records[index].generation << ECS_INDEX_BITS) | (EcsHandle)index;
+}
+
+
+bool EcsWorld::destroy(EcsHandle h)
+{
+	if (!record(h))
+		return false;
+	int index = (int)(h & (ECS_MAX_ENTITIES - 1));
+	Record& r = records[index];
+	remove_row(r.archetype, r.chunk, r.row);
+
+	// a new generation for whoever gets the index next; 0 is skipped so a
+	// live handle is never ECS_NULL
+	r.archetype = -1;
+	r.generation = (r.generation + 1) & ECS_GENERATION_MASK;
+	if (r.generation == 0)
+		r.generation = 1;
+	r.row = free_head;
+	free_head = index;
+	live--;
+	return true;
+}
+
+
+bool EcsWorld::alive(EcsHandle h) const
+{
+	return record(h) != NULL;
+}
+
+
+EcsMask EcsWorld::mask_of(EcsHandle h) const
+{
+	const Record* r = record(h);
+	return r ? archetypes[r->archetype].mask : 0;
+}
+
+
+void* EcsWorld::get(EcsHandle h, int component)
+{
+	const Record* r = record(h);
+	if (!r || component < 0 || component >= component_count)
+		return NULL;
+	const Archetype& a = archetypes[r->archetype];
+	if (a.offset[component] < 0)
+		return NULL;
+	return at(a, a.chunks[r->chunk], component, r->row);
+}
+
+
+// the entity moves to the archetype of mask, keeping what both have
+bool EcsWorld::change_archetype(EcsHandle h, EcsMask mask)
+{
+	const Record* found = record(h);
+	if (!found)
+		return false;
+	int from = found->archetype;
+	if (archetypes[from].mask == mask)
+		return true;
+
+	int index = (int)(h & (ECS_MAX_ENTITIES - 1));
+	int chunk = found->chunk, row = found->row;
+	int to = find_archetype(mask);
+	append(index, to);
+
+	const Archetype& a = archetypes[from];
+	const Archetype& b = archetypes[to];
+	const Record& r = records[index];
+	for (int k = 0; k < component_count; k++)
+	{
+		if (a.offset[k] >= 0 && b.offset[k] >= 0)
+			memcpy(at(b, b.chunks[r.chunk], k, r.row), at(a, a.chunks[chunk], k, row), sizes[k]);
+	}
+	remove_row(from, chunk, row);
+	return true;
+}
+
+
+bool EcsWorld::add_component(EcsHandle h, int component)
+{
+	if (component < 0 || component >= component_count)
+		return false;
+	return change_archetype(h, mask_of(h) | ECS_BIT(component));
+}
+
+
+bool EcsWorld::remove_component(EcsHandle h, int component)
+{
+	if (component < 0 || component >= component_count)
+		return false;
+	return change_archetype(h, mask_of(h) & ~ECS_BIT(component));
+}
+
+
+void EcsWorld::each_chunk(EcsMask mask, EcsSystem system, void* data)
+{
+	for (size_t i = 0; i < archetypes.size(); i++)
+	{
+		const Archetype& a = archetypes[i];
+		if ((a.mask & mask) != mask)
+			continue;
+		for (size_t c = 0; c < a.chunks.size(); c++)
+		{
+			const Chunk& chunk = a.chunks[c];
+			EcsChunk view;
+			view.count = chunk.count;
+			view.handles = handles(a, chunk);
+			for (int k = 0; k < ECS_MAX_COMPONENTS; k++)
+				view.columns[k] = a.offset[k] >= 0 ? chunk.base + a.offset[k] : NULL;
+			system(view, data);
+		}
+	}
+}
+
+
+int EcsWorld::chunk_capacity(EcsMask mask)
+{
+	return archetypes[find_archetype(mask)].capacity;
+}
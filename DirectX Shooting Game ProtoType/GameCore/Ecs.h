@@ -0,0 +1,144 @@
+//-----------------------------------------------------------------------------
+// File: Ecs.h
+//
+// Desc: Archetype entity store. A kind of object is just the set of
+//       components it has (position, velocity, hit points, tags ...), so a
+//       new kind needs no new code: every entity with the same set lives in
+//       the same archetype, in fixed-size chunks.
+//
+//       A chunk holds each component as its own column, every column
+//       starting on a cache line, so a system walks the chunks of every
+//       archetype that has the components it wants and streams straight
+//       down the columns. Chunks stay packed: removing an entity moves the
+//       archetype's last entity into its place.
+//
+//       Entities are named by 32-bit handles, an index and a generation.
+//       The generation goes up every time an index is freed, so a handle
+//       kept past its entity's death (a target that was shot and respawned
+//       as a new entity) is recognized as stale instead of reaching the
+//       entity that took its place.
+//
+//       Components are plain data, copied with memcpy and created zeroed.
+//       Size 0 components are tags: they only select the archetype.
+//
+//       Nothing in the game runs on it yet: it builds as its own library
+//       for bench_ecs, which measures it against ProjectilePool, and is not
+//       part of the game's project.
+//-----------------------------------------------------------------------------
+#ifndef __Ecs_h_
+#define __Ecs_h_
+
+#include <vector>
+
+#define ECS_CHUNK_BYTES 16384
+#define ECS_CACHE_LINE 64
+#define ECS_MAX_COMPONENTS 32
+
+// handle = generation << ECS_INDEX_BITS | index; 0 is never a live handle
+#define ECS_INDEX_BITS 22
+#define ECS_MAX_ENTITIES (1 << ECS_INDEX_BITS)
+#define ECS_GENERATION_MASK ((1u << (32 - ECS_INDEX_BITS)) - 1)
+#define ECS_NULL 0u
+
+typedef unsigned int EcsHandle;
+typedef unsigned int EcsMask;    // one bit per component id
+
+#define ECS_BIT(component) (1u << (component))
+
+
+// one chunk of one archetype, as a system sees it
+struct EcsChunk {
+	int count;
+	const EcsHandle* handles;
+	unsigned char* columns[ECS_MAX_COMPONENTS];    // NULL for components the archetype lacks
+
+	// column of a component, as the type it was registered with
+	template <typename T>
+	T* column(int component) const { return (T*)columns[component]; }
+};
+
+typedef void (*EcsSystem)(const EcsChunk& chunk, void* data);
+
+
+class EcsWorld {
+
+public:
+	EcsWorld();
+	~EcsWorld();
+
+	// returns the component id, or -1 when there are ECS_MAX_COMPONENTS
+	// already
+	int add_component_type(int size);
+
+	// a new entity with the components of mask, all zero; ECS_NULL when
+	// every index is in use
+	EcsHandle create(EcsMask mask);
+
+	// false if the handle is stale
+	bool destroy(EcsHandle h);
+	bool alive(EcsHandle h) const;
+
+	// the component of a live entity; NULL if the handle is stale or the
+	// entity doesn't have it (or it is a tag: use mask_of). Only good until
+	// the next create, destroy or change of components.
+	void* get(EcsHandle h, int component);
+
+	// move an entity to the archetype with or without one component; the
+	// others keep their values, an added one starts at zero
+	bool add_component(EcsHandle h, int component);
+	bool remove_component(EcsHandle h, int component);
+
+	EcsMask mask_of(EcsHandle h) const;
+	int count() const { return live; }
+
+	// call system on every chunk of every archetype that has all the
+	// components of mask, archetype by archetype in creation order
+	void each_chunk(EcsMask mask, EcsSystem system, void* data);
+
+	// entities one chunk of an archetype with this mask holds
+	int chunk_capacity(EcsMask mask);
+
+private:
+	struct Chunk {
+		unsigned char* memory;      // as allocated
+		unsigned char* base;        // cache line aligned
+		int count;
+	};
+
+	struct Archetype {
+		EcsMask mask;
+		int capacity;                          // entities per chunk
+		int offset[ECS_MAX_COMPONENTS];        // column offsets, -1 if absent
+		int handles_offset;
+		int bytes;                             // one chunk, before alignment
+		std::vector<Chunk> chunks;             // all full but the last
+		unsigned char* spare;                  // an emptied chunk, kept for reuse
+	};
+
+	struct Record {
+		int archetype;     // -1 while free
+		int chunk;
+		int row;           // while free: the next free index, or -1
+		unsigned int generation;
+	};
+
+	EcsWorld(const EcsWorld&);
+	EcsWorld& operator=(const EcsWorld&);
+
+	int find_archetype(EcsMask mask);
+	void append(int index, int archetype);
+	void remove_row(int archetype, int chunk, int row);
+	bool change_archetype(EcsHandle h, EcsMask mask);
+	unsigned char* at(const Archetype& a, const Chunk& c, int component, int row) const;
+	EcsHandle* handles(const Archetype& a, const Chunk& c) const;
+	const Record* record(EcsHandle h) const;
+
+	int sizes[ECS_MAX_COMPONENTS];
+	int component_count;
+	std::vector<Archetype> archetypes;
+	std::vector<Record> records;
+	int free_head;
+	int live;
+};
+
+#endif // __Ecs_h_
@@ -0,0 +1,90 @@
+//-----------------------------------------------------------------------------
+// File: Emitter.cpp
+//
+// Desc: Bullet pattern tables and the batched volley writer.
+//-----------------------------------------------------------------------------
+#include <math.h>
+
+#include "Emitter.h"
+
+#define PATTERN_PI 3.14159265358979f
+
+
+int PatternTable::add(const BulletPattern& p)
+{
+	int id = (int)patterns.size();
+	patterns.push_back(p);
+	first.push_back((int)unit_x.size());
+
+	for (int k = 0; k < p.count; k++)
+	{
+		float a;
+		if (p.type == PATTERN_AIMED_FAN)
+			a = p.count > 1 ? -0.5f * p.spread + p.spread * k / (p.count - 1) : 0.0f;
+		else
+			a = 2 * PATTERN_PI * k / p.count;
+		unit_x.push_back(cosf(a));
+		unit_y.push_back(sinf(a));
+	}
+	return id;
+}
+
+
+void PatternTable::clear()
+{
+	patterns.clear();
+	first.clear();
+	unit_x.clear();
+	unit_y.clear();
+}
+
+
+float PatternTable::volley_angle(int id, int volley, float x, float y, float tx, float ty) const
+{
+	const BulletPattern& p = patterns[id];
+	switch (p.type)
+	{
+	case PATTERN_SPIRAL:
+		return p.angle + p.spin * (float)volley;
+	case PATTERN_AIMED_FAN:
+		return atan2f(ty - y, tx - x);
+	}
+	return p.angle;
+}
+
+
+int fire_volleys(const PatternTable& table, const Volley* volleys, int n, ProjectilePool& pool)
+{
+	int spawned = 0;
+
+	for (int v = 0; v < n; v++)
+	{
+		const BulletPattern& p = table.get(volleys[v].pattern);
+		int got = pool.spawn_batch(p.count);
+		if (got == 0)
+			break;
+
+		int first = pool.count() - got;
+		float* x = pool.x.data() + first;
+		float* y = pool.y.data() + first;
+		float* vx = pool.vx.data() + first;
+		float* vy = pool.vy.data() + first;
+		const float* ux = table.dir_x(volleys[v].pattern);
+		const float* uy = table.dir_y(volleys[v].pattern);
+
+		// rotate the unit table by the volley angle and scale by the speed
+		float ox = volleys[v].x;
+		float oy = volleys[v].y;
+		float c = cosf(volleys[v].angle) * p.speed;
+		float s = sinf(volleys[v].angle) * p.speed;
+		for (int k = 0; k < got; k++)
+		{
+			x[k] = ox;
+			y[k] = oy;
+			vx[k] = ux[k] * c - uy[k] * s;
+			vy[k] = ux[k] * s + uy[k] * c;
+		}
+		spawned += got;
+	}
+	return spawned;
+}
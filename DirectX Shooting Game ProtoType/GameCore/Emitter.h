@@ -0,0 +1,75 @@
+//-----------------------------------------------------------------------------
+// File: Emitter.h
+//
+// Desc: Data-driven bullet patterns. A pattern is a handful of numbers
+//       (shape, volley size, speed, spread, spin); the directions of one
+//       volley are worked out once when the pattern is added, so firing a
+//       volley is a single rotate-and-scale loop straight into the
+//       projectile pool's arrays, with no trig per bullet.
+//
+//       Emitters keep no state of their own: the game queues a Volley for
+//       every emitter that fires this tick, then fire_volleys() writes them
+//       all out in one batch.
+//-----------------------------------------------------------------------------
+#ifndef __Emitter_h_
+#define __Emitter_h_
+
+#include <vector>
+
+#include "ProjectilePool.h"
+
+// pattern shapes; angles are in radians, 0 along +x and PI/2 straight down
+enum {
+	PATTERN_RADIAL,       // count bullets evenly around a circle
+	PATTERN_SPIRAL,       // a radial volley that turns by spin every volley
+	PATTERN_AIMED_FAN     // count bullets over spread radians, centred on the target
+};
+
+struct BulletPattern {
+	int type;
+	int interval;     // ticks between volleys
+	int count;        // bullets per volley
+	float speed;      // pixels per second
+	float spread;     // fan width in radians (aimed fans only)
+	float spin;       // radians added per volley (spirals only)
+	float angle;      // base direction (radial and spiral)
+};
+
+// one emitter firing one volley this tick
+struct Volley {
+	float x, y;       // origin
+	float angle;      // direction the volley's unit table is rotated to
+	int pattern;
+};
+
+class PatternTable {
+
+public:
+	// returns the new pattern's id
+	int add(const BulletPattern& p);
+	void clear();
+
+	int count() const { return (int)patterns.size(); }
+	const BulletPattern& get(int id) const { return patterns[id]; }
+
+	// base angle of volley number `volley` of pattern id fired from (x, y)
+	// at a target at (tx, ty)
+	float volley_angle(int id, int volley, float x, float y, float tx, float ty) const;
+
+	// unit directions of one volley, before rotating by the volley angle
+	const float* dir_x(int id) const { return &unit_x[first[id]]; }
+	const float* dir_y(int id) const { return &unit_y[first[id]]; }
+
+private:
+	std::vector<BulletPattern> patterns;
+	std::vector<int> first;
+	std::vector<float> unit_x;
+	std::vector<float> unit_y;
+};
+
+
+// spawn every queued volley into pool; stops quietly when the pool is full.
+// Returns how many bullets were spawned.
+int fire_volleys(const PatternTable& table, const Volley* volleys, int n, ProjectilePool& pool);
+
+#endif // __Emitter_h_
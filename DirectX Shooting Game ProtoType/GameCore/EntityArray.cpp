@@ -0,0 +1,38 @@
+//-----------------------------------------------------------------------------
+// File: EntityArray.cpp
+//
+// Desc: Dense update loops over an EntityArray. They are written without
+//       per-entity branches so the compiler can vectorize them.
+//-----------------------------------------------------------------------------
+#include "EntityArray.h"
+
+
+void EntityArray::resize(int n, int start_hp)
+{
+	x.assign(n, 0.0f);
+	y.assign(n, 0.0f);
+	alive.assign(n, 0);
+	hp.assign(n, start_hp);
+}
+
+
+void move_entities(EntityArray& a, float dx, float dy)
+{
+	move_entities(a, 0, a.count(), dx, dy);
+}
+
+
+void move_entities(EntityArray& a, int begin, int end, float dx, float dy)
+{
+	float* x = a.x.data();
+	float* y = a.y.data();
+
+	if (dx != 0)
+	{
+		for (int i = begin; i < end; i++)
+			x[i] += dx;
+	}
+	for (int i = begin; i < end; i++)
+		y[i] += dy;
+}
+
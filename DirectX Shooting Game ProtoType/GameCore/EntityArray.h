@@ -0,0 +1,32 @@
+//-----------------------------------------------------------------------------
+// File: EntityArray.h
+//
+// Desc: Struct-of-arrays storage for one archetype of game objects. Each
+//       field lives in its own contiguous array so the per-tick loops stream
+//       over exactly the data they touch.
+//-----------------------------------------------------------------------------
+#ifndef __EntityArray_h_
+#define __EntityArray_h_
+
+#include <vector>
+
+struct EntityArray {
+	std::vector<float> x;
+	std::vector<float> y;
+	std::vector<unsigned char> alive;    // 1 while the entity is in play
+	std::vector<int> hp;
+
+	int count() const { return (int)x.size(); }
+
+	// every slot starts dead at the origin with the given hit points
+	void resize(int n, int start_hp);
+};
+
+
+// move every slot by (dx, dy); dead slots move too, which is harmless
+void move_entities(EntityArray& a, float dx, float dy);
+
+// the same for the slots [begin, end) only
+void move_entities(EntityArray& a, int begin, int end, float dx, float dy);
+
+#endif // __EntityArray_h_
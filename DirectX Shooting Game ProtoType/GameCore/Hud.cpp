@@ -0,0 +1,294 @@
+//-----------------------------------------------------------------------------
+// File: Hud.cpp
+//
+// Desc: Glyph packing, label layout and the cached HUD vertex block.
+//-----------------------------------------------------------------------------
+#include <string.h>
+
+#include "Hud.h"
+
+// every label gets one draw's worth of quads at most between them
+#define HUD_MAX_LABELS (SPRITE_DRAW_QUADS / HUD_LABEL_CHARS)
+
+
+GlyphAtlas::GlyphAtlas()
+	: page_w(0), page_h(0), line(0), premultiply(false)
+{
+	memset(present, 0, sizeof(present));
+}
+
+
+void GlyphAtlas::init(int page_w_, int page_h_, int line_height, bool premultiplied)
+{
+	page_w = page_w_;
+	page_h = page_h_;
+	line = line_height;
+	premultiply = premultiplied;
+	packer.init(page_w, page_h);
+	argb.assign((size_t)page_w * page_h, 0);
+	memset(present, 0, sizeof(present));
+}
+
+
+bool GlyphAtlas::add(int code, const unsigned char* coverage, int w, int h, int pitch, int xoff, int yoff, int advance)
+{
+	if (code < GLYPH_FIRST || code > GLYPH_LAST)
+		return false;
+
+	Glyph& g = glyphs[code - GLYPH_FIRST];
+	g.w = w > 0 && h > 0 ? w : 0;
+	g.h = w > 0 && h > 0 ? h : 0;
+	g.xoff = xoff;
+	g.yoff = yoff;
+	g.advance = advance;
+	g.u0 = g.v0 = g.u1 = g.v1 = 0;
+
+	if (g.w > 0)
+	{
+		AtlasRect r;
+		if (!packer.insert(w + 2 * GLYPH_PADDING, h + 2 * GLYPH_PADDING, r))
+			return false;
+		int x0 = r.x + GLYPH_PADDING, y0 = r.y + GLYPH_PADDING;
+		for (int y = 0; y < h; y++)
+		{
+			const unsigned char* src = coverage + (size_t)y * pitch;
+			unsigned int* dst = &argb[(size_t)(y0 + y) * page_w + x0];
+			for (int x = 0; x < w; x++)
+			{
+				unsigned int a = src[x];
+				unsigned int c = premultiply ? a : 0xff;
+				dst[x] = (a << 24) | (c << 16) | (c << 8) | c;
+			}
+		}
+		g.u0 = (float)x0 / page_w;
+		g.v0 = (float)y0 / page_h;
+		g.u1 = (float)(x0 + w) / page_w;
+		g.v1 = (float)(y0 + h) / page_h;
+	}
+	present[code - GLYPH_FIRST] = true;
+	return true;
+}
+
+
+const Glyph* GlyphAtlas::glyph(int code) const
+{
+	if (code < GLYPH_FIRST || code > GLYPH_LAST || !present[code - GLYPH_FIRST])
+		return NULL;
+	return &glyphs[code - GLYPH_FIRST];
+}
+
+
+int hud_format_int(char* out, int value)
+{
+	// digits come out backwards; the magnitude is unsigned so INT_MIN works
+	char digits[12];
+	unsigned int v = value < 0 ? 0u - (unsigned int)value : (unsigned int)value;
+	int n = 0;
+	do
+	{
+		digits[n++] = (char)('0' + v % 10);
+		v /= 10;
+	} while (v != 0);
+
+	int length = 0;
+	if (value < 0)
+		out[length++] = '-';
+	while (n > 0)
+		out[length++] = digits[--n];
+	out[length] = 0;
+	return length;
+}
+
+
+Hud::Hud()
+	: font(NULL), texture(0), pixel_offset(0), quads(0), dirty(false)
+{
+	memset(&last, 0, sizeof(last));
+}
+
+
+void Hud::init(const GlyphAtlas* font_, int texture_, int max_labels, float pixel_offset_)
+{
+	font = font_;
+	texture = texture_;
+	pixel_offset = pixel_offset_;
+	if (max_labels > HUD_MAX_LABELS)
+		max_labels = HUD_MAX_LABELS;
+
+	labels.clear();
+	labels.reserve(max_labels);
+	label_vertices.resize(4 * (size_t)max_labels * HUD_LABEL_CHARS);
+	vertices.resize(label_vertices.size());
+
+	indices.resize(6 * (size_t)max_labels * HUD_LABEL_CHARS);
+	for (int q = 0; q < max_labels * HUD_LABEL_CHARS; q++)
+	{
+		unsigned short v = (unsigned short)(4 * q);
+		unsigned short* i = &indices[6 * q];
+		i[0] = v;
+		i[1] = v + 1;
+		i[2] = v + 2;
+		i[3] = v;
+		i[4] = v + 2;
+		i[5] = v + 3;
+	}
+	quads = 0;
+	dirty = false;
+}
+
+
+int Hud::add_label(float x, float y, unsigned int color)
+{
+	if (labels.size() == labels.capacity())
+		return -1;
+
+	Label l;
+	l.x = x;
+	l.y = y;
+	l.color = color;
+	l.text[0] = 0;
+	l.quads = 0;
+	l.dirty = false;
+	labels.push_back(l);
+	return (int)labels.size() - 1;
+}
+
+
+void Hud::mark(int label)
+{
+	labels[label].dirty = true;
+	dirty = true;
+}
+
+
+void Hud::set_text(int label, const char* text)
+{
+	Label& l = labels[label];
+	if (strncmp(l.text, text, HUD_LABEL_CHARS) == 0)
+		return;
+
+	strncpy(l.text, text, HUD_LABEL_CHARS);
+	l.text[HUD_LABEL_CHARS] = 0;
+	mark(label);
+}
+
+
+void Hud::set_number(int label, const char* prefix, int value)
+{
+	char text[HUD_LABEL_CHARS + 1];
+	size_t length = strlen(prefix);
+	if (length > HUD_LABEL_CHARS - 12)
+		length = HUD_LABEL_CHARS - 12;
+	memcpy(text, prefix, length);
+	hud_format_int(text + length, value);
+	set_text(label, text);
+}
+
+
+void Hud::set_color(int label, unsigned int color)
+{
+	if (labels[label].color == color)
+		return;
+	labels[label].color = color;
+	mark(label);
+}
+
+
+void Hud::set_position(int label, float x, float y)
+{
+	Label& l = labels[label];
+	if (l.x == x && l.y == y)
+		return;
+	l.x = x;
+	l.y = y;
+	mark(label);
+}
+
+
+void Hud::invalidate()
+{
+	for (size_t i = 0; i < labels.size(); i++)
+		labels[i].dirty = true;
+	dirty = true;
+}
+
+
+// the label's glyph quads into its own slice of label_vertices
+void Hud::layout(int label)
+{
+	Label& l = labels[label];
+	SpriteVertex* v = &label_vertices[4 * (size_t)label * HUD_LABEL_CHARS];
+	float pen_x = l.x + pixel_offset;
+	float pen_y = l.y + pixel_offset;
+	int n = 0;
+
+	for (const char* c = l.text; *c; c++)
+	{
+		if (*c == '\n')
+		{
+			pen_x = l.x + pixel_offset;
+			pen_y += font->line_height();
+			continue;
+		}
+
+		const Glyph* g = font->glyph((unsigned char)*c);
+		if (!g)
+			g = font->glyph('?');
+		if (!g)
+			continue;
+
+		if (g->w > 0)
+		{
+			float x0 = pen_x + g->xoff, y0 = pen_y + g->yoff;
+			float x1 = x0 + g->w, y1 = y0 + g->h;
+			v[0].x = x0; v[0].y = y0; v[0].u = g->u0; v[0].v = g->v0;
+			v[1].x = x1; v[1].y = y0; v[1].u = g->u1; v[1].v = g->v0;
+			v[2].x = x1; v[2].y = y1; v[2].u = g->u1; v[2].v = g->v1;
+			v[3].x = x0; v[3].y = y1; v[3].u = g->u0; v[3].v = g->v1;
+			for (int k = 0; k < 4; k++)
+			{
+				v[k].z = 0.0f;
+				v[k].rhw = 1.0f;
+				v[k].color = l.color;
+			}
+			v += 4;
+			n++;
+		}
+		pen_x += g->advance;
+	}
+	l.quads = n;
+	l.dirty = false;
+}
+
+
+void Hud::draw(SpriteBackend& backend)
+{
+	memset(&last, 0, sizeof(last));
+
+	// changed labels are laid out again, then every label's quads are
+	// copied into the block in label order
+	if (dirty)
+	{
+		quads = 0;
+		for (int i = 0; i < (int)labels.size(); i++)
+		{
+			if (labels[i].dirty)
+			{
+				layout(i);
+				last.labels_laid_out++;
+			}
+			memcpy(&vertices[4 * (size_t)quads], &label_vertices[4 * (size_t)i * HUD_LABEL_CHARS],
+				4 * labels[i].quads * sizeof(SpriteVertex));
+			quads += labels[i].quads;
+		}
+		dirty = false;
+		last.rebuilt = true;
+	}
+
+	last.quads = quads;
+	if (quads > 0)
+	{
+		backend.draw(texture, vertices.data(), quads, indices.data());
+		last.draw_calls = 1;
+	}
+}
@@ -0,0 +1,143 @@
+//-----------------------------------------------------------------------------
+// File: Hud.h
+//
+// Desc: Retained HUD text. The glyphs of one font are rasterized once into
+//       a glyph atlas page; the HUD is a fixed set of labels drawn from it.
+//
+//       Each label keeps its glyph quads laid out, and the HUD keeps the
+//       quads of every label packed into one vertex block. A label is laid
+//       out again only when its text, color or position changes, and the
+//       block is rebuilt only when some label did, so a frame where nothing
+//       changed is one draw call of vertices built earlier.
+//
+//       Numbers are formatted into the labels' fixed buffers, and nothing
+//       is allocated after init().
+//
+//       Glyphs come from the platform (GDI in the game, generated ones in
+//       the benchmarks) as 8-bit coverage; the page holds white texels with
+//       that coverage as alpha, straight or premultiplied to match the
+//       sprite blend state.
+//-----------------------------------------------------------------------------
+#ifndef __Hud_h_
+#define __Hud_h_
+
+#include <vector>
+
+#include "Atlas.h"
+#include "SpriteBatch.h"
+
+// the characters a glyph atlas can hold
+#define GLYPH_FIRST 32
+#define GLYPH_LAST 126
+#define GLYPH_NUM (GLYPH_LAST - GLYPH_FIRST + 1)
+
+// empty pixels around every glyph, so filtering never reaches a neighbour
+#define GLYPH_PADDING 1
+
+#define HUD_LABEL_CHARS 64     // longest label text, without the terminator
+
+struct Glyph {
+	int w, h;              // size of the bitmap; 0 for blank glyphs like space
+	int xoff, yoff;        // bitmap corner from the pen position at the top of the line
+	int advance;           // pen movement to the next glyph
+	float u0, v0, u1, v1;
+};
+
+
+class GlyphAtlas {
+
+public:
+	GlyphAtlas();
+
+	void init(int page_w, int page_h, int line_height, bool premultiplied);
+
+	// pack one glyph; coverage is w x h bytes, rows pitch bytes apart.
+	// False when the code is out of range or the page is full.
+	bool add(int code, const unsigned char* coverage, int w, int h, int pitch, int xoff, int yoff, int advance);
+
+	// NULL for characters that were never added
+	const Glyph* glyph(int code) const;
+
+	int line_height() const { return line; }
+	bool premultiplied() const { return premultiply; }
+	const unsigned int* pixels() const { return argb.data(); }
+	int width() const { return page_w; }
+	int height() const { return page_h; }
+
+private:
+	MaxRectsPacker packer;
+	std::vector<unsigned int> argb;
+	Glyph glyphs[GLYPH_NUM];
+	bool present[GLYPH_NUM];
+	int page_w, page_h;
+	int line;
+	bool premultiply;
+};
+
+
+struct HudStats {
+	int labels_laid_out;    // labels whose quads were rebuilt this frame
+	int quads;
+	int draw_calls;
+	bool rebuilt;           // the vertex block was put back together
+};
+
+
+class Hud {
+
+public:
+	Hud();
+
+	// font is drawn as texture; pixel_offset is added to every vertex as in
+	// SpriteBatch::init()
+	void init(const GlyphAtlas* font, int texture, int max_labels, float pixel_offset);
+
+	// a new empty label with its top-left corner at (x, y); -1 when full
+	int add_label(float x, float y, unsigned int color);
+
+	// each of these does nothing when the label already looks that way.
+	// Text longer than HUD_LABEL_CHARS is cut; '\n' starts a new line.
+	void set_text(int label, const char* text);
+	void set_number(int label, const char* prefix, int value);
+	void set_color(int label, unsigned int color);
+	void set_position(int label, float x, float y);
+
+	// lay every label out again on the next draw
+	void invalidate();
+
+	// draws the whole HUD with one call, laying out what changed first
+	void draw(SpriteBackend& backend);
+
+	const char* text(int label) const { return labels[label].text; }
+	const HudStats& stats() const { return last; }
+
+private:
+	struct Label {
+		float x, y;
+		unsigned int color;
+		char text[HUD_LABEL_CHARS + 1];
+		int quads;      // glyph quads in its slice of label_vertices
+		bool dirty;
+	};
+
+	void layout(int label);
+	void mark(int label);
+
+	const GlyphAtlas* font;
+	int texture;
+	float pixel_offset;
+	std::vector<Label> labels;
+	std::vector<SpriteVertex> label_vertices;    // HUD_LABEL_CHARS quads per label
+	std::vector<SpriteVertex> vertices;          // every label's quads, packed
+	std::vector<unsigned short> indices;
+	int quads;
+	bool dirty;
+	HudStats last;
+};
+
+
+// value in decimal at out, which needs room for 12 characters; returns the
+// length
+int hud_format_int(char* out, int value);
+
+#endif // __Hud_h_
@@ -0,0 +1,388 @@
+//-----------------------------------------------------------------------------
+// File: ImageFile.cpp
+//
+// Desc: PPM and PNG writers, the PPM reader and the PNG decoder.
+//-----------------------------------------------------------------------------
+#include <stdio.h>
+#include <string.h>
+
+#include "ImageFile.h"
+#include "Inflate.h"
+#include "MappedFile.h"
+
+// PNG stored blocks hold at most this many bytes
+#define PNG_STORED_MAX 65535
+
+
+static void argb_to_rgb(const unsigned int* argb, int n, unsigned char* rgb)
+{
+	for (int i = 0; i < n; i++)
+	{
+		rgb[3 * i] = (unsigned char)(argb[i] >> 16);
+		rgb[3 * i + 1] = (unsigned char)(argb[i] >> 8);
+		rgb[3 * i + 2] = (unsigned char)argb[i];
+	}
+}
+
+
+bool save_ppm(const char* path, const unsigned int* argb, int w, int h)
+{
+	FILE* f = fopen(path, "wb");
+	if (!f)
+		return false;
+
+	fprintf(f, "P6\n%d %d\n255\n", w, h);
+	std::vector<unsigned char> row(3 * (size_t)w);
+	bool ok = true;
+	for (int y = 0; y < h; y++)
+	{
+		argb_to_rgb(argb + (size_t)y * w, w, row.data());
+		ok = fwrite(row.data(), 1, row.size(), f) == row.size() && ok;
+	}
+	return fclose(f) == 0 && ok;
+}
+
+
+bool load_ppm(const char* path, std::vector<unsigned int>& argb, int& w, int& h)
+{
+	FILE* f = fopen(path, "rb");
+	if (!f)
+		return false;
+
+	int max = 0;
+	bool ok = fscanf(f, "P6 %d %d %d", &w, &h, &max) == 3 && max == 255 && w > 0 && h > 0 && fgetc(f) != EOF;
+	if (ok)
+	{
+		std::vector<unsigned char> rgb(3 * (size_t)w * h);
+		ok = fread(rgb.data(), 1, rgb.size(), f) == rgb.size();
+		argb.resize((size_t)w * h);
+		for (size_t i = 0; ok && i < argb.size(); i++)
+			argb[i] = 0xff000000u | ((unsigned int)rgb[3 * i] << 16) | ((unsigned int)rgb[3 * i + 1] << 8) | rgb[3 * i + 2];
+	}
+	fclose(f);
+	return ok;
+}
+
+
+struct CrcTable {
+	unsigned int entry[256];
+	CrcTable();
+};
+
+
+CrcTable::CrcTable()
+{
+	for (unsigned int i = 0; i < 256; i++)
+	{
+		unsigned int c = i;
+		for (int k = 0; k < 8; k++)
+			c = c & 1 ? 0xedb88320u ^ (c >> 1) : c >> 1;
+		entry[i] = c;
+	}
+}
+
+
+static unsigned int crc32(unsigned int crc, const unsigned char* p, size_t n)
+{
+	static const CrcTable table;
+
+	crc = ~crc;
+	for (size_t i = 0; i < n; i++)
+		crc = table.entry[(crc ^ p[i]) & 0xff] ^ (crc >> 8);
+	return ~crc;
+}
+
+
+static void put_be32(std::vector<unsigned char>& out, unsigned int v)
+{
+	out.push_back((unsigned char)(v >> 24));
+	out.push_back((unsigned char)(v >> 16));
+	out.push_back((unsigned char)(v >> 8));
+	out.push_back((unsigned char)v);
+}
+
+
+// length, type, data, crc of type and data
+static bool write_chunk(FILE* f, const char* type, const std::vector<unsigned char>& data)
+{
+	std::vector<unsigned char> chunk;
+	chunk.reserve(data.size() + 12);
+	put_be32(chunk, (unsigned int)data.size());
+	chunk.insert(chunk.end(), type, type + 4);
+	chunk.insert(chunk.end(), data.begin(), data.end());
+	put_be32(chunk, crc32(0, &chunk[4], data.size() + 4));
+	return fwrite(chunk.data(), 1, chunk.size(), f) == chunk.size();
+}
+
+
+// 8-bit RGB, or RGBA when alpha is kept
+static bool write_png(const char* path, const unsigned int* argb, int w, int h, bool alpha)
+{
+	FILE* f = fopen(path, "wb");
+	if (!f)
+		return false;
+
+	static const unsigned char signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+	bool ok = fwrite(signature, 1, 8, f) == 8;
+
+	int channels = alpha ? 4 : 3;
+	std::vector<unsigned char> ihdr;
+	put_be32(ihdr, (unsigned int)w);
+	put_be32(ihdr, (unsigned int)h);
+	ihdr.push_back(8);
+	ihdr.push_back(alpha ? 6 : 2);
+	ihdr.push_back(0);
+	ihdr.push_back(0);
+	ihdr.push_back(0);
+	ok = ok && write_chunk(f, "IHDR", ihdr);
+
+	// every row is filter type 0 followed by its pixels
+	size_t stride = channels * (size_t)w + 1;
+	std::vector<unsigned char> raw(stride * h);
+	std::vector<unsigned char> row_rgb(3 * (size_t)w);
+	for (int y = 0; y < h; y++)
+	{
+		raw[y * stride] = 0;
+		if (alpha)
+		{
+			unsigned char* out = &raw[y * stride + 1];
+			argb_to_rgb(argb + (size_t)y * w, w, row_rgb.data());
+			for (int x = 0; x < w; x++)
+			{
+				memcpy(out + 4 * x, &row_rgb[3 * x], 3);
+				out[4 * x + 3] = (unsigned char)(argb[(size_t)y * w + x] >> 24);
+			}
+		}
+		else
+			argb_to_rgb(argb + (size_t)y * w, w, &raw[y * stride + 1]);
+	}
+
+	// a zlib stream of stored blocks
+	std::vector<unsigned char> z;
+	z.reserve(raw.size() + raw.size() / PNG_STORED_MAX * 5 + 16);
+	z.push_back(0x78);
+	z.push_back(0x01);
+	size_t pos = 0;
+	do
+	{
+		size_t n = raw.size() - pos < PNG_STORED_MAX ? raw.size() - pos : PNG_STORED_MAX;
+		z.push_back(pos + n == raw.size() ? 1 : 0);
+		z.push_back((unsigned char)n);
+		z.push_back((unsigned char)(n >> 8));
+		z.push_back((unsigned char)~n);
+		z.push_back((unsigned char)(~n >> 8));
+		z.insert(z.end(), raw.begin() + pos, raw.begin() + pos + n);
+		pos += n;
+	} while (pos < raw.size());
+
+	unsigned int a = 1, b = 0;
+	for (size_t i = 0; i < raw.size(); i++)
+	{
+		a = (a + raw[i]) % 65521;
+		b = (b + a) % 65521;
+	}
+	put_be32(z, (b << 16) | a);
+	ok = ok && write_chunk(f, "IDAT", z);
+	ok = ok && write_chunk(f, "IEND", std::vector<unsigned char>());
+
+	return fclose(f) == 0 && ok;
+}
+
+
+bool save_png(const char* path, const unsigned int* argb, int w, int h)
+{
+	return write_png(path, argb, w, h, false);
+}
+
+
+bool save_png_alpha(const char* path, const unsigned int* argb, int w, int h)
+{
+	return write_png(path, argb, w, h, true);
+}
+
+
+static unsigned int get_be32(const unsigned char* p)
+{
+	return ((unsigned int)p[0] << 24) | ((unsigned int)p[1] << 16) | ((unsigned int)p[2] << 8) | p[3];
+}
+
+
+static int paeth(int a, int b, int c)
+{
+	int p = a + b - c;
+	int pa = p > a ? p - a : a - p;
+	int pb = p > b ? p - b : b - p;
+	int pc = p > c ? p - c : c - p;
+	if (pa <= pb && pa <= pc)
+		return a;
+	return pb <= pc ? b : c;
+}
+
+
+// undo the per-row filters in place; bpp is bytes per pixel, at least 1
+static bool unfilter(unsigned char* raw, int h, size_t stride, int bpp)
+{
+	const unsigned char* prev = NULL;
+	for (int y = 0; y < h; y++)
+	{
+		unsigned char* row = raw + y * (stride + 1);
+		int type = row[0];
+		unsigned char* cur = row + 1;
+		for (size_t i = 0; i < stride; i++)
+		{
+			int a = i >= (size_t)bpp ? cur[i - bpp] : 0;
+			int b = prev ? prev[i] : 0;
+			int c = prev && i >= (size_t)bpp ? prev[i - bpp] : 0;
+			switch (type)
+			{
+			case 0: break;
+			case 1: cur[i] = (unsigned char)(cur[i] + a); break;
+			case 2: cur[i] = (unsigned char)(cur[i] + b); break;
+			case 3: cur[i] = (unsigned char)(cur[i] + ((a + b) >> 1)); break;
+			case 4: cur[i] = (unsigned char)(cur[i] + paeth(a, b, c)); break;
+			default: return false;
+			}
+		}
+		prev = cur;
+	}
+	return true;
+}
+
+
+bool decode_png(const unsigned char* data, size_t size, std::vector<unsigned int>& argb, int& w, int& h)
+{
+	static const unsigned char signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+	if (size < 8 || memcmp(data, signature, 8) != 0)
+		return false;
+
+	int depth = 0, type = -1;
+	unsigned int palette[256];
+	int palette_size = 0;
+	int key = -1;                   // grey or RGB value that is transparent
+	std::vector<unsigned char> z;
+	w = h = 0;
+
+	// IDAT data may be split over any number of chunks
+	size_t pos = 8;
+	bool ended = false;
+	while (!ended && pos + 12 <= size)
+	{
+		unsigned int len = get_be32(data + pos);
+		const unsigned char* tag = data + pos + 4;
+		const unsigned char* body = data + pos + 8;
+		if (len > size - pos - 12)
+			return false;
+
+		if (memcmp(tag, "IHDR", 4) == 0 && len >= 13)
+		{
+			w = (int)get_be32(body);
+			h = (int)get_be32(body + 4);
+			depth = body[8];
+			type = body[9];
+			if (body[12] != 0)
+				return false;
+		}
+		else if (memcmp(tag, "PLTE", 4) == 0)
+		{
+			palette_size = (int)(len / 3) < 256 ? (int)(len / 3) : 256;
+			for (int i = 0; i < palette_size; i++)
+				palette[i] = 0xff000000u | ((unsigned int)body[3 * i] << 16) | ((unsigned int)body[3 * i + 1] << 8) | body[3 * i + 2];
+		}
+		else if (memcmp(tag, "tRNS", 4) == 0)
+		{
+			if (type == 3)
+			{
+				for (int i = 0; i < (int)len && i < palette_size; i++)
+					palette[i] = (palette[i] & 0xffffffu) | ((unsigned int)body[i] << 24);
+			}
+			else if (type == 0 && len >= 2)
+				key = body[1];
+			else if (type == 2 && len >= 6)
+				key = (body[1] << 16) | (body[3] << 8) | body[5];
+		}
+		else if (memcmp(tag, "IDAT", 4) == 0)
+			z.insert(z.end(), body, body + len);
+		else if (memcmp(tag, "IEND", 4) == 0)
+			ended = true;
+
+		pos += 12 + len;
+	}
+
+	int channels;
+	switch (type)
+	{
+	case 0: channels = 1; break;
+	case 2: channels = 3; break;
+	case 3: channels = 1; break;
+	case 4: channels = 2; break;
+	case 6: channels = 4; break;
+	default: return false;
+	}
+	bool low_depth = (type == 0 || type == 3) && (depth == 1 || depth == 2 || depth == 4);
+	if (w <= 0 || h <= 0 || w > 16384 || h > 16384 || (depth != 8 && !low_depth) || (type == 3 && palette_size == 0))
+		return false;
+
+	size_t stride = ((size_t)w * channels * depth + 7) / 8;
+	std::vector<unsigned char> raw((stride + 1) * h);
+	if (inflate_zlib(z.data(), z.size(), raw.data(), raw.size()) != (long long)raw.size())
+		return false;
+	int bpp = channels * depth / 8 > 0 ? channels * depth / 8 : 1;
+	if (!unfilter(raw.data(), h, stride, bpp))
+		return false;
+
+	argb.resize((size_t)w * h);
+	for (int y = 0; y < h; y++)
+	{
+		const unsigned char* row = &raw[y * (stride + 1) + 1];
+		unsigned int* out = &argb[(size_t)y * w];
+		for (int x = 0; x < w; x++)
+		{
+			unsigned int c;
+			if (type == 6)
+				c = ((unsigned int)row[4 * x + 3] << 24) | ((unsigned int)row[4 * x] << 16) | ((unsigned int)row[4 * x + 1] << 8) | row[4 * x + 2];
+			else if (type == 2)
+			{
+				unsigned int rgb = ((unsigned int)row[3 * x] << 16) | ((unsigned int)row[3 * x + 1] << 8) | row[3 * x + 2];
+				c = (int)rgb == key ? rgb : 0xff000000u | rgb;
+			}
+			else if (type == 4)
+				c = ((unsigned int)row[2 * x + 1] << 24) | 0x010101u * row[2 * x];
+			else
+			{
+				// grey or palette index, possibly packed several to a byte
+				int shift = 8 - depth - (x * depth) % 8;
+				int v = (row[x * depth / 8] >> shift) & ((1 << depth) - 1);
+				if (type == 3)
+					c = v < palette_size ? palette[v] : 0xff000000u;
+				else
+				{
+					int grey = v * 255 / ((1 << depth) - 1);
+					c = (v == key ? 0 : 0xff000000u) | 0x010101u * (unsigned int)grey;
+				}
+			}
+			out[x] = c;
+		}
+	}
+	return true;
+}
+
+
+bool load_png(const char* path, std::vector<unsigned int>& argb, int& w, int& h)
+{
+	MappedFile file;
+	return file.open(path) && decode_png(file.data(), file.size(), argb, w, h);
+}
+
+
+void apply_color_key(std::vector<unsigned int>& argb, int color_key)
+{
+	if (color_key < 0)
+		return;
+
+	unsigned int key = 0xff000000u | (unsigned int)color_key;
+	for (size_t i = 0; i < argb.size(); i++)
+	{
+		if (argb[i] == key)
+			argb[i] = 0;
+	}
+}
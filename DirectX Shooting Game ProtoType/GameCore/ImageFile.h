@@ -0,0 +1,44 @@
+//-----------------------------------------------------------------------------
+// File: ImageFile.h
+//
+// Desc: Saving ARGB frames as binary PPM or PNG, and reading PPM back, for
+//       looking at headless frames and comparing them with golden images.
+//       Alpha is dropped unless asked for; the PNGs written are uncompressed
+//       (stored deflate blocks), which every viewer reads and needs no zlib.
+//
+//       PNGs are also read, in every non-interlaced 8-bit and lower format
+//       (grey, grey + alpha, RGB, RGBA, palette, with tRNS transparency);
+//       16-bit and interlaced images are refused.
+//-----------------------------------------------------------------------------
+#ifndef __ImageFile_h_
+#define __ImageFile_h_
+
+#include <stddef.h>
+#include <vector>
+
+bool save_ppm(const char* path, const unsigned int* argb, int w, int h);
+bool save_png(const char* path, const unsigned int* argb, int w, int h);
+bool save_png_alpha(const char* path, const unsigned int* argb, int w, int h);
+
+// pixels come back as ARGB with alpha 255; false if the file isn't an
+// 8-bit binary PPM
+bool load_ppm(const char* path, std::vector<unsigned int>& argb, int& w, int& h);
+
+// decode a PNG from memory or from a file into ARGB; false if damaged or
+// in a format that isn't supported
+bool decode_png(const unsigned char* data, size_t size, std::vector<unsigned int>& argb, int& w, int& h);
+bool load_png(const char* path, std::vector<unsigned int>& argb, int& w, int& h);
+
+// make pixels that are exactly the opaque color_key RGB fully transparent,
+// the way D3DX color keys work; color_key < 0 for none
+void apply_color_key(std::vector<unsigned int>& argb, int color_key);
+
+// x / 255 rounded to nearest, exact for x up to 255 * 255: a channel
+// scaled by an alpha or by another channel
+inline unsigned int div255(unsigned int x)
+{
+	x += 128;
+	return (x + (x >> 8)) >> 8;
+}
+
+#endif // __ImageFile_h_
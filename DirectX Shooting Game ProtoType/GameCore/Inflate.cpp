@@ -0,0 +1,339 @@
+//-----------------------------------------------------------------------------
+// File: Inflate.cpp
+//
+// Desc: Bit reader, canonical Huffman tables and the block decoder.
+//-----------------------------------------------------------------------------
+#include <string.h>
+
+#include "Inflate.h"
+
+#define HUFF_FAST_BITS 9
+#define HUFF_MAX_BITS 15
+#define HUFF_MAX_SYMBOLS 288
+
+
+// LSB-first bits. Reading past the end yields zero bytes; that is only an
+// error once some of those bits have actually been used.
+struct BitReader {
+	const unsigned char* p;
+	const unsigned char* end;
+	unsigned int bits;
+	int count;
+	int padding;      // zero bytes added past the end
+
+	void fill(int n)
+	{
+		while (count < n)
+		{
+			unsigned int b = 0;
+			if (p < end)
+				b = *p++;
+			else
+				padding++;
+			bits |= b << count;
+			count += 8;
+		}
+	}
+
+	bool overrun() const { return padding * 8 > count; }
+
+	unsigned int get(int n)
+	{
+		if (n == 0)
+			return 0;
+		fill(n);
+		unsigned int v = bits & ((1u << n) - 1);
+		bits >>= n;
+		count -= n;
+		return v;
+	}
+};
+
+
+struct Huffman {
+	unsigned short fast[1 << HUFF_FAST_BITS];   // symbol << 4 | length, 0 when the code is longer
+	unsigned short count[HUFF_MAX_BITS + 1];    // codes of each length
+	unsigned short symbol[HUFF_MAX_SYMBOLS];    // symbols in code order
+};
+
+
+static unsigned int reverse_bits(unsigned int code, int n)
+{
+	unsigned int r = 0;
+	for (int i = 0; i < n; i++)
+	{
+		r = (r << 1) | (code & 1);
+		code >>= 1;
+	}
+	return r;
+}
+
+
+// false for over-subscribed lengths; incomplete codes are allowed, as a
+// single distance code is
+static bool build_huffman(Huffman& h, const unsigned char* lengths, int n)
+{
+	memset(h.count, 0, sizeof(h.count));
+	memset(h.fast, 0, sizeof(h.fast));
+	for (int i = 0; i < n; i++)
+		h.count[lengths[i]]++;
+	h.count[0] = 0;
+
+	int left = 1;
+	for (int len = 1; len <= HUFF_MAX_BITS; len++)
+	{
+		left = (left << 1) - h.count[len];
+		if (left < 0)
+			return false;
+	}
+
+	unsigned short offset[HUFF_MAX_BITS + 2];
+	unsigned int next_code[HUFF_MAX_BITS + 1];
+	offset[1] = 0;
+	unsigned int code = 0;
+	for (int len = 1; len <= HUFF_MAX_BITS; len++)
+	{
+		offset[len + 1] = offset[len] + h.count[len];
+		code = (code + h.count[len - 1]) << 1;
+		next_code[len] = code;
+	}
+
+	for (int i = 0; i < n; i++)
+	{
+		int len = lengths[i];
+		if (len == 0)
+			continue;
+		h.symbol[offset[len]++] = (unsigned short)i;
+
+		unsigned int c = next_code[len]++;
+		if (len <= HUFF_FAST_BITS)
+		{
+			unsigned short entry = (unsigned short)((i << 4) | len);
+			for (unsigned int r = reverse_bits(c, len); r < (1u << HUFF_FAST_BITS); r += 1u << len)
+				h.fast[r] = entry;
+		}
+	}
+	return true;
+}
+
+
+// the next symbol, or -1 for a code that isn't in the table
+static int decode_symbol(BitReader& br, const Huffman& h)
+{
+	br.fill(HUFF_MAX_BITS + 1);
+	unsigned short e = h.fast[br.bits & ((1u << HUFF_FAST_BITS) - 1)];
+	if (e)
+	{
+		br.bits >>= e & 15;
+		br.count -= e & 15;
+		return e >> 4;
+	}
+
+	// longer codes, one bit at a time
+	int code = 0, first = 0, index = 0;
+	for (int len = 1; len <= HUFF_MAX_BITS; len++)
+	{
+		code |= (int)br.get(1);
+		int count = h.count[len];
+		if (code - count < first)
+			return h.symbol[index + (code - first)];
+		index += count;
+		first = (first + count) << 1;
+		code <<= 1;
+	}
+	return -1;
+}
+
+
+static const unsigned short length_base[29] = {
+	3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+	35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+static const unsigned char length_extra[29] = {
+	0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+	3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+static const unsigned short dist_base[30] = {
+	1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+	257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+static const unsigned char dist_extra[30] = {
+	0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+	7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+
+static bool inflate_codes(BitReader& br, const Huffman& lit, const Huffman& dist,
+	unsigned char* out, size_t capacity, size_t& pos)
+{
+	for (;;)
+	{
+		int sym = decode_symbol(br, lit);
+		if (sym < 0 || br.overrun())
+			return false;
+		if (sym < 256)
+		{
+			if (pos >= capacity)
+				return false;
+			out[pos++] = (unsigned char)sym;
+			continue;
+		}
+		if (sym == 256)
+			return true;
+
+		sym -= 257;
+		if (sym >= 29)
+			return false;
+		size_t len = length_base[sym] + br.get(length_extra[sym]);
+
+		int d = decode_symbol(br, dist);
+		if (d < 0 || d >= 30)
+			return false;
+		size_t back = dist_base[d] + br.get(dist_extra[d]);
+		if (back > pos || len > capacity - pos)
+			return false;
+
+		// the copy may overlap itself, which repeats the last back bytes
+		unsigned char* to = out + pos;
+		const unsigned char* from = to - back;
+		for (size_t i = 0; i < len; i++)
+			to[i] = from[i];
+		pos += len;
+	}
+}
+
+
+// built once, on first use, safely from any thread
+struct FixedTables {
+	Huffman lit, dist;
+	FixedTables();
+};
+
+
+FixedTables::FixedTables()
+{
+	unsigned char lengths[HUFF_MAX_SYMBOLS];
+	int i = 0;
+	for (; i < 144; i++) lengths[i] = 8;
+	for (; i < 256; i++) lengths[i] = 9;
+	for (; i < 280; i++) lengths[i] = 7;
+	for (; i < 288; i++) lengths[i] = 8;
+	build_huffman(lit, lengths, 288);
+
+	for (i = 0; i < 30; i++)
+		lengths[i] = 5;
+	build_huffman(dist, lengths, 30);
+}
+
+
+static bool dynamic_tables(BitReader& br, Huffman& lit, Huffman& dist)
+{
+	static const unsigned char order[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+	int nlen = (int)br.get(5) + 257;
+	int ndist = (int)br.get(5) + 1;
+	int ncode = (int)br.get(4) + 4;
+	if (nlen > 286 || ndist > 30)
+		return false;
+
+	unsigned char lengths[286 + 30];
+	memset(lengths, 0, 19);
+	for (int i = 0; i < ncode; i++)
+		lengths[order[i]] = (unsigned char)br.get(3);
+
+	Huffman lencode;
+	if (!build_huffman(lencode, lengths, 19))
+		return false;
+
+	int i = 0;
+	while (i < nlen + ndist)
+	{
+		int sym = decode_symbol(br, lencode);
+		if (sym < 0 || br.overrun())
+			return false;
+		if (sym < 16)
+		{
+			lengths[i++] = (unsigned char)sym;
+			continue;
+		}
+
+		unsigned char value = 0;
+		int repeat;
+		if (sym == 16)
+		{
+			if (i == 0)
+				return false;
+			value = lengths[i - 1];
+			repeat = 3 + (int)br.get(2);
+		}
+		else if (sym == 17)
+			repeat = 3 + (int)br.get(3);
+		else
+			repeat = 11 + (int)br.get(7);
+
+		if (i + repeat > nlen + ndist)
+			return false;
+		while (repeat--)
+			lengths[i++] = value;
+	}
+
+	// a block must be able to end
+	if (lengths[256] == 0)
+		return false;
+	return build_huffman(lit, lengths, nlen) && build_huffman(dist, lengths + nlen, ndist);
+}
+
+
+long long inflate_zlib(const unsigned char* src, size_t src_size, unsigned char* out, size_t out_capacity)
+{
+	// deflate, with a header checksum that works out
+	if (src_size < 2 || (src[0] & 0x0f) != 8 || ((src[0] << 8) | src[1]) % 31 != 0 || (src[1] & 0x20))
+		return -1;
+
+	BitReader br;
+	br.p = src + 2;
+	br.end = src + src_size;
+	br.bits = 0;
+	br.count = 0;
+	br.padding = 0;
+
+	static const FixedTables fixed;
+
+	Huffman lit, dist;
+	size_t pos = 0;
+	bool last;
+	do
+	{
+		last = br.get(1) != 0;
+		unsigned int type = br.get(2);
+		if (type == 0)
+		{
+			// stored: byte-aligned length, its complement, then the bytes
+			br.get(br.count & 7);
+			unsigned int len = br.get(16);
+			unsigned int nlen = br.get(16);
+			if (len != (~nlen & 0xffff) || len > out_capacity - pos)
+				return -1;
+			while (len > 0 && br.count >= 8)
+			{
+				out[pos++] = (unsigned char)br.get(8);
+				len--;
+			}
+			if (len > (size_t)(br.end - br.p))
+				return -1;
+			memcpy(out + pos, br.p, len);
+			br.p += len;
+			pos += len;
+		}
+		else if (type == 1)
+		{
+			if (!inflate_codes(br, fixed.lit, fixed.dist, out, out_capacity, pos))
+				return -1;
+		}
+		else if (type == 2)
+		{
+			if (!dynamic_tables(br, lit, dist) || !inflate_codes(br, lit, dist, out, out_capacity, pos))
+				return -1;
+		}
+		else
+			return -1;
+	} while (!last);
+
+	return br.overrun() ? -1 : (long long)pos;
+}
@@ -0,0 +1,19 @@
+//-----------------------------------------------------------------------------
+// File: Inflate.h
+//
+// Desc: Decoder for zlib streams (RFC 1950/1951): stored, fixed and dynamic
+//       Huffman blocks. Enough for PNG image data; there is no encoder.
+//
+//       Codes of up to 9 bits, which are nearly all of them, decode with a
+//       single table lookup.
+//-----------------------------------------------------------------------------
+#ifndef __Inflate_h_
+#define __Inflate_h_
+
+#include <stddef.h>
+
+// decompress a zlib stream into out; returns the bytes written, or -1 if
+// the stream is damaged or needs more than out_capacity bytes
+long long inflate_zlib(const unsigned char* src, size_t src_size, unsigned char* out, size_t out_capacity);
+
+#endif // __Inflate_h_
@@ -0,0 +1,337 @@
+//-----------------------------------------------------------------------------
+// File: JobSystem.cpp
+//
+// Desc: Work-stealing deques, worker threads and the task graph runner.
+//-----------------------------------------------------------------------------
+#include "JobSystem.h"
+
+// which worker of which system the current thread is; any other thread
+// counts as worker 0
+static thread_local const JobSystem* t_system = 0;
+static thread_local int t_index = 0;
+
+// spins through empty deques before a worker goes to sleep
+#define JOB_IDLE_SPINS 64
+
+
+JobSystem::JobSystem()
+	: threads(1), queued(0), sleeping(0), quit(false)
+{
+}
+
+
+JobSystem::~JobSystem()
+{
+	stop();
+}
+
+
+void JobSystem::start(int threads_)
+{
+	stop();
+
+	if (threads_ <= 0)
+		threads_ = (int)std::thread::hardware_concurrency();
+	if (threads_ < 1)
+		threads_ = 1;
+	if (threads_ > JOB_MAX_THREADS)
+		threads_ = JOB_MAX_THREADS;
+
+	threads = threads_;
+	workers.reset(new Worker[threads]);
+	for (int i = 0; i < threads; i++)
+		workers[i].head = workers[i].tail = 0;
+
+	queued = 0;
+	sleeping = 0;
+	quit = false;
+	pool.reserve(threads - 1);
+	for (int i = 1; i < threads; i++)
+		pool.push_back(std::thread(&JobSystem::worker_main, this, i));
+}
+
+
+void JobSystem::stop()
+{
+	{
+		std::lock_guard<std::mutex> lock(sleep_lock);
+		quit = true;
+	}
+	wake.notify_all();
+
+	for (int i = 0; i < (int)pool.size(); i++)
+		pool[i].join();
+	pool.clear();
+	threads = 1;
+}
+
+
+int JobSystem::worker_index() const
+{
+	return t_system == this ? t_index : 0;
+}
+
+
+void JobSystem::push(const Job& job)
+{
+	Worker& w = workers[worker_index()];
+	bool full;
+	{
+		std::lock_guard<std::mutex> lock(w.lock);
+		full = w.tail - w.head == JOB_QUEUE_SIZE;
+		if (!full)
+		{
+			w.jobs[w.tail & (JOB_QUEUE_SIZE - 1)] = job;
+			w.tail++;
+			queued++;
+		}
+	}
+
+	if (full)
+	{
+		execute(job);
+		return;
+	}
+
+	// a sleeper that counted itself after this load sees queued > 0 first
+	if (sleeping.load() > 0)
+	{
+		{
+			std::lock_guard<std::mutex> lock(sleep_lock);
+		}
+		wake.notify_one();
+	}
+}
+
+
+bool JobSystem::pop(int self, Job& job)
+{
+	Worker& w = workers[self];
+	std::lock_guard<std::mutex> lock(w.lock);
+	if (w.tail == w.head)
+		return false;
+
+	w.tail--;
+	job = w.jobs[w.tail & (JOB_QUEUE_SIZE - 1)];
+	queued--;
+	return true;
+}
+
+
+bool JobSystem::steal(int self, Job& job)
+{
+	for (int k = 1; k < threads; k++)
+	{
+		Worker& w = workers[(self + k) % threads];
+		std::lock_guard<std::mutex> lock(w.lock);
+		if (w.tail != w.head)
+		{
+			job = w.jobs[w.head & (JOB_QUEUE_SIZE - 1)];
+			w.head++;
+			queued--;
+			return true;
+		}
+	}
+	return false;
+}
+
+
+void JobSystem::execute(const Job& job)
+{
+	job.fn(job.data, job.begin, job.end);
+	if (job.pending)
+		job.pending->fetch_sub(1, std::memory_order_acq_rel);
+}
+
+
+void JobSystem::wait(std::atomic<int>& pending)
+{
+	int self = worker_index();
+	Job job;
+
+	while (pending.load(std::memory_order_acquire) > 0)
+	{
+		if (pop(self, job) || steal(self, job))
+			execute(job);
+		else
+			std::this_thread::yield();
+	}
+}
+
+
+bool JobSystem::help()
+{
+	int self = worker_index();
+	Job job;
+	if (!pop(self, job) && !steal(self, job))
+		return false;
+	execute(job);
+	return true;
+}
+
+
+void JobSystem::worker_main(int index)
+{
+	t_system = this;
+	t_index = index;
+
+	Job job;
+	int idle = 0;
+	for (;;)
+	{
+		if (pop(index, job) || steal(index, job))
+		{
+			execute(job);
+			idle = 0;
+			continue;
+		}
+
+		if (++idle < JOB_IDLE_SPINS)
+		{
+			std::this_thread::yield();
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(sleep_lock);
+		sleeping++;
+		while (queued.load() == 0 && !quit)
+			wake.wait(lock);
+		sleeping--;
+		if (quit)
+			return;
+		idle = 0;
+	}
+}
+
+
+void parallel_for(JobSystem* jobs, int n, int grain, JobFunc fn, void* data)
+{
+	if (grain < 1)
+		grain = 1;
+
+	if (!jobs || jobs->thread_count() <= 1 || n <= grain)
+	{
+		for (int begin = 0; begin < n; begin += grain)
+			fn(data, begin, begin + grain < n ? begin + grain : n);
+		return;
+	}
+
+	// queue the later chunks back to front so our own pops take them in
+	// order, while thieves start from the far end
+	int chunks = (n + grain - 1) / grain;
+	std::atomic<int> pending(chunks - 1);
+	for (int c = chunks - 1; c >= 1; c--)
+	{
+		Job job;
+		job.fn = fn;
+		job.data = data;
+		job.begin = c * grain;
+		job.end = job.begin + grain < n ? job.begin + grain : n;
+		job.pending = &pending;
+		jobs->push(job);
+	}
+
+	fn(data, 0, grain);
+	jobs->wait(pending);
+}
+
+
+// state of one JobGraph::run(), on the caller's stack
+struct JobGraph::RunState {
+	const JobGraph* graph;
+	JobSystem* jobs;
+	void* data;
+	std::atomic<int> deps[JOB_GRAPH_MAX_NODES];
+	std::atomic<int> pending;
+};
+
+
+JobGraph::JobGraph()
+	: node_count(0)
+{
+}
+
+
+int JobGraph::add(TaskFunc fn)
+{
+	if (node_count == JOB_GRAPH_MAX_NODES)
+		return -1;
+
+	Node& node = nodes[node_count];
+	node.fn = fn;
+	node.deps = 0;
+	node.next_count = 0;
+	return node_count++;
+}
+
+
+void JobGraph::depend(int task, int before)
+{
+	if (before < 0 || before >= task || task >= node_count)
+		return;
+
+	Node& b = nodes[before];
+	if (b.next_count == JOB_GRAPH_MAX_NEXT)
+		return;
+	b.next[b.next_count++] = task;
+	nodes[task].deps++;
+}
+
+
+void JobGraph::run_node(void* state_, int node, int)
+{
+	RunState& state = *(RunState*)state_;
+	const Node& n = state.graph->nodes[node];
+
+	n.fn(state.data);
+
+	// release whatever was only waiting on this task
+	for (int k = 0; k < n.next_count; k++)
+	{
+		int next = n.next[k];
+		if (state.deps[next].fetch_sub(1, std::memory_order_acq_rel) == 1)
+		{
+			Job job;
+			job.fn = run_node;
+			job.data = &state;
+			job.begin = next;
+			job.end = next + 1;
+			job.pending = &state.pending;
+			state.jobs->push(job);
+		}
+	}
+}
+
+
+void JobGraph::run(JobSystem* jobs, void* data) const
+{
+	if (!jobs || jobs->thread_count() <= 1)
+	{
+		for (int i = 0; i < node_count; i++)
+			nodes[i].fn(data);
+		return;
+	}
+
+	RunState state;
+	state.graph = this;
+	state.jobs = jobs;
+	state.data = data;
+	state.pending = node_count;
+	for (int i = 0; i < node_count; i++)
+		state.deps[i] = nodes[i].deps;
+
+	for (int i = 0; i < node_count; i++)
+	{
+		if (nodes[i].deps == 0)
+		{
+			Job job;
+			job.fn = run_node;
+			job.data = &state;
+			job.begin = i;
+			job.end = i + 1;
+			job.pending = &state.pending;
+			jobs->push(job);
+		}
+	}
+	jobs->wait(state.pending);
+}
@@ -0,0 +1,136 @@
+//-----------------------------------------------------------------------------
+// File: JobSystem.h
+//
+// Desc: Work-stealing job scheduler. Each thread owns a fixed-size deque:
+//       it pushes and pops its own jobs at the back (newest first, while they
+//       are still in cache) and idle threads steal from the front of someone
+//       else's. The thread that calls start() is worker 0 and takes part in
+//       the work whenever it waits, so a system with one thread simply runs
+//       everything inline.
+//
+//       Two ways to submit work sit on top of the deques:
+//       - parallel_for() cuts [0, n) into fixed-size chunks. The chunks only
+//         depend on n and the grain, never on the thread count, so code that
+//         writes per-chunk results gets the same answer on any machine.
+//       - JobGraph runs a set of tasks with dependencies between them, each
+//         one as soon as everything it depends on has finished.
+//
+//       Nothing is allocated after start().
+//-----------------------------------------------------------------------------
+#ifndef __JobSystem_h_
+#define __JobSystem_h_
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#define JOB_MAX_THREADS 64
+#define JOB_QUEUE_SIZE 1024          // jobs per deque, a power of two
+#define JOB_GRAPH_MAX_NODES 16
+#define JOB_GRAPH_MAX_NEXT 8         // successors per graph node
+
+// runs the items [begin, end) of whatever data points to
+typedef void (*JobFunc)(void* data, int begin, int end);
+
+// a task in a JobGraph
+typedef void (*TaskFunc)(void* data);
+
+struct Job {
+	JobFunc fn;
+	void* data;
+	int begin;
+	int end;
+	std::atomic<int>* pending;    // decremented once fn returns; may be NULL
+};
+
+class JobSystem {
+
+public:
+	JobSystem();
+	~JobSystem();
+
+	// threads counts the calling thread too; 0 means one per hardware thread
+	void start(int threads);
+	void stop();
+
+	int thread_count() const { return threads; }
+
+	// queue a job on the calling thread's deque; runs it right away when
+	// the deque is full
+	void push(const Job& job);
+
+	// run queued jobs until pending drops to zero
+	void wait(std::atomic<int>& pending);
+
+	// run one queued job on the calling thread; false if there was none.
+	// For threads that poll for results between jobs instead of blocking.
+	bool help();
+
+private:
+	struct Worker {
+		std::mutex lock;
+		Job jobs[JOB_QUEUE_SIZE];
+		int head;    // next to steal
+		int tail;    // next free slot
+	};
+
+	int worker_index() const;
+	bool pop(int self, Job& job);
+	bool steal(int self, Job& job);
+	void execute(const Job& job);
+	void worker_main(int index);
+
+	int threads;
+	std::unique_ptr<Worker[]> workers;
+	std::vector<std::thread> pool;
+
+	std::atomic<int> queued;      // jobs sitting in any deque
+	std::atomic<int> sleeping;    // workers blocked on wake
+	std::atomic<bool> quit;
+	std::mutex sleep_lock;
+	std::condition_variable wake;
+};
+
+
+// run fn over [0, n) in chunks of grain items and return when all are done.
+// With jobs NULL the chunks run in order on the calling thread.
+void parallel_for(JobSystem* jobs, int n, int grain, JobFunc fn, void* data);
+
+
+// a fixed set of tasks and the order constraints between them. Tasks may
+// only depend on tasks added before them, so the order they were added in is
+// always a valid serial order.
+class JobGraph {
+
+public:
+	JobGraph();
+
+	// returns the task's id
+	int add(TaskFunc fn);
+
+	// task runs only after task before has finished; before < task
+	void depend(int task, int before);
+
+	// run every task once with the same data. With jobs NULL the tasks run in
+	// the order they were added, on the calling thread.
+	void run(JobSystem* jobs, void* data) const;
+
+private:
+	struct Node {
+		TaskFunc fn;
+		int deps;
+		int next[JOB_GRAPH_MAX_NEXT];
+		int next_count;
+	};
+
+	struct RunState;
+	static void run_node(void* state, int node, int unused);
+
+	Node nodes[JOB_GRAPH_MAX_NODES];
+	int node_count;
+};
+
+#endif // __JobSystem_h_
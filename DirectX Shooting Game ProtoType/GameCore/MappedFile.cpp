@@ -0,0 +1,135 @@
+//-----------------------------------------------------------------------------
+// File: MappedFile.cpp
+//
+// Desc: File mapping on Win32 and POSIX.
+//-----------------------------------------------------------------------------
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "MappedFile.h"
+
+
+#if defined(_WIN32)
+
+MappedFile::MappedFile()
+	: bytes(NULL), length(0), opened(false), file(INVALID_HANDLE_VALUE), mapping(NULL)
+{
+}
+
+
+bool MappedFile::open(const char* path)
+{
+	close();
+
+	file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size))
+	{
+		close();
+		return false;
+	}
+
+	length = (size_t)size.QuadPart;
+	if (length > 0)
+	{
+		mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (mapping)
+			bytes = (const unsigned char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+		if (!bytes)
+		{
+			close();
+			return false;
+		}
+	}
+
+	opened = true;
+	return true;
+}
+
+
+void MappedFile::close()
+{
+	if (bytes)
+		UnmapViewOfFile(bytes);
+	if (mapping)
+		CloseHandle(mapping);
+	if (file != INVALID_HANDLE_VALUE)
+		CloseHandle(file);
+
+	bytes = NULL;
+	length = 0;
+	opened = false;
+	file = INVALID_HANDLE_VALUE;
+	mapping = NULL;
+}
+
+#else
+
+MappedFile::MappedFile()
+	: bytes(NULL), length(0), opened(false), fd(-1)
+{
+}
+
+
+bool MappedFile::open(const char* path)
+{
+	close();
+
+	fd = ::open(path, O_RDONLY);
+	if (fd < 0)
+		return false;
+
+	struct stat st;
+	if (fstat(fd, &st) != 0)
+	{
+		close();
+		return false;
+	}
+
+	length = (size_t)st.st_size;
+	if (length > 0)
+	{
+		void* p = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (p == MAP_FAILED)
+		{
+			close();
+			return false;
+		}
+		bytes = (const unsigned char*)p;
+		madvise(p, length, MADV_SEQUENTIAL);
+	}
+
+	opened = true;
+	return true;
+}
+
+
+void MappedFile::close()
+{
+	if (bytes)
+		munmap((void*)bytes, length);
+	if (fd >= 0)
+		::close(fd);
+
+	bytes = NULL;
+	length = 0;
+	opened = false;
+	fd = -1;
+}
+
+#endif
+
+
+MappedFile::~MappedFile()
+{
+	close();
+}
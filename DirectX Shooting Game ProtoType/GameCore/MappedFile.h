@@ -0,0 +1,44 @@
+//-----------------------------------------------------------------------------
+// File: MappedFile.h
+//
+// Desc: Read-only memory mapping of a whole file. Readers work straight on
+//       the mapped bytes, so opening a large file costs nothing up front and
+//       the OS pages it in as it is read.
+//-----------------------------------------------------------------------------
+#ifndef __MappedFile_h_
+#define __MappedFile_h_
+
+#include <stddef.h>
+
+class MappedFile {
+
+public:
+	MappedFile();
+	~MappedFile();
+
+	// false if the file can't be opened or mapped; an empty file maps fine
+	// with data() NULL and size() 0
+	bool open(const char* path);
+	void close();
+
+	bool is_open() const { return opened; }
+	const unsigned char* data() const { return bytes; }
+	size_t size() const { return length; }
+
+private:
+	MappedFile(const MappedFile&);
+	MappedFile& operator=(const MappedFile&);
+
+	const unsigned char* bytes;
+	size_t length;
+	bool opened;
+
+#if defined(_WIN32)
+	void* file;       // HANDLE
+	void* mapping;    // HANDLE
+#else
+	int fd;
+#endif
+};
+
+#endif // __MappedFile_h_
@@ -0,0 +1,471 @@
+//-----------------------------------------------------------------------------
+// File: MoveScript.cpp
+//
+// Desc: Movement script compiler and the two VMs, batched and per enemy.
+//-----------------------------------------------------------------------------
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "MoveScript.h"
+
+#define MOVE_LINE_MAX 256
+#define MOVE_TOKENS_MAX 6
+
+// shortest run of enemies on the same line worth one dispatch for the run;
+// shorter ones are cheaper one enemy at a time
+#define MOVE_SCRIPT_MIN_RUN 16
+
+
+bool MoveProgram::fail(int line, const char* what)
+{
+	char text[MOVE_LINE_MAX + 64];    // room for any message and its line number
+	snprintf(text, sizeof text, "line %d: %s", line, what);
+	message = text;
+	return false;
+}
+
+
+// splits a line at white space, in place; returns the token count, or
+// MOVE_TOKENS_MAX + 1 when there are too many
+static int split_tokens(char* line, char** tokens)
+{
+	int n = 0;
+	for (char* p = strtok(line, " \t\r"); p; p = strtok(NULL, " \t\r"))
+	{
+		if (n == MOVE_TOKENS_MAX)
+			return MOVE_TOKENS_MAX + 1;
+		tokens[n++] = p;
+	}
+	return n;
+}
+
+
+static bool parse_number(const char* token, float& value)
+{
+	char* end;
+	value = (float)strtod(token, &end);
+	return end != token && *end == 0 && value == value;
+}
+
+
+MoveProgram::MoveProgram()
+	: longest_step(0)
+{
+}
+
+
+// how far op moves an enemy in its longest tick, as run_op() steps it; -1
+// if that grows without bound
+static float op_step(const MoveOp& op, const float* offsets)
+{
+	switch (op.code)
+	{
+	case MOVE_OP_MOVE:
+		return sqrtf(op.a * op.a + op.b * op.b);
+
+	case MOVE_OP_WEAVE:
+		{
+			// the first tick sways from the origin, and an endless weave
+			// wraps from its last offset back to its first
+			const float* t = offsets + op.table;
+			float dx = fabsf(t[0]);
+			for (int k = 1; k < op.period; k++)
+				dx = fmaxf(dx, fabsf(t[k] - t[k - 1]));
+			if (op.ticks == 0)
+				dx = fmaxf(dx, fabsf(t[0] - t[op.period - 1]));
+			return sqrtf(dx * dx + op.b * op.b);
+		}
+
+	case MOVE_OP_DIVE:
+		if (op.ticks == 0)
+			return op.b == 0 ? fabsf(op.a) : -1.0f;
+		return fmaxf(fabsf(op.a), fabsf(op.a + op.b * (float)(op.ticks - 1)));
+
+	default:
+		return 0;
+	}
+}
+
+
+bool MoveProgram::compile(const char* source, float tick_seconds)
+{
+	clear();
+	return add(source, tick_seconds) == 0;
+}
+
+
+int MoveProgram::add(const char* source, float tick_seconds)
+{
+	int entry = (int)ops.size();
+	size_t offsets = table.size();
+	message.clear();
+	if (!parse(source, tick_seconds, entry))
+	{
+		ops.resize(entry);
+		table.resize(offsets);
+		return -1;
+	}
+
+	for (int pc = entry; pc < (int)ops.size() && longest_step >= 0; pc++)
+	{
+		float step = op_step(ops[pc], table.data());
+		longest_step = step < 0 ? step : fmaxf(longest_step, step);
+	}
+	return entry;
+}
+
+
+void MoveProgram::clear()
+{
+	ops.clear();
+	table.clear();
+	message.clear();
+	longest_step = 0;
+}
+
+
+// the instructions of one script, appended from entry on
+bool MoveProgram::parse(const char* source, float tick_seconds, int entry)
+{
+	struct Syntax {
+		const char* name;
+		int code;
+		int numbers;      // besides the optional seconds
+	};
+	static const Syntax syntax[] = {
+		{ "wait", MOVE_OP_WAIT, 0 },
+		{ "move", MOVE_OP_MOVE, 2 },
+		{ "strafe", MOVE_OP_MOVE, 1 },
+		{ "weave", MOVE_OP_WEAVE, 3 },
+		{ "dive", MOVE_OP_DIVE, 2 },
+		{ "loop", MOVE_OP_LOOP, 0 },
+	};
+
+	int line_number = 0;
+	for (const char* p = source; *p; )
+	{
+		// one line, without its comment
+		const char* eol = strchr(p, '\n');
+		size_t length = eol ? (size_t)(eol - p) : strlen(p);
+		line_number++;
+		if (length >= MOVE_LINE_MAX)
+			return fail(line_number, "line too long");
+		char line[MOVE_LINE_MAX];
+		memcpy(line, p, length);
+		line[length] = 0;
+		p += eol ? length + 1 : length;
+		char* comment = strchr(line, '#');
+		if (comment)
+			*comment = 0;
+
+		char* tokens[MOVE_TOKENS_MAX];
+		int n = split_tokens(line, tokens);
+		if (n == 0)
+			continue;
+
+		const Syntax* s = NULL;
+		for (size_t k = 0; k < sizeof(syntax) / sizeof(syntax[0]); k++)
+		{
+			if (strcmp(tokens[0], syntax[k].name) == 0)
+				s = &syntax[k];
+		}
+		if (!s)
+		{
+			char what[MOVE_LINE_MAX + 32];
+			snprintf(what, sizeof what, "unknown instruction '%s'", tokens[0]);
+			return fail(line_number, what);
+		}
+
+		// the numbers, then the seconds: required for wait, optional for
+		// everything that moves, none for loop
+		float v[MOVE_TOKENS_MAX];
+		int numbers = n - 1;
+		bool timed = s->code != MOVE_OP_LOOP;
+		bool seconds_required = s->code == MOVE_OP_WAIT;
+		if (numbers < s->numbers + (seconds_required ? 1 : 0) || numbers > s->numbers + (timed ? 1 : 0))
+			return fail(line_number, "wrong number of arguments");
+		for (int k = 0; k < numbers; k++)
+		{
+			if (!parse_number(tokens[k + 1], v[k]))
+				return fail(line_number, "not a number");
+		}
+
+		MoveOp op;
+		memset(&op, 0, sizeof(op));
+		op.code = s->code;
+		if (numbers > s->numbers)
+		{
+			float seconds = v[s->numbers];
+			if (seconds <= 0)
+				return fail(line_number, "seconds must be positive");
+			op.ticks = (int)(seconds / tick_seconds + 0.5f);
+			if (op.ticks < 1)
+				op.ticks = 1;
+		}
+
+		if (s->code == MOVE_OP_MOVE)
+		{
+			op.a = v[0] * tick_seconds;
+			op.b = s->numbers == 2 ? v[1] * tick_seconds : 0.0f;
+		}
+		else if (s->code == MOVE_OP_WEAVE)
+		{
+			// offsets[k] is where the sway is after k + 1 ticks, for every
+			// tick of the instruction, or for one period of an endless one
+			int period = (int)(v[1] / tick_seconds + 0.5f);
+			if (period < 2 || period > MOVE_SCRIPT_MAX_PERIOD)
+				return fail(line_number, "weave period out of range");
+			if (op.ticks > MOVE_SCRIPT_MAX_WEAVE)
+				return fail(line_number, "weave too long; loop a shorter one");
+			op.b = v[2] * tick_seconds;
+			op.table = (int)table.size();
+			op.period = op.ticks > 0 ? op.ticks : period;
+			for (int k = 0; k < op.period; k++)
+				table.push_back((float)(v[0] * sin(2 * 3.14159265358979323846 * (k + 1) / period)));
+		}
+		else if (s->code == MOVE_OP_DIVE)
+		{
+			op.a = v[0] * tick_seconds;
+			op.b = v[1] * tick_seconds * tick_seconds;
+		}
+		else if (s->code == MOVE_OP_LOOP)
+		{
+			if ((int)ops.size() == entry)
+				return fail(line_number, "loop before any movement");
+			op.table = entry;
+		}
+
+		// counted over the whole program, leaving room for the END, so no
+		// program outgrows MOVE_SCRIPT_MAX_OPS however many scripts it holds
+		if ((int)ops.size() + 2 > MOVE_SCRIPT_MAX_OPS)
+			return fail(line_number, "script too long");
+		ops.push_back(op);
+	}
+
+	if ((int)ops.size() == entry)
+		return fail(line_number, "empty script");
+
+	// even after a loop, so every script has an instruction that holds an
+	// enemy still
+	MoveOp end;
+	memset(&end, 0, sizeof(end));
+	end.code = MOVE_OP_END;
+	ops.push_back(end);
+	return true;
+}
+
+
+bool MoveProgram::load(const char* path, float tick_seconds)
+{
+	FILE* f = fopen(path, "rb");
+	if (!f)
+	{
+		message = std::string("can't open ") + path;
+		return false;
+	}
+	std::string source;
+	char buffer[4096];
+	size_t n;
+	while ((n = fread(buffer, 1, sizeof(buffer), f)) > 0)
+		source.append(buffer, n);
+	fclose(f);
+	return compile(source.c_str(), tick_seconds);
+}
+
+
+int MoveProgram::next(int pc) const
+{
+	pc++;
+	return ops[pc].code == MOVE_OP_LOOP ? ops[pc].table : pc;
+}
+
+
+void MoveState::resize(int n)
+{
+	pc.assign(n, 0);
+	ticks.assign(n, 0);
+	origin_x.assign(n, 0.0f);
+}
+
+
+void start_move_script(const MoveProgram& program, MoveState& state, int i, float x)
+{
+	start_move_script_at(program, state, i, x, 0);
+}
+
+
+void start_move_script_at(const MoveProgram& program, MoveState& state, int i, float x, int pc)
+{
+	(void)program;
+	state.pc[i] = (unsigned short)pc;
+	state.ticks[i] = 0;
+	state.origin_x[i] = x;
+}
+
+
+// indices of the enemies an instruction runs over: a run of ids
+struct IdRun {
+	int first;
+	int operator[](int k) const { return first + k; }
+};
+
+
+// one tick of instruction pc for n enemies; the step of each instruction is
+// written once and shared with the per-enemy VM, so both round alike. The
+// instruction is copied so the stores to x and y can't make the compiler
+// read it again every iteration.
+template <typename Ids>
+static void run_op(const MoveProgram& program, int pc, MoveState& state, float* x, float* y, Ids ids, int n)
+{
+	const MoveOp op = program.op(pc);
+	const float a = op.a, b = op.b;
+	int* ticks = state.ticks.data();
+	const float* origin_x = state.origin_x.data();
+
+	switch (op.code)
+	{
+	case MOVE_OP_WAIT:
+		break;
+
+	case MOVE_OP_MOVE:
+		for (int k = 0; k < n; k++)
+			x[ids[k]] += a;
+		for (int k = 0; k < n; k++)
+			y[ids[k]] += b;
+		break;
+
+	case MOVE_OP_WEAVE:
+		{
+			const float* offsets = program.offsets() + op.table;
+			for (int k = 0; k < n; k++)
+			{
+				int i = ids[k];
+				x[i] = origin_x[i] + offsets[ticks[i]];
+			}
+			for (int k = 0; k < n; k++)
+				y[ids[k]] += b;
+		}
+		break;
+
+	case MOVE_OP_DIVE:
+		for (int k = 0; k < n; k++)
+		{
+			int i = ids[k];
+			y[i] += a + b * (float)ticks[i];
+		}
+		break;
+
+	default:    // end: nothing moves and nothing follows
+		return;
+	}
+
+	// a tick spent, which only a weave, a dive or an instruction that ends
+	// needs to count. An endless weave goes round its table again.
+	const int limit = op.ticks;
+	if (limit == 0)
+	{
+		if (op.code == MOVE_OP_WEAVE)
+		{
+			const int wrap = op.period;
+			for (int k = 0; k < n; k++)
+			{
+				int i = ids[k];
+				int t = ticks[i] + 1;
+				ticks[i] = t == wrap ? 0 : t;
+			}
+		}
+		else if (op.code == MOVE_OP_DIVE)
+		{
+			for (int k = 0; k < n; k++)
+				ticks[ids[k]]++;
+		}
+		return;
+	}
+
+	// the few enemies that finished go on to the next line
+	unsigned short* pcs = state.pc.data();
+	float* origins = state.origin_x.data();
+	const int next = program.next(pc);
+	for (int k = 0; k < n; k++)
+	{
+		int i = ids[k];
+		int t = ticks[i] + 1;
+		ticks[i] = t;
+		if (t == limit)
+		{
+			pcs[i] = (unsigned short)next;
+			ticks[i] = 0;
+			origins[i] = x[i];
+		}
+	}
+}
+
+
+// one dispatch per enemy
+static void run_each(const MoveProgram& program, MoveState& state, float* x, float* y, int begin, int end)
+{
+	for (int i = begin; i < end; i++)
+	{
+		IdRun one = { i };
+		run_op(program, state.pc[i], state, x, y, one, 1);
+	}
+}
+
+
+// a run long enough for one dispatch starts and ends on the same line
+static bool may_start_run(const unsigned short* pc, int i, int end)
+{
+	return i + MOVE_SCRIPT_MIN_RUN <= end && pc[i + MOVE_SCRIPT_MIN_RUN - 1] == pc[i];
+}
+
+
+void run_move_scripts(const MoveProgram& program, MoveState& state, float* x, float* y, int begin, int end)
+{
+	if (program.count() == 0)
+		return;
+
+	// enemies mostly scattered over the script go through the per-enemy
+	// loop; the count is one cheap pass that vectorizes
+	const unsigned short* pc = state.pc.data();
+	int runs = 1;
+	for (int i = begin + 1; i < end; i++)
+		runs += pc[i] != pc[i - 1];
+	if (runs * MOVE_SCRIPT_MIN_RUN > end - begin)
+	{
+		run_each(program, state, x, y, begin, end);
+		return;
+	}
+
+	// a run is measured before it runs, and running it only moves on the
+	// program counters of its own enemies. Enemies between runs cost one
+	// compare each before going through the per-enemy loop.
+	for (int first = begin; first < end; )
+	{
+		int last = first + 1;
+		while (last < end && pc[last] == pc[first])
+			last++;
+		if (last - first >= MOVE_SCRIPT_MIN_RUN)
+		{
+			IdRun run = { first };
+			run_op(program, pc[first], state, x, y, run, last - first);
+			first = last;
+			continue;
+		}
+
+		while (last < end && !may_start_run(pc, last, end))
+			last++;
+		run_each(program, state, x, y, first, last);
+		first = last;
+	}
+}
+
+
+void run_move_scripts_per_enemy(const MoveProgram& program, MoveState& state, float* x, float* y, int begin, int end)
+{
+	if (program.count() == 0)
+		return;
+
+	run_each(program, state, x, y, begin, end);
+}
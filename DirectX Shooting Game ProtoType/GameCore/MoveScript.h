@@ -0,0 +1,129 @@
+//-----------------------------------------------------------------------------
+// File: MoveScript.h
+//
+// Desc: Enemy movement scripts. A script is a short text program, one
+//       instruction per line, times in seconds and speeds in pixels per
+//       second ('#' starts a comment):
+//
+//           wait <seconds>                          stand still
+//           move <vx> <vy> [seconds]                straight line
+//           strafe <vx> [seconds]                   sideways only
+//           weave <amplitude> <period> <vy> [seconds]
+//                                                   sine across the x it
+//                                                   started at, drifting down
+//           dive <vy> <acceleration> [seconds]      down, faster and faster
+//           loop                                    back to the first line
+//
+//       An instruction without seconds runs forever. A script that runs off
+//       its end leaves the enemy where it stopped.
+//
+//       A program can hold several scripts one after the other, each started
+//       at the instruction add() returned for it, and a loop goes back to
+//       the first line of its own script.
+//
+//       Scripts compile to fixed-size instructions with every speed already
+//       turned into a per-tick step and every weave into a table of offsets,
+//       one per tick, so no instruction does any trig or division at run
+//       time.
+//
+//       Every enemy has its own program counter, so enemies that spawned at
+//       different times run different instructions. Enemies that spawned
+//       together sit in runs of ids on the same line, and each tick the VM
+//       runs a long run through its instruction in one dispatch, with each
+//       handler a straight loop. The enemies of a short run are dispatched
+//       one at a time: gathering scattered enemies by line costs more than
+//       the dispatches it saves.
+//-----------------------------------------------------------------------------
+#ifndef __MoveScript_h_
+#define __MoveScript_h_
+
+#include <string>
+#include <vector>
+
+#define MOVE_SCRIPT_MAX_OPS 256        // in a whole program, every END included
+#define MOVE_SCRIPT_MAX_PERIOD 4096    // longest weave period, in ticks
+#define MOVE_SCRIPT_MAX_WEAVE 16384    // longest timed weave, in ticks
+
+enum {
+	MOVE_OP_WAIT,
+	MOVE_OP_MOVE,       // strafe compiles to this too
+	MOVE_OP_WEAVE,
+	MOVE_OP_DIVE,
+	MOVE_OP_LOOP,
+	MOVE_OP_END         // added after the last line of every script
+};
+
+struct MoveOp {
+	int code;
+	int ticks;        // 0 runs forever
+	float a, b;       // move: dx, dy; weave: -, dy; dive: dy, extra dy per tick
+	int table;        // weave: first offset in the program's table; loop: first instruction of its script
+	int period;       // weave: offsets in the table, ticks before an endless weave repeats
+};
+
+
+class MoveProgram {
+
+public:
+	MoveProgram();
+
+	// false, with error() saying why and where, if the source doesn't
+	// compile; tick_seconds is the length of one VM step
+	bool compile(const char* source, float tick_seconds);
+	bool load(const char* path, float tick_seconds);
+
+	// appends one more script and returns its first instruction, or -1 with
+	// error() saying why, leaving the scripts already there as they were
+	int add(const char* source, float tick_seconds);
+	void clear();
+
+	const char* error() const { return message.c_str(); }
+	int count() const { return (int)ops.size(); }
+	const MoveOp& op(int pc) const { return ops[pc]; }
+	const float* offsets() const { return table.data(); }
+
+	// where an enemy goes once instruction pc is done, past any loop
+	int next(int pc) const;
+
+	// the furthest any instruction moves an enemy in one tick, or -1 when
+	// an endless dive makes that unbounded
+	float max_step() const { return longest_step; }
+
+private:
+	bool parse(const char* source, float tick_seconds, int entry);
+	bool fail(int line, const char* what);
+
+	std::vector<MoveOp> ops;
+	std::vector<float> table;
+	std::string message;
+	float longest_step;
+};
+
+
+// the script state of every enemy
+struct MoveState {
+	std::vector<unsigned short> pc;
+	std::vector<int> ticks;           // spent on the current instruction
+	std::vector<float> origin_x;      // x when the current instruction began
+
+	int count() const { return (int)pc.size(); }
+	void resize(int n);
+};
+
+
+// enemy i starts the script from the top at x
+void start_move_script(const MoveProgram& program, MoveState& state, int i, float x);
+
+// the same, from instruction pc: the entry of a script add() appended, or
+// the END of one to leave the enemy standing still
+void start_move_script_at(const MoveProgram& program, MoveState& state, int i, float x, int pc);
+
+// one tick of the scripts of enemies [begin, end); disjoint ranges can run
+// on different threads
+void run_move_scripts(const MoveProgram& program, MoveState& state, float* x, float* y, int begin, int end);
+
+// the same, one enemy at a time with a dispatch each; gives exactly the same
+// result. Kept as the reference for the benchmark.
+void run_move_scripts_per_enemy(const MoveProgram& program, MoveState& state, float* x, float* y, int begin, int end);
+
+#endif // __MoveScript_h_
@@ -0,0 +1,241 @@
+//-----------------------------------------------------------------------------
+// File: Particles.cpp
+//
+// Desc: Scalar and SSE2 particle kernels, the runtime dispatch, the pool
+//       and its draw. The AVX2 kernel lives in Particles_avx2.cpp so only
+//       that file needs to be compiled for AVX2. Every path does the same
+//       multiplies and adds in the same order, so all of them move every
+//       particle to exactly the same place.
+//-----------------------------------------------------------------------------
+#include <math.h>
+
+#include "Particles.h"
+#include "Cpu.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PARTICLES_SSE2 1
+#include <emmintrin.h>
+#endif
+
+
+typedef int (*ParticleKernel)(float*, float*, float*, float*, float*, int, const ParticleStep&, int*);
+
+// the SIMD path and its kernel
+struct ParticleDispatch {
+	int level;
+	ParticleKernel kernel;
+};
+
+
+// the index is always written and only kept when the particle is dead, so
+// there is no branch to mispredict
+int step_particles_scalar(float* x, float* y, float* vx, float* vy, float* life, int n, const ParticleStep& step, int* dead)
+{
+	const float dt = step.dt, damp = step.damp, fall = step.fall;
+	int count = 0;
+
+	for (int i = 0; i < n; i++)
+	{
+		float nvx = vx[i] * damp;
+		float nvy = vy[i] * damp + fall;
+		vx[i] = nvx;
+		vy[i] = nvy;
+		x[i] += nvx * dt;
+		y[i] += nvy * dt;
+		float left = life[i] - dt;
+		life[i] = left;
+		dead[count] = i;
+		count += left <= 0.0f;
+	}
+	return count;
+}
+
+
+#if defined(PARTICLES_SSE2)
+
+int step_particles_sse2(float* x, float* y, float* vx, float* vy, float* life, int n, const ParticleStep& step, int* dead)
+{
+	__m128 dt = _mm_set1_ps(step.dt);
+	__m128 damp = _mm_set1_ps(step.damp);
+	__m128 fall = _mm_set1_ps(step.fall);
+	__m128 zero = _mm_setzero_ps();
+	int count = 0;
+
+	int i = 0;
+	for (; i + 4 <= n; i += 4)
+	{
+		__m128 nvx = _mm_mul_ps(_mm_loadu_ps(vx + i), damp);
+		__m128 nvy = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(vy + i), damp), fall);
+		_mm_storeu_ps(vx + i, nvx);
+		_mm_storeu_ps(vy + i, nvy);
+		_mm_storeu_ps(x + i, _mm_add_ps(_mm_loadu_ps(x + i), _mm_mul_ps(nvx, dt)));
+		_mm_storeu_ps(y + i, _mm_add_ps(_mm_loadu_ps(y + i), _mm_mul_ps(nvy, dt)));
+		__m128 left = _mm_sub_ps(_mm_loadu_ps(life + i), dt);
+		_mm_storeu_ps(life + i, left);
+		for (unsigned int bits = (unsigned int)_mm_movemask_ps(_mm_cmple_ps(left, zero)); bits != 0; bits &= bits - 1)
+			dead[count++] = i + lowest_bit_index(bits);
+	}
+
+	int tail = step_particles_scalar(x + i, y + i, vx + i, vy + i, life + i, n - i, step, dead + count);
+	for (int k = 0; k < tail; k++)
+		dead[count + k] += i;
+	return count + tail;
+}
+
+#else
+
+int step_particles_sse2(float* x, float* y, float* vx, float* vy, float* life, int n, const ParticleStep& step, int* dead)
+{
+	return step_particles_scalar(x, y, vx, vy, life, n, step, dead);
+}
+
+#endif
+
+
+static ParticleDispatch particles_dispatch(int level)
+{
+	if (level > cpu_simd_level())
+		level = cpu_simd_level();
+
+	ParticleDispatch d;
+	d.level = level;
+	switch (level)
+	{
+	case SIMD_AVX2:
+		d.kernel = step_particles_avx2;
+		break;
+	case SIMD_SSE2:
+		d.kernel = step_particles_sse2;
+		break;
+	default:
+		d.kernel = step_particles_scalar;
+		break;
+	}
+	return d;
+}
+
+
+// chosen by the first step; the static is initialized once however many
+// jobs reach it together
+static ParticleDispatch& dispatch()
+{
+	static ParticleDispatch d = particles_dispatch(cpu_simd_level());
+	return d;
+}
+
+
+int particles_simd_level()
+{
+	return dispatch().level;
+}
+
+
+void particles_set_simd_level(int level)
+{
+	dispatch() = particles_dispatch(level);
+}
+
+
+int step_particles(float* x, float* y, float* vx, float* vy, float* life, int n, const ParticleStep& step, int* dead)
+{
+	return dispatch().kernel(x, y, vx, vy, life, n, step, dead);
+}
+
+
+ParticleSystem::ParticleSystem()
+	: live(0), gravity(0), drag(1)
+{
+}
+
+
+void ParticleSystem::init(int capacity, float gravity_, float drag_, unsigned int seed)
+{
+	x.assign(capacity, 0.0f);
+	y.assign(capacity, 0.0f);
+	vx.assign(capacity, 0.0f);
+	vy.assign(capacity, 0.0f);
+	life.assign(capacity, 0.0f);
+	fade.assign(capacity, 0.0f);
+	color.assign(capacity, 0);
+	dead.assign(capacity, 0);
+	gravity = gravity_;
+	drag = drag_;
+	rng.seed(seed, 0);
+	live = 0;
+}
+
+
+void ParticleSystem::clear()
+{
+	live = 0;
+}
+
+
+int ParticleSystem::emit(const ParticleBurst& burst, float px, float py)
+{
+	int n = burst.count < capacity() - live ? burst.count : capacity() - live;
+	for (int k = 0; k < n; k++)
+	{
+		int i = live++;
+		float angle = rng.uniform(0.0f, 6.2831853f);
+		float speed = rng.uniform(burst.speed_min, burst.speed_max);
+		float seconds = rng.uniform(burst.life_min, burst.life_max);
+		x[i] = px;
+		y[i] = py;
+		vx[i] = speed * cosf(angle);
+		vy[i] = speed * sinf(angle);
+		life[i] = seconds;
+		fade[i] = seconds > 0.0f ? 1.0f / seconds : 0.0f;
+		color[i] = burst.color & 0xffffff;
+	}
+	return n;
+}
+
+
+void ParticleSystem::update(float dt)
+{
+	ParticleStep step;
+	step.dt = dt;
+	step.damp = powf(drag, dt);
+	step.fall = gravity * dt;
+	int n = step_particles(x.data(), y.data(), vx.data(), vy.data(), life.data(), live, step, dead.data());
+
+	// highest first: everything above a dead particle is alive by the time
+	// it is removed, so the last one always fills the hole with a live one
+	for (int k = n - 1; k >= 0; k--)
+	{
+		int i = dead[k];
+		int last = --live;
+		if (i == last)
+			continue;
+		x[i] = x[last];
+		y[i] = y[last];
+		vx[i] = vx[last];
+		vy[i] = vy[last];
+		life[i] = life[last];
+		fade[i] = fade[last];
+		color[i] = color[last];
+	}
+}
+
+
+void draw_particles(const ParticleSystem& particles, const SpriteFrame& frame, int layer, bool premultiplied,
+	SpriteBatch& batch)
+{
+	const float half_w = frame.w * 0.5f, half_h = frame.h * 0.5f;
+	for (int i = 0; i < particles.count(); i++)
+	{
+		float f = particles.life[i] * particles.fade[i];
+		unsigned int a = f >= 1.0f ? 255 : (unsigned int)(f * 255.0f);
+		unsigned int c = particles.color[i];
+		if (premultiplied)
+		{
+			unsigned int r = ((c >> 16) & 0xff) * a / 255;
+			unsigned int g = ((c >> 8) & 0xff) * a / 255;
+			unsigned int b = (c & 0xff) * a / 255;
+			c = (r << 16) | (g << 8) | b;
+		}
+		if (!batch.add(frame, layer, 0, particles.x[i] - half_w, particles.y[i] - half_h, (a << 24) | c))
+			return;
+	}
+}
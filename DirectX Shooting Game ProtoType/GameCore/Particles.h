@@ -0,0 +1,104 @@
+//-----------------------------------------------------------------------------
+// File: Particles.h
+//
+// Desc: Particles for hit sparks and explosions. Live particles are packed
+//       at the front of fixed-capacity struct-of-arrays storage. One kernel
+//       pass moves all of them, 4 or 8 per instruction, and writes the
+//       indices of the ones whose time ran out. Those are then swap-removed,
+//       highest first, so every hole is filled from the live end and the
+//       arrays stay packed. Nothing is allocated after init().
+//
+//       Particles are only for show: they have their own random stream and
+//       nothing in the game logic reads them.
+//-----------------------------------------------------------------------------
+#ifndef __Particles_h_
+#define __Particles_h_
+
+#include <vector>
+
+#include "Rng.h"
+#include "SpriteBatch.h"
+
+// what one step does to every particle: velocity is scaled by damp, then
+// fall is added to vy, then the position moves by velocity * dt and dt
+// comes off the life left
+struct ParticleStep {
+	float dt;
+	float damp;
+	float fall;
+};
+
+// the particles of [0, n) take one step; dead needs room for n indices and
+// gets those of the particles with no life left, ascending. Returns how
+// many were written.
+int step_particles(float* x, float* y, float* vx, float* vy, float* life, int n, const ParticleStep& step, int* dead);
+
+
+// SIMD path used by step_particles(); defaults to cpu_simd_level() and can
+// be lowered to compare paths between steps. Requests above what the CPU
+// supports are clamped.
+int particles_simd_level();
+void particles_set_simd_level(int level);
+
+
+// per-ISA kernels, exposed for the benchmarks
+int step_particles_scalar(float* x, float* y, float* vx, float* vy, float* life, int n, const ParticleStep& step, int* dead);
+int step_particles_sse2(float* x, float* y, float* vx, float* vy, float* life, int n, const ParticleStep& step, int* dead);
+int step_particles_avx2(float* x, float* y, float* vx, float* vy, float* life, int n, const ParticleStep& step, int* dead);
+
+
+// a burst of particles flying out from a point in every direction
+struct ParticleBurst {
+	int count;
+	float speed_min, speed_max;    // pixels per second
+	float life_min, life_max;      // seconds
+	unsigned int color;            // RGB; alpha fades with the life left
+};
+
+
+class ParticleSystem {
+
+public:
+	ParticleSystem();
+
+	// allocates all storage; gravity pulls down in pixels per second
+	// squared, and drag is the share of its speed a particle keeps after a
+	// second
+	void init(int capacity, float gravity, float drag, unsigned int seed);
+	void clear();
+
+	// returns how many particles of the burst fit
+	int emit(const ParticleBurst& burst, float x, float y);
+
+	// move everything by dt seconds and retire what burned out
+	void update(float dt);
+
+	int count() const { return live; }
+	int capacity() const { return (int)x.size(); }
+
+	// dense arrays; only [0, count()) is meaningful
+	std::vector<float> x;
+	std::vector<float> y;
+	std::vector<float> vx;
+	std::vector<float> vy;
+	std::vector<float> life;           // seconds left
+	std::vector<float> fade;           // 1 / the life it started with
+	std::vector<unsigned int> color;
+
+private:
+	int live;
+	float gravity;
+	float drag;
+	Rng rng;
+	std::vector<int> dead;
+};
+
+
+// every particle as a frame-sized quad centered on it, tinted by its color
+// and faded by its life left, all on one layer: with one frame that is one
+// texture run, so the batch draws them together. premultiplied scales the
+// tint by the fade too, for a page blended as premultiplied alpha.
+void draw_particles(const ParticleSystem& particles, const SpriteFrame& frame, int layer, bool premultiplied,
+	SpriteBatch& batch);
+
+#endif // __Particles_h_
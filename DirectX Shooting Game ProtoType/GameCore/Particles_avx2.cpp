@@ -0,0 +1,54 @@
+//-----------------------------------------------------------------------------
+// File: Particles_avx2.cpp
+//
+// Desc: AVX2 particle kernel. Built with AVX2 enabled; only called when
+//       cpu_simd_level() says the machine has it.
+//-----------------------------------------------------------------------------
+#include "Particles.h"
+#include "Cpu.h"
+
+#if defined(__AVX2__) || defined(_MSC_VER)
+#define PARTICLES_AVX2 1
+#include <immintrin.h>
+#endif
+
+
+#if defined(PARTICLES_AVX2)
+
+int step_particles_avx2(float* x, float* y, float* vx, float* vy, float* life, int n, const ParticleStep& step, int* dead)
+{
+	__m256 dt = _mm256_set1_ps(step.dt);
+	__m256 damp = _mm256_set1_ps(step.damp);
+	__m256 fall = _mm256_set1_ps(step.fall);
+	__m256 zero = _mm256_setzero_ps();
+	int count = 0;
+
+	int i = 0;
+	for (; i + 8 <= n; i += 8)
+	{
+		__m256 nvx = _mm256_mul_ps(_mm256_loadu_ps(vx + i), damp);
+		__m256 nvy = _mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(vy + i), damp), fall);
+		_mm256_storeu_ps(vx + i, nvx);
+		_mm256_storeu_ps(vy + i, nvy);
+		_mm256_storeu_ps(x + i, _mm256_add_ps(_mm256_loadu_ps(x + i), _mm256_mul_ps(nvx, dt)));
+		_mm256_storeu_ps(y + i, _mm256_add_ps(_mm256_loadu_ps(y + i), _mm256_mul_ps(nvy, dt)));
+		__m256 left = _mm256_sub_ps(_mm256_loadu_ps(life + i), dt);
+		_mm256_storeu_ps(life + i, left);
+		for (unsigned int bits = (unsigned int)_mm256_movemask_ps(_mm256_cmp_ps(left, zero, _CMP_LE_OQ)); bits != 0; bits &= bits - 1)
+			dead[count++] = i + lowest_bit_index(bits);
+	}
+
+	int tail = step_particles_sse2(x + i, y + i, vx + i, vy + i, life + i, n - i, step, dead + count);
+	for (int k = 0; k < tail; k++)
+		dead[count + k] += i;
+	return count + tail;
+}
+
+#else
+
+int step_particles_avx2(float* x, float* y, float* vx, float* vy, float* life, int n, const ParticleStep& step, int* dead)
+{
+	return step_particles_sse2(x, y, vx, vy, life, n, step, dead);
+}
+
+#endif
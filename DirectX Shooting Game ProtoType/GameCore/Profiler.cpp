@@ -0,0 +1,196 @@
+//-----------------------------------------------------------------------------
+// File: Profiler.cpp
+//
+// Desc: Ring registration, tick calibration, trace export and the summary.
+//-----------------------------------------------------------------------------
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Profiler.h"
+
+// the TSC is measured against steady_clock for at least this long
+#define PROFILE_CALIBRATE_NS 10000000.0
+
+thread_local ProfileRing* t_profile_ring = 0;
+
+
+// every ring ever made, and where the clocks stood when the first one was
+struct ProfileRegistry {
+	std::mutex lock;
+	std::vector<ProfileRing*> rings;
+	unsigned long long start_ticks;
+	double start_ns;
+};
+
+
+static double steady_ns()
+{
+	return (double)std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+
+// never destroyed, so threads that outlive static destruction can still
+// record
+static ProfileRegistry& registry()
+{
+	static ProfileRegistry* r = new ProfileRegistry();
+	return *r;
+}
+
+
+ProfileRing* profile_register_thread()
+{
+	ProfileRing* ring = new ProfileRing();
+	ring->written = 0;
+
+	ProfileRegistry& r = registry();
+	{
+		std::lock_guard<std::mutex> lock(r.lock);
+		if (r.rings.empty())
+		{
+			r.start_ticks = profile_now();
+			r.start_ns = steady_ns();
+		}
+		ring->thread = (int)r.rings.size();
+		r.rings.push_back(ring);
+	}
+	t_profile_ring = ring;
+	return ring;
+}
+
+
+double profile_tick_ns()
+{
+#if PROFILE_TSC
+	ProfileRegistry& r = registry();
+	unsigned long long start_ticks;
+	double start_ns;
+	{
+		std::lock_guard<std::mutex> lock(r.lock);
+		if (r.rings.empty())
+		{
+			r.start_ticks = profile_now();
+			r.start_ns = steady_ns();
+		}
+		start_ticks = r.start_ticks;
+		start_ns = r.start_ns;
+	}
+
+	// a short run gets a short wait to stretch the measurement
+	while (steady_ns() - start_ns < PROFILE_CALIBRATE_NS)
+		std::this_thread::yield();
+	return (steady_ns() - start_ns) / (double)(profile_now() - start_ticks);
+#else
+	return 1.0;
+#endif
+}
+
+
+// the zones still held by every ring, oldest first within a ring
+static void collect(std::vector<ProfileEvent>& events, std::vector<int>& threads)
+{
+	ProfileRegistry& r = registry();
+	std::lock_guard<std::mutex> lock(r.lock);
+	for (size_t i = 0; i < r.rings.size(); i++)
+	{
+		const ProfileRing& ring = *r.rings[i];
+		unsigned long long n = ring.written.load(std::memory_order_acquire);
+		unsigned long long first = n > PROFILE_RING_EVENTS ? n - PROFILE_RING_EVENTS : 0;
+		for (unsigned long long k = first; k < n; k++)
+		{
+			events.push_back(ring.events[k & (PROFILE_RING_EVENTS - 1)]);
+			threads.push_back(ring.thread);
+		}
+	}
+}
+
+
+// JSON string contents; zone names are plain literals, but be safe
+static void write_escaped(FILE* f, const char* s)
+{
+	for (; *s; s++)
+	{
+		if (*s == '"' || *s == '\\')
+			fputc('\\', f);
+		if ((unsigned char)*s >= 0x20)
+			fputc(*s, f);
+	}
+}
+
+
+bool profile_write_trace(const char* path)
+{
+	std::vector<ProfileEvent> events;
+	std::vector<int> threads;
+	collect(events, threads);
+	double tick_ns = profile_tick_ns();
+
+	FILE* f = fopen(path, "w");
+	if (!f)
+		return false;
+
+	unsigned long long origin = ~0ull;
+	int thread_count = 0;
+	for (size_t i = 0; i < events.size(); i++)
+	{
+		origin = std::min(origin, events[i].begin);
+		thread_count = std::max(thread_count, threads[i] + 1);
+	}
+
+	// complete ("X") events in microseconds from the first zone
+	fprintf(f, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+	for (int t = 0; t < thread_count; t++)
+		fprintf(f, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"thread %d\"}},\n", t, t);
+	for (size_t i = 0; i < events.size(); i++)
+	{
+		const ProfileEvent& e = events[i];
+		fprintf(f, "{\"name\":\"");
+		write_escaped(f, e.name);
+		fprintf(f, "\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}%s\n", threads[i],
+			(double)(e.begin - origin) * tick_ns / 1000.0, (double)(e.end - e.begin) * tick_ns / 1000.0,
+			i + 1 < events.size() ? "," : "");
+	}
+	fprintf(f, "]}\n");
+	return fclose(f) == 0;
+}
+
+
+void profile_print_summary(FILE* out)
+{
+	std::vector<ProfileEvent> events;
+	std::vector<int> threads;
+	collect(events, threads);
+	double tick_ns = profile_tick_ns();
+
+	std::map<std::string, std::vector<unsigned long long> > zones;
+	for (size_t i = 0; i < events.size(); i++)
+		zones[events[i].name].push_back(events[i].end - events[i].begin);
+
+	fprintf(out, "%-24s %10s %12s %12s %12s\n", "zone", "count", "mean us", "p50 us", "p99 us");
+	for (std::map<std::string, std::vector<unsigned long long> >::iterator it = zones.begin(); it != zones.end(); ++it)
+	{
+		std::vector<unsigned long long>& d = it->second;
+		std::sort(d.begin(), d.end());
+		double total = 0;
+		for (size_t i = 0; i < d.size(); i++)
+			total += (double)d[i];
+		double us = tick_ns / 1000.0;
+		fprintf(out, "%-24s %10d %12.2f %12.2f %12.2f\n", it->first.c_str(), (int)d.size(), total / d.size() * us,
+			d[d.size() / 2] * us, d[std::min(d.size() - 1, d.size() * 99 / 100)] * us);
+	}
+}
+
+
+void profile_reset()
+{
+	ProfileRegistry& r = registry();
+	std::lock_guard<std::mutex> lock(r.lock);
+	for (size_t i = 0; i < r.rings.size(); i++)
+		r.rings[i]->written.store(0, std::memory_order_release);
+}
@@ -0,0 +1,133 @@
+//-----------------------------------------------------------------------------
+// File: Profiler.h
+//
+// Desc: Scoped timing zones cheap enough to leave in shipping builds.
+//
+//           PROFILE_SCOPE("collide");
+//
+//       times the rest of the enclosing block. Every thread writes its
+//       zones into its own ring buffer: two timestamps and a name pointer,
+//       no locks and no allocation after the thread's first zone. Once a
+//       ring is full the oldest zones are overwritten, so a long session
+//       keeps its last PROFILE_RING_EVENTS zones per thread.
+//
+//       Timestamps come from the TSC on x86 (converted to time at export by
+//       measuring it against steady_clock over the run) and from
+//       steady_clock elsewhere.
+//
+//       At the end, profile_write_trace() saves every zone as Chrome
+//       trace_event JSON (load it in chrome://tracing or Perfetto), and
+//       profile_print_summary() prints count, mean, p50 and p99 per zone
+//       name. Both read the rings of every thread, so call them once the
+//       threads are idle.
+//
+//       Build with PROFILE_ENABLED 0 to compile every zone away.
+//-----------------------------------------------------------------------------
+#ifndef __Profiler_h_
+#define __Profiler_h_
+
+#include <atomic>
+#include <stdio.h>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define PROFILE_TSC 1
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#else
+#define PROFILE_TSC 0
+#include <chrono>
+#endif
+
+#ifndef PROFILE_ENABLED
+#define PROFILE_ENABLED 1
+#endif
+
+#define PROFILE_RING_EVENTS 65536     // per thread, a power of two
+
+struct ProfileEvent {
+	const char* name;           // a string literal; zones are told apart by its text
+	unsigned long long begin;
+	unsigned long long end;
+};
+
+struct ProfileRing {
+	ProfileEvent events[PROFILE_RING_EVENTS];
+	std::atomic<unsigned long long> written;    // zones ever recorded
+	int thread;                                  // in order of first use
+};
+
+// the calling thread's ring, made on its first zone and kept for the life
+// of the process
+extern thread_local ProfileRing* t_profile_ring;
+ProfileRing* profile_register_thread();
+
+
+// raw timestamp, in TSC ticks or nanoseconds
+inline unsigned long long profile_now()
+{
+#if PROFILE_TSC
+	return __rdtsc();
+#else
+	return (unsigned long long)std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+
+inline void profile_record(const char* name, unsigned long long begin, unsigned long long end)
+{
+	ProfileRing* ring = t_profile_ring;
+	if (!ring)
+		ring = profile_register_thread();
+
+	// only this thread writes the ring, so a plain load and store will do
+	unsigned long long n = ring->written.load(std::memory_order_relaxed);
+	ProfileEvent& e = ring->events[n & (PROFILE_RING_EVENTS - 1)];
+	e.name = name;
+	e.begin = begin;
+	e.end = end;
+	ring->written.store(n + 1, std::memory_order_release);
+}
+
+
+class ProfileScope {
+
+public:
+	explicit ProfileScope(const char* name_) : name(name_), begin(profile_now()) {}
+	~ProfileScope() { profile_record(name, begin, profile_now()); }
+
+private:
+	ProfileScope(const ProfileScope&);
+	ProfileScope& operator=(const ProfileScope&);
+
+	const char* name;
+	unsigned long long begin;
+};
+
+
+#define PROFILE_JOIN2(a, b) a##b
+#define PROFILE_JOIN(a, b) PROFILE_JOIN2(a, b)
+
+#if PROFILE_ENABLED
+#define PROFILE_SCOPE(name) ProfileScope PROFILE_JOIN(profile_scope_, __LINE__)(name)
+#else
+#define PROFILE_SCOPE(name) ((void)0)
+#endif
+
+
+// nanoseconds per profile_now() tick
+double profile_tick_ns();
+
+// every zone still in the rings as Chrome trace_event JSON
+bool profile_write_trace(const char* path);
+
+// per zone name: count, mean, p50 and p99, in microseconds
+void profile_print_summary(FILE* out);
+
+// forget every zone recorded so far
+void profile_reset();
+
+#endif // __Profiler_h_
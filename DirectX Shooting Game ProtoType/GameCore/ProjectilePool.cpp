@@ -0,0 +1,165 @@
+//-----------------------------------------------------------------------------
+// File: ProjectilePool.cpp
+//
+// Desc: Packed projectile pool with a free list of stable ids.
+//-----------------------------------------------------------------------------
+#include "ProjectilePool.h"
+
+
+ProjectilePool::ProjectilePool()
+	: live(0), cooldown(0), cooldown_ticks(0), x_min(0), y_min(0), x_max(0), y_max(0), free_top(0)
+{
+}
+
+
+void ProjectilePool::init(int capacity, int cooldown_ticks_, float x_min_, float y_min_, float x_max_, float y_max_)
+{
+	x.assign(capacity, 0.0f);
+	y.assign(capacity, 0.0f);
+	vx.assign(capacity, 0.0f);
+	vy.assign(capacity, 0.0f);
+	alive.assign(capacity, 0);
+	id.assign(capacity, -1);
+	slot.assign(capacity, -1);
+	free_ids.assign(capacity, 0);
+
+	cooldown_ticks = cooldown_ticks_;
+	x_min = x_min_;
+	y_min = y_min_;
+	x_max = x_max_;
+	y_max = y_max_;
+	clear();
+}
+
+
+void ProjectilePool::clear()
+{
+	int n = capacity();
+	for (int i = 0; i < n; i++)
+	{
+		slot[i] = -1;
+		// pop order hands out low ids first
+		free_ids[i] = n - 1 - i;
+	}
+	free_top = n;
+	live = 0;
+	cooldown = 0;
+}
+
+
+int ProjectilePool::spawn(float px, float py, float pvx, float pvy)
+{
+	if (free_top == 0)
+		return -1;
+
+	int new_id = free_ids[--free_top];
+	int i = live++;
+	x[i] = px;
+	y[i] = py;
+	vx[i] = pvx;
+	vy[i] = pvy;
+	alive[i] = 1;
+	id[i] = new_id;
+	slot[new_id] = i;
+	return new_id;
+}
+
+
+int ProjectilePool::spawn_batch(int n)
+{
+	if (n > free_top)
+		n = free_top;
+
+	for (int k = 0; k < n; k++)
+	{
+		int new_id = free_ids[--free_top];
+		int i = live++;
+		alive[i] = 1;
+		id[i] = new_id;
+		slot[new_id] = i;
+	}
+	return n;
+}
+
+
+bool ProjectilePool::restore(int live_, int cooldown_, const int* free_list_, int free_count_)
+{
+	int n = capacity();
+	if (live_ < 0 || free_count_ < 0 || live_ + free_count_ != n)
+		return false;
+
+	live = live_;
+	cooldown = cooldown_;
+	free_top = free_count_;
+	for (int i = 0; i < free_top; i++)
+		free_ids[i] = free_list_[i];
+
+	for (int i = 0; i < n; i++)
+		slot[i] = -1;
+	for (int i = 0; i < live; i++)
+	{
+		if (id[i] < 0 || id[i] >= n)
+			return false;
+		slot[id[i]] = i;
+	}
+	return true;
+}
+
+
+void ProjectilePool::despawn_at(int index)
+{
+	int last = --live;
+	free_ids[free_top++] = id[index];
+	slot[id[index]] = -1;
+
+	if (index != last)
+	{
+		x[index] = x[last];
+		y[index] = y[last];
+		vx[index] = vx[last];
+		vy[index] = vy[last];
+		alive[index] = alive[last];
+		id[index] = id[last];
+		slot[id[index]] = index;
+	}
+}
+
+
+void ProjectilePool::update(float dt)
+{
+	advance(0, live, dt);
+	compact();
+}
+
+
+void ProjectilePool::advance(int begin, int end, float dt)
+{
+	float* px = x.data();
+	float* py = y.data();
+	const float* pvx = vx.data();
+	const float* pvy = vy.data();
+	unsigned char* palive = alive.data();
+
+	// same rule as the old single bullets: retire if already off screen, else move
+	for (int i = begin; i < end; i++)
+	{
+		unsigned char keep = palive[i] & (unsigned char)(px[i] >= x_min) & (unsigned char)(px[i] <= x_max)
+			& (unsigned char)(py[i] >= y_min) & (unsigned char)(py[i] <= y_max);
+		palive[i] = keep;
+		px[i] += pvx[i] * dt;
+		py[i] += pvy[i] * dt;
+	}
+}
+
+
+void ProjectilePool::compact()
+{
+	int i = 0;
+	while (i < live)
+	{
+		if (alive[i])
+			i++;
+		else
+			despawn_at(i);    // re-test i, it now holds what was the last one
+	}
+}
@@ -0,0 +1,86 @@
+//-----------------------------------------------------------------------------
+// File: ProjectilePool.h
+//
+// Desc: Fixed-capacity pool for one type of projectile. Live projectiles are
+//       kept packed at the front of struct-of-arrays storage, so updates and
+//       collision batches stream over [0, count()) with no holes. Every
+//       projectile also gets a stable id from a free list, which survives the
+//       packing. Spawn and despawn are O(1), and nothing is allocated after
+//       init().
+//-----------------------------------------------------------------------------
+#ifndef __ProjectilePool_h_
+#define __ProjectilePool_h_
+
+#include <vector>
+
+class ProjectilePool {
+
+public:
+	ProjectilePool();
+
+	// allocates all storage; speeds are in units per second and
+	// projectiles outside the bounds rectangle are retired
+	void init(int capacity, int cooldown_ticks, float x_min, float y_min, float x_max, float y_max);
+	void clear();
+
+	// returns the new projectile's id, or -1 when the pool is full
+	int spawn(float x, float y, float vx, float vy);
+
+	// append up to n projectiles at the end of the live range and return how
+	// many fit; the caller fills x/y/vx/vy of the last that many slots
+	int spawn_batch(int n);
+
+	// remove the projectile at a dense index; the last one takes its place
+	void despawn_at(int index);
+
+	// fire-rate limiting: ready() until fire() is called, then again after
+	// cooldown_ticks calls to tick_cooldown()
+	bool ready() const { return cooldown == 0; }
+	void fire() { cooldown = cooldown_ticks; }
+	void tick_cooldown() { if (cooldown > 0) cooldown--; }
+
+	// move everything by dt seconds, mark the ones that left the bounds
+	// dead, then compact
+	void update(float dt);
+
+	// the first half of update() for the dense range [begin, end) only;
+	// disjoint ranges can run on different threads, then call compact()
+	void advance(int begin, int end, float dt);
+
+	// drop every projectile whose alive flag was cleared, keeping the rest packed
+	void compact();
+
+	int count() const { return live; }
+	int capacity() const { return (int)x.size(); }
+	int index_of(int id) const { return slot[id]; }    // -1 when the id is free
+
+	// snapshot support. The free list is part of the state: it decides which
+	// id the next spawn gets.
+	int cooldown_left() const { return cooldown; }
+	int free_count() const { return free_top; }
+	const int* free_list() const { return free_ids.data(); }
+
+	// once x/y/vx/vy/alive/id [0, live) hold a saved state, put back the
+	// rest and rebuild the id -> index map; false if the counts don't fit
+	bool restore(int live, int cooldown, const int* free_list, int free_count);
+
+	// dense arrays; only [0, count()) is meaningful
+	std::vector<float> x;
+	std::vector<float> y;
+	std::vector<float> vx;
+	std::vector<float> vy;
+	std::vector<unsigned char> alive;
+	std::vector<int> id;
+
+private:
+	int live;
+	int cooldown;
+	int cooldown_ticks;
+	float x_min, y_min, x_max, y_max;
+
+	std::vector<int> slot;        // id -> dense index
+	std::vector<int> free_ids;    // stack of unused ids
+	int free_top;
+};
+
+#endif // __ProjectilePool_h_
@@ -0,0 +1,267 @@
+//-----------------------------------------------------------------------------
+// File: Replay.cpp
+//
+// Desc: Replay file writer, memory-mapped reader and the headless driver.
+//-----------------------------------------------------------------------------
+#include <string.h>
+
+#include "Replay.h"
+#include "BakedTexture.h"
+
+
+// LEB128: 7 bits per byte, high bit set on every byte but the last
+static void write_varint(FILE* file, unsigned int v)
+{
+	unsigned char buf[5];
+	int n = 0;
+	while (v >= 0x80)
+	{
+		buf[n++] = (unsigned char)(v | 0x80);
+		v >>= 7;
+	}
+	buf[n++] = (unsigned char)v;
+	fwrite(buf, 1, n, file);
+}
+
+
+static bool read_varint(const unsigned char*& p, const unsigned char* end, unsigned int& v)
+{
+	v = 0;
+	for (int shift = 0; shift < 35 && p < end; shift += 7)
+	{
+		unsigned char b = *p++;
+		v |= (unsigned int)(b & 0x7f) << shift;
+		if (!(b & 0x80))
+			return true;
+	}
+	return false;
+}
+
+
+// the path and hash of the file at path into a header; none with NULL
+static bool note_file(const char* path, char* header_path, unsigned long long& hash)
+{
+	memset(header_path, 0, REPLAY_PATH_MAX);
+	hash = 0;
+	if (!path)
+		return true;
+
+	MappedFile file;
+	if (strlen(path) >= REPLAY_PATH_MAX || !file.open(path))
+		return false;
+	strcpy(header_path, path);
+	hash = baked_source_hash(file.data(), file.size());
+	return true;
+}
+
+
+// the file at path is still the one that was recorded
+static bool same_file(const char* path, unsigned long long hash)
+{
+	MappedFile file;
+	return file.open(path) && baked_source_hash(file.data(), file.size()) == hash;
+}
+
+
+ReplayWriter::ReplayWriter()
+	: file(NULL), run_buttons(0), run_length(0)
+{
+	memset(&header, 0, sizeof(header));
+}
+
+
+ReplayWriter::~ReplayWriter()
+{
+	close();
+}
+
+
+bool ReplayWriter::open(const char* path, unsigned int seed, int enemy_num, const char* script_path, const char* stage_path)
+{
+	close();
+
+	memset(&header, 0, sizeof(header));
+	if (!note_file(script_path, header.script_path, header.script_hash)
+		|| !note_file(stage_path, header.stage_path, header.stage_hash))
+		return false;
+
+	file = fopen(path, "wb");
+	if (!file)
+		return false;
+
+	memcpy(header.magic, REPLAY_MAGIC, 4);
+	header.version = REPLAY_VERSION;
+	header.seed = seed;
+	header.enemy_num = enemy_num;
+	header.ticks = 0;
+	header.runs = 0;
+	run_buttons = 0;
+	run_length = 0;
+
+	// the counts are filled in by close()
+	fwrite(&header, sizeof(header), 1, file);
+	return true;
+}
+
+
+void ReplayWriter::write_run()
+{
+	write_varint(file, run_length);
+	write_varint(file, run_buttons);
+	header.runs++;
+}
+
+
+void ReplayWriter::record(const SimInput& input)
+{
+	if (!file)
+		return;
+
+	if (run_length > 0 && input.buttons != run_buttons)
+	{
+		write_run();
+		run_length = 0;
+	}
+	run_buttons = input.buttons;
+	run_length++;
+	header.ticks++;
+}
+
+
+bool ReplayWriter::close()
+{
+	if (!file)
+		return false;
+
+	if (run_length > 0)
+		write_run();
+
+	fseek(file, 0, SEEK_SET);
+	fwrite(&header, sizeof(header), 1, file);
+	bool ok = ferror(file) == 0;
+	ok = fclose(file) == 0 && ok;
+	file = NULL;
+	return ok;
+}
+
+
+ReplayReader::ReplayReader()
+	: pos(NULL), end(NULL), run_left(0), run_buttons(0)
+{
+	memset(&header, 0, sizeof(header));
+}
+
+
+bool ReplayReader::open(const char* path)
+{
+	close();
+
+	if (!file.open(path) || file.size() < sizeof(ReplayHeader))
+	{
+		close();
+		return false;
+	}
+
+	memcpy(&header, file.data(), sizeof(header));
+	if (memcmp(header.magic, REPLAY_MAGIC, 4) != 0 || header.version != REPLAY_VERSION
+		|| header.enemy_num <= 0 || header.enemy_num > REPLAY_MAX_ENEMIES
+		|| memchr(header.script_path, 0, REPLAY_PATH_MAX) == NULL || memchr(header.stage_path, 0, REPLAY_PATH_MAX) == NULL)
+	{
+		close();
+		return false;
+	}
+
+	// walk the runs once so playback never has to check for a short file
+	const unsigned char* p = file.data() + sizeof(ReplayHeader);
+	const unsigned char* e = file.data() + file.size();
+	unsigned long long ticks = 0;
+	for (unsigned int r = 0; r < header.runs; r++)
+	{
+		unsigned int length, buttons;
+		if (!read_varint(p, e, length) || !read_varint(p, e, buttons))
+		{
+			close();
+			return false;
+		}
+		ticks += length;
+	}
+	if (ticks != header.ticks)
+	{
+		close();
+		return false;
+	}
+
+	rewind();
+	return true;
+}
+
+
+void ReplayReader::close()
+{
+	file.close();
+	memset(&header, 0, sizeof(header));
+	pos = end = NULL;
+	run_left = 0;
+	run_buttons = 0;
+}
+
+
+void ReplayReader::rewind()
+{
+	pos = file.data() ? file.data() + sizeof(ReplayHeader) : NULL;
+	end = file.data() ? file.data() + file.size() : NULL;
+	run_left = 0;
+	run_buttons = 0;
+}
+
+
+bool ReplayReader::next(SimInput& input)
+{
+	while (run_left == 0)
+	{
+		if (pos == end || !read_varint(pos, end, run_left) || !read_varint(pos, end, run_buttons))
+			return false;
+	}
+	run_left--;
+	input.buttons = run_buttons;
+	return true;
+}
+
+
+bool start_replay(World& world, const ReplayReader& replay, Stage& stage)
+{
+	const ReplayHeader& h = replay.info();
+	init_game(world, h.enemy_num, h.seed);
+
+	if (h.script_path[0])
+	{
+		MoveProgram script;
+		if (!same_file(h.script_path, h.script_hash) || !script.load(h.script_path, TICK_SECONDS))
+			return false;
+		set_enemy_script(world, script);
+	}
+	if (h.stage_path[0])
+	{
+		if (!same_file(h.stage_path, h.stage_hash) || !stage.open(h.stage_path, TICK_RATE) || !set_stage(world, stage))
+			return false;
+	}
+	return true;
+}
+
+
+long long run_replay(World& world, ReplayReader& replay, JobSystem* jobs, Stage& stage)
+{
+	if (!start_replay(world, replay, stage))
+		return -1;
+	world.jobs = jobs;
+
+	replay.rewind();
+	long long ticks = 0;
+	SimInput input;
+	while (replay.next(input))
+	{
+		do_game_logic(world, input);
+		ticks++;
+	}
+	return ticks;
+}
@@ -0,0 +1,115 @@
+//-----------------------------------------------------------------------------
+// File: Replay.h
+//
+// Desc: Recorded input sessions. The simulation only ever sees a SimInput
+//       per tick, so the seed, the enemy count, the movement script and
+//       stage the game was set up with and the list of per-tick button sets
+//       are enough to reproduce a whole session exactly.
+//
+//       The script and stage are named by path, with a hash of their bytes;
+//       a replay whose files changed since it was recorded won't start
+//       rather than play a different game.
+//
+//       File layout (little-endian):
+//           ReplayHeader
+//           runs x { varint tick count, varint buttons }
+//       Held buttons rarely change from one tick to the next, so the inputs
+//       are run-length encoded; an hour of play is a few kilobytes.
+//       Playback reads the file through a memory mapping.
+//-----------------------------------------------------------------------------
+#ifndef __Replay_h_
+#define __Replay_h_
+
+#include <stdio.h>
+
+#include "MappedFile.h"
+#include "Sim.h"
+#include "Stage.h"
+
+#define REPLAY_MAGIC "SREP"
+#define REPLAY_VERSION 2
+#define REPLAY_PATH_MAX 64
+#define REPLAY_MAX_ENEMIES (1 << 20)    // most enemies a replay may set up
+
+struct ReplayHeader {
+	char magic[4];
+	unsigned int version;
+	unsigned int seed;          // passed to init_game()
+	int enemy_num;              // passed to init_game()
+	unsigned int ticks;         // ticks recorded
+	unsigned int runs;          // run records after the header
+	unsigned long long script_hash;       // FNV-1a of the script file
+	unsigned long long stage_hash;        // FNV-1a of the stage file
+	char script_path[REPLAY_PATH_MAX];    // passed to set_enemy_script(), or empty
+	char stage_path[REPLAY_PATH_MAX];     // passed to set_stage(), or empty
+};
+
+
+class ReplayWriter {
+
+public:
+	ReplayWriter();
+	~ReplayWriter();
+
+	// start a recording of a game set up with init_game(world, enemy_num,
+	// seed), then given the movement script loaded from script_path and
+	// the stage at stage_path; either can be NULL for none. False if one
+	// can't be read or its path is REPLAY_PATH_MAX or longer.
+	bool open(const char* path, unsigned int seed, int enemy_num, const char* script_path, const char* stage_path);
+
+	// the input of the next tick
+	void record(const SimInput& input);
+
+	// write the last run and the final counts; the file is unusable until then
+	bool close();
+
+	bool is_open() const { return file != NULL; }
+
+private:
+	void write_run();
+
+	FILE* file;
+	ReplayHeader header;
+	unsigned int run_buttons;
+	unsigned int run_length;
+};
+
+
+class ReplayReader {
+
+public:
+	ReplayReader();
+
+	// false if the file is missing, not a replay or cut short
+	bool open(const char* path);
+	void close();
+
+	const ReplayHeader& info() const { return header; }
+
+	// back to the first tick
+	void rewind();
+
+	// input of the next tick; false once every tick has been read
+	bool next(SimInput& input);
+
+private:
+	MappedFile file;
+	ReplayHeader header;
+	const unsigned char* pos;
+	const unsigned char* end;
+	unsigned int run_left;
+	unsigned int run_buttons;
+};
+
+
+// init_game() from the replay's header, then the script and stage it names;
+// false if either is missing, isn't the file that was recorded or doesn't
+// set up. The stage is opened into stage, which must stay open while the
+// world plays.
+bool start_replay(World& world, const ReplayReader& replay, Stage& stage);
+
+// start_replay(), then run every recorded tick as fast as possible; returns
+// the number of ticks run, or -1 if the replay doesn't start
+long long run_replay(World& world, ReplayReader& replay, JobSystem* jobs, Stage& stage);
+
+#endif // __Replay_h_
@@ -0,0 +1,107 @@
+//-----------------------------------------------------------------------------
+// File: Rng.cpp
+//
+// Desc: Seeding, skip-ahead and the bulk fills of the PCG32 generator.
+//-----------------------------------------------------------------------------
+#include "Rng.h"
+
+
+// the state transform of delta steps, state' = mult * state + plus
+static void lcg_jump(unsigned long long delta, unsigned long long inc, unsigned long long& mult, unsigned long long& plus)
+{
+	unsigned long long cur_mult = RNG_MULTIPLIER;
+	unsigned long long cur_plus = inc;
+	mult = 1;
+	plus = 0;
+	while (delta > 0)
+	{
+		if (delta & 1)
+		{
+			mult *= cur_mult;
+			plus = plus * cur_mult + cur_plus;
+		}
+		cur_plus = (cur_mult + 1) * cur_plus;
+		cur_mult *= cur_mult;
+		delta >>= 1;
+	}
+}
+
+
+void Rng::seed(unsigned long long seed_value, unsigned long long stream)
+{
+	state = 0;
+	inc = (stream << 1) | 1;
+	next();
+	state += seed_value;
+	next();
+}
+
+
+void Rng::advance(unsigned long long delta)
+{
+	unsigned long long mult, plus;
+	lcg_jump(delta, inc, mult, plus);
+	state = mult * state + plus;
+}
+
+
+void Rng::fill(unsigned int* out, int n)
+{
+	// four lanes, each four steps apart, so the multiplies overlap instead
+	// of waiting on each other
+	unsigned long long mult, plus;
+	lcg_jump(4, inc, mult, plus);
+
+	unsigned long long s0 = state;
+	unsigned long long s1 = s0 * RNG_MULTIPLIER + inc;
+	unsigned long long s2 = s1 * RNG_MULTIPLIER + inc;
+	unsigned long long s3 = s2 * RNG_MULTIPLIER + inc;
+
+	int i = 0;
+	for (; i + 4 <= n; i += 4)
+	{
+		out[i] = output(s0);
+		out[i + 1] = output(s1);
+		out[i + 2] = output(s2);
+		out[i + 3] = output(s3);
+		s0 = s0 * mult + plus;
+		s1 = s1 * mult + plus;
+		s2 = s2 * mult + plus;
+		s3 = s3 * mult + plus;
+	}
+
+	state = s0;
+	for (; i < n; i++)
+		out[i] = next();
+}
+
+
+void Rng::fill_uniform(float* out, int n, float lo, float hi)
+{
+	unsigned long long mult, plus;
+	lcg_jump(4, inc, mult, plus);
+
+	unsigned long long s0 = state;
+	unsigned long long s1 = s0 * RNG_MULTIPLIER + inc;
+	unsigned long long s2 = s1 * RNG_MULTIPLIER + inc;
+	unsigned long long s3 = s2 * RNG_MULTIPLIER + inc;
+	float scale = 1.0f / 16777216.0f;
+	float range = hi - lo;
+
+	int i = 0;
+	for (; i + 4 <= n; i += 4)
+	{
+		out[i] = lo + range * ((float)(output(s0) >> 8) * scale);
+		out[i + 1] = lo + range * ((float)(output(s1) >> 8) * scale);
+		out[i + 2] = lo + range * ((float)(output(s2) >> 8) * scale);
+		out[i + 3] = lo + range * ((float)(output(s3) >> 8) * scale);
+		s0 = s0 * mult + plus;
+		s1 = s1 * mult + plus;
+		s2 = s2 * mult + plus;
+		s3 = s3 * mult + plus;
+	}
+
+	state = s0;
+	for (; i < n; i++)
+		out[i] = uniform(lo, hi);
+}
@@ -0,0 +1,74 @@
+//-----------------------------------------------------------------------------
+// File: Rng.h
+//
+// Desc: PCG32 random number generator (O'Neill, XSH-RR output): 64 bits of
+//       state, 32-bit results, and a stream number that picks one of 2^63
+//       sequences that never overlap. Each system or worker gets its own
+//       stream, so they draw without locking and without disturbing each
+//       other's sequence.
+//
+//       Everything is explicit state; there is no global generator.
+//-----------------------------------------------------------------------------
+#ifndef __Rng_h_
+#define __Rng_h_
+
+#define RNG_MULTIPLIER 6364136223846793005ull
+
+class Rng {
+
+public:
+	Rng() { seed(0, 0); }
+	Rng(unsigned long long seed_value, unsigned long long stream) { seed(seed_value, stream); }
+
+	void seed(unsigned long long seed_value, unsigned long long stream);
+
+	unsigned int next()
+	{
+		unsigned long long old = state;
+		state = old * RNG_MULTIPLIER + inc;
+		return output(old);
+	}
+
+	// uniform in [0, bound), without modulo bias; bound > 0
+	unsigned int below(unsigned int bound)
+	{
+		unsigned long long m = (unsigned long long)next() * bound;
+		unsigned int low = (unsigned int)m;
+		if (low < bound)
+		{
+			unsigned int threshold = (0u - bound) % bound;
+			while (low < threshold)
+			{
+				m = (unsigned long long)next() * bound;
+				low = (unsigned int)m;
+			}
+		}
+		return (unsigned int)(m >> 32);
+	}
+
+	// uniform in [0, 1), 24 bits of precision
+	float uniform() { return (float)(next() >> 8) * (1.0f / 16777216.0f); }
+	float uniform(float lo, float hi) { return lo + (hi - lo) * uniform(); }
+
+	// the same numbers as n calls of next() / uniform(lo, hi), generated
+	// four at a time
+	void fill(unsigned int* out, int n);
+	void fill_uniform(float* out, int n, float lo, float hi);
+
+	// skip delta numbers in O(log delta), e.g. to hand each worker its own
+	// slice of one sequence
+	void advance(unsigned long long delta);
+
+private:
+	static unsigned int output(unsigned long long old)
+	{
+		unsigned int xorshifted = (unsigned int)(((old >> 18) ^ old) >> 27);
+		unsigned int rot = (unsigned int)(old >> 59);
+		return (xorshifted >> rot) | (xorshifted << ((0u - rot) & 31));
+	}
+
+	unsigned long long state;
+	unsigned long long inc;     // odd; selects the stream
+};
+
+#endif // __Rng_h_
@@ -0,0 +1,684 @@
+//-----------------------------------------------------------------------------
+// File: Sim.cpp
+//
+// Desc: Game logic of the shooting game, moved out of Matrices49860489.cpp so
+//       it can run headless.
+//-----------------------------------------------------------------------------
+#include <float.h>
+#include <math.h>
+#include <stdio.h>
+#include <algorithm>
+
+#include "Sim.h"
+#include "Collide.h"
+#include "Cpu.h"
+#include "Profiler.h"
+
+
+bool sphere_collision_check(float x0, float y0, float size0, float x1, float y1, float size1)
+{
+
+	if ((x0 - x1)*(x0 - x1) + (y0 - y1)*(y0 - y1) < (size0 + size1) * (size0 + size1))
+		return true;
+	else
+		return false;
+
+}
+
+
+// the same steps as collide_swept_batch_scalar(), with circle 1 as the target
+bool swept_collision_check(float x0, float y0, float dx0, float dy0, float size0, float x1, float y1, float size1)
+{
+	float size = (size1 + size0) * (size1 + size0);
+	float ex = x1 - x0;
+	float ey = y1 - y0;
+	float len2 = dx0 * dx0 + dy0 * dy0;
+	float t = (ex * dx0 + ey * dy0) / (len2 > FLT_MIN ? len2 : FLT_MIN);
+	t = t > -1.0f ? t : -1.0f;
+	t = t < 0.0f ? t : 0.0f;
+	float qx = ex - t * dx0;
+	float qy = ey - t * dy0;
+	return qx * qx + qy * qy < size || ex * ex + ey * ey < size;
+}
+
+
+// every enemy runs one of these, chosen by index; the boss runs all of its own
+static const BulletPattern g_enemy_patterns[] = {
+	// type               interval count speed   spread  spin   angle
+	{ PATTERN_AIMED_FAN,  40,      3,    240.0f, 0.5f,   0.0f,  0.0f },
+	{ PATTERN_RADIAL,     60,      12,   160.0f, 0.0f,   0.0f,  0.0f },
+};
+
+static const BulletPattern g_boss_patterns[] = {
+	{ PATTERN_SPIRAL,     4,       4,    200.0f, 0.0f,   0.3f,  0.0f },
+	{ PATTERN_AIMED_FAN,  30,      7,    280.0f, 1.0f,   0.0f,  0.0f },
+};
+
+#define ENEMY_PATTERN_NUM (int)(sizeof(g_enemy_patterns) / sizeof(g_enemy_patterns[0]))
+#define BOSS_PATTERN_NUM (int)(sizeof(g_boss_patterns) / sizeof(g_boss_patterns[0]))
+
+// parallel_for() chunk sizes; the collision one must be a multiple of 32 so
+// every chunk owns whole words of the hit mask
+#define ENEMY_GRAIN 16384
+#define ENEMY_BULLET_GRAIN 8192
+
+
+// the event list never grows past what init_game() reserved
+static void add_event(World& world, int type, float x, float y)
+{
+	if (world.events.size() < SIM_MAX_EVENTS)
+	{
+		SimEvent e = { type, x, y };
+		world.events.push_back(e);
+	}
+}
+
+
+// off the field until a stage spawn needs it
+static void park_enemy(World& world, int i)
+{
+	world.enemy.x[i] = 0;
+	world.enemy.y[i] = ENEMY_PARK_Y;
+	world.enemy.alive[i] = 0;
+	start_move_script_at(world.enemy_script, world.enemy_move, i, 0, world.enemy_script.count() - 1);
+	world.stage_free.push_back(i);
+}
+
+
+// respawn an enemy somewhere above the screen, or park it when a stage
+// decides where enemies come from
+static void respawn_enemy(World& world, int i, int x_range, int y_range)
+{
+	if (world.stage)
+	{
+		if (world.enemy.alive[i])
+			park_enemy(world, i);
+		if (world.grid_built)
+			world.grid.relocate(i);
+		return;
+	}
+
+	float x = (float)world.spawn_rng.below(x_range);
+	float y = (float)((int)world.spawn_rng.below(y_range) - 300);
+	world.enemy.x[i] = x;
+	world.enemy.y[i] = y;
+	world.enemy.alive[i] = 1;
+	start_move_script(world.enemy_script, world.enemy_move, i, x);
+
+	if (world.grid_built)
+		world.grid.relocate(i);
+}
+
+
+// ids of the enemies closer than radius to (x, y), in id order; with
+// radius = size0 + size1 this is exactly sphere_collision_check()
+static void enemies_in_radius(World& world, float x, float y, float radius, std::vector<int>& out)
+{
+	if (world.grid_built)
+	{
+		world.grid.query_radius(x, y, radius, out);
+		return;
+	}
+
+	int enemy_num = world.enemy.count();
+	unsigned int* hits = world.hits.data();
+	collide_circle_batch(x, y, radius, world.enemy.x.data(), world.enemy.y.data(), 0.0f, enemy_num, hits);
+
+	out.clear();
+	for (int w = 0; w < collide_mask_words(enemy_num); w++)
+	{
+		for (unsigned int bits = hits[w]; bits != 0; bits &= bits - 1)
+			out.push_back(w * 32 + lowest_bit_index(bits));
+	}
+}
+
+
+// ids of the enemies a projectile that moved by (dx, dy) to (x, y) passed
+// within reach of, in id order: a radius query around the middle of the
+// move, a pixel wider than the whole move needs, then the swept test
+static void enemies_in_sweep(World& world, float x, float y, float dx, float dy, std::vector<int>& out)
+{
+	float reach = ENTITY_RADIUS * 2 + 0.5f * sqrtf(dx * dx + dy * dy) + 1.0f;
+	enemies_in_radius(world, x - 0.5f * dx, y - 0.5f * dy, reach, out);
+
+	const float* ex = world.enemy.x.data();
+	const float* ey = world.enemy.y.data();
+	int n = 0;
+	for (int k = 0; k < (int)out.size(); k++)
+	{
+		int i = out[k];
+		if (swept_collision_check(x, y, dx, dy, ENTITY_RADIUS, ex[i], ey[i], ENTITY_RADIUS))
+			out[n++] = i;
+	}
+	out.resize(n);
+}
+
+
+// the grid only pays for its rebuild once there are enough queries per tick
+static void build_broadphase(World& world)
+{
+	PROFILE_SCOPE("broadphase");
+	int queries = world.bullet.count() + world.super_bullet.count();
+
+	world.grid_built = queries >= GRID_MIN_QUERIES && world.enemy.count() >= GRID_MIN_ENEMIES;
+	if (world.grid_built)
+		world.grid.build(world.enemy.x.data(), world.enemy.y.data(), world.enemy.alive.data(), world.enemy.count());
+}
+
+
+// test the last move of every hero projectile against every enemy, respawn
+// the enemies hit and retire the projectiles that hit something
+static void collide_projectiles(World& world, ProjectilePool& p, int x_range, int y_range)
+{
+	PROFILE_SCOPE("collide projectiles");
+	for (int b = 0; b < p.count(); b++)
+	{
+		float dx = p.vx[b] * TICK_SECONDS;
+		float dy = p.vy[b] * TICK_SECONDS;
+		enemies_in_sweep(world, p.x[b], p.y[b], dx, dy, world.found);
+		for (int k = 0; k < (int)world.found.size(); k++)
+		{
+			int i = world.found[k];
+			p.alive[b] = 0;
+			add_event(world, SIM_EVENT_ENEMY_DOWN, world.enemy.x[i], world.enemy.y[i]);
+			respawn_enemy(world, i, x_range, y_range);
+		}
+
+		EntityArray& boss = world.boss;
+		if (boss.alive[0] && swept_collision_check(p.x[b], p.y[b], dx, dy, ENTITY_RADIUS, boss.x[0], boss.y[0], BOSS_RADIUS) == true)
+		{
+			p.alive[b] = 0;
+			add_event(world, SIM_EVENT_BOSS_HIT, p.x[b], p.y[b]);
+			if (--boss.hp[0] <= 0)
+				boss.hp[0] = BOSS_HP;
+		}
+	}
+	p.compact();
+}
+
+
+// queue a volley for every emitter whose turn it is this tick
+static void queue_volleys(World& world)
+{
+	PROFILE_SCOPE("queue volleys");
+	const float* ex = world.enemy.x.data();
+	const float* ey = world.enemy.y.data();
+	int enemy_num = world.enemy.count();
+	float hx = world.hero.x[0];
+	float hy = world.hero.y[0];
+	Volley v;
+
+	world.volleys.clear();
+
+	// enemy i runs pattern i % ENEMY_PATTERN_NUM; the j-th enemy of a pattern
+	// fires when j + tick is a multiple of the interval, which spreads the
+	// volleys evenly over the ticks. Only enemies past y = 50 fire.
+	for (int k = 0; k < ENEMY_PATTERN_NUM; k++)
+	{
+		int interval = g_enemy_patterns[k].interval;
+		int j0 = (interval - (int)(world.tick % interval)) % interval;
+		for (int j = j0; k + j * ENEMY_PATTERN_NUM < enemy_num; j += interval)
+		{
+			int i = k + j * ENEMY_PATTERN_NUM;
+			if (ey[i] > 50)
+			{
+				v.x = ex[i];
+				v.y = ey[i];
+				v.pattern = k;
+				v.angle = world.patterns.volley_angle(k, (int)((j + world.tick) / interval), v.x, v.y, hx, hy);
+				world.volleys.push_back(v);
+			}
+		}
+	}
+
+	for (int k = 0; k < BOSS_PATTERN_NUM; k++)
+	{
+		int interval = g_boss_patterns[k].interval;
+		if (world.boss.alive[0] && world.tick % interval == 0)
+		{
+			v.x = world.boss.x[0];
+			v.y = world.boss.y[0];
+			v.pattern = ENEMY_PATTERN_NUM + k;
+			v.angle = world.patterns.volley_angle(v.pattern, (int)(world.tick / interval), v.x, v.y, hx, hy);
+			world.volleys.push_back(v);
+		}
+	}
+}
+
+
+// hit mask of the last move of the enemy bullets [begin, end) against the hero
+static void collide_hero_range(void* data, int begin, int end)
+{
+	World& world = *(World*)data;
+	ProjectilePool& p = world.enemy_bullet;
+
+	collide_swept_batch(world.hero.x[0], world.hero.y[0], ENTITY_RADIUS,
+		p.x.data() + begin, p.y.data() + begin, p.vx.data() + begin, p.vy.data() + begin, TICK_SECONDS,
+		ENTITY_RADIUS, end - begin, world.hits.data() + begin / 32);
+}
+
+
+// enemy bullets that reach the hero cost one hit point each
+static void collide_hero(World& world)
+{
+	PROFILE_SCOPE("collide hero");
+	ProjectilePool& p = world.enemy_bullet;
+	unsigned int* hits = world.hits.data();
+
+	parallel_for(world.jobs, p.count(), ENEMY_BULLET_GRAIN, collide_hero_range, &world);
+
+	for (int w = 0; w < collide_mask_words(p.count()); w++)
+	{
+		for (unsigned int bits = hits[w]; bits != 0; bits &= bits - 1)
+		{
+			int b = w * 32 + lowest_bit_index(bits);
+			p.alive[b] = 0;
+			add_event(world, SIM_EVENT_HERO_HIT, p.x[b], p.y[b]);
+			if (world.hero.hp[0] > 0)
+				world.hero.hp[0]--;
+		}
+	}
+	p.compact();
+}
+
+
+static unsigned long long hash_bytes(unsigned long long h, const void* p, size_t n)
+{
+	const unsigned char* b = (const unsigned char*)p;
+	for (size_t i = 0; i < n; i++)
+	{
+		h ^= b[i];
+		h *= 1099511628211ull;
+	}
+	return h;
+}
+
+
+static unsigned long long hash_pool(unsigned long long h, const ProjectilePool& p)
+{
+	int n = p.count();
+	h = hash_bytes(h, &n, sizeof(n));
+	h = hash_bytes(h, p.x.data(), n * sizeof(float));
+	h = hash_bytes(h, p.y.data(), n * sizeof(float));
+	return hash_bytes(h, p.id.data(), n * sizeof(int));
+}
+
+
+unsigned long long world_hash(const World& world)
+{
+	int n = world.enemy.count();
+	unsigned long long h = 14695981039346656037ull;
+	h = hash_bytes(h, world.enemy.x.data(), n * sizeof(float));
+	h = hash_bytes(h, world.enemy.y.data(), n * sizeof(float));
+	h = hash_bytes(h, world.enemy.alive.data(), n);
+	h = hash_bytes(h, &world.hero.x[0], sizeof(float));
+	h = hash_bytes(h, &world.hero.y[0], sizeof(float));
+	h = hash_bytes(h, &world.hero.hp[0], sizeof(int));
+	h = hash_bytes(h, &world.boss.x[0], sizeof(float));
+	h = hash_bytes(h, &world.boss.hp[0], sizeof(int));
+	h = hash_bytes(h, &world.tick, sizeof(world.tick));
+	h = hash_bytes(h, world.enemy_move.pc.data(), world.enemy_move.pc.size() * sizeof(unsigned short));
+	h = hash_bytes(h, world.enemy_move.ticks.data(), world.enemy_move.ticks.size() * sizeof(int));
+	h = hash_bytes(h, world.enemy_move.origin_x.data(), world.enemy_move.origin_x.size() * sizeof(float));
+	h = hash_bytes(h, &world.spawn_rng, sizeof(world.spawn_rng));
+	int stage[3] = { world.stage_cursor.position(), world.stage_cursor.skipped(), world.stage_dropped };
+	h = hash_bytes(h, stage, sizeof(stage));
+	h = hash_bytes(h, world.stage_free.data(), world.stage_free.size() * sizeof(int));
+	h = hash_pool(h, world.bullet);
+	h = hash_pool(h, world.super_bullet);
+	return hash_pool(h, world.enemy_bullet);
+}
+
+
+int bomb_area(World& world, float x, float y, float radius)
+{
+	enemies_in_radius(world, x, y, radius, world.found);
+	for (int k = 0; k < (int)world.found.size(); k++)
+	{
+		int i = world.found[k];
+		add_event(world, SIM_EVENT_ENEMY_DOWN, world.enemy.x[i], world.enemy.y[i]);
+		respawn_enemy(world, i, 300, 200);
+	}
+	return (int)world.found.size();
+}
+
+
+void init_game(World& world, int enemy_num, unsigned int seed)
+{
+	world.spawn_rng.seed(seed, RNG_STREAM_SPAWN);
+
+	world.tick = 0;
+
+	// every buffer the game logic needs is sized here, nothing grows later
+	world.hero.resize(1, HERO_HP);
+	world.enemy.resize(enemy_num, 1);
+	world.boss.resize(1, BOSS_HP);
+	world.enemy_move.resize(enemy_num);
+	world.bullet.init(BULLET_CAPACITY, BULLET_COOLDOWN, -FLT_MAX, -70, FLT_MAX, FLT_MAX);
+	world.super_bullet.init(SUPER_BULLET_CAPACITY, SUPER_BULLET_COOLDOWN, -FLT_MAX, -70, FLT_MAX, FLT_MAX);
+	world.enemy_bullet.init(ENEMY_BULLET_CAPACITY, 0, -64, -64, SCREEN_WIDTH, 500);
+	world.hits.assign(collide_mask_words(std::max(enemy_num, ENEMY_BULLET_CAPACITY)), 0);
+	world.found.reserve(enemy_num);
+	world.stage_free.reserve(enemy_num);
+	world.events.clear();
+	world.events.reserve(SIM_MAX_EVENTS);
+	world.leaving.assign(enemy_num, 0);
+	world.leaving_count.assign((enemy_num + ENEMY_GRAIN - 1) / ENEMY_GRAIN, 0);
+	world.grid.set_cell_size(ENTITY_RADIUS * 4);
+	world.grid.reserve(enemy_num);
+	world.grid_built = false;
+	world.bomb_cooldown = 0;
+
+	world.patterns.clear();
+	for (int k = 0; k < ENEMY_PATTERN_NUM; k++)
+		world.patterns.add(g_enemy_patterns[k]);
+	for (int k = 0; k < BOSS_PATTERN_NUM; k++)
+		world.patterns.add(g_boss_patterns[k]);
+	world.volleys.reserve(enemy_num + BOSS_PATTERN_NUM);
+
+	// objects
+	world.hero.x[0] = 150;
+	world.hero.y[0] = 400;
+	world.hero.alive[0] = 1;
+
+	world.boss.x[0] = 20;
+	world.boss.y[0] = 20;
+	world.boss.alive[0] = 1;
+
+	world.jobs = NULL;
+
+	world.stage = NULL;
+	world.stage_cursor.start(NULL);
+	world.stage_entries.clear();
+	world.stage_free.clear();
+	world.stage_dropped = 0;
+
+	// enemies fall straight down unless the game sets a script of its own
+	char script[64];
+	sprintf(script, "move 0 %g\n", ENEMY_SPEED);
+	world.enemy_script.compile(script, TICK_SECONDS);
+
+	// enemies
+	for (int i = 0; i < enemy_num; i++)
+		respawn_enemy(world, i, 300, 200);
+
+}
+
+
+void set_enemy_script(World& world, const MoveProgram& script)
+{
+	world.enemy_script = script;
+	for (int i = 0; i < world.enemy.count(); i++)
+		start_move_script(world.enemy_script, world.enemy_move, i, world.enemy.x[i]);
+}
+
+
+bool set_stage(World& world, const Stage& stage)
+{
+	// every script of the stage in one program; the END of the last one
+	// is where parked enemies stand
+	MoveProgram script;
+	std::vector<int> entries(stage.script_count());
+	for (int k = 0; k < stage.script_count(); k++)
+	{
+		entries[k] = script.add(stage.script_source(k), TICK_SECONDS);
+		if (entries[k] < 0)
+			return false;
+	}
+	if (script.count() == 0)
+		return false;
+
+	world.enemy_script = script;
+	world.stage = &stage;
+	world.stage_cursor.start(&stage);
+	world.stage_entries.swap(entries);
+	world.stage_dropped = 0;
+
+	// parked in reverse, so the lowest ids spawn first
+	int enemy_num = world.enemy.count();
+	world.stage_free.clear();
+	for (int i = enemy_num - 1; i >= 0; i--)
+		park_enemy(world, i);
+	world.grid_built = false;
+	return true;
+}
+
+
+// what the tasks of one tick share
+struct TickState {
+	World* world;
+	SimInput input;
+	int enemy_bullets;    // enemy bullets alive before this tick's volleys
+};
+
+
+// note the enemies of [begin, end) that left the bottom, then run all of
+// their scripts; each chunk keeps its list in its own part of leaving
+static void move_enemy_range(void* data, int begin, int end)
+{
+	World& world = *(World*)data;
+	const float* ey = world.enemy.y.data();
+	int* leaving = world.leaving.data() + begin;
+	int n = 0;
+
+	for (int i = begin; i < end; i++)
+	{
+		if (ey[i] > 500)
+			leaving[n++] = i;
+	}
+	world.leaving_count[begin / ENEMY_GRAIN] = n;
+
+	run_move_scripts(world.enemy_script, world.enemy_move, world.enemy.x.data(), world.enemy.y.data(), begin, end);
+}
+
+
+static void advance_enemy_bullet_range(void* data, int begin, int end)
+{
+	((ProjectilePool*)data)->advance(begin, end, TICK_SECONDS);
+}
+
+
+static void tick_hero(void* data)
+{
+	PROFILE_SCOPE("move hero");
+	TickState& state = *(TickState*)data;
+	EntityArray& hero = state.world->hero;
+	unsigned int buttons = state.input.buttons;
+	float step = HERO_SPEED * TICK_SECONDS;
+
+	if (buttons & BUTTON_UP)
+		hero.y[0] -= step;
+
+	if (buttons & BUTTON_DOWN)
+		hero.y[0] += step;
+
+	if (buttons & BUTTON_LEFT)
+		hero.x[0] -= step;
+
+	if (buttons & BUTTON_RIGHT)
+		hero.x[0] += step;
+}
+
+
+// the stage spawns due this tick, each taking the parked enemy on top;
+// the records are read in place and nothing is allocated
+static void spawn_from_stage(World& world)
+{
+	PROFILE_SCOPE("stage spawns");
+	for (const StageSpawn* s = world.stage_cursor.next(world.tick); s; s = world.stage_cursor.next(world.tick))
+	{
+		if (world.stage_free.empty())
+		{
+			world.stage_dropped++;
+			continue;
+		}
+		int i = world.stage_free.back();
+		world.stage_free.pop_back();
+		world.enemy.x[i] = s->x;
+		world.enemy.y[i] = s->y;
+		world.enemy.alive[i] = 1;
+		start_move_script_at(world.enemy_script, world.enemy_move, i, s->x, world.stage_entries[s->script]);
+		if (world.grid_built)
+			world.grid.relocate(i);
+	}
+}
+
+
+// hero projectiles, the bomb and the enemies; everything that respawns an
+// enemy stays on this one task so spawn_rng is always drawn in the same order
+static void tick_enemies(void* data)
+{
+	TickState& state = *(TickState*)data;
+	World& world = *state.world;
+	EntityArray& hero = world.hero;
+	unsigned int buttons = state.input.buttons;
+
+	if (world.stage)
+		spawn_from_stage(world);
+
+	// hero bullets
+	world.bullet.tick_cooldown();
+	if ((buttons & BUTTON_FIRE) && world.bullet.ready())
+	{
+		if (world.bullet.spawn(hero.x[0], hero.y[0], 0, -BULLET_SPEED) >= 0)
+			world.bullet.fire();
+	}
+
+	build_broadphase(world);
+
+	// bomb
+	if (world.bomb_cooldown > 0)
+		world.bomb_cooldown--;
+	else if (buttons & BUTTON_BOMB)
+	{
+		bomb_area(world, hero.x[0], hero.y[0], BOMB_RADIUS);
+		world.bomb_cooldown = BOMB_COOLDOWN;
+	}
+
+	world.bullet.update(TICK_SECONDS);
+	collide_projectiles(world, world.bullet, 300, 200);
+
+
+	// enemies: move everyone, then respawn the ones that had left the bottom,
+	// in id order
+	int enemy_num = world.enemy.count();
+	{
+		PROFILE_SCOPE("move enemies");
+		parallel_for(world.jobs, enemy_num, ENEMY_GRAIN, move_enemy_range, &world);
+	}
+	{
+		PROFILE_SCOPE("respawn");
+		for (int c = 0; c < (int)world.leaving_count.size(); c++)
+		{
+			const int* leaving = world.leaving.data() + c * ENEMY_GRAIN;
+			for (int k = 0; k < world.leaving_count[c]; k++)
+				respawn_enemy(world, leaving[k], 300, 200);
+		}
+	}
+	// the grid covers the move only as far as the script bounds it;
+	// otherwise the super bullets fall back to brute force this tick
+	if (world.grid_built)
+	{
+		float step = world.enemy_script.max_step();
+		if (step >= 0)
+			world.grid.add_slack(step);
+		else
+			world.grid_built = false;
+	}
+
+
+	// hero super bullets
+	world.super_bullet.tick_cooldown();
+	if ((buttons & BUTTON_SUPER_FIRE) && world.super_bullet.ready())
+	{
+		if (world.super_bullet.spawn(hero.x[0], hero.y[0], 0, -SUPER_BULLET_SPEED) >= 0)
+			world.super_bullet.fire();
+	}
+
+	world.super_bullet.update(TICK_SECONDS);
+	collide_projectiles(world, world.super_bullet, 400, 300);
+}
+
+
+// enemy bullets already in flight only need the pool, so they move while
+// tick_enemies() runs
+static void tick_enemy_bullets(void* data)
+{
+	TickState& state = *(TickState*)data;
+	World& world = *state.world;
+
+	PROFILE_SCOPE("move enemy bullets");
+	parallel_for(world.jobs, state.enemy_bullets, ENEMY_BULLET_GRAIN, advance_enemy_bullet_range, &world.enemy_bullet);
+}
+
+
+// new volleys are appended after the bullets tick_enemy_bullets() is moving
+static void tick_volleys(void* data)
+{
+	TickState& state = *(TickState*)data;
+	World& world = *state.world;
+
+	// boss sways across the top of the screen; the position comes from the
+	// tick count so it never drifts
+	int period = (int)(2 * BOSS_SWAY / BOSS_SPEED * TICK_RATE);
+	int sway = (int)(world.tick % period);
+	world.boss.x[0] = 20 + (float)(sway < period / 2 ? sway : period - sway) * (BOSS_SPEED * TICK_SECONDS);
+
+	queue_volleys(world);
+	{
+		PROFILE_SCOPE("fire volleys");
+		fire_volleys(world.patterns, world.volleys.data(), (int)world.volleys.size(), world.enemy_bullet);
+	}
+	world.enemy_bullet.advance(state.enemy_bullets, world.enemy_bullet.count(), TICK_SECONDS);
+}
+
+
+static void tick_hero_hits(void* data)
+{
+	TickState& state = *(TickState*)data;
+	World& world = *state.world;
+
+	world.enemy_bullet.compact();
+	collide_hero(world);
+
+	world.tick++;
+}
+
+
+// one tick as a task graph:
+//
+//   hero --> enemies --> volleys ------> hero hits
+//   enemy bullets ---------------------/
+//
+// Run serially the tasks go in the order they are added, which is the order
+// the game always ran them in.
+static JobGraph build_tick_graph()
+{
+	JobGraph graph;
+	int hero = graph.add(tick_hero);
+	int enemies = graph.add(tick_enemies);
+	int enemy_bullets = graph.add(tick_enemy_bullets);
+	int volleys = graph.add(tick_volleys);
+	int hero_hits = graph.add(tick_hero_hits);
+
+	graph.depend(enemies, hero);
+	graph.depend(volleys, enemies);
+	graph.depend(hero_hits, enemy_bullets);
+	graph.depend(hero_hits, volleys);
+	return graph;
+}
+
+
+void do_game_logic(World& world, const SimInput& input)
+{
+	PROFILE_SCOPE("tick");
+	static const JobGraph graph = build_tick_graph();
+
+	TickState state;
+	state.world = &world;
+	state.input = input;
+	state.enemy_bullets = world.enemy_bullet.count();
+	world.events.clear();
+
+	graph.run(world.jobs, &state);
+}
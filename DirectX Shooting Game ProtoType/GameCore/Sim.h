@@ -0,0 +1,186 @@
+//-----------------------------------------------------------------------------
+// File: Sim.h
+//
+// Desc: Platform-neutral game logic for the shooting game. Nothing in here
+//       touches Win32 or Direct3D: the platform layer samples the keyboard
+//       into a SimInput once per tick and hands it to do_game_logic(), and
+//       the renderer only reads the World afterwards.
+//-----------------------------------------------------------------------------
+#ifndef __Sim_h_
+#define __Sim_h_
+
+#include "EntityArray.h"
+#include "Emitter.h"
+#include "JobSystem.h"
+#include "MoveScript.h"
+#include "ProjectilePool.h"
+#include "Rng.h"
+#include "SpatialGrid.h"
+#include "Stage.h"
+
+// define the screen resolution and the default enemy count
+#define SCREEN_WIDTH 640
+#define SCREEN_HEIGHT 480
+
+#define ENEMY_NUM 5
+
+// enemies a stage can have in play at once, when the game runs one
+#define STAGE_ENEMY_NUM 256
+
+// where enemies wait for a stage spawn, far from anything they could touch
+#define ENEMY_PARK_Y -100000.0f
+
+// the game logic runs at a fixed rate; speeds are in pixels per second and
+// scaled by TICK_SECONDS, so changing the rate keeps the game speed
+#define TICK_RATE 40
+#define TICK_SECONDS (1.0f / TICK_RATE)
+
+#define HERO_SPEED 200.0f
+#define BULLET_SPEED 400.0f
+#define SUPER_BULLET_SPEED 800.0f
+#define ENEMY_SPEED 80.0f
+#define BOSS_SPEED 100.0f
+#define BOSS_SWAY 500.0f     // how far the boss travels each way
+
+// collision radius shared by every sprite
+#define ENTITY_RADIUS 32.0f
+
+// projectile pools: how many can be in flight and ticks between shots
+#define BULLET_CAPACITY 256
+#define BULLET_COOLDOWN 4
+#define SUPER_BULLET_CAPACITY 64
+#define SUPER_BULLET_COOLDOWN 12
+#define ENEMY_BULLET_CAPACITY 65536
+
+// hit points; the boss comes straight back at full strength when beaten
+#define HERO_HP 100
+#define BOSS_HP 200
+#define BOSS_RADIUS 50.0f
+
+// the bomb clears every enemy this close to the hero, once a second
+#define BOMB_RADIUS 150.0f
+#define BOMB_COOLDOWN 40
+
+// below this many projectile queries per tick, or enemies, brute force beats
+// rebuilding the grid (see bench_broadphase)
+#define GRID_MIN_QUERIES 32
+#define GRID_MIN_ENEMIES 1000
+
+// events kept per tick; any more are dropped, they only drive effects
+#define SIM_MAX_EVENTS 4096
+
+
+// buttons sampled by the platform layer, one bit each
+enum {
+	BUTTON_UP = 1 << 0,
+	BUTTON_DOWN = 1 << 1,
+	BUTTON_LEFT = 1 << 2,
+	BUTTON_RIGHT = 1 << 3,
+	BUTTON_FIRE = 1 << 4,
+	BUTTON_SUPER_FIRE = 1 << 5,
+	BUTTON_BOMB = 1 << 6
+};
+
+// random streams of a world, all from the seed given to init_game(); each
+// system draws from its own, so extra draws in one never shift another
+enum {
+	RNG_STREAM_SPAWN = 1
+};
+
+// everything the game logic is allowed to know about the player for one tick
+struct SimInput {
+	unsigned int buttons;
+};
+
+// things that happened during a tick that the game shows but the logic
+// never reads back
+enum {
+	SIM_EVENT_ENEMY_DOWN,    // shot or bombed, where it was hit
+	SIM_EVENT_BOSS_HIT,      // where the projectile was
+	SIM_EVENT_HERO_HIT
+};
+
+struct SimEvent {
+	int type;
+	float x, y;
+};
+
+
+bool sphere_collision_check(float x0, float y0, float size0, float x1, float y1, float size1);
+
+// circle 0 moved by (dx0, dy0) and is now at (x0, y0): true if it came
+// closer than size0 + size1 to circle 1 anywhere along the move, so a
+// projectile faster than a tick can't jump over what it hits. Never misses
+// a hit sphere_collision_check() at the end point finds, and gives the same
+// answer as collide_swept_batch().
+bool swept_collision_check(float x0, float y0, float dx0, float dy0, float size0, float x1, float y1, float size1);
+
+
+// the whole simulation state, one entity array per archetype
+struct World {
+	EntityArray hero;            // always one entity
+	EntityArray enemy;           // sized by init_game()
+	EntityArray boss;            // always one entity
+	MoveProgram enemy_script;    // how every enemy moves
+	MoveState enemy_move;        // where each enemy is in it
+	ProjectilePool bullet;
+	ProjectilePool super_bullet;
+	ProjectilePool enemy_bullet;
+
+	PatternTable patterns;       // enemy patterns first, then the boss's
+	std::vector<Volley> volleys;    // volleys queued this tick
+
+	SpatialGrid grid;       // broadphase over the enemies, rebuilt each tick when worth it
+	bool grid_built;        // grid is valid for this tick
+	int bomb_cooldown;      // ticks until the bomb can be used again
+
+	std::vector<unsigned int> hits;    // scratch bitmask for the collision kernels
+	std::vector<int> found;            // scratch ids for radius queries
+	std::vector<int> leaving;          // enemies past the bottom, per move chunk
+	std::vector<int> leaving_count;
+
+	// what happened in the last tick, in the order it happened; not part of
+	// the state, so neither saved nor hashed
+	std::vector<SimEvent> events;
+
+	// threads the tick is spread over; init_game() clears it, set it
+	// afterwards. NULL runs everything on the calling thread. The results
+	// are the same either way.
+	JobSystem* jobs;
+
+	unsigned int tick;         // ticks since init_game()
+	Rng spawn_rng;             // enemy respawn positions
+
+	// with a stage set, enemies only come from its spawns and wait parked
+	// in between; without one they respawn at random above the screen
+	const Stage* stage;
+	StageCursor stage_cursor;
+	std::vector<int> stage_entries;    // first instruction of each stage script in enemy_script
+	std::vector<int> stage_free;       // parked enemies, the next one to spawn last
+	int stage_dropped;                 // spawns that came while no enemy was parked
+};
+
+
+// starts with enemies falling straight down at ENEMY_SPEED
+void init_game(World& world, int enemy_num, unsigned int seed);
+
+// every enemy runs script from its top, starting now; scripts step once a
+// tick, so compile them with TICK_SECONDS
+void set_enemy_script(World& world, const MoveProgram& script);
+
+// enemies spawn from stage from now on, as its spawns come due, and every
+// enemy is parked until then; the enemy count caps how many can be in play.
+// Replaces the enemy script with the stage's scripts. False if a script of
+// the stage doesn't compile, they don't fit one program together or there
+// are none. The stage must stay open while the world uses it.
+bool set_stage(World& world, const Stage& stage);
+void do_game_logic(World& world, const SimInput& input);
+
+// respawn every enemy within radius of (x, y); returns how many were hit
+int bomb_area(World& world, float x, float y, float radius);
+
+// FNV-1a hash of everything a tick can change; equal hashes mean two runs
+// ended in the same state
+unsigned long long world_hash(const World& world);
+
+#endif // __Sim_h_
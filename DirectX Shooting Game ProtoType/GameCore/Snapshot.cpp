@@ -0,0 +1,677 @@
+//-----------------------------------------------------------------------------
+// File: Snapshot.cpp
+//
+// Desc: Snapshot layout, the delta codec and the rewind ring.
+//-----------------------------------------------------------------------------
+#include <string.h>
+
+#include "Snapshot.h"
+
+// sections are padded to whole words, so every array in a snapshot starts
+// 4-byte aligned and the delta coder never splits a field
+#define SECTION_PAD(n) (((n) + 3) & ~(size_t)3)
+
+// everything in a World that isn't an array
+struct SnapshotGlobals {
+	unsigned int tick;
+	int bomb_cooldown;
+	int enemy_num;
+	int reserved;
+	Rng spawn_rng;
+};
+
+struct SnapshotPool {
+	int live;
+	int cooldown;
+	int free_count;
+};
+
+// how far into its stage a world is; all zero without one
+struct SnapshotStage {
+	int position;
+	int skipped;
+	int dropped;
+	int free_count;
+};
+
+
+static unsigned char* put_section(unsigned char* p, const void* data, size_t bytes)
+{
+	unsigned int n = (unsigned int)bytes;
+	memcpy(p, &n, 4);
+	memcpy(p + 4, data, bytes);
+	memset(p + 4 + bytes, 0, SECTION_PAD(bytes) - bytes);
+	return p + 4 + SECTION_PAD(bytes);
+}
+
+
+static unsigned char* put_entities(unsigned char* p, const EntityArray& a)
+{
+	int n = a.count();
+	p = put_section(p, a.x.data(), n * sizeof(float));
+	p = put_section(p, a.y.data(), n * sizeof(float));
+	p = put_section(p, a.alive.data(), n);
+	return put_section(p, a.hp.data(), n * sizeof(int));
+}
+
+
+static unsigned char* put_pool(unsigned char* p, const ProjectilePool& pool)
+{
+	SnapshotPool s;
+	s.live = pool.count();
+	s.cooldown = pool.cooldown_left();
+	s.free_count = pool.free_count();
+
+	p = put_section(p, &s, sizeof(s));
+	p = put_section(p, pool.x.data(), s.live * sizeof(float));
+	p = put_section(p, pool.y.data(), s.live * sizeof(float));
+	p = put_section(p, pool.vx.data(), s.live * sizeof(float));
+	p = put_section(p, pool.vy.data(), s.live * sizeof(float));
+	p = put_section(p, pool.alive.data(), s.live);
+	p = put_section(p, pool.id.data(), s.live * sizeof(int));
+	return put_section(p, pool.free_list(), s.free_count * sizeof(int));
+}
+
+
+static unsigned char* put_move_state(unsigned char* p, const MoveState& s)
+{
+	int n = s.count();
+	p = put_section(p, s.pc.data(), n * sizeof(unsigned short));
+	p = put_section(p, s.ticks.data(), n * sizeof(int));
+	return put_section(p, s.origin_x.data(), n * sizeof(float));
+}
+
+
+static unsigned char* put_stage(unsigned char* p, const World& world)
+{
+	SnapshotStage s;
+	s.position = world.stage_cursor.position();
+	s.skipped = world.stage_cursor.skipped();
+	s.dropped = world.stage_dropped;
+	s.free_count = (int)world.stage_free.size();
+
+	p = put_section(p, &s, sizeof(s));
+	return put_section(p, world.stage_free.data(), s.free_count * sizeof(int));
+}
+
+
+static size_t move_state_max_size(int n)
+{
+	return 3 * 4 + SECTION_PAD(n * sizeof(unsigned short)) + 2 * SECTION_PAD(n * sizeof(int));
+}
+
+
+static size_t entities_max_size(int n)
+{
+	return 4 * (4 + SECTION_PAD(n * sizeof(float)));
+}
+
+
+static size_t pool_max_size(const ProjectilePool& pool)
+{
+	// live and free entries together never exceed the capacity
+	int n = pool.capacity();
+	return 8 * 4 + SECTION_PAD(sizeof(SnapshotPool)) + 4 * SECTION_PAD(n * sizeof(float)) + SECTION_PAD(n)
+		+ 2 * SECTION_PAD(n * sizeof(int));
+}
+
+
+size_t snapshot_max_size(const World& world)
+{
+	return 4 + SECTION_PAD(sizeof(SnapshotGlobals))
+		+ entities_max_size(world.hero.count())
+		+ entities_max_size(world.boss.count())
+		+ entities_max_size(world.enemy.count())
+		+ move_state_max_size(world.enemy_move.count())
+		+ 2 * 4 + SECTION_PAD(sizeof(SnapshotStage)) + SECTION_PAD(world.enemy.count() * sizeof(int))
+		+ pool_max_size(world.bullet)
+		+ pool_max_size(world.super_bullet)
+		+ pool_max_size(world.enemy_bullet);
+}
+
+
+size_t save_snapshot(const World& world, unsigned char* out)
+{
+	SnapshotGlobals g = SnapshotGlobals();
+	g.tick = world.tick;
+	g.bomb_cooldown = world.bomb_cooldown;
+	g.enemy_num = world.enemy.count();
+	g.spawn_rng = world.spawn_rng;
+
+	unsigned char* p = out;
+	p = put_section(p, &g, sizeof(g));
+	p = put_entities(p, world.hero);
+	p = put_entities(p, world.boss);
+	p = put_entities(p, world.enemy);
+	p = put_move_state(p, world.enemy_move);
+	p = put_stage(p, world);
+	p = put_pool(p, world.bullet);
+	p = put_pool(p, world.super_bullet);
+	p = put_pool(p, world.enemy_bullet);
+	return p - out;
+}
+
+
+// walks the sections of a snapshot, checking every size against the world
+struct SectionReader {
+	const unsigned char* p;
+	const unsigned char* end;
+	bool ok;
+
+	// the next section, which must be exactly bytes long
+	const unsigned char* next(size_t bytes)
+	{
+		unsigned int n;
+		if (!ok || end - p < 4)
+			return fail();
+		memcpy(&n, p, 4);
+		if (n != bytes || (size_t)(end - p - 4) < SECTION_PAD(bytes))
+			return fail();
+
+		const unsigned char* data = p + 4;
+		p += 4 + SECTION_PAD(bytes);
+		return data;
+	}
+
+	void get(void* out, size_t bytes)
+	{
+		const unsigned char* data = next(bytes);
+		if (data)
+			memcpy(out, data, bytes);
+	}
+
+	const unsigned char* fail()
+	{
+		ok = false;
+		return NULL;
+	}
+};
+
+
+static void get_entities(SectionReader& r, EntityArray& a)
+{
+	int n = a.count();
+	r.get(a.x.data(), n * sizeof(float));
+	r.get(a.y.data(), n * sizeof(float));
+	r.get(a.alive.data(), n);
+	r.get(a.hp.data(), n * sizeof(int));
+}
+
+
+// every program counter must be an instruction of the script
+static void get_move_state(SectionReader& r, MoveState& s, const MoveProgram& script)
+{
+	int n = s.count();
+	r.get(s.pc.data(), n * sizeof(unsigned short));
+	r.get(s.ticks.data(), n * sizeof(int));
+	r.get(s.origin_x.data(), n * sizeof(float));
+	for (int i = 0; r.ok && i < n; i++)
+	{
+		if (s.pc[i] >= script.count())
+			r.fail();
+	}
+}
+
+
+// the parked enemies must be real ones, and only a world with a stage has any
+static void get_stage(SectionReader& r, World& world)
+{
+	SnapshotStage s;
+	r.get(&s, sizeof(s));
+	int enemy_num = world.enemy.count();
+	if (!r.ok || s.free_count < 0 || s.free_count > (world.stage ? enemy_num : 0) || s.dropped < 0
+		|| !world.stage_cursor.restore(s.position, s.skipped))
+	{
+		r.fail();
+		return;
+	}
+
+	world.stage_dropped = s.dropped;
+	world.stage_free.resize(s.free_count);
+	r.get(world.stage_free.data(), s.free_count * sizeof(int));
+	for (int k = 0; r.ok && k < s.free_count; k++)
+	{
+		if (world.stage_free[k] < 0 || world.stage_free[k] >= enemy_num)
+			r.fail();
+	}
+}
+
+
+static void get_pool(SectionReader& r, ProjectilePool& pool)
+{
+	SnapshotPool s;
+	r.get(&s, sizeof(s));
+	if (!r.ok || s.live < 0 || s.live > pool.capacity() || s.free_count != pool.capacity() - s.live)
+	{
+		r.fail();
+		return;
+	}
+
+	r.get(pool.x.data(), s.live * sizeof(float));
+	r.get(pool.y.data(), s.live * sizeof(float));
+	r.get(pool.vx.data(), s.live * sizeof(float));
+	r.get(pool.vy.data(), s.live * sizeof(float));
+	r.get(pool.alive.data(), s.live);
+	r.get(pool.id.data(), s.live * sizeof(int));
+	const int* free_list = (const int*)r.next(s.free_count * sizeof(int));
+	if (r.ok && !pool.restore(s.live, s.cooldown, free_list, s.free_count))
+		r.fail();
+}
+
+
+bool load_snapshot(World& world, const unsigned char* data, size_t size)
+{
+	SectionReader r;
+	r.p = data;
+	r.end = data + size;
+	r.ok = true;
+
+	SnapshotGlobals g;
+	r.get(&g, sizeof(g));
+	if (!r.ok || g.enemy_num != world.enemy.count())
+		return false;
+
+	world.tick = g.tick;
+	world.bomb_cooldown = g.bomb_cooldown;
+	world.spawn_rng = g.spawn_rng;
+
+	get_entities(r, world.hero);
+	get_entities(r, world.boss);
+	get_entities(r, world.enemy);
+	get_move_state(r, world.enemy_move, world.enemy_script);
+	get_stage(r, world);
+	get_pool(r, world.bullet);
+	get_pool(r, world.super_bullet);
+	get_pool(r, world.enemy_bullet);
+
+	// the grid is rebuilt by the next tick
+	world.grid_built = false;
+	return r.ok && r.p == r.end;
+}
+
+
+static unsigned char* put_varint(unsigned char* p, unsigned int v)
+{
+	while (v >= 0x80)
+	{
+		*p++ = (unsigned char)(v | 0x80);
+		v >>= 7;
+	}
+	*p++ = (unsigned char)v;
+	return p;
+}
+
+
+static inline bool get_varint(const unsigned char*& p, const unsigned char* end, unsigned int& v)
+{
+	// most words are a few bytes, well away from the end of the delta
+	if (end - p >= 5)
+	{
+		v = p[0] & 0x7f;
+		if (!(*p++ & 0x80))
+			return true;
+		for (int shift = 7; shift < 35; shift += 7)
+		{
+			unsigned char b = *p++;
+			v |= (unsigned int)(b & 0x7f) << shift;
+			if (!(b & 0x80))
+				return true;
+		}
+		return false;
+	}
+
+	v = 0;
+	for (int shift = 0; shift < 35 && p < end; shift += 7)
+	{
+		unsigned char b = *p++;
+		v |= (unsigned int)(b & 0x7f) << shift;
+		if (!(b & 0x80))
+			return true;
+	}
+	return false;
+}
+
+
+static unsigned int load_word(const unsigned char* p)
+{
+	unsigned int w;
+	memcpy(&w, p, 4);
+	return w;
+}
+
+
+size_t delta_max_size(size_t snapshot_size)
+{
+	// at worst every word becomes a 5-byte varint
+	return snapshot_size + snapshot_size / 4 + 16;
+}
+
+
+size_t encode_delta(const unsigned char* base, size_t base_size,
+	const unsigned char* target, size_t target_size, unsigned char* out)
+{
+	unsigned char* p = out;
+	size_t bpos = 0;
+	size_t tpos = 0;
+
+	while (tpos + 4 <= target_size)
+	{
+		unsigned int tlen = load_word(target + tpos);
+		const unsigned char* t = target + tpos + 4;
+		size_t words = SECTION_PAD(tlen) / 4;
+
+		// the matching section of the base; missing words count as zero
+		unsigned int blen = bpos + 4 <= base_size ? load_word(base + bpos) : 0;
+		const unsigned char* b = base + bpos + 4;
+		size_t base_words = bpos + 4 <= base_size ? SECTION_PAD(blen) / 4 : 0;
+
+		p = put_varint(p, tlen);
+		size_t i = 0;
+		while (i < words)
+		{
+			unsigned int tw = load_word(t + 4 * i);
+			unsigned int bw = i < base_words ? load_word(b + 4 * i) : 0;
+			if (tw == bw)
+			{
+				// a run of unchanged words: a zero, then its length
+				size_t j = i + 1;
+				while (j < words && load_word(t + 4 * j) == (j < base_words ? load_word(b + 4 * j) : 0))
+					j++;
+				p = put_varint(p, 0);
+				p = put_varint(p, (unsigned int)(j - i));
+				i = j;
+			}
+			else
+			{
+				unsigned int d = tw - bw;
+				p = put_varint(p, (d << 1) ^ (unsigned int)((int)d >> 31));
+				i++;
+			}
+		}
+
+		tpos += 4 + SECTION_PAD(tlen);
+		if (bpos + 4 <= base_size)
+			bpos += 4 + SECTION_PAD(blen);
+	}
+	return p - out;
+}
+
+
+size_t decode_delta(const unsigned char* base, size_t base_size,
+	const unsigned char* delta, size_t delta_size, unsigned char* out, size_t out_capacity)
+{
+	const unsigned char* p = delta;
+	const unsigned char* end = delta + delta_size;
+	size_t bpos = 0;
+	size_t opos = 0;
+
+	while (p < end)
+	{
+		unsigned int tlen;
+		if (!get_varint(p, end, tlen) || opos + 4 + SECTION_PAD(tlen) > out_capacity)
+			return 0;
+		memcpy(out + opos, &tlen, 4);
+		unsigned char* t = out + opos + 4;
+		size_t words = SECTION_PAD(tlen) / 4;
+
+		unsigned int blen = bpos + 4 <= base_size ? load_word(base + bpos) : 0;
+		const unsigned char* b = base + bpos + 4;
+		size_t base_words = bpos + 4 <= base_size ? SECTION_PAD(blen) / 4 : 0;
+
+		size_t i = 0;
+		while (i < words)
+		{
+			unsigned int v;
+			if (!get_varint(p, end, v))
+				return 0;
+			if (v == 0)
+			{
+				unsigned int run;
+				if (!get_varint(p, end, run) || run == 0 || run > words - i)
+					return 0;
+				size_t from_base = i < base_words ? (base_words - i < run ? base_words - i : run) : 0;
+				memcpy(t + 4 * i, b + 4 * i, 4 * from_base);
+				memset(t + 4 * (i + from_base), 0, 4 * (run - from_base));
+				i += run;
+			}
+			else
+			{
+				unsigned int d = (v >> 1) ^ (0u - (v & 1));
+				unsigned int w = (i < base_words ? load_word(b + 4 * i) : 0) + d;
+				memcpy(t + 4 * i, &w, 4);
+				i++;
+			}
+		}
+
+		opos += 4 + SECTION_PAD(tlen);
+		if (bpos + 4 <= base_size)
+			bpos += 4 + SECTION_PAD(blen);
+	}
+	return opos;
+}
+
+
+RewindBuffer::RewindBuffer()
+	: key_interval(1), first(0), count(0), write(0), head_size(0), head_tick(0), has_head(false), last_entry(0)
+{
+}
+
+
+void RewindBuffer::init(const World& world, int max_ticks, int key_interval_, size_t arena_bytes)
+{
+	// push(), rebuild() and rollback() swap these between roles, so each
+	// has room for a snapshot or a delta, whichever is bigger
+	size_t max_size = delta_max_size(snapshot_max_size(world));
+
+	key_interval = key_interval_ < 1 ? 1 : key_interval_;
+	arena.assign(arena_bytes, 0);
+	entries.assign(max_ticks < 1 ? 1 : max_ticks, Entry());
+	head.assign(max_size, 0);
+	cur.assign(max_size, 0);
+	back.assign(max_size, 0);
+	clear();
+}
+
+
+void RewindBuffer::clear()
+{
+	first = 0;
+	count = 0;
+	write = 0;
+	head_size = 0;
+	head_tick = 0;
+	has_head = false;
+	last_entry = 0;
+}
+
+
+size_t RewindBuffer::arena_used() const
+{
+	size_t used = 0;
+	for (int i = 0; i < count; i++)
+		used += entry_at(i).size;
+	return used;
+}
+
+
+void RewindBuffer::drop_oldest()
+{
+	first = (first + 1) % (int)entries.size();
+	count--;
+	if (count == 0)
+		write = 0;
+}
+
+
+void RewindBuffer::drop_newest()
+{
+	count--;
+	write = count > 0 ? entry_at(count - 1).offset + entry_at(count - 1).size : 0;
+}
+
+
+// room for n bytes after the newest entry, dropping old entries until it fits
+bool RewindBuffer::alloc(size_t n, size_t& offset)
+{
+	if (n > arena.size())
+		return false;
+
+	for (;;)
+	{
+		if (count == 0)
+		{
+			offset = 0;
+			return true;
+		}
+
+		size_t read = entry_at(0).offset;
+		if (write > read)
+		{
+			// in use: [read, write)
+			if (write + n <= arena.size())
+			{
+				offset = write;
+				return true;
+			}
+			if (n <= read)
+			{
+				offset = 0;
+				return true;
+			}
+		}
+		else if (write + n <= read)
+		{
+			// wrapped, in use: [read, end) and [0, write)
+			offset = write;
+			return true;
+		}
+		drop_oldest();
+	}
+}
+
+
+void RewindBuffer::push(const World& world)
+{
+	size_t size = save_snapshot(world, cur.data());
+
+	// anything but the next tick starts the history over
+	if (has_head && world.tick == head_tick + 1)
+	{
+		// the old head becomes an entry: whole on key ticks, otherwise the
+		// delta that gets it back from the new snapshot
+		bool key = head_tick % key_interval == 0;
+		const unsigned char* data = head.data();
+		size_t n = head_size;
+		if (!key)
+		{
+			n = encode_delta(cur.data(), size, head.data(), head_size, back.data());
+			data = back.data();
+		}
+
+		if (count == (int)entries.size())
+			drop_oldest();
+
+		size_t offset;
+		if (alloc(n, offset))
+		{
+			memcpy(arena.data() + offset, data, n);
+			Entry& e = entries[(first + count) % entries.size()];
+			e.offset = offset;
+			e.size = n;
+			e.key = key;
+			count++;
+			write = offset + n;
+		}
+		else
+		{
+			// bigger than the whole arena; history restarts at the new head
+			first = 0;
+			count = 0;
+			write = 0;
+		}
+		last_entry = n;
+	}
+	else
+	{
+		first = 0;
+		count = 0;
+		write = 0;
+		last_entry = 0;
+	}
+
+	head.swap(cur);
+	head_size = size;
+	head_tick = world.tick;
+	has_head = true;
+}
+
+
+// rebuild the snapshot of tick into cur; its size ends up in last_entry
+bool RewindBuffer::rebuild(unsigned int tick)
+{
+	if (!has_head || tick > head_tick || tick < oldest_tick())
+		return false;
+
+	int target = (int)(tick - oldest_tick());
+
+	// start from the nearest full snapshot at or after the target
+	int start = count;
+	for (int i = target; i < count; i++)
+	{
+		if (entry_at(i).key)
+		{
+			start = i;
+			break;
+		}
+	}
+
+	size_t size;
+	if (start == count)
+	{
+		memcpy(cur.data(), head.data(), head_size);
+		size = head_size;
+	}
+	else
+	{
+		memcpy(cur.data(), arena.data() + entry_at(start).offset, entry_at(start).size);
+		size = entry_at(start).size;
+	}
+
+	// then walk back one delta at a time
+	for (int i = start - 1; i >= target; i--)
+	{
+		const Entry& e = entry_at(i);
+		size = decode_delta(cur.data(), size, arena.data() + e.offset, e.size, back.data(), back.size());
+		if (size == 0)
+			return false;
+		cur.swap(back);
+	}
+
+	last_entry = size;
+	return true;
+}
+
+
+bool RewindBuffer::restore(World& world, unsigned int tick)
+{
+	return rebuild(tick) && load_snapshot(world, cur.data(), last_entry);
+}
+
+
+bool RewindBuffer::rollback(World& world, unsigned int tick)
+{
+	if (!restore(world, tick))
+		return false;
+
+	// entries hold oldest .. head_tick - 1 and tick becomes the head, so
+	// the entries from tick on go; oldest_tick() moves with the head, so it
+	// is read once before
+	unsigned int oldest = oldest_tick();
+	while (count > 0 && oldest + (unsigned int)count > tick)
+		drop_newest();
+
+	head.swap(cur);
+	head_size = last_entry;
+	head_tick = tick;
+	return true;
+}
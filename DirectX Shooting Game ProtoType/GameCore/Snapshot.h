@@ -0,0 +1,116 @@
+//-----------------------------------------------------------------------------
+// File: Snapshot.h
+//
+// Desc: Save and restore of the whole simulation state, plus a ring buffer
+//       of the last few seconds of ticks for rewind and rollback.
+//
+//       A snapshot is one flat block of sections, each a 32-bit byte count
+//       followed by the bytes of one array (enemy x, enemy bullet ids, ...),
+//       always in the same order. Only live entries are written, so it is
+//       as big as the state actually in play. Scratch buffers, the grid, the
+//       pattern table, the enemy script and the stage are rebuilt or
+//       constant and are not saved; where each enemy is in the script and
+//       how far into the stage the world is are.
+//
+//       Deltas between two snapshots go section by section and 32-bit word
+//       by word: each word becomes the zigzag varint of its difference from
+//       the same word of the base, and runs of unchanged words collapse to
+//       a count.
+//-----------------------------------------------------------------------------
+#ifndef __Snapshot_h_
+#define __Snapshot_h_
+
+#include <stddef.h>
+#include <vector>
+
+#include "Sim.h"
+
+// worst-case snapshot size for this world, for sizing buffers once
+size_t snapshot_max_size(const World& world);
+
+// write the state of world to out, which holds snapshot_max_size() bytes;
+// returns the bytes used
+size_t save_snapshot(const World& world, unsigned char* out);
+
+// false, with the world in an unspecified state, if the block is damaged or
+// from a world with a different enemy count or pool sizes
+bool load_snapshot(World& world, const unsigned char* data, size_t size);
+
+// worst-case delta size for snapshots of up to this size
+size_t delta_max_size(size_t snapshot_size);
+
+// the delta that turns base into target; returns its size
+size_t encode_delta(const unsigned char* base, size_t base_size,
+	const unsigned char* target, size_t target_size, unsigned char* out);
+
+// apply a delta to the base it was made from; returns the size of the
+// rebuilt target, or 0 if the delta is damaged or out is too small
+size_t decode_delta(const unsigned char* base, size_t base_size,
+	const unsigned char* delta, size_t delta_size, unsigned char* out, size_t out_capacity);
+
+
+// The last max_ticks snapshots, all packed into one fixed arena. The newest
+// snapshot is kept whole; every older tick is stored as the delta back from
+// the tick after it, and every key_interval ticks as a full snapshot, so
+// stepping back a few ticks costs a few small decodes and no restore ever
+// decodes more than key_interval deltas. The oldest ticks are dropped when
+// either limit is reached, so memory never grows.
+class RewindBuffer {
+
+public:
+	RewindBuffer();
+
+	// size everything for this world; nothing is allocated after this
+	void init(const World& world, int max_ticks, int key_interval, size_t arena_bytes);
+	void clear();
+
+	// store the world as it is after its latest tick
+	void push(const World& world);
+
+	// put the world back to how it was after the given tick; the buffer is
+	// unchanged
+	bool restore(World& world, unsigned int tick);
+
+	// restore, then forget everything after that tick so pushing continues
+	// from there
+	bool rollback(World& world, unsigned int tick);
+
+	bool empty() const { return !has_head; }
+	unsigned int oldest_tick() const { return head_tick - (unsigned int)count; }
+	unsigned int newest_tick() const { return head_tick; }
+
+	size_t arena_used() const;               // compressed bytes held
+	size_t head_bytes() const { return head_size; }
+	size_t last_entry_bytes() const { return last_entry; }
+
+private:
+	struct Entry {
+		size_t offset;
+		size_t size;
+		bool key;      // a full snapshot rather than a delta
+	};
+
+	const Entry& entry_at(int i) const { return entries[(first + i) % entries.size()]; }
+	bool rebuild(unsigned int tick);
+	bool alloc(size_t n, size_t& offset);
+	void drop_oldest();
+	void drop_newest();
+
+	int key_interval;
+	std::vector<unsigned char> arena;
+	std::vector<Entry> entries;    // ring; entry i holds tick oldest_tick() + i
+	int first;
+	int count;
+	size_t write;                  // arena offset after the newest entry
+
+	std::vector<unsigned char> head;    // newest snapshot, whole
+	size_t head_size;
+	unsigned int head_tick;
+	bool has_head;
+
+	std::vector<unsigned char> cur;     // scratch for push() and rebuild()
+	std::vector<unsigned char> back;
+	size_t last_entry;
+};
+
+#endif // __Snapshot_h_
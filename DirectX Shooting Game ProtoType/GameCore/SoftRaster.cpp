@@ -0,0 +1,298 @@
+//-----------------------------------------------------------------------------
+// File: SoftRaster.cpp
+//
+// Desc: Band binning, quad scan-out and the scalar and SSE2 span blenders of
+//       the software sprite backend.
+//-----------------------------------------------------------------------------
+#include <math.h>
+#include <string.h>
+
+#include "SoftRaster.h"
+#include "Cpu.h"
+#include "ImageFile.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define RASTER_SSE2 1
+#include <emmintrin.h>
+#endif
+
+// texels gathered per step when a span can't be blended straight from the
+// texture
+#define RASTER_SPAN 256
+
+#define ALPHA_MASK 0xff000000u
+
+
+void blend_span_scalar(unsigned int* dst, const unsigned int* src, int n)
+{
+	for (int i = 0; i < n; i++)
+	{
+		unsigned int s = src[i];
+		unsigned int a = s >> 24;
+		if (a == 0)
+			continue;
+		if (a == 255)
+		{
+			dst[i] = s;
+			continue;
+		}
+
+		unsigned int d = dst[i];
+		unsigned int ia = 255 - a;
+		unsigned int r = div255(((s >> 16) & 0xff) * a + ((d >> 16) & 0xff) * ia);
+		unsigned int g = div255(((s >> 8) & 0xff) * a + ((d >> 8) & 0xff) * ia);
+		unsigned int b = div255((s & 0xff) * a + (d & 0xff) * ia);
+		dst[i] = ALPHA_MASK | (r << 16) | (g << 8) | b;
+	}
+}
+
+
+#if defined(RASTER_SSE2)
+
+// one half of four pixels, widened to 16 bits per channel
+static inline __m128i blend_half(__m128i s, __m128i d)
+{
+	__m128i a = _mm_shufflehi_epi16(_mm_shufflelo_epi16(s, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+	__m128i ia = _mm_sub_epi16(_mm_set1_epi16(255), a);
+	__m128i t = _mm_add_epi16(_mm_mullo_epi16(s, a), _mm_mullo_epi16(d, ia));
+	t = _mm_add_epi16(t, _mm_set1_epi16(128));
+	return _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+}
+
+
+void blend_span_sse2(unsigned int* dst, const unsigned int* src, int n)
+{
+	__m128i zero = _mm_setzero_si128();
+	__m128i alpha = _mm_set1_epi32((int)ALPHA_MASK);
+
+	int i = 0;
+	for (; i + 4 <= n; i += 4)
+	{
+		__m128i s = _mm_loadu_si128((const __m128i*)(src + i));
+		__m128i sa = _mm_and_si128(s, alpha);
+
+		// whole groups of clear or solid texels are common around and
+		// inside a sprite
+		if (_mm_movemask_epi8(_mm_cmpeq_epi32(sa, zero)) == 0xffff)
+			continue;
+		if (_mm_movemask_epi8(_mm_cmpeq_epi32(sa, alpha)) == 0xffff)
+		{
+			_mm_storeu_si128((__m128i*)(dst + i), s);
+			continue;
+		}
+
+		__m128i d = _mm_loadu_si128((const __m128i*)(dst + i));
+		__m128i lo = blend_half(_mm_unpacklo_epi8(s, zero), _mm_unpacklo_epi8(d, zero));
+		__m128i hi = blend_half(_mm_unpackhi_epi8(s, zero), _mm_unpackhi_epi8(d, zero));
+		_mm_storeu_si128((__m128i*)(dst + i), _mm_or_si128(_mm_packus_epi16(lo, hi), alpha));
+	}
+
+	blend_span_scalar(dst + i, src + i, n - i);
+}
+
+#else
+
+void blend_span_sse2(unsigned int* dst, const unsigned int* src, int n)
+{
+	blend_span_scalar(dst, src, n);
+}
+
+#endif
+
+
+SoftwareRenderer::SoftwareRenderer()
+	: w(0), h(0), clear_color(ALPHA_MASK), simd(SIMD_SCALAR)
+{
+}
+
+
+void SoftwareRenderer::init(int width, int height)
+{
+	w = width;
+	h = height;
+	frame.assign((size_t)w * h, ALPHA_MASK);
+	band_start.assign((h + RASTER_BAND_ROWS - 1) / RASTER_BAND_ROWS + 1, 0);
+	band_fill.assign(band_start.size(), 0);
+	set_simd_level(cpu_simd_level());
+}
+
+
+int SoftwareRenderer::add_texture(const unsigned int* argb, int tw, int th)
+{
+	Texture t;
+	t.w = tw;
+	t.h = th;
+	t.first = (int)texels.size();
+	texels.insert(texels.end(), argb, argb + (size_t)tw * th);
+	textures.push_back(t);
+	return (int)textures.size() - 1;
+}
+
+
+void SoftwareRenderer::set_simd_level(int level)
+{
+	if (level > cpu_simd_level())
+		level = cpu_simd_level();
+	simd = level > SIMD_SSE2 ? SIMD_SSE2 : level;
+}
+
+
+void SoftwareRenderer::begin(unsigned int color)
+{
+	// the back buffer has no alpha, so every pixel is opaque
+	clear_color = color | ALPHA_MASK;
+	quads.clear();
+}
+
+
+void SoftwareRenderer::draw(int texture, const SpriteVertex* vertices, int n, const unsigned short*)
+{
+	for (int i = 0; i < n; i++)
+	{
+		QuadRef q;
+		q.vertices = vertices + 4 * i;
+		q.texture = texture;
+		quads.push_back(q);
+	}
+}
+
+
+// first and last pixel row a quad covers, clipped to the screen; empty when
+// last < first
+static void quad_rows(const SpriteVertex* v, int h, int& first, int& last)
+{
+	first = (int)ceilf(v[0].y - 0.5f);
+	last = (int)ceilf(v[2].y - 0.5f) - 1;
+	first = first < 0 ? 0 : first;
+	last = last >= h ? h - 1 : last;
+}
+
+
+static void band_job(void* data, int begin, int end)
+{
+	SoftwareRenderer& r = *(SoftwareRenderer*)data;
+	for (int band = begin; band < end; band++)
+		r.draw_band(band);
+}
+
+
+void SoftwareRenderer::flush(JobSystem* jobs)
+{
+	int bands = (int)band_start.size() - 1;
+
+	// bin the quads by band with a counting sort, which keeps them in draw
+	// order inside every band
+	memset(band_start.data(), 0, band_start.size() * sizeof(int));
+	for (size_t i = 0; i < quads.size(); i++)
+	{
+		int first, last;
+		quad_rows(quads[i].vertices, h, first, last);
+		if (last < first)
+			continue;
+		for (int b = first / RASTER_BAND_ROWS; b <= last / RASTER_BAND_ROWS; b++)
+			band_start[b + 1]++;
+	}
+	for (int b = 0; b < bands; b++)
+		band_start[b + 1] += band_start[b];
+
+	band_items.resize(band_start[bands]);
+	memcpy(band_fill.data(), band_start.data(), band_start.size() * sizeof(int));
+	for (size_t i = 0; i < quads.size(); i++)
+	{
+		int first, last;
+		quad_rows(quads[i].vertices, h, first, last);
+		if (last < first)
+			continue;
+		for (int b = first / RASTER_BAND_ROWS; b <= last / RASTER_BAND_ROWS; b++)
+			band_items[band_fill[b]++] = (int)i;
+	}
+
+	parallel_for(jobs, bands, 1, band_job, this);
+	quads.clear();
+}
+
+
+void SoftwareRenderer::draw_band(int band)
+{
+	int y_begin = band * RASTER_BAND_ROWS;
+	int y_end = y_begin + RASTER_BAND_ROWS < h ? y_begin + RASTER_BAND_ROWS : h;
+
+	unsigned int* rows = &frame[(size_t)y_begin * w];
+	for (int i = 0; i < (y_end - y_begin) * w; i++)
+		rows[i] = clear_color;
+
+	for (int i = band_start[band]; i < band_start[band + 1]; i++)
+	{
+		const QuadRef& q = quads[band_items[i]];
+		draw_quad(textures[q.texture], q.vertices, y_begin, y_end);
+	}
+}
+
+
+void SoftwareRenderer::draw_quad(const Texture& t, const SpriteVertex* v, int y_begin, int y_end)
+{
+	float x0 = v[0].x, y0 = v[0].y;
+	float x1 = v[2].x, y1 = v[2].y;
+	if (x1 <= x0 || y1 <= y0)
+		return;
+
+	// pixels whose centers are inside the quad
+	int px0 = (int)ceilf(x0 - 0.5f);
+	int px1 = (int)ceilf(x1 - 0.5f);
+	int py0 = (int)ceilf(y0 - 0.5f);
+	int py1 = (int)ceilf(y1 - 0.5f);
+	px0 = px0 < 0 ? 0 : px0;
+	px1 = px1 > w ? w : px1;
+	py0 = py0 < y_begin ? y_begin : py0;
+	py1 = py1 > y_end ? y_end : py1;
+	if (px1 <= px0 || py1 <= py0)
+		return;
+
+	// texel = (pixel center - quad corner) * scale + offset
+	float su = (v[2].u - v[0].u) * t.w / (x1 - x0);
+	float sv = (v[2].v - v[0].v) * t.h / (y1 - y0);
+	float ou = v[0].u * t.w;
+	float ov = v[0].v * t.h;
+
+	unsigned int color = v[0].color;
+	bool white = color == 0xffffffffu;
+	void (*blend)(unsigned int*, const unsigned int*, int) = simd >= SIMD_SSE2 ? blend_span_sse2 : blend_span_scalar;
+	unsigned int span[RASTER_SPAN];
+
+	for (int py = py0; py < py1; py++)
+	{
+		int ty = (int)((py + 0.5f - y0) * sv + ov);
+		ty = ty < 0 ? 0 : (ty >= t.h ? t.h - 1 : ty);
+		const unsigned int* row = &texels[t.first + (size_t)ty * t.w];
+		unsigned int* dst = &frame[(size_t)py * w];
+
+		for (int x = px0; x < px1; x += RASTER_SPAN)
+		{
+			int n = px1 - x < RASTER_SPAN ? px1 - x : RASTER_SPAN;
+			int tx = (int)((x + 0.5f - x0) * su + ou);
+
+			// drawn 1:1 and untinted, the texture row is the span
+			if (su == 1.0f && white && tx >= 0 && tx + n <= t.w)
+			{
+				blend(dst + x, row + tx, n);
+				continue;
+			}
+
+			for (int k = 0; k < n; k++)
+			{
+				int u = (int)((x + k + 0.5f - x0) * su + ou);
+				u = u < 0 ? 0 : (u >= t.w ? t.w - 1 : u);
+				unsigned int s = row[u];
+				if (!white)
+				{
+					s = (div255((s >> 24) * (color >> 24)) << 24)
+						| (div255(((s >> 16) & 0xff) * ((color >> 16) & 0xff)) << 16)
+						| (div255(((s >> 8) & 0xff) * ((color >> 8) & 0xff)) << 8)
+						| div255((s & 0xff) * (color & 0xff));
+				}
+				span[k] = s;
+			}
+			blend(dst + x, span, n);
+		}
+	}
+}
@@ -0,0 +1,94 @@
+//-----------------------------------------------------------------------------
+// File: SoftRaster.h
+//
+// Desc: Software sprite backend. Draws what the sprite batch sends into an
+//       ARGB framebuffer in memory, so frames can be rendered, saved and
+//       compared without a Direct3D device.
+//
+//       Quads are axis-aligned and point-sampled at pixel centers, which is
+//       what Direct3D gives for sprites drawn 1:1 with the -0.5 offset.
+//       Blending matches D3DXSPRITE_ALPHABLEND:
+//
+//           dst = src * src.a + dst * (1 - src.a)
+//
+//       with the texture modulated by the vertex color and every channel
+//       rounded to the nearest 8-bit value. The result is the same on every
+//       SIMD path and at every thread count.
+//
+//       draw() only queues runs; flush() clears and draws the frame in
+//       horizontal bands, which can run on a job system.
+//-----------------------------------------------------------------------------
+#ifndef __SoftRaster_h_
+#define __SoftRaster_h_
+
+#include <vector>
+
+#include "SpriteBatch.h"
+#include "JobSystem.h"
+
+// rows per band; each band is drawn start to finish by one thread
+#define RASTER_BAND_ROWS 16
+
+class SoftwareRenderer : public SpriteBackend {
+
+public:
+	SoftwareRenderer();
+
+	void init(int width, int height);
+
+	// copies the pixels; returns the id to put in SpriteFrame::texture
+	int add_texture(const unsigned int* argb, int w, int h);
+
+	// start a frame; the clear happens in flush(), band by band
+	void begin(unsigned int clear_color);
+
+	// queue one texture run; the vertices must stay valid until flush()
+	void draw(int texture, const SpriteVertex* vertices, int quads, const unsigned short* indices);
+
+	// draw everything queued since begin(); jobs may be NULL
+	void flush(JobSystem* jobs);
+
+	const unsigned int* pixels() const { return frame.data(); }
+	int width() const { return w; }
+	int height() const { return h; }
+
+	// span blending path, SIMD_SCALAR or SIMD_SSE2; defaults to the best
+	// the CPU has
+	void set_simd_level(int level);
+	int simd_level() const { return simd; }
+
+	// for flush()'s band jobs
+	void draw_band(int band);
+
+private:
+	struct Texture {
+		int w, h;
+		int first;      // offset into texels
+	};
+
+	struct QuadRef {
+		const SpriteVertex* vertices;
+		int texture;
+	};
+
+	void draw_quad(const Texture& t, const SpriteVertex* v, int y_begin, int y_end);
+
+	int w, h;
+	std::vector<unsigned int> frame;
+	std::vector<unsigned int> texels;
+	std::vector<Texture> textures;
+	std::vector<QuadRef> quads;      // in draw order
+	std::vector<int> band_start;     // band b draws band_items[band_start[b], band_start[b + 1])
+	std::vector<int> band_fill;
+	std::vector<int> band_items;     // quad indices, grouped by band
+	unsigned int clear_color;
+	int simd;
+};
+
+
+// dst = src over dst for n pixels, per channel rounded; dst is opaque, like
+// the frame buffer, and stays opaque. Exposed for the benchmarks.
+void blend_span_scalar(unsigned int* dst, const unsigned int* src, int n);
+void blend_span_sse2(unsigned int* dst, const unsigned int* src, int n);
+
+#endif // __SoftRaster_h_
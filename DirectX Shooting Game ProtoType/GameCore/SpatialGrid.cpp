@@ -0,0 +1,252 @@
+//-----------------------------------------------------------------------------
+// File: SpatialGrid.cpp
+//
+// Desc: Uniform grid broadphase. Entities outside the grid bounds are clamped
+//       into the border cells, which keeps every query conservative.
+//-----------------------------------------------------------------------------
+#include <algorithm>
+#include <math.h>
+
+#include "SpatialGrid.h"
+
+
+SpatialGrid::SpatialGrid()
+	: cell_size(64), inv_cell_size(1.0f / 64), min_x(0), min_y(0), cols(1), rows(1), slack(0),
+	src_x(0), src_y(0), count(0)
+{
+	cell_start.assign(2, 0);
+}
+
+
+void SpatialGrid::set_cell_size(float size)
+{
+	cell_size = size;
+	inv_cell_size = 1.0f / size;
+}
+
+
+int SpatialGrid::cell_of(float x, float y) const
+{
+	float fc = (x - min_x) * inv_cell_size;
+	float fr = (y - min_y) * inv_cell_size;
+	int c = fc <= 0 ? 0 : (fc >= cols - 1 ? cols - 1 : (int)fc);
+	int r = fr <= 0 ? 0 : (fr >= rows - 1 ? rows - 1 : (int)fr);
+	return r * cols + c;
+}
+
+
+void SpatialGrid::cell_range(float qx, float qy, float radius, int& c0, int& r0, int& c1, int& r1) const
+{
+	float reach = radius + slack;
+	int lo = cell_of(qx - reach, qy - reach);
+	int hi = cell_of(qx + reach, qy + reach);
+	c0 = lo % cols;
+	r0 = lo / cols;
+	c1 = hi % cols;
+	r1 = hi / cols;
+}
+
+
+void SpatialGrid::reserve(int n)
+{
+	cell_start.reserve(4 * n + 65);
+	items.reserve(n);
+	cell_index.reserve(n);
+	moved.reserve(n);
+	overflow.reserve(n);
+}
+
+
+void SpatialGrid::build(const float* x, const float* y, const unsigned char* alive, int n)
+{
+	src_x = x;
+	src_y = y;
+	count = n;
+	slack = 0;
+
+	// bounds of the live entities
+	float x0 = 0, y0 = 0, x1 = 0, y1 = 0;
+	int live = 0;
+	for (int i = 0; i < n; i++)
+	{
+		if (!alive[i])
+			continue;
+		if (live == 0)
+		{
+			x0 = x1 = x[i];
+			y0 = y1 = y[i];
+		}
+		x0 = std::min(x0, x[i]);
+		x1 = std::max(x1, x[i]);
+		y0 = std::min(y0, y[i]);
+		y1 = std::max(y1, y[i]);
+		live++;
+	}
+
+	// keep the cell count in proportion to the entity count when they are
+	// spread thin, so memory and the clear below stay O(n)
+	float size = cell_size;
+	int max_cells = 4 * live + 64;
+	double want = (double)((x1 - x0) / size + 1) * (double)((y1 - y0) / size + 1);
+	if (want > max_cells)
+		size *= (float)sqrt(want / max_cells);
+
+	min_x = x0;
+	min_y = y0;
+	inv_cell_size = 1.0f / size;
+	cols = (int)((x1 - x0) * inv_cell_size) + 1;
+	rows = (int)((y1 - y0) * inv_cell_size) + 1;
+
+	// a very skinny spread can still overshoot; the extra entities clamp
+	// into the border cells, which queries handle anyway
+	if ((double)cols * rows > max_cells)
+	{
+		cols = std::min(cols, max_cells);
+		rows = std::max(1, max_cells / cols);
+	}
+
+	// counting sort of the live ids by cell
+	int cells = cols * rows;
+	cell_start.assign(cells + 1, 0);
+	cell_index.resize(n);
+	for (int i = 0; i < n; i++)
+	{
+		if (alive[i])
+		{
+			cell_index[i] = cell_of(x[i], y[i]);
+			cell_start[cell_index[i] + 1]++;
+		}
+		else
+		{
+			cell_index[i] = -1;
+		}
+	}
+	for (int c = 0; c < cells; c++)
+		cell_start[c + 1] += cell_start[c];
+
+	items.resize(live);
+	for (int i = 0; i < n; i++)
+	{
+		if (cell_index[i] >= 0)
+			items[cell_start[cell_index[i]]++] = i;
+	}
+
+	// the scatter advanced each start to the next cell's; shift them back
+	for (int c = cells; c > 0; c--)
+		cell_start[c] = cell_start[c - 1];
+	cell_start[0] = 0;
+
+	moved.assign(n, 0);
+	overflow.clear();
+}
+
+
+void SpatialGrid::add_slack(float d)
+{
+	slack += d < 0 ? -d : d;
+}
+
+
+void SpatialGrid::relocate(int id)
+{
+	if (!moved[id])
+	{
+		moved[id] = 1;
+		overflow.push_back(id);
+	}
+}
+
+
+void SpatialGrid::query_candidates(float qx, float qy, float radius, std::vector<int>& out) const
+{
+	int c0, r0, c1, r1;
+	cell_range(qx, qy, radius, c0, r0, c1, r1);
+
+	out.clear();
+	for (int r = r0; r <= r1; r++)
+	{
+		// the cells of one row are contiguous in items
+		int begin = cell_start[r * cols + c0];
+		int end = cell_start[r * cols + c1 + 1];
+		for (int k = begin; k < end; k++)
+		{
+			if (!moved[items[k]])
+				out.push_back(items[k]);
+		}
+	}
+	out.insert(out.end(), overflow.begin(), overflow.end());
+}
+
+
+void SpatialGrid::query_radius(float qx, float qy, float radius, std::vector<int>& out) const
+{
+	float size = radius * radius;
+	int c0, r0, c1, r1;
+	cell_range(qx, qy, radius, c0, r0, c1, r1);
+
+	out.clear();
+	for (int r = r0; r <= r1; r++)
+	{
+		int begin = cell_start[r * cols + c0];
+		int end = cell_start[r * cols + c1 + 1];
+		for (int k = begin; k < end; k++)
+		{
+			int id = items[k];
+			float dx = qx - src_x[id];
+			float dy = qy - src_y[id];
+			float dx2 = dx * dx;
+			float dy2 = dy * dy;
+			if (dx2 + dy2 < size && !moved[id])
+				out.push_back(id);
+		}
+	}
+	for (int k = 0; k < (int)overflow.size(); k++)
+	{
+		int id = overflow[k];
+		float dx = qx - src_x[id];
+		float dy = qy - src_y[id];
+		float dx2 = dx * dx;
+		float dy2 = dy * dy;
+		if (dx2 + dy2 < size)
+			out.push_back(id);
+	}
+
+	// callers act on hits in id order, the same order a brute force loop has
+	std::sort(out.begin(), out.end());
+}
+
+
+void SpatialGrid::query_pairs(const float* qx, const float* qy, const unsigned char* qalive, int m,
+	float radius, std::vector<GridPair>& out) const
+{
+	out.clear();
+	for (int j = 0; j < m; j++)
+	{
+		if (!qalive[j])
+			continue;
+
+		int c0, r0, c1, r1;
+		cell_range(qx[j], qy[j], radius, c0, r0, c1, r1);
+
+		GridPair pair;
+		pair.a = j;
+		for (int r = r0; r <= r1; r++)
+		{
+			int begin = cell_start[r * cols + c0];
+			int end = cell_start[r * cols + c1 + 1];
+			for (int k = begin; k < end; k++)
+			{
+				if (!moved[items[k]])
+				{
+					pair.b = items[k];
+					out.push_back(pair);
+				}
+			}
+		}
+		for (int k = 0; k < (int)overflow.size(); k++)
+		{
+			pair.b = overflow[k];
+			out.push_back(pair);
+		}
+	}
+}
@@ -0,0 +1,79 @@
+//-----------------------------------------------------------------------------
+// File: SpatialGrid.h
+//
+// Desc: Uniform grid broadphase over an entity array. build() buckets every
+//       live entity by cell with a counting sort; queries then only look at
+//       the cells that overlap the query circle instead of every entity.
+//
+//       The grid keeps pointers to the caller's x/y arrays and always tests
+//       live positions, so it stays correct while entities move after the
+//       build: add_slack() widens every query by how far everything has
+//       moved, and relocate() takes a single entity that jumped (a respawn)
+//       out of its cell and into a small list every query scans.
+//-----------------------------------------------------------------------------
+#ifndef __SpatialGrid_h_
+#define __SpatialGrid_h_
+
+#include <vector>
+
+// a (projectile, entity) pair that the broadphase could not rule out
+struct GridPair {
+	int a;
+	int b;
+};
+
+class SpatialGrid {
+
+public:
+	SpatialGrid();
+
+	// cell edge length; about twice the usual query radius works well
+	void set_cell_size(float size);
+
+	// size the internal buffers for up to n entities so build() never allocates
+	void reserve(int n);
+
+	void build(const float* x, const float* y, const unsigned char* alive, int n);
+
+	// every entity moved at most d since build()
+	void add_slack(float d);
+
+	// entity id was moved by an arbitrary amount since build()
+	void relocate(int id);
+
+	// ids whose cell overlaps the circle, unsorted; a superset of the hits
+	void query_candidates(float qx, float qy, float radius, std::vector<int>& out) const;
+
+	// ids with (qx - x)^2 + (qy - y)^2 < radius^2, ascending; radius = size0 + size1
+	// gives exactly the answer of sphere_collision_check()
+	void query_radius(float qx, float qy, float radius, std::vector<int>& out) const;
+
+	// candidate pairs for m query circles (a indexes the queries, b the entities)
+	void query_pairs(const float* qx, const float* qy, const unsigned char* qalive, int m,
+		float radius, std::vector<GridPair>& out) const;
+
+	int entity_count() const { return count; }
+	int cell_count() const { return cols * rows; }
+
+private:
+	void cell_range(float qx, float qy, float radius, int& c0, int& r0, int& c1, int& r1) const;
+	int cell_of(float x, float y) const;
+
+	float cell_size;
+	float inv_cell_size;
+	float min_x, min_y;
+	int cols, rows;
+	float slack;
+
+	const float* src_x;
+	const float* src_y;
+	int count;
+
+	std::vector<int> cell_start;    // cols * rows + 1 offsets into items
+	std::vector<int> items;         // entity ids grouped by cell
+	std::vector<int> cell_index;    // cell of every entity at build time
+	std::vector<unsigned char> moved;    // 1 once relocate() took the id out of its cell
+	std::vector<int> overflow;      // relocated ids, scanned by every query
+};
+
+#endif // __SpatialGrid_h_
@@ -0,0 +1,189 @@
+//-----------------------------------------------------------------------------
+// File: SpriteBatch.cpp
+//
+// Desc: Draw list, key sort and vertex generation of the sprite batch.
+//-----------------------------------------------------------------------------
+#include <string.h>
+
+#include "SpriteBatch.h"
+
+#define KEY_LAYER_SHIFT 56
+#define KEY_TEXTURE_SHIFT 44
+#define KEY_DEPTH_SHIFT 24
+#define KEY_INDEX_MASK 0xffffffull
+
+// the index bits are already in order when the keys are added, so sorting
+// starts above them
+#define KEY_SORT_FIRST_BYTE 3
+
+
+unsigned long long* radix_sort_keys(unsigned long long* keys, unsigned long long* scratch, int n, int first_byte)
+{
+	// every histogram in one read of the keys
+	static const int passes = 8;
+	int counts[passes][256];
+	memset(counts, 0, sizeof(counts));
+	for (int i = 0; i < n; i++)
+	{
+		unsigned long long k = keys[i];
+		for (int b = first_byte; b < passes; b++)
+			counts[b][(k >> (8 * b)) & 0xff]++;
+	}
+
+	unsigned long long* from = keys;
+	unsigned long long* to = scratch;
+	for (int b = first_byte; b < passes; b++)
+	{
+		int shift = 8 * b;
+		if (n == 0 || counts[b][(from[0] >> shift) & 0xff] == n)
+			continue;
+
+		int offset[256];
+		int sum = 0;
+		for (int d = 0; d < 256; d++)
+		{
+			offset[d] = sum;
+			sum += counts[b][d];
+		}
+		for (int i = 0; i < n; i++)
+		{
+			unsigned long long k = from[i];
+			to[offset[(k >> shift) & 0xff]++] = k;
+		}
+
+		unsigned long long* t = from;
+		from = to;
+		to = t;
+	}
+	return from;
+}
+
+
+SpriteBatch::SpriteBatch()
+	: max_quads(0), pixel_offset(0), last_texture(-1)
+{
+	memset(&last, 0, sizeof(last));
+}
+
+
+void SpriteBatch::init(int max_quads_, float pixel_offset_)
+{
+	max_quads = max_quads_ < SPRITE_MAX_QUADS ? max_quads_ : SPRITE_MAX_QUADS;
+	pixel_offset = pixel_offset_;
+	quads.reserve(max_quads);
+	keys.reserve(max_quads);
+	scratch.resize(max_quads);
+	vertices.resize(4 * (size_t)max_quads);
+
+	indices.resize(6 * SPRITE_DRAW_QUADS);
+	for (int q = 0; q < SPRITE_DRAW_QUADS; q++)
+	{
+		unsigned short v = (unsigned short)(4 * q);
+		unsigned short* i = &indices[6 * q];
+		i[0] = v;
+		i[1] = v + 1;
+		i[2] = v + 2;
+		i[3] = v;
+		i[4] = v + 2;
+		i[5] = v + 3;
+	}
+	begin();
+}
+
+
+void SpriteBatch::begin()
+{
+	quads.clear();
+	keys.clear();
+}
+
+
+bool SpriteBatch::add(const SpriteFrame& frame, int layer, int depth, float x, float y, unsigned int color)
+{
+	int index = (int)keys.size();
+	if (index >= max_quads)
+		return false;
+
+	Quad q;
+	q.x = x + pixel_offset;
+	q.y = y + pixel_offset;
+	q.w = frame.w;
+	q.h = frame.h;
+	q.u0 = frame.u0;
+	q.v0 = frame.v0;
+	q.u1 = frame.u1;
+	q.v1 = frame.v1;
+	q.color = color;
+	quads.push_back(q);
+
+	keys.push_back(((unsigned long long)(layer & SPRITE_MAX_LAYER) << KEY_LAYER_SHIFT)
+		| ((unsigned long long)(frame.texture & SPRITE_MAX_TEXTURE) << KEY_TEXTURE_SHIFT)
+		| ((unsigned long long)(depth & SPRITE_MAX_DEPTH) << KEY_DEPTH_SHIFT)
+		| (unsigned long long)index);
+	return true;
+}
+
+
+void SpriteBatch::flush(SpriteBackend& backend, int texture, int first, int n)
+{
+	for (int done = 0; done < n; done += SPRITE_DRAW_QUADS)
+	{
+		int chunk = n - done < SPRITE_DRAW_QUADS ? n - done : SPRITE_DRAW_QUADS;
+		if (texture != last_texture)
+			last.texture_switches++;
+		last_texture = texture;
+		last.draw_calls++;
+		backend.draw(texture, &vertices[4 * (size_t)(first + done)], chunk, indices.data());
+	}
+}
+
+
+void SpriteBatch::end(SpriteBackend& backend)
+{
+	int n = (int)keys.size();
+	memset(&last, 0, sizeof(last));
+	last.quads = n;
+	last_texture = -1;
+	if (n == 0)
+		return;
+
+	// sprites usually arrive layer by layer already, and then there is
+	// nothing to sort
+	const unsigned long long* sorted = keys.data();
+	int in_order = 1;
+	while (in_order < n && keys[in_order - 1] < keys[in_order])
+		in_order++;
+	if (in_order < n)
+		sorted = radix_sort_keys(keys.data(), scratch.data(), n, KEY_SORT_FIRST_BYTE);
+
+	// vertices in draw order, cut into runs at every texture change
+	int run_texture = (int)((sorted[0] >> KEY_TEXTURE_SHIFT) & SPRITE_MAX_TEXTURE);
+	int run_first = 0;
+	SpriteVertex* v = vertices.data();
+	for (int i = 0; i < n; i++, v += 4)
+	{
+		unsigned long long key = sorted[i];
+		int texture = (int)((key >> KEY_TEXTURE_SHIFT) & SPRITE_MAX_TEXTURE);
+		if (texture != run_texture)
+		{
+			flush(backend, run_texture, run_first, i - run_first);
+			run_texture = texture;
+			run_first = i;
+		}
+
+		const Quad& q = quads[(size_t)(key & KEY_INDEX_MASK)];
+		float x1 = q.x + q.w;
+		float y1 = q.y + q.h;
+		v[0].x = q.x; v[0].y = q.y; v[0].u = q.u0; v[0].v = q.v0;
+		v[1].x = x1;  v[1].y = q.y; v[1].u = q.u1; v[1].v = q.v0;
+		v[2].x = x1;  v[2].y = y1;  v[2].u = q.u1; v[2].v = q.v1;
+		v[3].x = q.x; v[3].y = y1;  v[3].u = q.u0; v[3].v = q.v1;
+		for (int c = 0; c < 4; c++)
+		{
+			v[c].z = 0.0f;
+			v[c].rhw = 1.0f;
+			v[c].color = q.color;
+		}
+	}
+	flush(backend, run_texture, run_first, n - run_first);
+}
@@ -0,0 +1,118 @@
+//-----------------------------------------------------------------------------
+// File: SpriteBatch.h
+//
+// Desc: Sprite batching. Every sprite of a frame goes into one draw list as
+//       a quad plus a 64-bit sort key; end() radix-sorts the keys, writes
+//       the vertices in sorted order and hands each run of quads that share
+//       a texture to the backend as a single draw.
+//
+//       Sort key, high bits first:
+//
+//           layer 8 | texture 12 | depth 20 | submission index 24
+//
+//       so sprites are drawn layer by layer, grouped by texture inside a
+//       layer, back to front by depth, and in the order they were added
+//       when everything else is equal.
+//
+//       The backend is an interface, so the batch runs the same with
+//       Direct3D in the game and with a counting or software backend in
+//       the headless benchmarks.
+//-----------------------------------------------------------------------------
+#ifndef __SpriteBatch_h_
+#define __SpriteBatch_h_
+
+#include <vector>
+
+#define SPRITE_MAX_LAYER 0xff
+#define SPRITE_MAX_TEXTURE 0xfff
+#define SPRITE_MAX_DEPTH 0xfffff
+#define SPRITE_MAX_QUADS (1 << 24)
+
+// quads per draw call; keeps every index within 16 bits
+#define SPRITE_DRAW_QUADS 16384
+
+#define SPRITE_COLOR(a, r, g, b) (((unsigned int)(a) << 24) | ((unsigned int)(r) << 16) | ((unsigned int)(g) << 8) | (unsigned int)(b))
+#define SPRITE_WHITE SPRITE_COLOR(255, 255, 255, 255)
+
+// a screen-space vertex; the layout is D3DFVF_XYZRHW | D3DFVF_DIFFUSE |
+// D3DFVF_TEX1, so a Direct3D 9 backend can draw straight from it
+struct SpriteVertex {
+	float x, y, z, rhw;
+	unsigned int color;     // ARGB
+	float u, v;
+};
+
+// where a sprite's image is inside its texture, in texture coordinates
+struct SpriteFrame {
+	int texture;
+	float w, h;          // size on screen in pixels
+	float u0, v0, u1, v1;
+};
+
+
+// receives the sorted frame one texture run at a time
+class SpriteBackend {
+
+public:
+	virtual ~SpriteBackend() {}
+
+	// quads * 4 vertices, drawn as two triangles each with indices, which
+	// are the same for every call: 0 1 2, 0 2 3, 4 5 6, ...
+	virtual void draw(int texture, const SpriteVertex* vertices, int quads, const unsigned short* indices) = 0;
+};
+
+
+struct SpriteStats {
+	int quads;
+	int draw_calls;
+	int texture_switches;    // draws that use a different texture from the draw before
+};
+
+
+class SpriteBatch {
+
+public:
+	SpriteBatch();
+
+	// allocates everything; pixel_offset is added to every vertex position
+	// (-0.5 maps pixels onto texels in Direct3D 9)
+	void init(int max_quads, float pixel_offset);
+
+	void begin();
+
+	// top-left corner at (x, y); false when the batch is full
+	bool add(const SpriteFrame& frame, int layer, int depth, float x, float y, unsigned int color);
+
+	// sort, build the vertices and draw
+	void end(SpriteBackend& backend);
+
+	const SpriteStats& stats() const { return last; }
+	int count() const { return (int)keys.size(); }
+
+private:
+	struct Quad {
+		float x, y, w, h;
+		float u0, v0, u1, v1;
+		unsigned int color;
+	};
+
+	void flush(SpriteBackend& backend, int texture, int first, int quads);
+
+	int max_quads;
+	float pixel_offset;
+	std::vector<Quad> quads;
+	std::vector<unsigned long long> keys;
+	std::vector<unsigned long long> scratch;
+	std::vector<SpriteVertex> vertices;
+	std::vector<unsigned short> indices;
+	SpriteStats last;
+	int last_texture;
+};
+
+
+// stable LSD radix sort of n keys, 8 bits at a time, over the bytes from
+// first_byte up; passes where every key has the same byte are skipped.
+// Returns the buffer holding the result (keys or scratch).
+unsigned long long* radix_sort_keys(unsigned long long* keys, unsigned long long* scratch, int n, int first_byte);
+
+#endif // __SpriteBatch_h_
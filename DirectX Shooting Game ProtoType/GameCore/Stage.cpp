@@ -0,0 +1,381 @@
+//-----------------------------------------------------------------------------
+// File: Stage.cpp
+//
+// Desc: Stage compiler, the mapped reader and the spawn cursor.
+//-----------------------------------------------------------------------------
+#include <float.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+
+#include "Stage.h"
+#include "MoveScript.h"
+
+#define STAGE_LINE_MAX 256
+#define STAGE_TOKENS_MAX 10
+
+// latest spawn time, in ticks, so a tick count never overflows on the way
+#define STAGE_MAX_TICK 0x7fffffffu
+
+
+static bool stage_error(std::string& error, int line, const char* what)
+{
+	char text[STAGE_LINE_MAX + 96];    // room for any message and its line number
+	snprintf(text, sizeof text, "line %d: %s", line, what);
+	error = text;
+	return false;
+}
+
+
+// splits a line at white space, in place; returns the token count, or
+// STAGE_TOKENS_MAX + 1 when there are too many
+static int split_tokens(char* line, char** tokens)
+{
+	int n = 0;
+	for (char* p = strtok(line, " \t\r"); p; p = strtok(NULL, " \t\r"))
+	{
+		if (n == STAGE_TOKENS_MAX)
+			return STAGE_TOKENS_MAX + 1;
+		tokens[n++] = p;
+	}
+	return n;
+}
+
+
+static bool parse_number(const char* token, double& value)
+{
+	char* end;
+	value = strtod(token, &end);
+	return end != token && *end == 0 && fabs(value) <= FLT_MAX;
+}
+
+
+static bool tick_of(double seconds, int tick_rate, unsigned int& tick)
+{
+	double t = seconds * tick_rate + 0.5;
+	if (!(seconds >= 0) || t > STAGE_MAX_TICK)
+		return false;
+	tick = (unsigned int)t;
+	return true;
+}
+
+
+static bool spawn_before(const StageSpawn& a, const StageSpawn& b)
+{
+	return a.tick < b.tick;
+}
+
+
+static size_t align_up(size_t n, size_t to)
+{
+	return (n + to - 1) & ~(to - 1);
+}
+
+
+bool compile_stage(const char* source, int tick_rate, std::vector<unsigned char>& out, std::string& error)
+{
+	std::vector<std::string> names;
+	std::vector<std::string> scripts;
+	std::vector<StageSpawn> spawns;
+	error.clear();
+	if (tick_rate <= 0)
+		return stage_error(error, 0, "tick rate must be positive");
+
+	// the script being read, between its script and end lines
+	int script_line = 0;
+	std::string script;
+
+	// every script so far, added the way set_stage() adds them, so a stage
+	// whose scripts only fit one at a time doesn't compile
+	MoveProgram program;
+
+	int line_number = 0;
+	for (const char* p = source; *p; )
+	{
+		// one line, as it is for a script and without its comment otherwise
+		const char* eol = strchr(p, '\n');
+		size_t length = eol ? (size_t)(eol - p) : strlen(p);
+		line_number++;
+		if (length >= STAGE_LINE_MAX)
+			return stage_error(error, line_number, "line too long");
+		char line[STAGE_LINE_MAX];
+		memcpy(line, p, length);
+		line[length] = 0;
+		p += eol ? length + 1 : length;
+		std::string text(line);
+		char* comment = strchr(line, '#');
+		if (comment)
+			*comment = 0;
+
+		char* tokens[STAGE_TOKENS_MAX];
+		int n = split_tokens(line, tokens);
+		if (n == 0)
+		{
+			if (script_line)
+				script += text + "\n";
+			continue;
+		}
+		if (n > STAGE_TOKENS_MAX)
+			return stage_error(error, line_number, "too many arguments");
+
+		if (script_line)
+		{
+			if (strcmp(tokens[0], "end") != 0 || n != 1)
+			{
+				script += text + "\n";
+				continue;
+			}
+
+			// the script compiles now, so its errors point into the stage
+			if (program.add(script.c_str(), 1.0f / tick_rate) < 0)
+			{
+				char what[STAGE_LINE_MAX + 64];
+				snprintf(what, sizeof what, "in script '%.64s', %s", names.back().c_str(), program.error());
+				return stage_error(error, script_line, what);
+			}
+			scripts.push_back(script);
+			script_line = 0;
+			continue;
+		}
+
+		if (strcmp(tokens[0], "script") == 0)
+		{
+			if (n != 2)
+				return stage_error(error, line_number, "wrong number of arguments");
+			if (std::find(names.begin(), names.end(), tokens[1]) != names.end())
+				return stage_error(error, line_number, "script defined twice");
+			if ((int)names.size() == STAGE_MAX_SCRIPTS)
+				return stage_error(error, line_number, "too many scripts");
+			names.push_back(tokens[1]);
+			script.clear();
+			script_line = line_number;
+			continue;
+		}
+
+		bool wave = strcmp(tokens[0], "wave") == 0;
+		if (!wave && strcmp(tokens[0], "at") != 0)
+		{
+			char what[STAGE_LINE_MAX + 32];
+			snprintf(what, sizeof what, "unknown command '%s'", tokens[0]);
+			return stage_error(error, line_number, what);
+		}
+
+		// at:   seconds archetype x y script
+		// wave: seconds count interval archetype x y dx dy script
+		if (n != (wave ? 10 : 6))
+			return stage_error(error, line_number, "wrong number of arguments");
+		const int archetype_token = wave ? 4 : 2;
+		double v[STAGE_TOKENS_MAX];
+		memset(v, 0, sizeof(v));
+		for (int k = 1; k < n - 1; k++)
+		{
+			if (k != archetype_token && !parse_number(tokens[k], v[k]))
+				return stage_error(error, line_number, "not a number");
+		}
+		if (strcmp(tokens[archetype_token], "enemy") != 0)
+			return stage_error(error, line_number, "unknown archetype");
+		std::vector<std::string>::iterator name = std::find(names.begin(), names.end(), tokens[n - 1]);
+		if (name == names.end())
+			return stage_error(error, line_number, "unknown script");
+
+		double count = wave ? v[2] : 1;
+		double interval = wave ? v[3] : 0;
+		double x = v[archetype_token + 1], y = v[archetype_token + 2];
+		double dx = wave ? v[7] : 0, dy = wave ? v[8] : 0;
+		if (count < 1 || count != floor(count) || count > STAGE_MAX_SPAWNS - spawns.size())
+			return stage_error(error, line_number, wave ? "wave count out of range" : "too many spawns");
+		if (interval < 0)
+			return stage_error(error, line_number, "interval can't be negative");
+
+		StageSpawn s;
+		memset(&s, 0, sizeof(s));
+		s.archetype = STAGE_ENEMY;
+		s.script = (unsigned short)(name - names.begin());
+		for (int k = 0; k < (int)count; k++)
+		{
+			double px = x + k * dx, py = y + k * dy;
+			if (!tick_of(v[1] + k * interval, tick_rate, s.tick))
+				return stage_error(error, line_number, "time out of range");
+			if (fabs(px) > FLT_MAX || fabs(py) > FLT_MAX)
+				return stage_error(error, line_number, "position out of range");
+			s.x = (float)px;
+			s.y = (float)py;
+			spawns.push_back(s);
+		}
+	}
+	if (script_line)
+		return stage_error(error, script_line, "script without an end");
+
+	// spawns due on the same tick keep the order they were written in
+	std::stable_sort(spawns.begin(), spawns.end(), spawn_before);
+
+	StageHeader head;
+	memset(&head, 0, sizeof(head));
+	memcpy(head.magic, STAGE_MAGIC, 4);
+	head.version = STAGE_VERSION;
+	head.tick_rate = (unsigned int)tick_rate;
+	head.script_count = (unsigned int)scripts.size();
+	head.script_offset = sizeof(StageHeader);
+	head.spawn_count = (unsigned int)spawns.size();
+
+	std::vector<StageScript> table(scripts.size());
+	size_t offset = sizeof(StageHeader) + scripts.size() * sizeof(StageScript);
+	for (size_t i = 0; i < scripts.size(); i++)
+	{
+		table[i].offset = (unsigned int)offset;
+		table[i].length = (unsigned int)scripts[i].size();
+		offset += scripts[i].size() + 1;
+	}
+	head.spawn_offset = (unsigned int)align_up(offset, STAGE_ALIGN);
+	head.size = (unsigned int)(head.spawn_offset + spawns.size() * sizeof(StageSpawn));
+
+	out.assign(head.size, 0);
+	memcpy(out.data(), &head, sizeof(head));
+	if (!table.empty())
+		memcpy(out.data() + head.script_offset, table.data(), table.size() * sizeof(StageScript));
+	for (size_t i = 0; i < scripts.size(); i++)
+		memcpy(out.data() + table[i].offset, scripts[i].data(), scripts[i].size());
+	if (!spawns.empty())
+		memcpy(out.data() + head.spawn_offset, spawns.data(), spawns.size() * sizeof(StageSpawn));
+	return true;
+}
+
+
+bool compile_stage_file(const char* source_path, const char* out_path, int tick_rate, std::string& error)
+{
+	FILE* f = fopen(source_path, "rb");
+	if (!f)
+	{
+		error = std::string("can't open ") + source_path;
+		return false;
+	}
+	std::string source;
+	char buffer[4096];
+	size_t n;
+	while ((n = fread(buffer, 1, sizeof(buffer), f)) > 0)
+		source.append(buffer, n);
+	fclose(f);
+
+	std::vector<unsigned char> bytes;
+	if (!compile_stage(source.c_str(), tick_rate, bytes, error))
+		return false;
+
+	f = fopen(out_path, "wb");
+	if (!f)
+	{
+		error = std::string("can't write ") + out_path;
+		return false;
+	}
+	bool ok = fwrite(bytes.data(), 1, bytes.size(), f) == bytes.size();
+	if (fclose(f) != 0 || !ok)
+	{
+		error = std::string("can't write ") + out_path;
+		return false;
+	}
+	return true;
+}
+
+
+Stage::Stage()
+	: head(NULL), scripts(NULL), spawns(NULL)
+{
+}
+
+
+bool Stage::open(const char* path, int tick_rate)
+{
+	close();
+	if (!file.open(path) || file.size() < sizeof(StageHeader))
+	{
+		close();
+		return false;
+	}
+
+	const StageHeader* h = (const StageHeader*)file.data();
+	size_t size = file.size();
+	bool ok = memcmp(h->magic, STAGE_MAGIC, 4) == 0 && h->version == STAGE_VERSION
+		&& h->tick_rate == (unsigned int)tick_rate && h->size == size
+		&& h->script_count <= STAGE_MAX_SCRIPTS && h->script_offset % 4 == 0 && h->script_offset >= sizeof(StageHeader)
+		&& h->script_offset <= size && h->script_count * sizeof(StageScript) <= size - h->script_offset
+		&& h->spawn_count <= STAGE_MAX_SPAWNS && h->spawn_offset % STAGE_ALIGN == 0 && h->spawn_offset >= sizeof(StageHeader)
+		&& h->spawn_offset <= size && (unsigned long long)h->spawn_count * sizeof(StageSpawn) <= size - h->spawn_offset;
+
+	const StageScript* table = (const StageScript*)(file.data() + (ok ? h->script_offset : 0));
+	for (unsigned int i = 0; ok && i < h->script_count; i++)
+	{
+		ok = table[i].offset <= size && table[i].length < size - table[i].offset
+			&& file.data()[table[i].offset + table[i].length] == 0;
+	}
+	if (!ok)
+	{
+		close();
+		return false;
+	}
+
+	head = h;
+	scripts = table;
+	spawns = (const StageSpawn*)(file.data() + h->spawn_offset);
+	return true;
+}
+
+
+void Stage::close()
+{
+	file.close();
+	head = NULL;
+	scripts = NULL;
+	spawns = NULL;
+}
+
+
+bool Stage::valid(const StageSpawn& s) const
+{
+	return s.archetype < STAGE_ARCHETYPE_NUM && s.script < head->script_count
+		&& fabsf(s.x) <= FLT_MAX && fabsf(s.y) <= FLT_MAX;
+}
+
+
+StageCursor::StageCursor()
+	: stage(NULL), index(0), bad(0)
+{
+}
+
+
+void StageCursor::start(const Stage* s)
+{
+	stage = s;
+	index = 0;
+	bad = 0;
+}
+
+
+const StageSpawn* StageCursor::next(unsigned int tick)
+{
+	if (!stage)
+		return NULL;
+
+	while (index < stage->spawn_count())
+	{
+		const StageSpawn& s = stage->spawn(index);
+		if (s.tick > tick)
+			return NULL;
+		index++;
+		if (stage->valid(s))
+			return &s;
+		bad++;
+	}
+	return NULL;
+}
+
+
+bool StageCursor::restore(int position, int skipped)
+{
+	int count = stage ? stage->spawn_count() : 0;
+	if (position < 0 || position > count || skipped < 0 || skipped > position)
+		return false;
+	index = position;
+	bad = skipped;
+	return true;
+}
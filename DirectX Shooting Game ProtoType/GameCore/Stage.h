@@ -0,0 +1,146 @@
+//-----------------------------------------------------------------------------
+// File: Stage.h
+//
+// Desc: Stages: when and where enemies spawn and which movement script each
+//       one runs. A stage is written as text and compiled ahead of time
+//       (tools/stage_compile) into a flat file of spawn records sorted by
+//       tick, which the game maps and walks with a cursor: opening one
+//       reads the header and the script table and nothing else, and play
+//       only ever reads the next record.
+//
+//       Source ('#' starts a comment, times in seconds):
+//
+//           script <name>               a movement script (MoveScript.h),
+//               <instructions>          one instruction per line
+//           end
+//
+//           at <seconds> <archetype> <x> <y> <script>
+//                                       one spawn
+//           wave <seconds> <count> <interval> <archetype> <x> <y> <dx> <dy> <script>
+//                                       count spawns, interval seconds
+//                                       apart, each (dx, dy) on from the last
+//
+//       The only archetype so far is "enemy". A script must be defined
+//       before the first spawn that runs it.
+//
+//       File layout (little-endian):
+//           StageHeader
+//           StageScript x script_count
+//           the source of every script, each followed by a 0
+//           StageSpawn x spawn_count    at a 16-byte aligned offset
+//
+//       Spawn times are stored in ticks, so a stage only opens at the tick
+//       rate it was compiled for. The scripts stay source; they are
+//       compiled once when the stage is set up.
+//-----------------------------------------------------------------------------
+#ifndef __Stage_h_
+#define __Stage_h_
+
+#include <string>
+#include <vector>
+
+#include "MappedFile.h"
+
+#define STAGE_MAGIC "STGE"
+#define STAGE_VERSION 1
+#define STAGE_ALIGN 16
+#define STAGE_MAX_SCRIPTS 64
+#define STAGE_MAX_SPAWNS (1 << 24)
+
+enum {
+	STAGE_ENEMY,
+	STAGE_ARCHETYPE_NUM
+};
+
+struct StageHeader {
+	char magic[4];
+	unsigned int version;
+	unsigned int tick_rate;       // ticks per second the spawn times count
+	unsigned int script_count;
+	unsigned int script_offset;   // the StageScript table, from the start of the file
+	unsigned int spawn_count;
+	unsigned int spawn_offset;
+	unsigned int size;            // of the whole file
+};
+
+struct StageScript {
+	unsigned int offset;          // source text, from the start of the file
+	unsigned int length;          // without the 0 after it
+};
+
+struct StageSpawn {
+	unsigned int tick;            // spawns during this tick
+	unsigned short archetype;
+	unsigned short script;        // index into the script table
+	float x, y;
+};
+
+// compile stage source for a game running tick_rate ticks a second into
+// the bytes of a stage file; false, with error saying why and where, if it
+// doesn't compile. Its scripts together must fit one MoveProgram.
+bool compile_stage(const char* source, int tick_rate, std::vector<unsigned char>& out, std::string& error);
+
+// compile_stage() from one file into another
+bool compile_stage_file(const char* source_path, const char* out_path, int tick_rate, std::string& error);
+
+
+// a compiled stage, read in place from its mapping
+class Stage {
+
+public:
+	Stage();
+
+	// false if the file is missing, damaged, from another version or for
+	// another tick rate. Only the header and the script table are checked
+	// here; every spawn is checked as the cursor reaches it.
+	bool open(const char* path, int tick_rate);
+	void close();
+
+	bool is_open() const { return head != NULL; }
+	int script_count() const { return (int)head->script_count; }
+	int spawn_count() const { return (int)head->spawn_count; }
+
+	// source of script i, 0-terminated
+	const char* script_source(int i) const { return (const char*)file.data() + scripts[i].offset; }
+
+	const StageSpawn& spawn(int i) const { return spawns[i]; }
+
+	// whether a spawn record names an archetype and a script that exist and
+	// a position that is a number
+	bool valid(const StageSpawn& s) const;
+
+private:
+	MappedFile file;
+	const StageHeader* head;
+	const StageScript* scripts;
+	const StageSpawn* spawns;
+};
+
+
+// how far play is into a stage: every spawn before position() is done
+class StageCursor {
+
+public:
+	StageCursor();
+
+	void start(const Stage* stage);
+
+	// the next spawn due by tick, or NULL once none is; damaged records are
+	// passed over and counted
+	const StageSpawn* next(unsigned int tick);
+
+	int position() const { return index; }
+	int skipped() const { return bad; }
+	bool finished() const { return !stage || index == stage->spawn_count(); }
+
+	// back to a position and count a snapshot saved; false if they don't fit
+	// the stage
+	bool restore(int position, int skipped);
+
+private:
+	const Stage* stage;
+	int index;
+	int bad;
+};
+
+#endif // __Stage_h_
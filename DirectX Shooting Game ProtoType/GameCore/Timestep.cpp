@@ -0,0 +1,124 @@
+//-----------------------------------------------------------------------------
+// File: Timestep.cpp
+//
+// Desc: Clocks and the fixed-timestep accumulator.
+//-----------------------------------------------------------------------------
+#include <chrono>
+#include <thread>
+#include <math.h>
+
+#include "Timestep.h"
+
+// weight of the newest sleep in the running oversleep estimate
+#define OVERSLEEP_WEIGHT 0.125
+
+
+double SystemClock::now()
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+
+void SystemClock::sleep(double seconds)
+{
+	std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+}
+
+
+void SystemClock::yield()
+{
+	std::this_thread::yield();
+}
+
+
+ManualClock::ManualClock()
+	: time(0), oversleep(0), spin_step(0.0001), sleeps(0), spins(0)
+{
+}
+
+
+FixedStep::FixedStep(Clock& clock_, double step_, int max_ticks_)
+	: clock(clock_), step(step_), max_ticks(max_ticks_)
+{
+	// start by assuming a timer that oversleeps by about a millisecond
+	oversleep_mean = 0.001;
+	oversleep_var = 0.0003 * 0.0003;
+	margin = oversleep_mean + 3 * sqrt(oversleep_var);
+
+	reset();
+	reset_stats();
+}
+
+
+void FixedStep::reset()
+{
+	last = clock.now();
+	accumulator = 0;
+}
+
+
+void FixedStep::reset_stats()
+{
+	waits = 0;
+	jitter_sum = 0;
+	jitter_peak = 0;
+	dropped = 0;
+}
+
+
+int FixedStep::advance()
+{
+	double now = clock.now();
+	accumulator += now - last;
+	last = now;
+
+	int ticks = (int)(accumulator / step);
+	if (ticks > max_ticks)
+	{
+		// too far behind to catch up; let the game slow down instead
+		dropped += ticks - max_ticks;
+		accumulator -= (ticks - max_ticks) * step;
+		ticks = max_ticks;
+	}
+	accumulator -= ticks * step;
+	return ticks;
+}
+
+
+void FixedStep::wait()
+{
+	double target = last + (step - accumulator);
+	double now = clock.now();
+
+	// sleep through most of the gap and learn how much the sleep overshoots
+	double gap = target - now - margin;
+	if (gap > 0)
+	{
+		clock.sleep(gap);
+		double after = clock.now();
+		double over = (after - now) - gap;
+		double delta = over - oversleep_mean;
+		oversleep_mean += OVERSLEEP_WEIGHT * delta;
+		oversleep_var = (1 - OVERSLEEP_WEIGHT) * (oversleep_var + OVERSLEEP_WEIGHT * delta * delta);
+
+		margin = oversleep_mean + 3 * sqrt(oversleep_var);
+		if (margin < 0)
+			margin = 0;
+		if (margin > step)
+			margin = step;
+		now = after;
+	}
+
+	// then spin out the rest
+	while (now < target)
+	{
+		clock.yield();
+		now = clock.now();
+	}
+
+	double late = now - target;
+	waits++;
+	jitter_sum += late;
+	if (late > jitter_peak)
+		jitter_peak = late;
+}
@@ -0,0 +1,110 @@
+//-----------------------------------------------------------------------------
+// File: Timestep.h
+//
+// Desc: Fixed-timestep frame pacing. FixedStep accumulates real time from a
+//       Clock and tells the main loop how many fixed ticks to run, so the
+//       game keeps the same speed when a frame comes in late: the missed
+//       ticks are run on the next frame instead of being lost.
+//
+//       Waiting for the next tick sleeps for most of the gap and only spins
+//       for the last part. The spin margin is learned from how much the
+//       clock's sleeps have overshot so far.
+//
+//       The clock is an interface so tests can drive the loop with a
+//       ManualClock instead of wall time.
+//-----------------------------------------------------------------------------
+#ifndef __Timestep_h_
+#define __Timestep_h_
+
+// time source for FixedStep; times are in seconds
+class Clock {
+
+public:
+	virtual ~Clock() {}
+
+	// monotonic time
+	virtual double now() = 0;
+
+	// block for about this long; may oversleep
+	virtual void sleep(double seconds) = 0;
+
+	// give the rest of the time slice away while spinning
+	virtual void yield() = 0;
+};
+
+
+// steady_clock and the OS scheduler
+class SystemClock : public Clock {
+
+public:
+	double now();
+	void sleep(double seconds);
+	void yield();
+};
+
+
+// time only moves when something sleeps or spins on it, or when advance()
+// is called to stand in for work done between frames
+class ManualClock : public Clock {
+
+public:
+	ManualClock();
+
+	double now() { return time; }
+	void sleep(double seconds) { time += seconds + oversleep; sleeps++; }
+	void yield() { time += spin_step; spins++; }
+	void advance(double seconds) { time += seconds; }
+
+	double time;
+	double oversleep;     // added to every sleep, like a coarse OS timer
+	double spin_step;     // time that passes per yield()
+	long long sleeps;
+	long long spins;
+};
+
+
+class FixedStep {
+
+public:
+	// step is the tick length; at most max_ticks are run per frame, anything
+	// further behind than that is dropped
+	FixedStep(Clock& clock, double step, int max_ticks);
+
+	// start counting from now, with nothing accumulated
+	void reset();
+
+	// number of ticks due since the last call
+	int advance();
+
+	// block until the next tick is due
+	void wait();
+
+	// how far into the next tick we are, 0..1, for interpolating the render
+	double alpha() const { return accumulator / step; }
+
+	// lateness of wait() against the tick it was waiting for
+	double jitter_mean() const { return waits ? jitter_sum / waits : 0.0; }
+	double jitter_max() const { return jitter_peak; }
+	double sleep_margin() const { return margin; }
+	long long dropped_ticks() const { return dropped; }
+	void reset_stats();
+
+private:
+	Clock& clock;
+	double step;
+	int max_ticks;
+
+	double last;           // clock time of the last advance()
+	double accumulator;    // time not yet turned into ticks
+
+	double margin;                   // how early to stop sleeping and start spinning
+	double oversleep_mean;
+	double oversleep_var;
+
+	long long waits;
+	double jitter_sum;
+	double jitter_peak;
+	long long dropped;
+};
+
+#endif // __Timestep_h_
@@ -0,0 +1,96 @@
+//-----------------------------------------------------------------------------
+// File: WorldSprites.cpp
+//
+// Desc: Fills a sprite batch from the world, all of it or what is in view.
+//-----------------------------------------------------------------------------
+#include "WorldSprites.h"
+
+
+int world_sprite_capacity(int enemy_num)
+{
+	return 2 + enemy_num + BULLET_CAPACITY + SUPER_BULLET_CAPACITY + ENEMY_BULLET_CAPACITY;
+}
+
+
+static void draw_pool(const ProjectilePool& pool, const SpriteFrame& frame, int layer, SpriteBatch& batch)
+{
+	for (int i = 0; i < pool.count(); i++)
+		batch.add(frame, layer, 0, pool.x[i], pool.y[i], SPRITE_WHITE);
+}
+
+
+void draw_world(const World& world, const SpriteFrame* frames, SpriteBatch& batch)
+{
+	batch.add(frames[SPRITE_HERO], SPRITE_HERO, 0, world.hero.x[0], world.hero.y[0], SPRITE_WHITE);
+	draw_pool(world.bullet, frames[SPRITE_BULLET], SPRITE_BULLET, batch);
+	draw_pool(world.super_bullet, frames[SPRITE_SUPER_BULLET], SPRITE_SUPER_BULLET, batch);
+
+	const SpriteFrame& enemy = frames[SPRITE_ENEMY];
+	for (int i = 0; i < world.enemy.count(); i++)
+		batch.add(enemy, SPRITE_ENEMY, 0, world.enemy.x[i], world.enemy.y[i], SPRITE_WHITE);
+
+	if (world.boss.alive[0])
+		batch.add(frames[SPRITE_BOSS], SPRITE_BOSS, 0, world.boss.x[0], world.boss.y[0], SPRITE_WHITE);
+
+	draw_pool(world.enemy_bullet, frames[SPRITE_ENEMY_BULLET], SPRITE_ENEMY_BULLET, batch);
+}
+
+
+static void draw_visible(SpriteCuller& culler, const float* x, const float* y, int n, const SpriteFrame& frame,
+	int layer, SpriteBatch& batch)
+{
+	int count;
+	const int* visible = culler.visible(x, y, n, frame.w, frame.h, &count);
+	for (int k = 0; k < count; k++)
+		batch.add(frame, layer, 0, x[visible[k]], y[visible[k]], SPRITE_WHITE);
+}
+
+
+static void draw_visible_pool(SpriteCuller& culler, const ProjectilePool& pool, const SpriteFrame& frame,
+	int layer, SpriteBatch& batch)
+{
+	draw_visible(culler, pool.x.data(), pool.y.data(), pool.count(), frame, layer, batch);
+}
+
+
+// the same order as above, so what is drawn is drawn identically
+void draw_world(const World& world, const SpriteFrame* frames, SpriteCuller& culler, SpriteBatch& batch)
+{
+	culler.begin();
+	draw_visible(culler, world.hero.x.data(), world.hero.y.data(), 1, frames[SPRITE_HERO], SPRITE_HERO, batch);
+	draw_visible_pool(culler, world.bullet, frames[SPRITE_BULLET], SPRITE_BULLET, batch);
+	draw_visible_pool(culler, world.super_bullet, frames[SPRITE_SUPER_BULLET], SPRITE_SUPER_BULLET, batch);
+	draw_visible(culler, world.enemy.x.data(), world.enemy.y.data(), world.enemy.count(), frames[SPRITE_ENEMY],
+		SPRITE_ENEMY, batch);
+	if (world.boss.alive[0])
+		draw_visible(culler, world.boss.x.data(), world.boss.y.data(), 1, frames[SPRITE_BOSS], SPRITE_BOSS, batch);
+	draw_visible_pool(culler, world.enemy_bullet, frames[SPRITE_ENEMY_BULLET], SPRITE_ENEMY_BULLET, batch);
+}
+
+
+// what each kind of event throws off, in SIM_EVENT_ order
+static const ParticleBurst g_effects[] = {
+	// count  speed           life           color
+	{ 48,     40.0f, 220.0f,  0.4f, 0.9f,    0xffa030 },    // enemy down: an explosion
+	{ 8,      80.0f, 260.0f,  0.1f, 0.3f,    0xfff0a0 },    // boss hit: sparks
+	{ 12,     60.0f, 200.0f,  0.2f, 0.4f,    0xff4040 },    // hero hit
+};
+
+
+void emit_effects(const World& world, ParticleSystem& particles)
+{
+	// events are where sprites are drawn from, their top-left corner; the
+	// effect goes off in the middle of the sprite
+	for (size_t k = 0; k < world.events.size(); k++)
+	{
+		const SimEvent& e = world.events[k];
+		particles.emit(g_effects[e.type], e.x + ENTITY_RADIUS, e.y + ENTITY_RADIUS);
+	}
+}
+
+
+CullRect screen_view()
+{
+	CullRect view = { 0.0f, 0.0f, (float)SCREEN_WIDTH, (float)SCREEN_HEIGHT };
+	return view;
+}
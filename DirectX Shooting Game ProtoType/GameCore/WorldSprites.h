@@ -0,0 +1,45 @@
+//-----------------------------------------------------------------------------
+// File: WorldSprites.h
+//
+// Desc: What the world looks like: one sprite frame per kind of entity, and
+//       the function that puts every live entity of a world into a sprite
+//       batch, or only those the view can show. Shared by the game and the
+//       headless renderers.
+//-----------------------------------------------------------------------------
+#ifndef __WorldSprites_h_
+#define __WorldSprites_h_
+
+#include "Cull.h"
+#include "Particles.h"
+#include "Sim.h"
+#include "SpriteBatch.h"
+
+// kinds of sprites, in the order they are drawn
+enum {
+	SPRITE_HERO,
+	SPRITE_BULLET,
+	SPRITE_SUPER_BULLET,
+	SPRITE_ENEMY,
+	SPRITE_BOSS,
+	SPRITE_ENEMY_BULLET,
+	SPRITE_KIND_NUM
+};
+
+// the batch capacity a world of this many enemies can need; also enough
+// for a culler drawing it
+int world_sprite_capacity(int enemy_num);
+
+// add every live entity; frames holds SPRITE_KIND_NUM entries
+void draw_world(const World& world, const SpriteFrame* frames, SpriteBatch& batch);
+
+// the same, leaving out every sprite outside the culler's view; the
+// culler's stats count this frame only
+void draw_world(const World& world, const SpriteFrame* frames, SpriteCuller& culler, SpriteBatch& batch);
+
+// the whole screen
+CullRect screen_view();
+
+// sparks and explosions for the events of the last tick
+void emit_effects(const World& world, ParticleSystem& particles);
+
+#endif // __WorldSprites_h_
@@ -0,0 +1,48 @@
+//-----------------------------------------------------------------------------
+// File: BenchUtil.h
+//
+// Desc: Small helpers shared by the headless benchmarks.
+//-----------------------------------------------------------------------------
+#ifndef __BenchUtil_h_
+#define __BenchUtil_h_
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+// monotonic time in nanoseconds
+inline double bench_now_ns()
+{
+	return (double)std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// seconds each measurement should run for; "--quick" shortens every run
+inline double bench_seconds(int argc, char** argv, double normal)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--quick") == 0)
+			return normal / 20;
+	}
+	return normal;
+}
+
+// keeps the optimizer from throwing a result away
+template <typename T>
+inline void bench_keep(const T& value)
+{
+	static volatile unsigned char sink;
+	sink = *(const volatile unsigned char*)&value;
+	(void)sink;
+}
+
+// prints one self-check and passes its result on
+inline bool check(bool ok, const char* what)
+{
+	printf("%-50s %s\n", what, ok ? "ok" : "FAILED");
+	return ok;
+}
+
+#endif // __BenchUtil_h_
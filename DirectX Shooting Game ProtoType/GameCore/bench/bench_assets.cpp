@@ -0,0 +1,149 @@
+//-----------------------------------------------------------------------------
+// File: bench_assets.cpp
+//
+// Desc: Time to first frame for the 34-frame "DirectX 2D Sprite" set:
+//       decode every PNG, upload it, set up the renderer and draw one
+//       frame showing them all.
+//
+//           bench_assets [--quick]
+//
+//       Serial decodes each image inside load(), as InitGeometry() does with
+//       D3DXCreateTextureFromFile. Async queues every decode first, sets up
+//       the renderer while the workers decode, then uploads images as they
+//       finish. The upload stage is the software renderer's add_texture();
+//       both ways must draw the same frame.
+//-----------------------------------------------------------------------------
+#include <algorithm>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+#include "AssetLoader.h"
+#include "ImageFile.h"
+#include "SoftRaster.h"
+#include "SpriteBatch.h"
+#include "BenchUtil.h"
+
+#define FRAME_COUNT 34
+#define GRID_COLUMNS 7
+#define CELL_W 90
+#define CELL_H 95
+
+
+// uploads into the software renderer, remembering which texture each
+// handle became
+class RasterSink : public TextureSink {
+
+public:
+	SoftwareRenderer* renderer;
+	int texture[FRAME_COUNT];
+	int size[FRAME_COUNT][2];
+
+	void upload(int handle, const unsigned int* argb, int w, int h)
+	{
+		texture[handle] = renderer->add_texture(argb, w, h);
+		size[handle][0] = w;
+		size[handle][1] = h;
+	}
+};
+
+
+static unsigned long long frame_hash(const SoftwareRenderer& r)
+{
+	unsigned long long h = 14695981039346656037ull;
+	const unsigned char* p = (const unsigned char*)r.pixels();
+	for (size_t i = 0; i < (size_t)r.width() * r.height() * 4; i++)
+		h = (h ^ p[i]) * 1099511628211ull;
+	return h;
+}
+
+
+// one startup: load, upload, draw; returns milliseconds to the first frame
+static double first_frame(JobSystem* jobs, const std::vector<std::string>& files, unsigned long long& hash, bool& loaded)
+{
+	double start = bench_now_ns();
+
+	AssetLoader loader;
+	loader.init(jobs, FRAME_COUNT);
+	for (int i = 0; i < FRAME_COUNT; i++)
+		loader.load(files[i].c_str(), -1);
+
+	// the rest of startup, which the decodes overlap with
+	SoftwareRenderer r;
+	r.init(640, 480);
+	SpriteBatch batch;
+	batch.init(FRAME_COUNT, 0.0f);
+
+	RasterSink sink;
+	sink.renderer = &r;
+	loader.pump(sink);
+	loaded = loader.finish(sink);
+
+	r.begin(0x202040);
+	batch.begin();
+	for (int i = 0; loaded && i < FRAME_COUNT; i++)
+	{
+		SpriteFrame f = { sink.texture[i], (float)sink.size[i][0], (float)sink.size[i][1], 0, 0, 1, 1 };
+		f.w = std::min(f.w, (float)CELL_W);
+		f.h = std::min(f.h, (float)CELL_H);
+		f.u1 = f.w / sink.size[i][0];
+		f.v1 = f.h / sink.size[i][1];
+		batch.add(f, 0, 0, (float)(i % GRID_COLUMNS * CELL_W), (float)(i / GRID_COLUMNS * CELL_H), SPRITE_WHITE);
+	}
+	batch.end(r);
+	r.flush(jobs);
+	hash = frame_hash(r);
+
+	return (bench_now_ns() - start) / 1e6;
+}
+
+
+int main(int argc, char** argv)
+{
+	double seconds = bench_seconds(argc, argv, 1.0);
+
+	std::vector<std::string> files;
+	for (int group = 1; group <= 3; group++)
+	{
+		for (int i = 1; i <= (group == 3 ? 12 : 11); i++)
+			files.push_back(std::string(FRAME_SET_DIR) + "/" + std::to_string(group) + "-" + std::to_string(i) + ".png");
+	}
+
+	JobSystem jobs;
+	jobs.start(0);
+
+	// the two ways take turns, so neither gets the warmer caches
+	std::vector<double> times[2];
+	bool loaded = true;
+	bool same = true;
+	unsigned long long reference = 0;
+	double start = bench_now_ns();
+	while (bench_now_ns() - start < seconds * 1e9 || times[0].size() < 3)
+	{
+		for (int async = 0; async < 2; async++)
+		{
+			unsigned long long hash;
+			bool run_loaded;
+			times[async].push_back(first_frame(async ? &jobs : NULL, files, hash, run_loaded));
+			loaded = loaded && run_loaded;
+			if (reference == 0)
+				reference = hash;
+			same = same && hash == reference;
+		}
+	}
+
+	printf("%-8s %8s %6s %12s %12s %12s\n", "loader", "threads", "runs", "first ms", "median ms", "best ms");
+	for (int async = 0; async < 2; async++)
+	{
+		std::vector<double>& t = times[async];
+		double first = t[0];
+		std::sort(t.begin(), t.end());
+		printf("%-8s %8d %6d %12.2f %12.2f %12.2f\n", async ? "async" : "serial", async ? jobs.thread_count() : 1,
+			(int)t.size(), first, t[t.size() / 2], t[0]);
+	}
+
+	bool ok = check(loaded, "every frame decoded and uploaded");
+	ok = check(same, "same first frame both ways") && ok;
+
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,164 @@
+//-----------------------------------------------------------------------------
+// File: bench_atlas.cpp
+//
+// Desc: Atlas packing of the "DirectX 2D Sprite" frame set and of the game
+//       sprites: PNG decode time, pack time and page density.
+//
+//           bench_atlas [--quick]
+//
+//       Also checks that no two sprites overlap, that the page holds every
+//       sprite pixel for pixel, that a page survives a PNG round trip, and
+//       that the game's sprites.atlas table matches its page and sources;
+//       exits non-zero on any failure.
+//-----------------------------------------------------------------------------
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+#include "Atlas.h"
+#include "ImageFile.h"
+#include "BenchUtil.h"
+
+#define PADDING 1
+#define COLOR_KEY 0xff00ff
+
+
+static bool load_images(const std::string& dir, const char* const* names, int count, std::vector<AtlasImage>& images)
+{
+	images.resize(count);
+	for (int i = 0; i < count; i++)
+	{
+		std::string path = dir + "/" + names[i] + ".png";
+		if (!load_atlas_image(path.c_str(), COLOR_KEY, images[i]))
+		{
+			printf("can't read %s\n", path.c_str());
+			return false;
+		}
+	}
+	return true;
+}
+
+
+static bool overlaps(const AtlasRect& a, const AtlasRect& b, int padding)
+{
+	return a.x - padding < b.x + b.w + padding && b.x - padding < a.x + a.w + padding
+		&& a.y - padding < b.y + b.h + padding && b.y - padding < a.y + a.h + padding;
+}
+
+
+// every sprite with its border inside the page, apart from the others, and
+// copied exactly
+static bool page_holds(const std::vector<AtlasImage>& images, const AtlasRect* rects, const unsigned int* argb, int w, int h)
+{
+	for (size_t i = 0; i < images.size(); i++)
+	{
+		const AtlasRect& r = rects[i];
+		if (r.x < PADDING || r.y < PADDING || r.x + r.w + PADDING > w || r.y + r.h + PADDING > h
+			|| r.w != images[i].w || r.h != images[i].h)
+			return false;
+		for (size_t j = 0; j < i; j++)
+		{
+			if (overlaps(r, rects[j], PADDING))
+				return false;
+		}
+		for (int y = 0; y < r.h; y++)
+		{
+			for (int x = 0; x < r.w; x++)
+			{
+				if (argb[(size_t)(r.y + y) * w + r.x + x] != images[i].argb[(size_t)y * r.w + x])
+					return false;
+			}
+		}
+	}
+	return true;
+}
+
+
+static bool bench_set(const char* title, const std::string& dir, const char* const* names, int count, double seconds,
+	AtlasPage& page, std::vector<AtlasImage>& images)
+{
+	double start = bench_now_ns();
+	if (!load_images(dir, names, count, images))
+		return check(false, "sprites decoded");
+	double decode_ms = (bench_now_ns() - start) / 1e6;
+
+	int packs = 0;
+	bool packed = true;
+	start = bench_now_ns();
+	double now = start;
+	while (now - start < seconds * 1e9 || packs == 0)
+	{
+		packed = pack_atlas(images, PADDING, ATLAS_MAX_SIZE, page) && packed;
+		packs++;
+		now = bench_now_ns();
+	}
+
+	long long pixels = 0;
+	for (size_t i = 0; i < images.size(); i++)
+		pixels += (long long)images[i].w * images[i].h;
+	printf("%s: %d sprites, %lld pixels, decode %.2f ms\n", title, count, pixels, decode_ms);
+	printf("    %dx%d page, %.1f%% used, pack %.3f ms\n", page.w, page.h, 100.0 * atlas_density(images, page),
+		(now - start) / 1e6 / packs);
+
+	bool ok = check(packed, "packed");
+	return check(ok && page_holds(images, page.rects.data(), page.argb.data(), page.w, page.h),
+		"sprites in bounds, apart and copied exactly") && ok;
+}
+
+
+int main(int argc, char** argv)
+{
+	double seconds = bench_seconds(argc, argv, 1.0);
+	bool ok = true;
+
+	static const char* const frame_set[] = {
+		"1-1", "1-2", "1-3", "1-4", "1-5", "1-6", "1-7", "1-8", "1-9", "1-10", "1-11",
+		"2-1", "2-2", "2-3", "2-4", "2-5", "2-6", "2-7", "2-8", "2-9", "2-10", "2-11",
+		"3-1", "3-2", "3-3", "3-4", "3-5", "3-6", "3-7", "3-8", "3-9", "3-10", "3-11", "3-12",
+	};
+	static const char* const game_set[] = { "Gundam", "Enemy2", "Bomb", "HaroBullet", "Boss" };
+
+	AtlasPage page;
+	std::vector<AtlasImage> images;
+	ok = bench_set("DirectX 2D Sprite", FRAME_SET_DIR, frame_set, sizeof(frame_set) / sizeof(frame_set[0]), seconds / 2,
+		page, images) && ok;
+
+	// the page written with alpha reads back the same
+	std::string path = "bench_atlas_page.png";
+	std::vector<unsigned int> back;
+	int w = 0, h = 0;
+	bool round_trip = save_png_alpha(path.c_str(), page.argb.data(), page.w, page.h) && load_png(path.c_str(), back, w, h)
+		&& w == page.w && h == page.h && back == page.argb;
+	remove(path.c_str());
+	ok = check(round_trip, "page survives a PNG round trip") && ok;
+
+	ok = bench_set("game sprites", GAME_DIR, game_set, sizeof(game_set) / sizeof(game_set[0]), seconds / 2,
+		page, images) && ok;
+
+	// the table the game loads lines up with its page and the sources
+	AtlasTable table;
+	std::vector<unsigned int> game_page;
+	bool loaded = table.load(GAME_DIR "/sprites.atlas")
+		&& load_png((std::string(GAME_DIR) + "/" + table.page_file()).c_str(), game_page, w, h)
+		&& w == table.width() && h == table.height();
+	ok = check(loaded, "sprites.atlas and its page load") && ok;
+	if (loaded)
+	{
+		std::vector<AtlasRect> rects(images.size());
+		bool found = table.count() == (int)images.size();
+		for (size_t i = 0; found && i < images.size(); i++)
+		{
+			SpriteFrame f;
+			found = table.find(images[i].name.c_str(), 0, f);
+			rects[i].x = (int)(f.u0 * w + 0.5f);
+			rects[i].y = (int)(f.v0 * h + 0.5f);
+			rects[i].w = (int)f.w;
+			rects[i].h = (int)f.h;
+			found = found && (int)(f.u1 * w + 0.5f) == rects[i].x + rects[i].w && (int)(f.v1 * h + 0.5f) == rects[i].y + rects[i].h;
+		}
+		ok = check(found && page_holds(images, rects.data(), game_page.data(), w, h),
+			"sprites.atlas matches the game sprites") && ok;
+	}
+
+	return ok ? 0 : 1;
+}
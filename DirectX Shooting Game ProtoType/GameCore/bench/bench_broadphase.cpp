@@ -0,0 +1,149 @@
+//-----------------------------------------------------------------------------
+// File: bench_broadphase.cpp
+//
+// Desc: Brute force (SIMD batch per projectile) against the uniform grid
+//       (rebuild plus one query per projectile) at 1k, 10k and 100k enemies,
+//       for a growing number of projectiles, and the projectile count at
+//       which the grid starts to win. Both sides must find the same hits.
+//-----------------------------------------------------------------------------
+#include <stdio.h>
+#include <math.h>
+#include <vector>
+
+#include "Sim.h"
+#include "Collide.h"
+#include "Cpu.h"
+#include "SpatialGrid.h"
+#include "BenchUtil.h"
+
+
+static unsigned int g_seed = 777;
+
+static float random_float(float lo, float hi)
+{
+	g_seed = g_seed * 1664525u + 1013904223u;
+	return lo + (hi - lo) * (float)(g_seed >> 8) / 16777216.0f;
+}
+
+
+struct Scene {
+	std::vector<float> ex, ey, px, py;
+	std::vector<unsigned char> ealive, palive;
+};
+
+// enemies at a fixed density, so the field grows with the count
+static void make_scene(Scene& s, int n, int m)
+{
+	float side = sqrtf((float)n) * 48;
+	s.ex.resize(n);
+	s.ey.resize(n);
+	s.ealive.assign(n, 1);
+	for (int i = 0; i < n; i++)
+	{
+		s.ex[i] = random_float(0, side);
+		s.ey[i] = random_float(0, side);
+	}
+	s.px.resize(m);
+	s.py.resize(m);
+	s.palive.assign(m, 1);
+	for (int j = 0; j < m; j++)
+	{
+		s.px[j] = random_float(0, side);
+		s.py[j] = random_float(0, side);
+	}
+}
+
+
+static long long brute_force(const Scene& s, std::vector<unsigned int>& hits)
+{
+	int n = (int)s.ex.size();
+	long long found = 0;
+	for (int j = 0; j < (int)s.px.size(); j++)
+	{
+		collide_circle_batch(s.px[j], s.py[j], ENTITY_RADIUS, s.ex.data(), s.ey.data(), ENTITY_RADIUS, n, hits.data());
+		for (int w = 0; w < collide_mask_words(n); w++)
+		{
+			for (unsigned int bits = hits[w]; bits != 0; bits &= bits - 1)
+				found++;
+		}
+	}
+	return found;
+}
+
+
+static long long grid(const Scene& s, SpatialGrid& g, std::vector<int>& ids)
+{
+	long long found = 0;
+	g.build(s.ex.data(), s.ey.data(), s.ealive.data(), (int)s.ex.size());
+	for (int j = 0; j < (int)s.px.size(); j++)
+	{
+		g.query_radius(s.px[j], s.py[j], ENTITY_RADIUS * 2, ids);
+		found += (long long)ids.size();
+	}
+	return found;
+}
+
+
+// average ns per call of f over roughly the given time
+template <typename F>
+static double time_ns(F f, double seconds)
+{
+	long long calls = 0;
+	double start = bench_now_ns();
+	double now = start;
+	while (now - start < seconds * 1e9 || calls < 3)
+	{
+		f();
+		calls++;
+		now = bench_now_ns();
+	}
+	return (now - start) / calls;
+}
+
+
+int main(int argc, char** argv)
+{
+	static const int counts[] = { 1000, 10000, 100000 };
+	static const int projectiles[] = { 1, 2, 4, 8, 16, 32, 64, 128, 256, 1024 };
+	double seconds = bench_seconds(argc, argv, 0.2);
+
+	printf("collision kernel: %s\n\n", simd_level_name(collide_simd_level()));
+	printf("%8s %8s %14s %14s %8s\n", "enemies", "shots", "brute ns", "grid ns", "speedup");
+
+	for (int c = 0; c < 3; c++)
+	{
+		int n = counts[c];
+		int crossover = -1;
+		for (int p = 0; p < (int)(sizeof(projectiles) / sizeof(projectiles[0])); p++)
+		{
+			int m = projectiles[p];
+			Scene s;
+			make_scene(s, n, m);
+
+			std::vector<unsigned int> hits(collide_mask_words(n));
+			SpatialGrid g;
+			g.set_cell_size(ENTITY_RADIUS * 4);
+			std::vector<int> ids;
+
+			if (brute_force(s, hits) != grid(s, g, ids))
+			{
+				printf("grid and brute force disagree at %d enemies, %d shots\n", n, m);
+				return 1;
+			}
+
+			double brute_ns = time_ns([&]() { bench_keep(brute_force(s, hits)); }, seconds);
+			double grid_ns = time_ns([&]() { bench_keep(grid(s, g, ids)); }, seconds);
+			if (crossover < 0 && grid_ns < brute_ns)
+				crossover = m;
+
+			printf("%8d %8d %14.0f %14.0f %7.2fx\n", n, m, brute_ns, grid_ns, brute_ns / grid_ns);
+		}
+
+		if (crossover > 0)
+			printf("%8d: grid wins from %d projectiles\n\n", n, crossover);
+		else
+			printf("%8d: brute force wins at every tested projectile count\n\n", n);
+	}
+
+	return 0;
+}
@@ -0,0 +1,144 @@
+//-----------------------------------------------------------------------------
+// File: bench_collide.cpp
+//
+// Desc: Checks every collision kernel against sphere_collision_check() bit
+//       for bit, then reports pairs/sec for each SIMD path the CPU supports.
+//       Exits non-zero if any path disagrees with the scalar function.
+//-----------------------------------------------------------------------------
+#include <stdio.h>
+#include <vector>
+
+#include "Sim.h"
+#include "Collide.h"
+#include "Cpu.h"
+#include "BenchUtil.h"
+
+
+static unsigned int g_seed = 12345;
+
+static float random_float(float lo, float hi)
+{
+	g_seed = g_seed * 1664525u + 1013904223u;
+	return lo + (hi - lo) * (float)(g_seed >> 8) / 16777216.0f;
+}
+
+
+// circles scattered around (0, 0), with some placed exactly on the
+// touching distance where a rounding difference would show up
+static void make_circles(std::vector<float>& x, std::vector<float>& y, int n)
+{
+	x.resize(n);
+	y.resize(n);
+	for (int i = 0; i < n; i++)
+	{
+		switch (i % 4)
+		{
+		case 0:
+			x[i] = 64.0f;
+			y[i] = 0.0f;
+			break;
+		case 1:
+			x[i] = random_float(-45.26f, 45.26f);
+			y[i] = random_float(-45.26f, 45.26f);
+			break;
+		default:
+			x[i] = random_float(-200, 200);
+			y[i] = random_float(-200, 200);
+			break;
+		}
+	}
+}
+
+
+static bool verify(int level)
+{
+	collide_set_simd_level(level);
+
+	std::vector<float> x, y, px, py;
+	std::vector<unsigned int> hits;
+	long long pairs = 0;
+
+	for (int n = 0; n <= 300; n++)
+	{
+		int m = 1 + n % 5;
+		make_circles(x, y, n);
+		make_circles(px, py, m);
+
+		int stride = collide_mask_words(n);
+		hits.assign(m * stride + 1, 0xdeadbeef);
+		collide_circles_batch(px.data(), py.data(), m, ENTITY_RADIUS, x.data(), y.data(), ENTITY_RADIUS, n, hits.data());
+
+		for (int j = 0; j < m; j++)
+		{
+			for (int i = 0; i < stride * 32; i++)
+			{
+				bool expect = i < n && sphere_collision_check(px[j], py[j], ENTITY_RADIUS, x[i], y[i], ENTITY_RADIUS);
+				bool got = (hits[j * stride + (i >> 5)] >> (i & 31)) & 1;
+				if (expect != got)
+				{
+					printf("verify %-6s FAILED: n=%d projectile %d circle %d\n", simd_level_name(level), n, j, i);
+					return false;
+				}
+				pairs++;
+			}
+		}
+		if (hits[m * stride] != 0xdeadbeef)
+		{
+			printf("verify %-6s FAILED: n=%d wrote past the mask\n", simd_level_name(level), n);
+			return false;
+		}
+	}
+
+	printf("verify %-6s ok (%lld pairs)\n", simd_level_name(level), pairs);
+	return true;
+}
+
+
+static double measure(int m, int n, double seconds)
+{
+	std::vector<float> x, y, px, py;
+	make_circles(x, y, n);
+	make_circles(px, py, m);
+	std::vector<unsigned int> hits(m * collide_mask_words(n));
+
+	// enough calls between clock reads that the clock stays out of the measurement
+	int reps = 1 + 100000 / (m * n);
+
+	long long pairs = 0;
+	double start = bench_now_ns();
+	double now = start;
+	while (now - start < seconds * 1e9)
+	{
+		for (int k = 0; k < reps; k++)
+			collide_circles_batch(px.data(), py.data(), m, ENTITY_RADIUS, x.data(), y.data(), ENTITY_RADIUS, n, hits.data());
+		pairs += (long long)reps * m * n;
+		now = bench_now_ns();
+	}
+	bench_keep(hits[0]);
+	return pairs / ((now - start) / 1e9);
+}
+
+
+int main(int argc, char** argv)
+{
+	double seconds = bench_seconds(argc, argv, 0.5);
+	int best = cpu_simd_level();
+	bool ok = true;
+
+	for (int level = SIMD_SCALAR; level <= best; level++)
+		ok = verify(level) && ok;
+	if (!ok)
+		return 1;
+
+	printf("\n%-8s %16s %16s %16s\n", "isa", "1x1000", "1x100000", "64x4096");
+	for (int level = SIMD_SCALAR; level <= best; level++)
+	{
+		collide_set_simd_level(level);
+		printf("%-8s", simd_level_name(level));
+		printf(" %10.1f Mp/s", measure(1, 1000, seconds) / 1e6);
+		printf(" %10.1f Mp/s", measure(1, 100000, seconds) / 1e6);
+		printf(" %10.1f Mp/s\n", measure(64, 4096, seconds) / 1e6);
+	}
+
+	return 0;
+}
@@ -0,0 +1,261 @@
+//-----------------------------------------------------------------------------
+// File: bench_cull.cpp
+//
+// Desc: View culling in the draw list: the kernels on their own for every
+//       SIMD path, then a game frame at 10k, 100k and 1M enemies drawn whole
+//       and culled to the screen, with the share of sprites culled: right
+//       after the enemies spawn above the screen and two seconds later,
+//       when the first of them have fallen into view.
+//
+//           bench_cull [--quick]
+//
+//       Checks that every SIMD path keeps exactly the sprites a plain
+//       overlap test keeps, sprites exactly on the edge included, and that
+//       the culled frame comes out of the software renderer pixel for pixel
+//       the same as the whole one.
+//-----------------------------------------------------------------------------
+#include <stdio.h>
+#include <algorithm>
+#include <vector>
+
+#include "Cpu.h"
+#include "Cull.h"
+#include "Rng.h"
+#include "SoftRaster.h"
+#include "WorldSprites.h"
+#include "BenchUtil.h"
+
+#define KERNEL_SPRITES 100000
+
+
+static float random_float(Rng& rng, float lo, float hi)
+{
+	return lo + (hi - lo) * (float)(rng.next() >> 8) / 16777216.0f;
+}
+
+
+// corners all around the screen, a quarter of them exactly on the edges
+// of the view or of the grown view
+static void make_corners(std::vector<float>& x, std::vector<float>& y, int n, float w, float h, Rng& rng)
+{
+	const CullRect view = screen_view();
+	const float edges_x[] = { view.left - w, view.left, view.right - w, view.right };
+	const float edges_y[] = { view.top - h, view.top, view.bottom - h, view.bottom };
+	x.resize(n);
+	y.resize(n);
+	for (int i = 0; i < n; i++)
+	{
+		x[i] = i % 4 == 0 ? edges_x[rng.below(4)] : random_float(rng, -400, 1000);
+		y[i] = i % 4 == 1 ? edges_y[rng.below(4)] : random_float(rng, -600, 800);
+	}
+}
+
+
+static bool verify(int level)
+{
+	cull_set_simd_level(level);
+	Rng rng(23, 0);
+	const CullRect view = screen_view();
+	std::vector<float> x, y;
+	std::vector<int> visible, expect;
+
+	for (int n = 0; n <= 300; n++)
+	{
+		float w = n % 3 ? 64.0f : 100.0f;
+		make_corners(x, y, n, w, w, rng);
+		expect.clear();
+		for (int i = 0; i < n; i++)
+		{
+			if (x[i] + w > view.left && x[i] < view.right && y[i] + w > view.top && y[i] < view.bottom)
+				expect.push_back(i);
+		}
+		visible.assign(n + 1, -1);
+		int count = cull_sprites(x.data(), y.data(), n, w, w, view, visible.data());
+		if (count != (int)expect.size() || !std::equal(expect.begin(), expect.end(), visible.begin()) || visible[n] != -1)
+		{
+			printf("verify %-6s FAILED: n=%d\n", simd_level_name(level), n);
+			return false;
+		}
+	}
+	printf("verify %-6s ok\n", simd_level_name(level));
+	return true;
+}
+
+
+// ns per sprite for one kernel, at a share of sprites in view
+static double measure_kernel(float on_screen, double seconds)
+{
+	Rng rng(5, 0);
+	const CullRect view = screen_view();
+	std::vector<float> x(KERNEL_SPRITES), y(KERNEL_SPRITES);
+	std::vector<int> visible(KERNEL_SPRITES);
+	for (int i = 0; i < KERNEL_SPRITES; i++)
+	{
+		bool in = random_float(rng, 0, 1) < on_screen;
+		x[i] = random_float(rng, 0, SCREEN_WIDTH - 64);
+		y[i] = in ? random_float(rng, 0, SCREEN_HEIGHT - 64) : random_float(rng, -2000, -100);
+	}
+
+	long long runs = 0;
+	double start = bench_now_ns();
+	double now = start;
+	while (now - start < seconds * 1e9 || runs < 3)
+	{
+		bench_keep(cull_sprites(x.data(), y.data(), KERNEL_SPRITES, 64, 64, view, visible.data()));
+		runs++;
+		now = bench_now_ns();
+	}
+	return (now - start) / runs / KERNEL_SPRITES;
+}
+
+
+// counts what it is asked to draw and reads every vertex, as an upload would
+class CountingBackend : public SpriteBackend {
+
+public:
+	CountingBackend() : quads(0), sum(0) {}
+
+	void draw(int, const SpriteVertex* vertices, int n, const unsigned short*)
+	{
+		quads += n;
+		for (int i = 0; i < 4 * n; i++)
+			sum += vertices[i].x;
+	}
+
+	int quads;
+	float sum;
+};
+
+
+static const SpriteFrame g_frames[SPRITE_KIND_NUM] = {
+	{ 0, 64, 64, 0, 0, 1, 1 },
+	{ 1, 64, 64, 0, 0, 1, 1 },
+	{ 2, 100, 100, 0, 0, 1, 1 },
+	{ 3, 64, 64, 0, 0, 1, 1 },
+	{ 2, 100, 100, 0, 0, 1, 1 },
+	{ 4, 64, 64, 0, 0, 1, 1 },
+};
+
+
+// a world a few seconds into play, the hero firing all the while
+static void play(World& world, int enemies, int ticks)
+{
+	init_game(world, enemies, 1);
+	SimInput input;
+	input.buttons = BUTTON_FIRE | BUTTON_SUPER_FIRE | BUTTON_LEFT;
+	for (int t = 0; t < ticks; t++)
+		do_game_logic(world, input);
+}
+
+
+// the same world drawn whole and culled by the software renderer
+static bool same_pixels()
+{
+	World world;
+	play(world, 2000, 3 * TICK_RATE);
+
+	SoftwareRenderer r;
+	r.init(SCREEN_WIDTH, SCREEN_HEIGHT);
+	for (int k = 0; k < 5; k++)
+	{
+		std::vector<unsigned int> square(100 * 100, SPRITE_COLOR(160, 60 * k, 255 - 50 * k, 128));
+		r.add_texture(square.data(), 100, 100);
+	}
+	SpriteBatch batch;
+	batch.init(world_sprite_capacity(2000), 0.0f);
+	SpriteCuller culler;
+	culler.reserve(world_sprite_capacity(2000));
+	culler.set_view(screen_view());
+
+	r.begin(0);
+	batch.begin();
+	draw_world(world, g_frames, batch);
+	batch.end(r);
+	r.flush(NULL);
+	std::vector<unsigned int> whole(r.pixels(), r.pixels() + SCREEN_WIDTH * SCREEN_HEIGHT);
+	int all = batch.stats().quads;
+
+	r.begin(0);
+	batch.begin();
+	draw_world(world, g_frames, culler, batch);
+	batch.end(r);
+	r.flush(NULL);
+	std::vector<unsigned int> culled(r.pixels(), r.pixels() + SCREEN_WIDTH * SCREEN_HEIGHT);
+
+	printf("2000 enemies: %d of %d sprites drawn\n", batch.stats().quads, all);
+	return whole == culled && batch.stats().quads < all && culler.stats().visible == batch.stats().quads;
+}
+
+
+// us per frame for the draw list and the sort, whole and culled
+static void measure_frame(int enemies, int ticks, double seconds)
+{
+	World world;
+	play(world, enemies, ticks);
+
+	SpriteBatch batch;
+	batch.init(world_sprite_capacity(enemies), 0.0f);
+	SpriteCuller culler;
+	culler.reserve(world_sprite_capacity(enemies));
+	culler.set_view(screen_view());
+
+	double us[2];
+	int quads[2];
+	for (int cull = 0; cull < 2; cull++)
+	{
+		CountingBackend backend;
+		long long frames = 0;
+		double start = bench_now_ns();
+		double now = start;
+		while (now - start < seconds * 1e9 || frames < 3)
+		{
+			batch.begin();
+			if (cull)
+				draw_world(world, g_frames, culler, batch);
+			else
+				draw_world(world, g_frames, batch);
+			batch.end(backend);
+			frames++;
+			now = bench_now_ns();
+		}
+		bench_keep(backend.sum);
+		us[cull] = (now - start) / frames / 1000;
+		quads[cull] = batch.stats().quads;
+	}
+	printf("%8d %6.1f s %10d %10d %9.1f%% %12.1f %12.1f %8.1fx\n", enemies, ticks * TICK_SECONDS, quads[0], quads[1],
+		culler.culled_ratio() * 100, us[0], us[1], us[0] / us[1]);
+}
+
+
+int main(int argc, char** argv)
+{
+	double seconds = bench_seconds(argc, argv, 0.5);
+	int best = cpu_simd_level();
+	bool ok = true;
+
+	for (int level = SIMD_SCALAR; level <= best; level++)
+		ok = verify(level) && ok;
+	cull_set_simd_level(best);
+	ok = check(same_pixels(), "culled frame matches the whole frame") && ok;
+
+	printf("\n%-8s %16s %16s %16s\n", "isa", "1% on screen", "50% on screen", "all on screen");
+	for (int level = SIMD_SCALAR; level <= best; level++)
+	{
+		cull_set_simd_level(level);
+		printf("%-8s", simd_level_name(level));
+		printf(" %10.2f ns/sp", measure_kernel(0.01f, seconds / 3));
+		printf(" %10.2f ns/sp", measure_kernel(0.5f, seconds / 3));
+		printf(" %10.2f ns/sp\n", measure_kernel(1.0f, seconds / 3));
+	}
+	cull_set_simd_level(best);
+
+	printf("\ndraw list and sort per frame:\n");
+	printf("%8s %8s %10s %10s %10s %12s %12s %9s\n", "enemies", "played", "sprites", "in view", "culled", "whole us", "culled us", "");
+	const int sizes[] = { 10000, 100000, 1000000 };
+	for (int k = 0; k < 3; k++)
+	{
+		measure_frame(sizes[k], 0, seconds);
+		measure_frame(sizes[k], 2 * TICK_RATE, seconds);
+	}
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,382 @@
+//-----------------------------------------------------------------------------
+// File: bench_ecs.cpp
+//
+// Desc: The archetype store against the other two ways this game has kept
+//       its objects: one heap object per entity behind a virtual move (the
+//       original entity classes) and a projectile pool's parallel arrays.
+//
+//           bench_ecs [--quick]
+//
+//       Times moving every projectile once and replacing entities (one
+//       destroyed, one created) at 100k and 1M, and tagging and untagging
+//       entities in the store.
+//
+//       Checks that stale handles are refused after their index is reused,
+//       that every handle still finds its own entity after the packing
+//       moves, that a change of archetype keeps the components, and that
+//       columns start on cache lines.
+//-----------------------------------------------------------------------------
+#include <stdio.h>
+#include <vector>
+
+#include "Ecs.h"
+#include "ProjectilePool.h"
+#include "Rng.h"
+#include "BenchUtil.h"
+
+#define DT (1.0f / 60.0f)
+
+
+struct Position { float x, y; };
+struct Velocity { float vx, vy; };
+struct Health { int hp; };
+
+// the game's objects as components
+struct Shooter {
+	EcsWorld world;
+	int position, velocity, health;
+	int hero, enemy, boss, player_shot, super_shot, enemy_shot, stunned;    // tags
+
+	EcsMask bullet() const { return ECS_BIT(position) | ECS_BIT(velocity) | ECS_BIT(player_shot); }
+	EcsMask super_bullet() const { return bullet() | ECS_BIT(super_shot); }
+	EcsMask enemy_bullet() const { return ECS_BIT(position) | ECS_BIT(velocity) | ECS_BIT(enemy_shot); }
+	EcsMask enemy_ship() const { return ECS_BIT(position) | ECS_BIT(velocity) | ECS_BIT(health) | ECS_BIT(enemy); }
+	EcsMask hero_ship() const { return ECS_BIT(position) | ECS_BIT(health) | ECS_BIT(hero); }
+	EcsMask boss_ship() const { return ECS_BIT(position) | ECS_BIT(health) | ECS_BIT(boss); }
+	EcsMask moving() const { return ECS_BIT(position) | ECS_BIT(velocity); }
+};
+
+
+static void make_shooter(Shooter& s)
+{
+	s.position = s.world.add_component_type(sizeof(Position));
+	s.velocity = s.world.add_component_type(sizeof(Velocity));
+	s.health = s.world.add_component_type(sizeof(Health));
+	s.hero = s.world.add_component_type(0);
+	s.enemy = s.world.add_component_type(0);
+	s.boss = s.world.add_component_type(0);
+	s.player_shot = s.world.add_component_type(0);
+	s.super_shot = s.world.add_component_type(0);
+	s.enemy_shot = s.world.add_component_type(0);
+	s.stunned = s.world.add_component_type(0);
+}
+
+
+static EcsHandle spawn(Shooter& s, EcsMask mask, float x, float y, float vx, float vy)
+{
+	EcsHandle h = s.world.create(mask);
+	Position* p = (Position*)s.world.get(h, s.position);
+	p->x = x;
+	p->y = y;
+	Velocity* v = (Velocity*)s.world.get(h, s.velocity);
+	if (v)
+	{
+		v->vx = vx;
+		v->vy = vy;
+	}
+	return h;
+}
+
+
+struct MoveSystem {
+	int position, velocity;
+	float dt;
+};
+
+static void move_system(const EcsChunk& chunk, void* data)
+{
+	const MoveSystem* m = (const MoveSystem*)data;
+	Position* p = chunk.column<Position>(m->position);
+	const Velocity* v = chunk.column<Velocity>(m->velocity);
+	for (int i = 0; i < chunk.count; i++)
+	{
+		p[i].x += v[i].vx * m->dt;
+		p[i].y += v[i].vy * m->dt;
+	}
+}
+
+
+static void move_ecs(Shooter& s)
+{
+	MoveSystem m = { s.position, s.velocity, DT };
+	s.world.each_chunk(s.moving(), move_system, &m);
+}
+
+
+// the original layout: one object per entity, its own move
+class Object {
+
+public:
+	virtual ~Object() {}
+	virtual void move(float dt) = 0;
+
+	float x_pos, y_pos;
+	int status;
+	int HP;
+};
+
+class ShotObject : public Object {
+
+public:
+	void move(float dt) { x_pos += vx * dt; y_pos += vy * dt; }
+
+	bool bShow;
+	float vx, vy;
+};
+
+
+static void move_pool(ProjectilePool& pool)
+{
+	int n = pool.count();
+	float* x = pool.x.data();
+	float* y = pool.y.data();
+	const float* vx = pool.vx.data();
+	const float* vy = pool.vy.data();
+	for (int i = 0; i < n; i++)
+	{
+		x[i] += vx[i] * DT;
+		y[i] += vy[i] * DT;
+	}
+}
+
+
+static bool alignment_ok(const EcsChunk& chunk, int position, int velocity)
+{
+	return ((size_t)chunk.columns[position] & (ECS_CACHE_LINE - 1)) == 0
+		&& ((size_t)chunk.columns[velocity] & (ECS_CACHE_LINE - 1)) == 0
+		&& ((size_t)chunk.handles & (ECS_CACHE_LINE - 1)) == 0;
+}
+
+struct AlignCheck {
+	int position, velocity;
+	bool ok;
+	int chunks;
+};
+
+static void align_system(const EcsChunk& chunk, void* data)
+{
+	AlignCheck* a = (AlignCheck*)data;
+	a->ok = a->ok && alignment_ok(chunk, a->position, a->velocity);
+	a->chunks++;
+}
+
+
+static bool checks()
+{
+	bool ok = true;
+	Shooter s;
+	make_shooter(s);
+
+	// a destroyed entity's index goes to the next one created; the old
+	// handle must not reach it
+	EcsHandle shot = spawn(s, s.bullet(), 1, 2, 0, -300);
+	s.world.destroy(shot);
+	EcsHandle next = spawn(s, s.enemy_bullet(), 5, 6, 0, 100);
+	ok = check((shot & (ECS_MAX_ENTITIES - 1)) == (next & (ECS_MAX_ENTITIES - 1)) && shot != next
+		&& !s.world.alive(shot) && !s.world.get(shot, s.position) && !s.world.destroy(shot)
+		&& s.world.alive(next) && shot != ECS_NULL && next != ECS_NULL, "stale handle refused after reuse") && ok;
+	s.world.destroy(next);
+
+	// every kind of object, then destroy at random: the survivors keep
+	// their own components wherever the packing moved them
+	Rng rng(21, 0);
+	const EcsMask kinds[] = { s.bullet(), s.super_bullet(), s.enemy_bullet(), s.enemy_ship(), s.hero_ship(), s.boss_ship() };
+	std::vector<EcsHandle> handles;
+	for (int i = 0; i < 50000; i++)
+		handles.push_back(spawn(s, kinds[i % 6], (float)i, (float)-i, 0, 0));
+	for (int i = 0; i < 50000; i += 1 + (int)rng.below(3))
+	{
+		s.world.destroy(handles[i]);
+		handles[i] = ECS_NULL;
+	}
+	bool found = true;
+	int live = 0;
+	for (int i = 0; i < 50000; i++)
+	{
+		if (handles[i] == ECS_NULL)
+			continue;
+		live++;
+		const Position* p = (const Position*)s.world.get(handles[i], s.position);
+		found = found && p && p->x == (float)i && p->y == (float)-i && s.world.mask_of(handles[i]) == kinds[i % 6];
+	}
+	ok = check(found && live == s.world.count(), "handles follow their entities through removal") && ok;
+
+	// stun an enemy and let it go: a move to another archetype and back
+	EcsHandle ship = spawn(s, s.enemy_ship(), 7, 8, 0, 80);
+	((Health*)s.world.get(ship, s.health))->hp = 3;
+	s.world.add_component(ship, s.stunned);
+	bool kept = s.world.mask_of(ship) == (s.enemy_ship() | ECS_BIT(s.stunned))
+		&& ((Health*)s.world.get(ship, s.health))->hp == 3 && ((Position*)s.world.get(ship, s.position))->y == 8;
+	s.world.remove_component(ship, s.velocity);
+	s.world.remove_component(ship, s.stunned);
+	s.world.add_component(ship, s.velocity);
+	const Velocity* v = (const Velocity*)s.world.get(ship, s.velocity);
+	kept = kept && v && v->vy == 0 && ((Health*)s.world.get(ship, s.health))->hp == 3;
+	ok = check(kept, "components kept across archetype changes") && ok;
+
+	AlignCheck a = { s.position, s.velocity, true, 0 };
+	s.world.each_chunk(s.moving(), align_system, &a);
+	ok = check(a.ok && a.chunks > 0, "columns cache line aligned") && ok;
+	return ok;
+}
+
+
+// ns per entity for one move of everything, three layouts
+static void measure_move(int n, double seconds)
+{
+	Shooter s;
+	make_shooter(s);
+	ProjectilePool pool;
+	pool.init(n, 0, -1e30f, -1e30f, 1e30f, 1e30f);
+	std::vector<Object*> objects;
+	for (int i = 0; i < n; i++)
+	{
+		float x = (float)(i % 640), y = (float)(i % 480);
+		spawn(s, i % 4 == 3 ? s.enemy_bullet() : s.bullet(), x, y, 0, -300);
+		pool.spawn(x, y, 0, -300);
+		ShotObject* o = new ShotObject;
+		o->x_pos = x;
+		o->y_pos = y;
+		o->vx = 0;
+		o->vy = -300;
+		o->bShow = true;
+		objects.push_back(o);
+	}
+
+	double ns[3];
+	for (int layout = 0; layout < 3; layout++)
+	{
+		long long ticks = 0;
+		double start = bench_now_ns();
+		double now = start;
+		while (now - start < seconds * 1e9 || ticks < 3)
+		{
+			if (layout == 0)
+				move_ecs(s);
+			else if (layout == 1)
+				move_pool(pool);
+			else
+			{
+				for (int i = 0; i < n; i++)
+					objects[i]->move(DT);
+			}
+			ticks++;
+			now = bench_now_ns();
+		}
+		ns[layout] = (now - start) / ticks / n;
+	}
+	bench_keep(pool.y[n / 2]);
+	bench_keep(objects[n / 2]->y_pos);
+	printf("move %8d %16.2f %16.2f %16.2f\n", n, ns[0], ns[1], ns[2]);
+
+	for (int i = 0; i < n; i++)
+		delete objects[i];
+}
+
+
+// ns per entity replaced: one at random destroyed, a new one created
+static void measure_churn(int n, double seconds)
+{
+	Shooter s;
+	make_shooter(s);
+	ProjectilePool pool;
+	pool.init(n, 0, -1e30f, -1e30f, 1e30f, 1e30f);
+	std::vector<EcsHandle> handles(n);
+	std::vector<Object*> objects(n);
+	for (int i = 0; i < n; i++)
+	{
+		handles[i] = spawn(s, s.bullet(), 0, 0, 0, -300);
+		pool.spawn(0, 0, 0, -300);
+		objects[i] = new ShotObject;
+	}
+
+	double ns[3];
+	for (int layout = 0; layout < 3; layout++)
+	{
+		Rng rng(3, 0);
+		long long ops = 0;
+		double start = bench_now_ns();
+		double now = start;
+		while (now - start < seconds * 1e9 || ops < 1024)
+		{
+			for (int k = 0; k < 1024; k++, ops++)
+			{
+				int i = (int)rng.below((unsigned int)n);
+				if (layout == 0)
+				{
+					s.world.destroy(handles[i]);
+					handles[i] = spawn(s, s.bullet(), 1, 2, 0, -300);
+				}
+				else if (layout == 1)
+				{
+					pool.despawn_at(i);
+					pool.spawn(1, 2, 0, -300);
+				}
+				else
+				{
+					delete objects[i];
+					ShotObject* o = new ShotObject;
+					o->x_pos = 1;
+					o->y_pos = 2;
+					o->vx = 0;
+					o->vy = -300;
+					objects[i] = o;
+				}
+			}
+			now = bench_now_ns();
+		}
+		ns[layout] = (now - start) / ops;
+	}
+	bench_keep(s.world.count());
+	printf("replace %5d %16.2f %16.2f %16.2f\n", n, ns[0], ns[1], ns[2]);
+
+	for (int i = 0; i < n; i++)
+		delete objects[i];
+}
+
+
+// ns per tag added and removed again: two moves between archetypes
+static void measure_tagging(int n, double seconds)
+{
+	Shooter s;
+	make_shooter(s);
+	std::vector<EcsHandle> handles(n);
+	for (int i = 0; i < n; i++)
+		handles[i] = spawn(s, s.enemy_ship(), 0, 0, 0, 80);
+
+	Rng rng(5, 0);
+	long long ops = 0;
+	double start = bench_now_ns();
+	double now = start;
+	while (now - start < seconds * 1e9 || ops < 1024)
+	{
+		for (int k = 0; k < 1024; k++, ops++)
+		{
+			EcsHandle h = handles[rng.below((unsigned int)n)];
+			s.world.add_component(h, s.stunned);
+			s.world.remove_component(h, s.stunned);
+		}
+		now = bench_now_ns();
+	}
+	printf("stun and release %8d %14.2f ns\n", n, (now - start) / ops);
+}
+
+
+int main(int argc, char** argv)
+{
+	double seconds = bench_seconds(argc, argv, 0.5);
+	bool ok = checks();
+
+	Shooter s;
+	make_shooter(s);
+	printf("\nbullets per %d byte chunk: %d\n", ECS_CHUNK_BYTES, s.world.chunk_capacity(s.bullet()));
+	printf("ns per entity %9s %16s %16s %16s\n", "n", "archetypes", "projectile pool", "heap objects");
+	const int sizes[] = { 100000, 1000000 };
+	for (int k = 0; k < 2; k++)
+		measure_move(sizes[k], seconds);
+	for (int k = 0; k < 2; k++)
+		measure_churn(sizes[k], seconds);
+	for (int k = 0; k < 2; k++)
+		measure_tagging(sizes[k], seconds);
+	return ok ? 0 : 1;
+}
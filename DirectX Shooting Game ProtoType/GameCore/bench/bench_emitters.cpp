@@ -0,0 +1,113 @@
+//-----------------------------------------------------------------------------
+// File: bench_emitters.cpp
+//
+// Desc: Stress test for the bullet pattern engine. First the engine on its
+//       own, holding 50k live bullets (fire, move, collide with the hero,
+//       compact), then the whole game with enough enemies to fill the enemy
+//       bullet pool. Times are per tick against the 25 ms frame.
+//-----------------------------------------------------------------------------
+#include <stdio.h>
+
+#include "Sim.h"
+#include "Collide.h"
+#include "Cpu.h"
+#include "Emitter.h"
+#include "BenchUtil.h"
+
+
+static void bench_engine(int target, double seconds)
+{
+	PatternTable table;
+	BulletPattern ring = { PATTERN_SPIRAL, 1, 64, 60.0f, 0.0f, 0.1f, 0.0f };
+	table.add(ring);
+
+	ProjectilePool pool;
+	pool.init(target + 64, 0, -64, -64, SCREEN_WIDTH, SCREEN_HEIGHT);
+	std::vector<unsigned int> hits(collide_mask_words(pool.capacity()));
+	std::vector<Volley> volleys(target / 64 + 1);
+
+	long long ticks = 0;
+	long long peak = 0;
+	double start = 0;
+	double now = 0;
+	while (ticks < 500 || now - start < seconds * 1e9)
+	{
+		// top the pool back up to the target from emitters spread over the screen
+		int n = 0;
+		for (int missing = target - pool.count(); missing > 0 && n < (int)volleys.size(); missing -= 64, n++)
+		{
+			volleys[n].x = (float)((n * 37) % SCREEN_WIDTH);
+			volleys[n].y = (float)((n * 91) % SCREEN_HEIGHT);
+			volleys[n].pattern = 0;
+			volleys[n].angle = table.volley_angle(0, (int)ticks + n, 0, 0, 0, 0);
+		}
+		fire_volleys(table, volleys.data(), n, pool);
+
+		pool.update(TICK_SECONDS);
+		collide_circle_batch(320, 400, ENTITY_RADIUS, pool.x.data(), pool.y.data(), ENTITY_RADIUS, pool.count(), hits.data());
+		for (int w = 0; w < collide_mask_words(pool.count()); w++)
+		{
+			for (unsigned int bits = hits[w]; bits != 0; bits &= bits - 1)
+				pool.alive[w * 32 + lowest_bit_index(bits)] = 0;
+		}
+		pool.compact();
+
+		if (pool.count() > peak)
+			peak = pool.count();
+
+		// warm up until the pool has reached its steady state
+		ticks++;
+		if (ticks == 200)
+			start = bench_now_ns();
+		if (ticks >= 200)
+			now = bench_now_ns();
+	}
+
+	double ms = (now - start) / (ticks - 200) / 1e6;
+	printf("engine: %6d live bullets (peak %lld): %7.3f ms/tick, %5.1f%% of 25 ms\n",
+		pool.count(), peak, ms, ms / 25 * 100);
+}
+
+
+static void bench_game(int enemies, double seconds)
+{
+	World world;
+	init_game(world, enemies, 1);
+
+	SimInput input;
+	input.buttons = BUTTON_FIRE | BUTTON_SUPER_FIRE;
+
+	// let the enemies come on screen and the bullet count settle
+	for (int i = 0; i < 600; i++)
+		do_game_logic(world, input);
+
+	long long ticks = 0;
+	double start = bench_now_ns();
+	double now = start;
+	while (now - start < seconds * 1e9)
+	{
+		for (int i = 0; i < 4; i++, ticks++)
+			do_game_logic(world, input);
+		now = bench_now_ns();
+	}
+
+	double ms = (now - start) / ticks / 1e6;
+	printf("game: %7d enemies, %6d live enemy bullets: %7.3f ms/tick, %5.1f%% of 25 ms\n",
+		enemies, world.enemy_bullet.count(), ms, ms / 25 * 100);
+}
+
+
+int main(int argc, char** argv)
+{
+	double seconds = bench_seconds(argc, argv, 1.0);
+
+	bench_engine(10000, seconds);
+	bench_engine(50000, seconds);
+
+	bench_game(ENEMY_NUM, seconds);
+	bench_game(1000, seconds);
+	bench_game(4000, seconds);
+	bench_game(16000, seconds);
+
+	return 0;
+}
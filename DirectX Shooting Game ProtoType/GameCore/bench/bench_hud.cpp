@@ -0,0 +1,208 @@
+//-----------------------------------------------------------------------------
+// File: bench_hud.cpp
+//
+// Desc: Per-frame cost of the retained HUD, with generated stand-ins for the
+//       glyphs of the game's font.
+//
+//           bench_hud [--quick] [--dump <file.png>]
+//
+//       Times a HUD of game-like labels three ways: laid out again every
+//       frame (what DrawText did), retained with nothing changing, and
+//       retained with one number changing every frame. Then draws it with
+//       the software backend.
+//
+//       Checks that the retained and re-laid-out frames are the same pixel
+//       for pixel, that each frame is a single draw call, and that no frame
+//       allocates. --dump saves the software frame.
+//-----------------------------------------------------------------------------
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <new>
+#include <vector>
+
+#include "Hud.h"
+#include "ImageFile.h"
+#include "SoftRaster.h"
+#include "BenchUtil.h"
+
+#define FONT_HEIGHT 40
+#define FRAME_WIDTH 640
+#define FRAME_HEIGHT 480
+
+
+static long long g_allocations = 0;
+
+void* operator new(size_t size)
+{
+	g_allocations++;
+	void* p = malloc(size ? size : 1);
+	if (!p)
+		throw std::bad_alloc();
+	return p;
+}
+
+void operator delete(void* p) noexcept
+{
+	free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+	free(p);
+}
+
+
+// counts what it is sent and reads every vertex, as an upload would
+class CountingBackend : public SpriteBackend {
+
+public:
+	CountingBackend() : calls(0), quads(0), sum(0) {}
+
+	void draw(int, const SpriteVertex* vertices, int n, const unsigned short*)
+	{
+		calls++;
+		quads += n;
+		for (int i = 0; i < 4 * n; i++)
+			sum += vertices[i].color ^ (unsigned int)vertices[i].x;
+	}
+
+	long long calls;
+	long long quads;
+	unsigned int sum;
+};
+
+
+// a glyph-sized block of antialiased stripes per character, narrower for
+// lower case, roughly as wide and as tall as 40 pixel Arial
+static void make_font(GlyphAtlas& font)
+{
+	font.init(512, 256, FONT_HEIGHT, false);
+	std::vector<unsigned char> coverage;
+	for (int c = GLYPH_FIRST; c <= GLYPH_LAST; c++)
+	{
+		bool lower = c >= 'a' && c <= 'z';
+		int w = c == ' ' ? 0 : 8 + (c * 7) % 14 - (lower ? 4 : 0);
+		int h = lower ? 21 : 29;
+		coverage.assign((size_t)w * h, 0);
+		for (int y = 0; y < h; y++)
+		{
+			for (int x = 0; x < w; x++)
+			{
+				bool edge = x == 0 || y == 0 || x == w - 1 || y == h - 1;
+				coverage[(size_t)y * w + x] = (unsigned char)(edge ? 96 : ((x + y + c) % 3 == 0 ? 255 : 0));
+			}
+		}
+		font.add(c, coverage.data(), w, h, w, 1, 37 - h, w + 3);
+	}
+}
+
+
+static void make_hud(Hud& hud, const GlyphAtlas& font, int texture, int* number_label)
+{
+	hud.init(&font, texture, 16, 0.0f);
+	hud.set_text(hud.add_label(0, 0, SPRITE_WHITE), "Shooting Game");
+	hud.set_text(hud.add_label(0, 40, SPRITE_WHITE), "1234 sprites, 2 draws, 1 texture switches");
+	hud.set_number(hud.add_label(0, 400, SPRITE_COLOR(255, 120, 255, 120)), "HP ", 100);
+	hud.set_number(hud.add_label(420, 400, SPRITE_COLOR(255, 255, 120, 120)), "BOSS ", 200);
+	*number_label = hud.add_label(420, 0, SPRITE_COLOR(255, 255, 255, 0));
+	hud.set_number(*number_label, "SCORE ", 0);
+	hud.set_text(hud.add_label(0, 440, SPRITE_COLOR(160, 255, 255, 255)), "Z super  X bomb  SPACE fire");
+}
+
+
+enum { MODE_RELAYOUT, MODE_STATIC, MODE_NUMBER, MODE_NUM };
+
+static const char* g_mode_names[MODE_NUM] = { "laid out every frame", "retained, unchanged", "retained, score ticking" };
+
+
+static void hud_frame(Hud& hud, int mode, int number_label, int frame)
+{
+	if (mode == MODE_RELAYOUT)
+		hud.invalidate();
+	else if (mode == MODE_NUMBER)
+		hud.set_number(number_label, "SCORE ", frame * 10);
+}
+
+
+int main(int argc, char** argv)
+{
+	double seconds = bench_seconds(argc, argv, 0.5);
+	const char* dump = NULL;
+	for (int i = 1; i + 1 < argc; i++)
+	{
+		if (strcmp(argv[i], "--dump") == 0)
+			dump = argv[i + 1];
+	}
+	bool ok = true;
+
+	GlyphAtlas font;
+	make_font(font);
+	int number_label;
+	Hud hud;
+	make_hud(hud, font, 0, &number_label);
+
+	// CPU cost of a HUD frame: what changed is laid out, then one draw
+	printf("%-26s %12s %10s %12s\n", "hud", "ns/frame", "quads", "allocations");
+	bool single = true, quiet = true;
+	for (int mode = 0; mode < MODE_NUM; mode++)
+	{
+		CountingBackend backend;
+		hud.invalidate();
+		hud.draw(backend);
+
+		long long allocations = g_allocations;
+		long long frames = 0;
+		double start = bench_now_ns();
+		double now = start;
+		while (now - start < seconds * 1e9)
+		{
+			for (int k = 0; k < 256; k++, frames++)
+			{
+				hud_frame(hud, mode, number_label, (int)frames);
+				hud.draw(backend);
+			}
+			now = bench_now_ns();
+		}
+		allocations = g_allocations - allocations;
+		bench_keep(backend.sum);
+		single = single && backend.calls == frames + 1;
+		quiet = quiet && allocations == 0;
+		printf("%-26s %12.1f %10d %12lld\n", g_mode_names[mode], (now - start) / frames, hud.stats().quads, allocations);
+	}
+	ok = check(single, "one draw call per frame") && ok;
+	ok = check(quiet, "no allocations while drawing") && ok;
+	hud.set_number(number_label, "SCORE ", 0);
+
+	// the same HUD drawn by the software backend, retained and laid out anew
+	SoftwareRenderer r;
+	r.init(FRAME_WIDTH, FRAME_HEIGHT);
+	int texture = r.add_texture(font.pixels(), font.width(), font.height());
+	Hud soft;
+	make_hud(soft, font, texture, &number_label);
+
+	std::vector<unsigned int> frames[MODE_NUM];
+	for (int mode = 0; mode < MODE_NUM; mode++)
+	{
+		long long count = 0;
+		double start = bench_now_ns();
+		double now = start;
+		while (now - start < seconds * 1e9 / MODE_NUM || count == 0)
+		{
+			hud_frame(soft, mode, number_label, 0);
+			r.begin(SPRITE_COLOR(255, 0, 0, 48));
+			soft.draw(r);
+			r.flush(NULL);
+			count++;
+			now = bench_now_ns();
+		}
+		printf("software frame, %-21s %9.1f us\n", g_mode_names[mode], (now - start) / count / 1000);
+		frames[mode].assign(r.pixels(), r.pixels() + FRAME_WIDTH * FRAME_HEIGHT);
+	}
+	ok = check(frames[MODE_STATIC] == frames[MODE_RELAYOUT] && frames[MODE_NUMBER] == frames[MODE_RELAYOUT],
+		"retained frames match laid out frames") && ok;
+
+	if (dump)
+		ok = check(save_png(dump, frames[MODE_STATIC].data(), FRAME_WIDTH, FRAME_HEIGHT), "frame saved") && ok;
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,129 @@
+//-----------------------------------------------------------------------------
+// File: bench_jobs.cpp
+//
+// Desc: Scaling of the job system at 1, 2, 4, 8 and 16 threads: a bare
+//       parallel_for over a large entity array, then the whole tick at large
+//       enemy counts. Every thread count must leave the world in exactly the
+//       state the single-threaded run did; the program exits non-zero if not.
+//-----------------------------------------------------------------------------
+#include <stdio.h>
+
+#include "Sim.h"
+#include "JobSystem.h"
+#include "BenchUtil.h"
+
+
+static const int g_threads[] = { 1, 2, 4, 8, 16 };
+#define THREAD_COUNTS (int)(sizeof(g_threads) / sizeof(g_threads[0]))
+
+
+static SimInput scripted_input(long long tick)
+{
+	SimInput input;
+	input.buttons = BUTTON_FIRE | BUTTON_SUPER_FIRE;
+	input.buttons |= ((tick / 40) & 1) ? BUTTON_LEFT : BUTTON_RIGHT;
+	if (tick % 97 == 0)
+		input.buttons |= BUTTON_BOMB;
+	return input;
+}
+
+
+static void move_range(void* data, int begin, int end)
+{
+	move_entities(*(EntityArray*)data, begin, end, 1, 2);
+}
+
+static void bench_parallel_for(int n, double seconds)
+{
+	EntityArray a;
+	a.resize(n, 1);
+
+	printf("parallel_for, move %d entities\n", n);
+	double base = 0;
+	for (int t = 0; t < THREAD_COUNTS; t++)
+	{
+		JobSystem jobs;
+		jobs.start(g_threads[t]);
+
+		long long runs = 0;
+		double start = bench_now_ns();
+		double now = start;
+		while (now - start < seconds * 1e9)
+		{
+			parallel_for(&jobs, n, 16384, move_range, &a);
+			runs++;
+			now = bench_now_ns();
+		}
+		bench_keep(a.y[0]);
+
+		double us = (now - start) / runs / 1000;
+		if (t == 0)
+			base = us;
+		printf("  %2d threads: %9.1f us, speedup %5.2fx\n", g_threads[t], us, base / us);
+	}
+}
+
+
+static bool bench_game(int enemies, double seconds)
+{
+	bool ok = true;
+	unsigned long long expected = 0;
+	double base = 0;
+
+	printf("game, %d enemies\n", enemies);
+	for (int t = 0; t < THREAD_COUNTS; t++)
+	{
+		JobSystem jobs;
+		jobs.start(g_threads[t]);
+
+		World world;
+		init_game(world, enemies, 1);
+		world.jobs = &jobs;
+
+		// a fixed stretch first, for the determinism check
+		long long ticks = 0;
+		for (; ticks < 300; ticks++)
+			do_game_logic(world, scripted_input(ticks));
+		unsigned long long h = world_hash(world);
+		if (t == 0)
+			expected = h;
+
+		long long measured = 0;
+		double start = bench_now_ns();
+		double now = start;
+		while (now - start < seconds * 1e9)
+		{
+			for (int i = 0; i < 4; i++, ticks++, measured++)
+				do_game_logic(world, scripted_input(ticks));
+			now = bench_now_ns();
+		}
+
+		double ms = (now - start) / measured / 1e6;
+		if (t == 0)
+			base = ms;
+		printf("  %2d threads: %7.3f ms/tick, speedup %5.2fx, state %016llx%s\n",
+			g_threads[t], ms, base / ms, h, h == expected ? "" : "  MISMATCH");
+		ok = ok && h == expected;
+	}
+	return ok;
+}
+
+
+int main(int argc, char** argv)
+{
+	double seconds = bench_seconds(argc, argv, 1.0);
+
+	printf("%u hardware threads\n", std::thread::hardware_concurrency());
+	bench_parallel_for(4000000, seconds);
+
+	bool ok = true;
+	ok = bench_game(100000, seconds) && ok;
+	ok = bench_game(1000000, seconds) && ok;
+
+	if (!ok)
+	{
+		printf("the threaded tick did not match the single-threaded one\n");
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,251 @@
+//-----------------------------------------------------------------------------
+// File: bench_kernels.cpp
+//
+// Desc: The game's hot kernels one at a time, at 10, 1k, 100k and 1M items:
+//
+//           enemy_move        move_entities() over the enemy array
+//           bullet_move       ProjectilePool::update() (hero bullets and
+//                             super bullets run the same code)
+//           collide_pair      sphere_collision_check() on n separate pairs
+//           collide_batch     one projectile against n enemies, as the
+//                             game tests each bullet
+//           respawn           bomb_area() over the whole field, so every
+//                             enemy is found and respawned
+//           projectile_spawn  n ProjectilePool::spawn() calls into an empty
+//                             pool, including the clear() that empties it
+//
+//           bench_kernels [--quick] [--json <file>]
+//
+//       Prints ns per item and items per second; --json also saves them as
+//       one JSON object, so two builds can be compared with a script.
+//-----------------------------------------------------------------------------
+#include <float.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+#include "Sim.h"
+#include "Collide.h"
+#include "Cpu.h"
+#include "BenchUtil.h"
+
+// a sample runs the kernel this long at least, so the clock reads stay out
+// of it, and every case takes this many samples at least
+#define SAMPLE_NS 200000.0
+#define MIN_SAMPLES 5
+
+static const int g_sizes[] = { 10, 1000, 100000, 1000000 };
+#define SIZE_NUM (int)(sizeof(g_sizes) / sizeof(g_sizes[0]))
+
+
+static unsigned int g_seed = 777;
+
+static float random_float(float lo, float hi)
+{
+	g_seed = g_seed * 1664525u + 1013904223u;
+	return lo + (hi - lo) * (float)(g_seed >> 8) / 16777216.0f;
+}
+
+
+struct Result {
+	const char* kernel;
+	int n;
+	double ns_per_item;
+	int samples;
+};
+
+
+// median ns per item of run(), which returns how many items it did
+template <typename F>
+static Result measure(const char* kernel, int n, double seconds, F run)
+{
+	long long items = run();
+	int reps = 1;
+	double start = bench_now_ns();
+	while (bench_now_ns() - start < SAMPLE_NS / 4 && reps < (1 << 24))
+	{
+		for (int k = 0; k < reps; k++)
+			items += run();
+		reps *= 2;
+	}
+	reps = std::max(1, reps / 2);
+
+	std::vector<double> per_item;
+	double begin = bench_now_ns();
+	while (bench_now_ns() - begin < seconds * 1e9 || (int)per_item.size() < MIN_SAMPLES)
+	{
+		long long done = 0;
+		double t = bench_now_ns();
+		for (int k = 0; k < reps; k++)
+			done += run();
+		per_item.push_back((bench_now_ns() - t) / std::max(1ll, done));
+		items += done;
+	}
+	bench_keep(items);
+
+	std::sort(per_item.begin(), per_item.end());
+	Result r;
+	r.kernel = kernel;
+	r.n = n;
+	r.ns_per_item = per_item[per_item.size() / 2];
+	r.samples = (int)per_item.size();
+	return r;
+}
+
+
+static Result bench_enemy_move(int n, double seconds)
+{
+	EntityArray enemy;
+	enemy.resize(n, 1);
+	for (int i = 0; i < n; i++)
+	{
+		enemy.x[i] = random_float(0, SCREEN_WIDTH);
+		enemy.y[i] = random_float(-300, SCREEN_HEIGHT);
+	}
+	Result r = measure("enemy_move", n, seconds, [&]() -> long long {
+		move_entities(enemy, 0, ENEMY_SPEED * TICK_SECONDS);
+		return n;
+	});
+	bench_keep(enemy.y[0]);
+	return r;
+}
+
+
+// the bounds are wide open, so nothing retires and every call moves n
+static Result bench_bullet_move(int n, double seconds)
+{
+	ProjectilePool pool;
+	pool.init(n, 0, -FLT_MAX, -FLT_MAX, FLT_MAX, FLT_MAX);
+	for (int i = 0; i < n; i++)
+		pool.spawn(random_float(0, SCREEN_WIDTH), random_float(0, SCREEN_HEIGHT), 0, -BULLET_SPEED);
+	Result r = measure("bullet_move", n, seconds, [&]() -> long long {
+		pool.update(TICK_SECONDS);
+		return pool.count();
+	});
+	bench_keep(pool.y[0]);
+	return r;
+}
+
+
+// pairs spread over a couple of screens, so some hit and some don't
+static Result bench_collide_pair(int n, double seconds)
+{
+	std::vector<float> ax(n), ay(n), bx(n), by(n);
+	for (int i = 0; i < n; i++)
+	{
+		ax[i] = random_float(0, SCREEN_WIDTH);
+		ay[i] = random_float(0, SCREEN_HEIGHT);
+		bx[i] = random_float(0, SCREEN_WIDTH);
+		by[i] = random_float(0, SCREEN_HEIGHT);
+	}
+	long long hits = 0;
+	Result r = measure("collide_pair", n, seconds, [&]() -> long long {
+		for (int i = 0; i < n; i++)
+			hits += sphere_collision_check(ax[i], ay[i], ENTITY_RADIUS, bx[i], by[i], ENTITY_RADIUS);
+		return n;
+	});
+	bench_keep(hits);
+	return r;
+}
+
+
+static Result bench_collide_batch(int n, double seconds)
+{
+	std::vector<float> x(n), y(n);
+	for (int i = 0; i < n; i++)
+	{
+		x[i] = random_float(0, SCREEN_WIDTH);
+		y[i] = random_float(0, SCREEN_HEIGHT);
+	}
+	std::vector<unsigned int> hits(collide_mask_words(n));
+	Result r = measure("collide_batch", n, seconds, [&]() -> long long {
+		collide_circle_batch(SCREEN_WIDTH / 2, SCREEN_HEIGHT / 2, ENTITY_RADIUS * 2, x.data(), y.data(), 0.0f, n, hits.data());
+		return n;
+	});
+	bench_keep(hits[0]);
+	return r;
+}
+
+
+static Result bench_respawn(int n, double seconds)
+{
+	World world;
+	init_game(world, n, 1);
+	return measure("respawn", n, seconds, [&]() -> long long {
+		return bomb_area(world, 0, 0, 1e9f);
+	});
+}
+
+
+static Result bench_projectile_spawn(int n, double seconds)
+{
+	ProjectilePool pool;
+	pool.init(n, 0, -FLT_MAX, -FLT_MAX, FLT_MAX, FLT_MAX);
+	Result r = measure("projectile_spawn", n, seconds, [&]() -> long long {
+		pool.clear();
+		for (int i = 0; i < n; i++)
+			pool.spawn((float)i, 0, 0, -BULLET_SPEED);
+		return pool.count();
+	});
+	bench_keep(pool.x[0]);
+	return r;
+}
+
+
+static bool write_json(const char* path, const std::vector<Result>& results, bool quick)
+{
+	FILE* f = fopen(path, "w");
+	if (!f)
+		return false;
+
+	fprintf(f, "{\n  \"suite\": \"bench_kernels\",\n  \"simd\": \"%s\",\n  \"quick\": %s,\n  \"results\": [\n",
+		simd_level_name(collide_simd_level()), quick ? "true" : "false");
+	for (size_t i = 0; i < results.size(); i++)
+	{
+		const Result& r = results[i];
+		fprintf(f, "    {\"kernel\": \"%s\", \"n\": %d, \"ns_per_op\": %.4f, \"items_per_sec\": %.1f, \"samples\": %d}%s\n",
+			r.kernel, r.n, r.ns_per_item, 1e9 / r.ns_per_item, r.samples, i + 1 < results.size() ? "," : "");
+	}
+	fprintf(f, "  ]\n}\n");
+	return fclose(f) == 0;
+}
+
+
+int main(int argc, char** argv)
+{
+	const char* json = NULL;
+	bool quick = false;
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--json") == 0 && i + 1 < argc)
+			json = argv[++i];
+		else if (strcmp(argv[i], "--quick") == 0)
+			quick = true;
+	}
+	double seconds = bench_seconds(argc, argv, 0.25);
+
+	typedef Result (*Bench)(int n, double seconds);
+	static const Bench benches[] = {
+		bench_enemy_move, bench_bullet_move, bench_collide_pair, bench_collide_batch, bench_respawn, bench_projectile_spawn
+	};
+
+	std::vector<Result> results;
+	printf("%-18s %9s %12s %16s %8s\n", "kernel", "n", "ns/item", "items/s", "samples");
+	for (size_t b = 0; b < sizeof(benches) / sizeof(benches[0]); b++)
+	{
+		for (int s = 0; s < SIZE_NUM; s++)
+		{
+			Result r = benches[b](g_sizes[s], seconds);
+			printf("%-18s %9d %12.3f %16.0f %8d\n", r.kernel, r.n, r.ns_per_item, 1e9 / r.ns_per_item, r.samples);
+			results.push_back(r);
+		}
+	}
+
+	if (json && !write_json(json, results, quick))
+	{
+		fprintf(stderr, "bench_kernels: can't write %s\n", json);
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,282 @@
+//-----------------------------------------------------------------------------
+// File: bench_movescript.cpp
+//
+// Desc: The movement script VM at 100k enemies: batched (one dispatch per
+//       instruction) against one dispatch per enemy, with the enemies all
+//       on one instruction, starting in waves and starting anywhere.
+//
+//           bench_movescript [--quick]
+//
+//       Checks that both VMs move every enemy to exactly the same place,
+//       that the default falling script matches move_entities(), that
+//       broken scripts are rejected with the right line number, that no
+//       program outgrows MOVE_SCRIPT_MAX_OPS and that max_step() bounds how
+//       far a script moves an enemy in a tick. The batched VM must not be
+//       slower than the per-enemy one for any start: their fastest ticks
+//       are compared with BATCH_SLACK left for noise, and a timing a busy
+//       machine spoiled is taken again up to TIMING_TRIES times.
+//-----------------------------------------------------------------------------
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "MoveScript.h"
+#include "Sim.h"
+#include "BenchUtil.h"
+
+#define SCRIPT_ENEMIES 100000
+#define CHECK_TICKS 600
+#define TIMING_TRIES 5
+#define BATCH_SLACK 1.1
+
+static const char* g_script =
+	"# weave in, strafe, dive, catch breath, drift back\n"
+	"weave 60 1.5 40 3\n"
+	"strafe 120 1\n"
+	"dive 30 200 1\n"
+	"wait 0.5\n"
+	"move -60 20 2\n"
+	"loop\n";
+
+
+struct Field {
+	std::vector<float> x, y;
+	MoveState state;
+};
+
+
+// how far into the script each enemy starts
+enum { START_TOGETHER, START_IN_WAVES, START_RANDOM, START_NUM };
+
+static const char* g_start_names[START_NUM] = { "all on one line", "waves of 1000", "random lines" };
+
+
+// n enemies on the script, run ahead by their start
+static void make_field(Field& f, const MoveProgram& program, int n, int start)
+{
+	f.x.resize(n);
+	f.y.resize(n);
+	f.state.resize(n);
+	for (int i = 0; i < n; i++)
+	{
+		f.x[i] = (float)(i % 600);
+		f.y[i] = (float)(i % 400) - 300;
+		start_move_script(program, f.state, i, f.x[i]);
+		unsigned int hash = (unsigned int)i * 2654435761u;
+		int lead = start == START_IN_WAVES ? i / 1000 * 37 % 340 : start == START_RANDOM ? (int)(hash >> 8) % 340 : 0;
+		for (int t = 0; t < lead; t++)
+			run_move_scripts_per_enemy(program, f.state, f.x.data(), f.y.data(), i, i + 1);
+	}
+}
+
+
+static bool compile_fails(const char* source, const char* line)
+{
+	MoveProgram p;
+	return !p.compile(source, TICK_SECONDS) && strncmp(p.error(), line, strlen(line)) == 0;
+}
+
+
+// n timed moves, one per line
+static std::string moves(int n)
+{
+	std::string source;
+	for (int i = 0; i < n; i++)
+		source += "move 0 10 1\n";
+	return source;
+}
+
+
+// a program, however many scripts it was added from, never outgrows
+// MOVE_SCRIPT_MAX_OPS with its END instructions counted
+static bool program_limit()
+{
+	MoveProgram p;
+	if (!p.compile(moves(MOVE_SCRIPT_MAX_OPS - 1).c_str(), TICK_SECONDS) || p.count() != MOVE_SCRIPT_MAX_OPS)
+		return false;
+	if (p.compile(moves(MOVE_SCRIPT_MAX_OPS).c_str(), TICK_SECONDS))
+		return false;
+
+	// one short of full, then scripts that each need two more
+	p.clear();
+	if (p.add(moves(MOVE_SCRIPT_MAX_OPS - 2).c_str(), TICK_SECONDS) < 0 || p.add("move 0 10\n", TICK_SECONDS) >= 0
+		|| p.add("move 0 10\nmove 0 20\n", TICK_SECONDS) >= 0)
+		return false;
+	return p.count() == MOVE_SCRIPT_MAX_OPS - 1;
+}
+
+
+// max_step() is at least every move an enemy makes in a tick, so the grid
+// slack it feeds never misses one, and not much more; an endless dive has
+// no bound
+static bool step_bounds()
+{
+	static const char* sources[] = {
+		g_script,
+		"weave 80 0.5 60\n",
+		"move 300 400 1\ndive 120 900 1\nloop\n",
+		"wait 1\nweave 30 0.25 0 2\nstrafe -50\n",
+	};
+	for (size_t k = 0; k < sizeof(sources) / sizeof(sources[0]); k++)
+	{
+		MoveProgram p;
+		if (!p.compile(sources[k], TICK_SECONDS))
+			return false;
+		const int n = 64;
+		std::vector<float> x(n), y(n);
+		MoveState state;
+		state.resize(n);
+		for (int i = 0; i < n; i++)
+		{
+			start_move_script(p, state, i, 0);
+			for (int t = 0; t < i; t++)
+				run_move_scripts_per_enemy(p, state, x.data(), y.data(), i, i + 1);
+		}
+
+		float most = 0;
+		for (int t = 0; t < 400; t++)
+		{
+			std::vector<float> x0 = x, y0 = y;
+			run_move_scripts(p, state, x.data(), y.data(), 0, n);
+			for (int i = 0; i < n; i++)
+				most = std::max(most, sqrtf((x[i] - x0[i]) * (x[i] - x0[i]) + (y[i] - y0[i]) * (y[i] - y0[i])));
+		}
+		if (most > p.max_step() * 1.0001f + 1e-4f || most < p.max_step() * 0.9f)
+		{
+			printf("script %d: moved %g in a tick, max_step() %g\n", (int)k, most, p.max_step());
+			return false;
+		}
+	}
+
+	MoveProgram dive;
+	return dive.compile("move 0 10 1\ndive 10 100\n", TICK_SECONDS) && dive.max_step() < 0;
+}
+
+
+// ns per enemy per tick, on average and in the fastest tick
+static double measure(const MoveProgram& program, int start_at, bool batched, double seconds, double* best = 0)
+{
+	Field f;
+	make_field(f, program, SCRIPT_ENEMIES, start_at);
+	long long ticks = 0;
+	double fastest = 1e30;
+	double start = bench_now_ns();
+	double now = start;
+	while (now - start < seconds * 1e9 || ticks < 3)
+	{
+		if (batched)
+			run_move_scripts(program, f.state, f.x.data(), f.y.data(), 0, SCRIPT_ENEMIES);
+		else
+			run_move_scripts_per_enemy(program, f.state, f.x.data(), f.y.data(), 0, SCRIPT_ENEMIES);
+		ticks++;
+		double then = now;
+		now = bench_now_ns();
+		fastest = std::min(fastest, now - then);
+	}
+	bench_keep(f.x[SCRIPT_ENEMIES / 2]);
+	if (best)
+		*best = fastest / SCRIPT_ENEMIES;
+	return (now - start) / ticks / SCRIPT_ENEMIES;
+}
+
+
+static double measure_move_entities(double seconds)
+{
+	EntityArray a;
+	a.resize(SCRIPT_ENEMIES, 1);
+	long long ticks = 0;
+	double start = bench_now_ns();
+	double now = start;
+	while (now - start < seconds * 1e9 || ticks < 3)
+	{
+		move_entities(a, 0, ENEMY_SPEED * TICK_SECONDS);
+		ticks++;
+		now = bench_now_ns();
+	}
+	bench_keep(a.y[0]);
+	return (now - start) / ticks / SCRIPT_ENEMIES;
+}
+
+
+int main(int argc, char** argv)
+{
+	double seconds = bench_seconds(argc, argv, 0.5);
+	bool ok = true;
+
+	MoveProgram program;
+	if (!program.compile(g_script, TICK_SECONDS))
+	{
+		printf("script: %s\n", program.error());
+		return 1;
+	}
+	printf("script: %d instructions\n", program.count());
+
+	ok = check(compile_fails("move 0 80\nwiggle 3\n", "line 2:"), "unknown instruction rejected") && ok;
+	ok = check(compile_fails("wait\n", "line 1:"), "wait without seconds rejected") && ok;
+	ok = check(compile_fails("# nothing yet\nloop\n", "line 2:"), "loop before any movement rejected") && ok;
+	ok = check(compile_fails("move 0 80 x\n", "line 1:"), "bad number rejected") && ok;
+	ok = check(compile_fails("weave 10 0 80\n", "line 1:"), "zero weave period rejected") && ok;
+	ok = check(program_limit(), "program capped at MOVE_SCRIPT_MAX_OPS") && ok;
+	ok = check(step_bounds(), "max_step() bounds every tick's move") && ok;
+
+	// both VMs from the same start, for every kind of start
+	bool same = true;
+	for (int start = 0; start < START_NUM; start++)
+	{
+		Field a, b;
+		make_field(a, program, SCRIPT_ENEMIES, start);
+		make_field(b, program, SCRIPT_ENEMIES, start);
+		for (int t = 0; t < CHECK_TICKS; t++)
+		{
+			run_move_scripts(program, a.state, a.x.data(), a.y.data(), 0, SCRIPT_ENEMIES);
+			run_move_scripts_per_enemy(program, b.state, b.x.data(), b.y.data(), 0, SCRIPT_ENEMIES);
+		}
+		same = same && a.x == b.x && a.y == b.y && a.state.pc == b.state.pc && a.state.ticks == b.state.ticks;
+	}
+	ok = check(same, "batched VM matches the per-enemy VM") && ok;
+
+	// the script the game starts with against the loop it replaced
+	MoveProgram fall;
+	char source[64];
+	sprintf(source, "move 0 %g\n", ENEMY_SPEED);
+	fall.compile(source, TICK_SECONDS);
+	Field c;
+	make_field(c, fall, SCRIPT_ENEMIES, START_TOGETHER);
+	EntityArray plain;
+	plain.resize(SCRIPT_ENEMIES, 1);
+	plain.x = c.x;
+	plain.y = c.y;
+	for (int t = 0; t < CHECK_TICKS; t++)
+	{
+		run_move_scripts(fall, c.state, c.x.data(), c.y.data(), 0, SCRIPT_ENEMIES);
+		move_entities(plain, 0, ENEMY_SPEED * TICK_SECONDS);
+	}
+	ok = check(c.x == plain.x && c.y == plain.y, "falling script matches move_entities") && ok;
+
+	printf("\n%d enemies, ns per enemy per tick:\n", SCRIPT_ENEMIES);
+	printf("%-34s %10s %10s %12s\n", "", "batched", "per enemy", "us per tick");
+	bool faster = true;
+	for (int start = 0; start < START_NUM; start++)
+	{
+		double batched_best, each_best;
+		double batched = measure(program, start, true, seconds, &batched_best);
+		double each = measure(program, start, false, seconds, &each_best);
+		printf("script, %-26s %10.2f %10.2f %12.1f\n", g_start_names[start], batched, each, batched * SCRIPT_ENEMIES / 1000);
+		for (int tries = 1; batched_best > each_best * BATCH_SLACK && tries < TIMING_TRIES; tries++)
+		{
+			measure(program, start, true, seconds, &batched_best);
+			measure(program, start, false, seconds, &each_best);
+		}
+		faster = faster && batched_best <= each_best * BATCH_SLACK;
+	}
+	double falling = measure(fall, START_TOGETHER, true, seconds);
+	printf("%-34s %10.2f %10s %12.1f\n", "falling script", falling, "", falling * SCRIPT_ENEMIES / 1000);
+	double plain_ns = measure_move_entities(seconds);
+	printf("%-34s %10.2f %10s %12.1f\n", "move_entities", plain_ns, "", plain_ns * SCRIPT_ENEMIES / 1000);
+	printf("\n");
+	ok = check(faster, "batched VM not slower than the per-enemy VM") && ok;
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,366 @@
+//-----------------------------------------------------------------------------
+// File: bench_particles.cpp
+//
+// Desc: The particle pool at 200k live particles: the step kernel on its
+//       own for every SIMD path, a whole update with a thirtieth of the
+//       particles burning out every tick and as many emitted again, and
+//       building their draw.
+//
+//           bench_particles [--quick]
+//
+//       Checks that every SIMD path moves every particle to exactly the same
+//       place and finds the same dead ones as the scalar kernel, that an
+//       update keeps exactly the live particles packed, that a 200k update
+//       takes under 2 ms on one core, that the particles go out as one
+//       texture run, and that a game emitting effects allocates nothing.
+//-----------------------------------------------------------------------------
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <new>
+#include <vector>
+
+#include "Cpu.h"
+#include "Particles.h"
+#include "Rng.h"
+#include "WorldSprites.h"
+#include "BenchUtil.h"
+
+#define BENCH_PARTICLES 200000
+#define BUDGET_MS 2.0
+#define GAME_ENEMIES 2000
+#define GAME_PARTICLES 16384
+
+
+static long long g_allocations = 0;
+
+void* operator new(size_t size)
+{
+	g_allocations++;
+	void* p = malloc(size ? size : 1);
+	if (!p)
+		throw std::bad_alloc();
+	return p;
+}
+
+void operator delete(void* p) noexcept
+{
+	free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+	free(p);
+}
+
+
+struct Arrays {
+	std::vector<float> x, y, vx, vy, life;
+};
+
+
+// particles anywhere, some with exactly one step of life left and some
+// already out
+static void make_arrays(Arrays& a, int n, float dt, Rng& rng)
+{
+	a.x.resize(n);
+	a.y.resize(n);
+	a.vx.resize(n);
+	a.vy.resize(n);
+	a.life.resize(n);
+	for (int i = 0; i < n; i++)
+	{
+		a.x[i] = rng.uniform(-100, 700);
+		a.y[i] = rng.uniform(-100, 600);
+		a.vx[i] = rng.uniform(-300, 300);
+		a.vy[i] = rng.uniform(-300, 300);
+		a.life[i] = i % 7 == 0 ? dt : i % 11 == 0 ? 0.0f : rng.uniform(-0.1f, 0.5f);
+	}
+}
+
+
+static bool same(const std::vector<float>& a, const std::vector<float>& b)
+{
+	return a.size() == b.size() && (a.empty() || memcmp(a.data(), b.data(), a.size() * sizeof(float)) == 0);
+}
+
+
+static bool verify(int level)
+{
+	particles_set_simd_level(level);
+	Rng rng(25, 0);
+	ParticleStep step = { 1.0f / 40, 0.98f, 12.5f };
+	Arrays ref, got;
+	std::vector<int> ref_dead, got_dead;
+
+	for (int n = 0; n <= 300; n++)
+	{
+		make_arrays(ref, n, step.dt, rng);
+		got = ref;
+		ref_dead.assign(n + 1, -1);
+		got_dead.assign(n + 1, -1);
+		int ref_count = step_particles_scalar(ref.x.data(), ref.y.data(), ref.vx.data(), ref.vy.data(), ref.life.data(), n,
+			step, ref_dead.data());
+		int got_count = step_particles(got.x.data(), got.y.data(), got.vx.data(), got.vy.data(), got.life.data(), n,
+			step, got_dead.data());
+		if (got_count != ref_count || !std::equal(ref_dead.begin(), ref_dead.begin() + ref_count, got_dead.begin())
+			|| got_dead[n] != -1 || !same(ref.x, got.x) || !same(ref.y, got.y) || !same(ref.vx, got.vx)
+			|| !same(ref.vy, got.vy) || !same(ref.life, got.life))
+		{
+			printf("verify %-6s FAILED: n=%d\n", simd_level_name(level), n);
+			return false;
+		}
+	}
+	printf("verify %-6s ok\n", simd_level_name(level));
+	return true;
+}
+
+
+// each particle carries its number in its color; after an update the live
+// ones are packed, every one of them is exactly where the scalar kernel
+// puts it and none of the burnt out ones is left
+static bool compaction()
+{
+	ParticleSystem p;
+	p.init(5000, 300.0f, 0.5f, 1);
+	ParticleBurst burst = { 1, 10.0f, 200.0f, 0.0f, 0.3f, 0 };
+	for (int i = 0; i < 5000; i++)
+	{
+		burst.color = (unsigned int)i;
+		p.emit(burst, (float)(i % 640), (float)(i % 480));
+	}
+
+	for (int round = 0; round < 20; round++)
+	{
+		int n = p.count();
+		Arrays expect;
+		expect.x.assign(p.x.begin(), p.x.begin() + n);
+		expect.y.assign(p.y.begin(), p.y.begin() + n);
+		expect.vx.assign(p.vx.begin(), p.vx.begin() + n);
+		expect.vy.assign(p.vy.begin(), p.vy.begin() + n);
+		expect.life.assign(p.life.begin(), p.life.begin() + n);
+		std::vector<unsigned int> ids(p.color.begin(), p.color.begin() + n);
+		std::vector<int> dead(n);
+		ParticleStep step = { 1.0f / 40, powf(0.5f, 1.0f / 40), 300.0f / 40 };
+		step_particles_scalar(expect.x.data(), expect.y.data(), expect.vx.data(), expect.vy.data(), expect.life.data(), n,
+			step, dead.data());
+
+		// where each number should be, or -1 once it burnt out
+		std::vector<int> where(5000, -1);
+		int survivors = 0;
+		for (int i = 0; i < n; i++)
+		{
+			if (expect.life[i] > 0)
+			{
+				where[ids[i]] = i;
+				survivors++;
+			}
+		}
+
+		p.update(1.0f / 40);
+		if (p.count() != survivors)
+			return false;
+		for (int i = 0; i < p.count(); i++)
+		{
+			int k = where[p.color[i]];
+			if (k < 0 || p.x[i] != expect.x[k] || p.y[i] != expect.y[k] || p.vx[i] != expect.vx[k]
+				|| p.vy[i] != expect.vy[k] || p.life[i] != expect.life[k])
+				return false;
+			where[p.color[i]] = -1;
+		}
+	}
+	return p.count() == 0;
+}
+
+
+// a pool kept at BENCH_PARTICLES: lives of 0.5 to 1 second at 40 ticks a
+// second burn out about a thirtieth of it each tick, and each burst puts
+// back what went
+static void fill(ParticleSystem& p)
+{
+	p.init(BENCH_PARTICLES, 300.0f, 0.5f, 1);
+	ParticleBurst burst = { 64, 20.0f, 240.0f, 0.5f, 1.0f, 0xffa030 };
+	while (p.emit(burst, (float)(p.count() % SCREEN_WIDTH), (float)(p.count() % SCREEN_HEIGHT)) > 0)
+		;
+	// spread the ages out before measuring
+	for (int t = 0; t < 40; t++)
+	{
+		p.update(TICK_SECONDS);
+		while (p.emit(burst, (float)(t * 13 % SCREEN_WIDTH), (float)(t * 7 % SCREEN_HEIGHT)) > 0)
+			;
+	}
+}
+
+
+// ms per update of the full pool, and per update plus the emits refilling it
+static void measure_update(double seconds, double& update_ms, double& refill_ms)
+{
+	ParticleSystem p;
+	fill(p);
+	ParticleBurst burst = { 64, 20.0f, 240.0f, 0.5f, 1.0f, 0xffa030 };
+
+	double updating = 0, refilling = 0;
+	long long updates = 0;
+	double start = bench_now_ns();
+	double now = start;
+	while (now - start < seconds * 1e9 || updates < 10)
+	{
+		double t0 = bench_now_ns();
+		p.update(TICK_SECONDS);
+		double t1 = bench_now_ns();
+		while (p.emit(burst, (float)(updates * 13 % SCREEN_WIDTH), (float)(updates * 7 % SCREEN_HEIGHT)) > 0)
+			;
+		now = bench_now_ns();
+		updating += t1 - t0;
+		refilling += now - t1;
+		updates++;
+	}
+	bench_keep(p.x[0]);
+	update_ms = updating / updates / 1e6;
+	refill_ms = (updating + refilling) / updates / 1e6;
+}
+
+
+// ns per particle for the kernel alone, with nothing dying
+static double measure_kernel(double seconds)
+{
+	Rng rng(3, 0);
+	Arrays a;
+	make_arrays(a, BENCH_PARTICLES, 0, rng);
+	for (int i = 0; i < BENCH_PARTICLES; i++)
+		a.life[i] = 1e30f;
+	std::vector<int> dead(BENCH_PARTICLES);
+	ParticleStep step = { 1e-6f, 1.0f, 0.0f };
+
+	long long runs = 0;
+	double start = bench_now_ns();
+	double now = start;
+	while (now - start < seconds * 1e9 || runs < 3)
+	{
+		bench_keep(step_particles(a.x.data(), a.y.data(), a.vx.data(), a.vy.data(), a.life.data(), BENCH_PARTICLES, step,
+			dead.data()));
+		runs++;
+		now = bench_now_ns();
+	}
+	return (now - start) / runs / BENCH_PARTICLES;
+}
+
+
+// counts what it is asked to draw and reads every vertex, as an upload would
+class CountingBackend : public SpriteBackend {
+
+public:
+	CountingBackend() : quads(0), sum(0) {}
+
+	void draw(int, const SpriteVertex* vertices, int n, const unsigned short*)
+	{
+		quads += n;
+		for (int i = 0; i < 4 * n; i++)
+			sum += vertices[i].x;
+	}
+
+	int quads;
+	float sum;
+};
+
+
+// the full pool into a batch and through it; true if it went out as one
+// texture run
+static bool measure_draw(double seconds)
+{
+	ParticleSystem p;
+	fill(p);
+	SpriteBatch batch;
+	batch.init(BENCH_PARTICLES, 0.0f);
+	SpriteFrame frame = { 0, 8, 8, 0, 0, 1, 1 };
+	CountingBackend backend;
+
+	long long frames = 0;
+	double list = 0;
+	double start = bench_now_ns();
+	double now = start;
+	while (now - start < seconds * 1e9 || frames < 3)
+	{
+		double t0 = bench_now_ns();
+		batch.begin();
+		draw_particles(p, frame, SPRITE_KIND_NUM, true, batch);
+		list += bench_now_ns() - t0;
+		batch.end(backend);
+		frames++;
+		now = bench_now_ns();
+	}
+	bench_keep(backend.sum);
+
+	const SpriteStats& s = batch.stats();
+	printf("draw of %d particles: %.2f ms draw list, %.2f ms with sort and vertices, %d draw calls, %d texture switches\n",
+		p.count(), list / frames / 1e6, (now - start) / frames / 1e6, s.draw_calls, s.texture_switches);
+	return s.quads == p.count() && s.texture_switches == 1
+		&& s.draw_calls == (p.count() + SPRITE_DRAW_QUADS - 1) / SPRITE_DRAW_QUADS;
+}
+
+
+// a game at GAME_ENEMIES enemies with the hero firing and bombing, its
+// events turned into effects every tick
+static bool game_effects()
+{
+	World world;
+	init_game(world, GAME_ENEMIES, 1);
+	ParticleSystem particles;
+	particles.init(GAME_PARTICLES, 300.0f, 0.5f, 1);
+	SimInput input;
+	input.buttons = BUTTON_FIRE | BUTTON_SUPER_FIRE | BUTTON_LEFT;
+
+	// the first tick builds the tick graph
+	do_game_logic(world, input);
+	long long allocations = g_allocations;
+	long long events = 0;
+	int most = 0;
+	for (int t = 0; t < 20 * TICK_RATE; t++)
+	{
+		input.buttons = BUTTON_FIRE | BUTTON_SUPER_FIRE | (t % 200 < 100 ? BUTTON_LEFT : BUTTON_RIGHT)
+			| (t % 80 == 0 ? BUTTON_BOMB : 0);
+		do_game_logic(world, input);
+		emit_effects(world, particles);
+		particles.update(TICK_SECONDS);
+		events += world.events.size();
+		most = std::max(most, particles.count());
+	}
+	allocations = g_allocations - allocations;
+
+	printf("%d enemies, 20 s: %lld events, up to %d particles, %lld allocations\n", GAME_ENEMIES, events, most, allocations);
+	return events > 0 && most > 0 && allocations == 0;
+}
+
+
+int main(int argc, char** argv)
+{
+	double seconds = bench_seconds(argc, argv, 0.5);
+	int best = cpu_simd_level();
+	bool ok = true;
+
+	for (int level = SIMD_SCALAR; level <= best; level++)
+		ok = verify(level) && ok;
+	particles_set_simd_level(best);
+	ok = check(compaction(), "update keeps exactly the live particles") && ok;
+
+	printf("\n%d particles:\n%-8s %14s %14s %18s\n", BENCH_PARTICLES, "isa", "kernel", "update", "update + refill");
+	double best_ms = 0;
+	for (int level = SIMD_SCALAR; level <= best; level++)
+	{
+		particles_set_simd_level(level);
+		double update_ms, refill_ms;
+		double kernel_ns = measure_kernel(seconds / 3);
+		measure_update(seconds, update_ms, refill_ms);
+		printf("%-8s %8.2f ns/p %11.3f ms %15.3f ms\n", simd_level_name(level), kernel_ns, update_ms, refill_ms);
+		best_ms = update_ms;
+	}
+	particles_set_simd_level(best);
+	ok = check(best_ms < BUDGET_MS, "200k particle update under 2 ms") && ok;
+
+	printf("\n");
+	ok = check(measure_draw(seconds), "particles drawn as one texture run") && ok;
+	ok = check(game_effects(), "game effects allocate nothing") && ok;
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,107 @@
+//-----------------------------------------------------------------------------
+// File: bench_profile.cpp
+//
+// Desc: Cost of a profiling zone, and the zones of a few seconds of play.
+//
+//           bench_profile [--quick] [--trace <file.json>]
+//
+//       Times empty PROFILE_SCOPE blocks against an empty loop and reports
+//       what a zone costs, also as a multiple of the two clock reads it
+//       makes; the target is under 50 ns, but a wall-clock number on a
+//       loaded machine is no pass/fail. Then runs the game with 1000
+//       enemies, prints the per-zone summary and, with --trace, saves the
+//       Chrome trace; it fails only if the trace can't be written.
+//-----------------------------------------------------------------------------
+#include <chrono>
+#include <stdio.h>
+#include <string.h>
+
+#include "Profiler.h"
+#include "Sim.h"
+#include "BenchUtil.h"
+
+#define ZONE_TARGET_NS 50.0
+#define PLAY_ENEMIES 1000
+#define PLAY_TICKS (5 * TICK_RATE)
+
+
+static volatile int g_sink;
+
+
+// nanoseconds per iteration of n empty zones, or of n bare iterations
+static double loop_ns(long long n, bool zoned)
+{
+	double start = bench_now_ns();
+	for (long long i = 0; i < n; i++)
+	{
+		if (zoned)
+		{
+			PROFILE_SCOPE("empty");
+			g_sink = (int)i;
+		}
+		else
+			g_sink = (int)i;
+	}
+	return (bench_now_ns() - start) / n;
+}
+
+
+static double steady_clock_ns(long long n)
+{
+	double start = bench_now_ns();
+	long long sum = 0;
+	for (long long i = 0; i < n; i++)
+		sum += std::chrono::steady_clock::now().time_since_epoch().count();
+	bench_keep(sum);
+	return (bench_now_ns() - start) / n;
+}
+
+
+int main(int argc, char** argv)
+{
+	double seconds = bench_seconds(argc, argv, 1.0);
+	const char* trace = NULL;
+	for (int i = 1; i + 1 < argc; i++)
+	{
+		if (strcmp(argv[i], "--trace") == 0)
+			trace = argv[i + 1];
+	}
+	bool ok = true;
+
+	// size the loops to the time allowed, then take the best of a few
+	long long n = 1000;
+	while (loop_ns(n, true) * n < seconds * 1e9 / 20 && n < (1ll << 40))
+		n *= 2;
+	double bare = 1e30, zoned = 1e30;
+	for (int rep = 0; rep < 5; rep++)
+	{
+		bare = std::min(bare, loop_ns(n, false));
+		zoned = std::min(zoned, loop_ns(n, true));
+	}
+	double zone = zoned - bare;
+	double now_ns = steady_clock_ns(n / 4 + 1);
+	printf("clock: %s, %.3f ns per tick\n", PROFILE_TSC ? "rdtsc" : "steady_clock", profile_tick_ns());
+	printf("one zone: %.1f ns (loop %.1f ns bare, %.1f ns zoned; steady_clock::now() alone %.1f ns)\n",
+		zone, bare, zoned, now_ns);
+	printf("one zone: %.2fx two steady_clock::now() calls, %s the %.0f ns target\n", zone / (2 * now_ns),
+		zone < ZONE_TARGET_NS ? "under" : "OVER", ZONE_TARGET_NS);
+
+	// a few seconds of play, on every core
+	profile_reset();
+	JobSystem jobs;
+	jobs.start(0);
+	World world;
+	init_game(world, PLAY_ENEMIES, 1);
+	world.jobs = &jobs;
+	SimInput input;
+	input.buttons = BUTTON_FIRE | BUTTON_SUPER_FIRE | BUTTON_LEFT;
+	for (int t = 0; t < PLAY_TICKS; t++)
+		do_game_logic(world, input);
+
+	printf("\n%d ticks, %d enemies, %d threads:\n", PLAY_TICKS, PLAY_ENEMIES, jobs.thread_count());
+	profile_print_summary(stdout);
+
+	if (trace)
+		ok = check(profile_write_trace(trace), "trace written") && ok;
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,118 @@
+//-----------------------------------------------------------------------------
+// File: bench_projectiles.cpp
+//
+// Desc: Spawn/despawn cost of ProjectilePool, and the full tick with the
+//       pools saturated. Counts heap allocations while ticking and exits
+//       non-zero if the game logic allocated anything after init_game().
+//-----------------------------------------------------------------------------
+#include <stdio.h>
+#include <stdlib.h>
+#include <new>
+
+#include "Sim.h"
+#include "ProjectilePool.h"
+#include "BenchUtil.h"
+
+
+static long long g_allocations = 0;
+
+void* operator new(size_t size)
+{
+	g_allocations++;
+	void* p = malloc(size ? size : 1);
+	if (!p)
+		throw std::bad_alloc();
+	return p;
+}
+
+void operator delete(void* p) noexcept
+{
+	free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+	free(p);
+}
+
+
+static void bench_churn(double seconds)
+{
+	ProjectilePool pool;
+	pool.init(4096, 0, -1e9f, -1e9f, 1e9f, 1e9f);
+	for (int i = 0; i < 2048; i++)
+		pool.spawn((float)i, 0, 0, 1);
+
+	// keep the pool half full: kill one at a pseudo-random index, spawn one
+	unsigned int seed = 1;
+	long long ops = 0;
+	double start = bench_now_ns();
+	double now = start;
+	while (now - start < seconds * 1e9)
+	{
+		for (int k = 0; k < 1024; k++)
+		{
+			seed = seed * 1664525u + 1013904223u;
+			pool.despawn_at((int)((seed >> 8) % (unsigned int)pool.count()));
+			pool.spawn((float)k, 0, 0, 1);
+		}
+		ops += 1024;
+		now = bench_now_ns();
+	}
+	bench_keep(pool.x[0]);
+	printf("pool churn: %.1f ns per despawn+spawn\n", (now - start) / ops);
+}
+
+
+static bool bench_game(int enemies, double seconds)
+{
+	World world;
+	init_game(world, enemies, 1);
+
+	SimInput input;
+	input.buttons = BUTTON_FIRE | BUTTON_SUPER_FIRE;
+
+	// fill the pools before measuring
+	for (int i = 0; i < 200; i++)
+		do_game_logic(world, input);
+
+	long long allocations = g_allocations;
+	long long ticks = 0;
+	double start = bench_now_ns();
+	double now = start;
+	while (now - start < seconds * 1e9)
+	{
+		for (int i = 0; i < 8; i++, ticks++)
+			do_game_logic(world, input);
+		now = bench_now_ns();
+	}
+	allocations = g_allocations - allocations;
+
+	printf("%8d enemies: %9.1f us/tick, live bullets %d/%d super %d/%d enemy %d/%d, %lld allocations\n",
+		enemies, (now - start) / ticks / 1000,
+		world.bullet.count(), world.bullet.capacity(),
+		world.super_bullet.count(), world.super_bullet.capacity(),
+		world.enemy_bullet.count(), world.enemy_bullet.capacity(),
+		allocations);
+	return allocations == 0;
+}
+
+
+int main(int argc, char** argv)
+{
+	double seconds = bench_seconds(argc, argv, 0.5);
+
+	bench_churn(seconds);
+
+	bool ok = true;
+	ok = bench_game(ENEMY_NUM, seconds) && ok;
+	ok = bench_game(1000, seconds) && ok;
+	ok = bench_game(100000, seconds) && ok;
+
+	if (!ok)
+	{
+		printf("the game logic allocated after init_game()\n");
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,231 @@
+//-----------------------------------------------------------------------------
+// File: bench_raster.cpp
+//
+// Desc: The software sprite backend: frames per second at 10, 1000 and
+//       100000 sprites on a 640x480 frame, scalar against SSE2 blending and
+//       one thread against every thread.
+//
+//           bench_raster [--quick] [--dump <file>] [--golden <file.ppm>]
+//
+//       Also draws a game frame (the world after a few seconds of play,
+//       with generated stand-ins for the sprite images) and checks that it
+//       comes out the same on every SIMD path and thread count. --dump
+//       saves that frame (.png or .ppm), --golden compares it with a saved
+//       PPM; exits non-zero on any difference.
+//-----------------------------------------------------------------------------
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+#include "Cpu.h"
+#include "ImageFile.h"
+#include "Rng.h"
+#include "SoftRaster.h"
+#include "WorldSprites.h"
+#include "BenchUtil.h"
+
+#define FRAME_ENEMIES 1000
+
+
+// a shaded ball with a soft edge, size x size in the top-left corner of a
+// tex_size x tex_size texture; the rest is clear
+static std::vector<unsigned int> ball_texture(int tex_size, int size, unsigned int rgb)
+{
+	std::vector<unsigned int> t((size_t)tex_size * tex_size, 0);
+	float r = size * 0.5f;
+	for (int y = 0; y < size; y++)
+	{
+		for (int x = 0; x < size; x++)
+		{
+			float dx = x + 0.5f - r, dy = y + 0.5f - r;
+			float d = sqrtf(dx * dx + dy * dy);
+			float a = r - d;
+			if (a <= 0)
+				continue;
+			a = a > 1.5f ? 1.0f : a / 1.5f;
+			float shade = 1.0f - 0.5f * d / r;
+			unsigned int cr = (unsigned int)(((rgb >> 16) & 0xff) * shade);
+			unsigned int cg = (unsigned int)(((rgb >> 8) & 0xff) * shade);
+			unsigned int cb = (unsigned int)((rgb & 0xff) * shade);
+			t[(size_t)y * tex_size + x] = ((unsigned int)(a * 255) << 24) | (cr << 16) | (cg << 8) | cb;
+		}
+	}
+	return t;
+}
+
+
+static void load_textures(SoftwareRenderer& r, SpriteFrame* frames)
+{
+	struct Look { int size; int tex_size; unsigned int rgb; };
+	static const Look looks[SPRITE_KIND_NUM] = {
+		{ 64, 64, 0x40a0ff },     // hero
+		{ 64, 64, 0xffff60 },     // bullet
+		{ 100, 128, 0xff60ff },   // super bullet
+		{ 64, 64, 0x60ff60 },     // enemy
+		{ 100, 128, 0xff60ff },   // boss, the super bullet's texture
+		{ 64, 64, 0xff4040 },     // enemy bullet
+	};
+
+	for (int k = 0; k < SPRITE_KIND_NUM; k++)
+	{
+		const Look& l = looks[k];
+		int id = k == SPRITE_BOSS ? frames[SPRITE_SUPER_BULLET].texture
+			: r.add_texture(ball_texture(l.tex_size, l.size, l.rgb).data(), l.tex_size, l.tex_size);
+		SpriteFrame f = { id, (float)l.size, (float)l.size, 0, 0, (float)l.size / l.tex_size, (float)l.size / l.tex_size };
+		frames[k] = f;
+	}
+}
+
+
+static unsigned long long frame_hash(const SoftwareRenderer& r)
+{
+	unsigned long long h = 14695981039346656037ull;
+	const unsigned char* p = (const unsigned char*)r.pixels();
+	for (size_t i = 0; i < (size_t)r.width() * r.height() * 4; i++)
+		h = (h ^ p[i]) * 1099511628211ull;
+	return h;
+}
+
+
+static void render_world(const World& world, const SpriteFrame* frames, SpriteBatch& batch, SoftwareRenderer& r, JobSystem* jobs)
+{
+	r.begin(0);
+	batch.begin();
+	draw_world(world, frames, batch);
+	batch.end(r);
+	r.flush(jobs);
+}
+
+
+static bool check_world_frame(SpriteBatch& batch, SoftwareRenderer& r, const SpriteFrame* frames, JobSystem& jobs,
+	const char* dump, const char* golden)
+{
+	bool ok = true;
+
+	World world;
+	init_game(world, FRAME_ENEMIES, 1);
+	SimInput input;
+	input.buttons = BUTTON_FIRE | BUTTON_SUPER_FIRE | BUTTON_LEFT;
+	for (int i = 0; i < 3 * TICK_RATE; i++)
+		do_game_logic(world, input);
+
+	r.set_simd_level(SIMD_SCALAR);
+	render_world(world, frames, batch, r, NULL);
+	unsigned long long reference = frame_hash(r);
+
+	bool same = true;
+	for (int level = SIMD_SCALAR; level <= SIMD_SSE2; level++)
+	{
+		r.set_simd_level(level);
+		render_world(world, frames, batch, r, NULL);
+		same = same && frame_hash(r) == reference;
+		render_world(world, frames, batch, r, &jobs);
+		same = same && frame_hash(r) == reference;
+	}
+	r.set_simd_level(cpu_simd_level());
+	printf("game frame: %d sprites, %016llx\n", batch.stats().quads, reference);
+	ok = check(same, "same frame on every SIMD path and thread count") && ok;
+
+	if (dump)
+	{
+		size_t n = strlen(dump);
+		bool png = n > 4 && strcmp(dump + n - 4, ".png") == 0;
+		bool saved = png ? save_png(dump, r.pixels(), r.width(), r.height()) : save_ppm(dump, r.pixels(), r.width(), r.height());
+		ok = check(saved, "frame saved") && ok;
+	}
+
+	if (golden)
+	{
+		std::vector<unsigned int> expected;
+		int w, h;
+		int differ = -1;
+		if (load_ppm(golden, expected, w, h) && w == r.width() && h == r.height())
+		{
+			differ = 0;
+			for (size_t i = 0; i < expected.size(); i++)
+				differ += (expected[i] & 0xffffff) != (r.pixels()[i] & 0xffffff);
+		}
+		printf("golden image: %d pixels differ\n", differ);
+		ok = check(differ == 0, "frame matches the golden image") && ok;
+	}
+	return ok;
+}
+
+
+struct Placed {
+	int kind;
+	float x, y;
+};
+
+
+int main(int argc, char** argv)
+{
+	double seconds = bench_seconds(argc, argv, 1.0);
+	const char* dump = NULL;
+	const char* golden = NULL;
+	for (int i = 1; i + 1 < argc; i++)
+	{
+		if (strcmp(argv[i], "--dump") == 0)
+			dump = argv[i + 1];
+		else if (strcmp(argv[i], "--golden") == 0)
+			golden = argv[i + 1];
+	}
+
+	JobSystem jobs;
+	jobs.start(0);
+
+	SoftwareRenderer r;
+	r.init(SCREEN_WIDTH, SCREEN_HEIGHT);
+	SpriteFrame frames[SPRITE_KIND_NUM];
+	load_textures(r, frames);
+
+	static const int counts[] = { 10, 1000, 100000 };
+	SpriteBatch batch;
+	batch.init(counts[2] > world_sprite_capacity(FRAME_ENEMIES) ? counts[2] : world_sprite_capacity(FRAME_ENEMIES), 0.0f);
+
+	bool ok = check_world_frame(batch, r, frames, jobs, dump, golden);
+
+	// sprites scattered over the screen, some hanging off the edges
+	Rng rng(11, 11);
+	std::vector<Placed> placed(counts[2]);
+	for (size_t i = 0; i < placed.size(); i++)
+	{
+		placed[i].kind = (int)rng.below(SPRITE_KIND_NUM);
+		placed[i].x = rng.uniform(-50.0f, SCREEN_WIDTH - 50.0f);
+		placed[i].y = rng.uniform(-50.0f, SCREEN_HEIGHT - 50.0f);
+	}
+
+	printf("%-10s %-8s %8s %12s\n", "sprites", "blend", "threads", "frames/sec");
+	for (int c = 0; c < 3; c++)
+	{
+		int n = counts[c];
+		for (int level = SIMD_SCALAR; level <= SIMD_SSE2; level++)
+		{
+			for (int threaded = 0; threaded < 2; threaded++)
+			{
+				r.set_simd_level(level);
+				JobSystem* j = threaded ? &jobs : NULL;
+				long long rendered = 0;
+				double start = bench_now_ns();
+				double now = start;
+				while (now - start < seconds * 1e9 / 4 || rendered == 0)
+				{
+					r.begin(0);
+					batch.begin();
+					for (int i = 0; i < n; i++)
+						batch.add(frames[placed[i].kind], placed[i].kind, 0, placed[i].x, placed[i].y, SPRITE_WHITE);
+					batch.end(r);
+					r.flush(j);
+					rendered++;
+					now = bench_now_ns();
+				}
+				printf("%-10d %-8s %8d %12.1f\n", n, simd_level_name(r.simd_level()), threaded ? jobs.thread_count() : 1,
+					rendered / ((now - start) / 1e9));
+			}
+		}
+	}
+
+	bench_keep(r.pixels()[0]);
+	return ok ? 0 : 1;
+}
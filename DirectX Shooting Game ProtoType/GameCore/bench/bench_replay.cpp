@@ -0,0 +1,252 @@
+//-----------------------------------------------------------------------------
+// File: bench_replay.cpp
+//
+// Desc: Replays recorded sessions headless at full speed.
+//
+//           bench_replay [--quick]          record a scripted hour (three
+//                                           minutes with --quick), then
+//                                           replay it and check the result
+//           bench_replay <file> [threads]   replay a recording from the game
+//
+//       The scripted run plays with a movement script and a stage, as the
+//       game does. It exits non-zero if the replay does not end in exactly
+//       the state the live run did, if it still starts once the script
+//       it was recorded with has changed, or if a file asking for no enemies
+//       or more than REPLAY_MAX_ENEMIES opens.
+//-----------------------------------------------------------------------------
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "Sim.h"
+#include "Replay.h"
+#include "Stage.h"
+#include "BenchUtil.h"
+
+#define SESSION_FILE "bench_replay.rep"
+#define SESSION_SCRIPT "bench_replay.move"
+#define SESSION_STAGE "bench_replay.stage"
+#define BAD_FILE "bench_replay_bad.rep"
+#define SESSION_ENEMIES 1000
+
+static const char* g_script =
+	"move 0 60 1\n"
+	"weave 40 2 80\n";
+
+
+// a player who changes what they hold every half second or so
+static SimInput scripted_input(unsigned int& seed, SimInput last)
+{
+	seed = seed * 1664525u + 1013904223u;
+	if ((seed >> 24) % 20 != 0)
+		return last;
+
+	SimInput input;
+	input.buttons = (seed >> 8) & (BUTTON_UP | BUTTON_DOWN | BUTTON_LEFT | BUTTON_RIGHT | BUTTON_FIRE | BUTTON_SUPER_FIRE);
+	if ((seed >> 4) % 16 == 0)
+		input.buttons |= BUTTON_BOMB;
+	return input;
+}
+
+
+static void report(const char* what, long long ticks, double ns)
+{
+	double played = (double)ticks / TICK_RATE;
+	printf("%s: %lld ticks (%.1f min of play) in %.2f s, %.0f ticks/sec, %.0fx real time\n",
+		what, ticks, played / 60, ns / 1e9, ticks / (ns / 1e9), played / (ns / 1e9));
+}
+
+
+static bool write_file(const char* path, const void* bytes, size_t size)
+{
+	FILE* f = fopen(path, "wb");
+	if (!f)
+		return false;
+	bool ok = fwrite(bytes, 1, size, f) == size;
+	return fclose(f) == 0 && ok;
+}
+
+
+// whether a copy of the recording with its enemy count changed still opens
+static bool opens_with_enemies(const char* path, int enemy_num)
+{
+	FILE* f = fopen(path, "rb");
+	if (!f)
+		return false;
+	std::vector<unsigned char> bytes;
+	unsigned char chunk[4096];
+	size_t got;
+	while ((got = fread(chunk, 1, sizeof(chunk), f)) > 0)
+		bytes.insert(bytes.end(), chunk, chunk + got);
+	fclose(f);
+	if (bytes.size() < sizeof(ReplayHeader))
+		return false;
+
+	ReplayHeader header;
+	memcpy(&header, bytes.data(), sizeof(header));
+	header.enemy_num = enemy_num;
+	memcpy(bytes.data(), &header, sizeof(header));
+	ReplayReader replay;
+	bool opens = write_file(BAD_FILE, bytes.data(), bytes.size()) && replay.open(BAD_FILE);
+	replay.close();
+	remove(BAD_FILE);
+	return opens;
+}
+
+
+// a wave every two seconds for an hour, on the script of the session and
+// a dive of its own
+static bool write_stage(const char* path)
+{
+	std::string source = std::string("script drift\n") + g_script + "end\nscript dive\n\tdive 60 120\nend\n";
+	char line[128];
+	for (int k = 0; k < 1800; k++)
+	{
+		sprintf(line, "wave %d 20 0.1 enemy %d -64 8 0 %s\n", k * 2, (k * 53) % 480, k % 2 ? "drift" : "dive");
+		source += line;
+	}
+	std::vector<unsigned char> bytes;
+	std::string error;
+	return compile_stage(source.c_str(), TICK_RATE, bytes, error) && write_file(path, bytes.data(), bytes.size());
+}
+
+
+static int replay_file(const char* path, int threads)
+{
+	ReplayReader replay;
+	if (!replay.open(path))
+	{
+		printf("%s: not a replay file\n", path);
+		return 1;
+	}
+	printf("%s: seed %u, %d enemies, %u ticks in %u runs, script '%s', stage '%s'\n", path, replay.info().seed,
+		replay.info().enemy_num, replay.info().ticks, replay.info().runs, replay.info().script_path,
+		replay.info().stage_path);
+
+	JobSystem jobs;
+	jobs.start(threads);
+
+	World world;
+	Stage stage;
+	double start = bench_now_ns();
+	long long ticks = run_replay(world, replay, &jobs, stage);
+	if (ticks < 0)
+	{
+		printf("%s: its script or stage is missing or not the one it was recorded with\n", path);
+		return 1;
+	}
+	report("replay", ticks, bench_now_ns() - start);
+	printf("final state %016llx\n", world_hash(world));
+	return 0;
+}
+
+
+static int record_and_replay(double minutes)
+{
+	long long session = (long long)(minutes * 60 * TICK_RATE);
+
+	// set up live the way the game does, recording every tick
+	MoveProgram script;
+	Stage live_stage;
+	if (!write_file(SESSION_SCRIPT, g_script, strlen(g_script)) || !write_stage(SESSION_STAGE)
+		|| !script.load(SESSION_SCRIPT, TICK_SECONDS) || !live_stage.open(SESSION_STAGE, TICK_RATE))
+	{
+		printf("can't set up %s and %s\n", SESSION_SCRIPT, SESSION_STAGE);
+		return 1;
+	}
+	ReplayWriter writer;
+	if (!writer.open(SESSION_FILE, 1, SESSION_ENEMIES, SESSION_SCRIPT, SESSION_STAGE))
+	{
+		printf("can't write %s\n", SESSION_FILE);
+		return 1;
+	}
+
+	World live;
+	init_game(live, SESSION_ENEMIES, 1);
+	set_enemy_script(live, script);
+	if (!set_stage(live, live_stage))
+	{
+		printf("%s: a script doesn't compile\n", SESSION_STAGE);
+		return 1;
+	}
+	unsigned int seed = 7;
+	SimInput input;
+	input.buttons = 0;
+
+	double start = bench_now_ns();
+	for (long long t = 0; t < session; t++)
+	{
+		input = scripted_input(seed, input);
+		writer.record(input);
+		do_game_logic(live, input);
+	}
+	double live_ns = bench_now_ns() - start;
+	writer.close();
+	report("live", session, live_ns);
+
+	// play it back
+	ReplayReader replay;
+	if (!replay.open(SESSION_FILE))
+	{
+		printf("can't read back %s\n", SESSION_FILE);
+		return 1;
+	}
+
+	FILE* f = fopen(SESSION_FILE, "rb");
+	fseek(f, 0, SEEK_END);
+	long size = ftell(f);
+	fclose(f);
+	printf("replay file: %ld bytes, %u runs, %.3f bytes per tick\n", size, replay.info().runs, (double)size / session);
+
+	World world;
+	Stage stage;
+	start = bench_now_ns();
+	long long ticks = run_replay(world, replay, NULL, stage);
+	report("replay", ticks, bench_now_ns() - start);
+
+	unsigned long long expected = world_hash(live);
+	unsigned long long got = world_hash(world);
+	printf("state: live %016llx, replay %016llx\n", expected, got);
+	bool ok = ticks == session && got == expected;
+	if (!ok)
+		printf("the replay did not reproduce the live session\n");
+
+	// a script edited since the recording would play a different game
+	static const char* edited = "move 0 61 1\nweave 40 2 80\n";
+	World other;
+	Stage other_stage;
+	if (!write_file(SESSION_SCRIPT, edited, strlen(edited)) || run_replay(other, replay, NULL, other_stage) != -1)
+	{
+		printf("the replay started with a changed script\n");
+		ok = false;
+	}
+
+	// a damaged header can't make playback set up a world it can't hold
+	if (!opens_with_enemies(SESSION_FILE, SESSION_ENEMIES) || opens_with_enemies(SESSION_FILE, 0)
+		|| opens_with_enemies(SESSION_FILE, -1) || opens_with_enemies(SESSION_FILE, REPLAY_MAX_ENEMIES + 1))
+	{
+		printf("a replay with a bad enemy count opened\n");
+		ok = false;
+	}
+
+	replay.close();
+	stage.close();
+	other_stage.close();
+	live_stage.close();
+	remove(SESSION_FILE);
+	remove(SESSION_SCRIPT);
+	remove(SESSION_STAGE);
+	return ok ? 0 : 1;
+}
+
+
+int main(int argc, char** argv)
+{
+	if (argc > 1 && strcmp(argv[1], "--quick") != 0)
+		return replay_file(argv[1], argc > 2 ? atoi(argv[2]) : 1);
+
+	// an hour normally, three minutes with --quick
+	return record_and_replay(bench_seconds(argc, argv, 60.0));
+}
@@ -0,0 +1,165 @@
+//-----------------------------------------------------------------------------
+// File: bench_rng.cpp
+//
+// Desc: Numbers per second from the CRT rand() against Rng, one at a time,
+//       in bulk and from per-chunk streams across threads. Also checks Rng
+//       against the reference PCG32 output and checks that the bulk fills
+//       and advance() agree with plain next() calls; exits non-zero if not.
+//-----------------------------------------------------------------------------
+#include <stdio.h>
+#include <stdlib.h>
+#include <thread>
+#include <vector>
+
+#include "Rng.h"
+#include "JobSystem.h"
+#include "BenchUtil.h"
+
+#define BATCH 4096
+
+
+static bool check_rng()
+{
+	bool ok = true;
+
+	// first outputs of the reference pcg32-demo, seed 42 on stream 54
+	static const unsigned int expected[] = { 0xa15c02b7, 0x7b47f409, 0xba1d3330, 0x83d2f293, 0xbfa4784b, 0xcbed606e };
+	Rng ref(42, 54);
+	bool same = true;
+	for (int i = 0; i < 6; i++)
+		same = same && ref.next() == expected[i];
+	ok = check(same, "matches reference PCG32") && ok;
+
+	// fills and skip-ahead give the same numbers as next()
+	Rng a(7, 3), b(7, 3);
+	std::vector<unsigned int> bulk(1003);
+	a.fill(bulk.data(), (int)bulk.size());
+	same = true;
+	for (int i = 0; i < (int)bulk.size(); i++)
+		same = same && bulk[i] == b.next();
+	ok = check(same && a.next() == b.next(), "fill() == next() x n") && ok;
+
+	std::vector<float> floats(1001);
+	a.fill_uniform(floats.data(), (int)floats.size(), -3.0f, 5.0f);
+	same = true;
+	for (int i = 0; i < (int)floats.size(); i++)
+		same = same && floats[i] == b.uniform(-3.0f, 5.0f) && floats[i] >= -3.0f && floats[i] < 5.0f;
+	ok = check(same && a.next() == b.next(), "fill_uniform() == uniform() x n") && ok;
+
+	a.advance(123457);
+	for (int i = 0; i < 123457; i++)
+		b.next();
+	ok = check(a.next() == b.next(), "advance(n) == next() x n") && ok;
+
+	// neighbouring streams share nothing
+	Rng s1(1, 1), s2(1, 2);
+	int equal = 0;
+	for (int i = 0; i < 100000; i++)
+		equal += s1.next() == s2.next();
+	ok = check(equal < 5, "streams 1 and 2 differ") && ok;
+
+	// below() stays in range and is roughly flat
+	Rng r(9, 9);
+	int counts[300] = { 0 };
+	bool in_range = true;
+	for (int i = 0; i < 300000; i++)
+	{
+		unsigned int v = r.below(300);
+		in_range = in_range && v < 300;
+		if (v < 300)
+			counts[v]++;
+	}
+	int lo = counts[0], hi = counts[0];
+	for (int i = 1; i < 300; i++)
+	{
+		lo = counts[i] < lo ? counts[i] : lo;
+		hi = counts[i] > hi ? counts[i] : hi;
+	}
+	ok = check(in_range && lo > 800 && hi < 1200, "below(300) in range and flat") && ok;
+
+	return ok;
+}
+
+
+// runs body over and over for about seconds and returns numbers per second
+template <typename Body>
+static double rate(double seconds, long long per_call, Body body)
+{
+	long long numbers = 0;
+	double start = bench_now_ns();
+	double now = start;
+	while (now - start < seconds * 1e9)
+	{
+		body();
+		numbers += per_call;
+		now = bench_now_ns();
+	}
+	return numbers / ((now - start) / 1e9);
+}
+
+
+struct StreamFill {
+	std::vector<float>* out;
+};
+
+// every chunk draws from its own stream, so no two threads share state
+static void fill_chunk(void* data, int begin, int end)
+{
+	StreamFill& fill = *(StreamFill*)data;
+	Rng rng(1, (unsigned long long)begin);
+	rng.fill_uniform(fill.out->data() + begin, end - begin, 0.0f, 1.0f);
+}
+
+
+int main(int argc, char** argv)
+{
+	double seconds = bench_seconds(argc, argv, 0.5);
+
+	bool ok = check_rng();
+
+	std::vector<unsigned int> ints(BATCH);
+	std::vector<float> floats(BATCH);
+	Rng rng(1, 1);
+	unsigned int sum = 0;
+
+	printf("%-40s %10s\n", "", "M/sec");
+
+	srand(1);
+	double r = rate(seconds, BATCH, [&]() { for (int i = 0; i < BATCH; i++) sum += rand(); });
+	printf("%-40s %10.1f\n", "rand()", r / 1e6);
+	double base = r;
+
+	r = rate(seconds, BATCH, [&]() { for (int i = 0; i < BATCH; i++) sum += rand() % 300; });
+	printf("%-40s %10.1f\n", "rand() % 300", r / 1e6);
+
+	r = rate(seconds, BATCH, [&]() { for (int i = 0; i < BATCH; i++) sum += rng.next(); });
+	printf("%-40s %10.1f  %5.1fx rand()\n", "Rng::next()", r / 1e6, r / base);
+
+	r = rate(seconds, BATCH, [&]() { for (int i = 0; i < BATCH; i++) sum += rng.below(300); });
+	printf("%-40s %10.1f  %5.1fx rand()\n", "Rng::below(300)", r / 1e6, r / base);
+
+	r = rate(seconds, BATCH, [&]() { for (int i = 0; i < BATCH; i++) floats[i] = rng.uniform(); });
+	printf("%-40s %10.1f  %5.1fx rand()\n", "Rng::uniform()", r / 1e6, r / base);
+
+	r = rate(seconds, BATCH, [&]() { rng.fill(ints.data(), BATCH); });
+	printf("%-40s %10.1f  %5.1fx rand()\n", "Rng::fill()", r / 1e6, r / base);
+
+	r = rate(seconds, BATCH, [&]() { rng.fill_uniform(floats.data(), BATCH, 0.0f, 1.0f); });
+	printf("%-40s %10.1f  %5.1fx rand()\n", "Rng::fill_uniform()", r / 1e6, r / base);
+
+	// one stream per chunk across every hardware thread
+	JobSystem jobs;
+	jobs.start(0);
+	std::vector<float> big(1 << 20);
+	StreamFill fill = { &big };
+	r = rate(seconds, (long long)big.size(), [&]() { parallel_for(&jobs, (int)big.size(), 16384, fill_chunk, &fill); });
+	char label[64];
+	sprintf(label, "fill_uniform(), streams on %d threads", jobs.thread_count());
+	printf("%-40s %10.1f  %5.1fx rand()\n", label, r / 1e6, r / base);
+
+	bench_keep(sum);
+	bench_keep(floats[0]);
+	bench_keep(ints[0]);
+	bench_keep(big[0]);
+	return ok ? 0 : 1;
+}
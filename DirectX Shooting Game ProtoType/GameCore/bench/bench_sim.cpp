@@ -0,0 +1,52 @@
+//-----------------------------------------------------------------------------
+// File: bench_sim.cpp
+//
+// Desc: Runs do_game_logic() headless with a scripted player and reports the
+//       sustained tick rate as the enemy count grows.
+//-----------------------------------------------------------------------------
+#include <cstdio>
+
+#include "Sim.h"
+#include "BenchUtil.h"
+
+
+// a player that weaves left and right and keeps both triggers held
+static SimInput scripted_input(long long tick)
+{
+	SimInput input;
+	input.buttons = BUTTON_FIRE | BUTTON_SUPER_FIRE;
+	input.buttons |= ((tick / 40) & 1) ? BUTTON_LEFT : BUTTON_RIGHT;
+	return input;
+}
+
+
+int main(int argc, char** argv)
+{
+	static const int counts[] = { 5, 100, 1000, 10000, 100000, 1000000 };
+	double seconds = bench_seconds(argc, argv, 1.0);
+
+	printf("%10s %14s %12s %12s\n", "enemies", "ticks/sec", "ns/tick", "25ms budget");
+
+	for (int c = 0; c < (int)(sizeof(counts) / sizeof(counts[0])); c++)
+	{
+		World world;
+		init_game(world, counts[c], 1);
+
+		long long ticks = 0;
+		double start = bench_now_ns();
+		double now = start;
+		while (now - start < seconds * 1e9)
+		{
+			// check the clock in batches so it stays out of the measurement
+			for (int i = 0; i < 16; i++, ticks++)
+				do_game_logic(world, scripted_input(ticks));
+			now = bench_now_ns();
+		}
+		bench_keep(world.hero.x[0]);
+
+		double ns_per_tick = (now - start) / (double)ticks;
+		printf("%10d %14.0f %12.1f %11.2f%%\n", counts[c], 1e9 / ns_per_tick, ns_per_tick, ns_per_tick / 25e6 * 100);
+	}
+
+	return 0;
+}
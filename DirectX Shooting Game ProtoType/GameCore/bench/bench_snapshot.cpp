@@ -0,0 +1,160 @@
+//-----------------------------------------------------------------------------
+// File: bench_snapshot.cpp
+//
+// Desc: Snapshot size and speed at 10000 enemies: raw bytes per snapshot,
+//       delta bytes per tick in the rewind buffer, the cost of saving one
+//       tick and how long a restore takes depending on how far back it goes.
+//
+//       Also checks that every restored tick hashes the same as the live run
+//       did at that tick, and that rolling back and replaying the same input
+//       ends in the same state; exits non-zero if not.
+//-----------------------------------------------------------------------------
+#include <stdio.h>
+#include <vector>
+
+#include "Sim.h"
+#include "Snapshot.h"
+#include "BenchUtil.h"
+
+#define SNAPSHOT_ENEMIES 10000
+#define REWIND_TICKS (5 * TICK_RATE)
+#define KEY_INTERVAL 32
+#define ARENA_BYTES (128 << 20)
+
+
+// the same player as bench_replay, but a pure function of the tick
+static SimInput input_at(unsigned int tick)
+{
+	unsigned int seed = (tick / 20) * 1664525u + 1013904223u;
+	SimInput input;
+	input.buttons = (seed >> 8) & (BUTTON_UP | BUTTON_DOWN | BUTTON_LEFT | BUTTON_RIGHT | BUTTON_FIRE | BUTTON_SUPER_FIRE);
+	if (tick % 200 == 0)
+		input.buttons |= BUTTON_BOMB;
+	return input;
+}
+
+
+int main(int argc, char** argv)
+{
+	double seconds = bench_seconds(argc, argv, 2.0);
+	bool ok = true;
+
+	World world;
+	init_game(world, SNAPSHOT_ENEMIES, 1);
+
+	// warm up until the boss and the enemies have filled the screen
+	for (int i = 0; i < 4 * TICK_RATE; i++)
+		do_game_logic(world, input_at(world.tick));
+
+	RewindBuffer rewind;
+	rewind.init(world, REWIND_TICKS, KEY_INTERVAL, ARENA_BYTES);
+
+	// one full buffer of ticks, remembering the hash of each
+	std::vector<unsigned long long> hashes(REWIND_TICKS + 1);
+	unsigned int first_tick = world.tick;
+	double save_ns = 0;
+	double delta_bytes = 0;
+	int deltas = 0;
+	for (int i = 0; i <= REWIND_TICKS; i++)
+	{
+		if (i > 0)
+			do_game_logic(world, input_at(world.tick));
+		hashes[i] = world_hash(world);
+
+		double start = bench_now_ns();
+		rewind.push(world);
+		save_ns += bench_now_ns() - start;
+		if (i > 0 && (world.tick - 1) % KEY_INTERVAL != 0)
+		{
+			delta_bytes += (double)rewind.last_entry_bytes();
+			deltas++;
+		}
+	}
+	unsigned long long final_hash = world_hash(world);
+
+	printf("%d enemies, %d enemy bullets live\n", SNAPSHOT_ENEMIES, world.enemy_bullet.count());
+	printf("raw snapshot:            %8zu bytes (at most %zu)\n", rewind.head_bytes(), snapshot_max_size(world));
+	printf("delta per tick:          %8.0f bytes, %.1f%% of raw\n", delta_bytes / deltas, 100.0 * delta_bytes / deltas / rewind.head_bytes());
+	printf("rewind buffer:           %8.2f MB for %u ticks (%.1f s), key every %d\n",
+		rewind.arena_used() / 1048576.0, rewind.newest_tick() - rewind.oldest_tick(),
+		(rewind.newest_tick() - rewind.oldest_tick()) / (double)TICK_RATE, KEY_INTERVAL);
+	printf("save + push:             %8.1f us per tick\n", save_ns / (REWIND_TICKS + 1) / 1000);
+
+	// every tick restores to exactly what it was
+	World restored;
+	init_game(restored, SNAPSHOT_ENEMIES, 1);
+	bool same = rewind.oldest_tick() == first_tick;
+	for (unsigned int t = rewind.oldest_tick(); t <= rewind.newest_tick(); t++)
+		same = same && rewind.restore(restored, t) && world_hash(restored) == hashes[t - first_tick];
+	ok = check(same, "restore(t) matches the live run at every tick") && ok;
+
+	// how far back it goes against how long it takes
+	static const int back[] = { 0, 1, KEY_INTERVAL / 2, KEY_INTERVAL - 1, REWIND_TICKS / 2, REWIND_TICKS };
+	printf("%-24s %10s\n", "restore", "us");
+	for (int i = 0; i < (int)(sizeof(back) / sizeof(back[0])); i++)
+	{
+		unsigned int t = rewind.newest_tick() - back[i];
+		long long runs = 0;
+		double start = bench_now_ns();
+		double now = start;
+		while (now - start < seconds * 1e9 / 8)
+		{
+			rewind.restore(restored, t);
+			runs++;
+			now = bench_now_ns();
+		}
+		char label[64];
+		sprintf(label, "%d ticks back", back[i]);
+		printf("%-24s %10.1f\n", label, (now - start) / runs / 1000);
+	}
+
+	// the worst case over every tick in the buffer
+	double worst = 0;
+	double total = 0;
+	for (unsigned int t = rewind.oldest_tick(); t <= rewind.newest_tick(); t++)
+	{
+		double start = bench_now_ns();
+		rewind.restore(restored, t);
+		double ns = bench_now_ns() - start;
+		worst = ns > worst ? ns : worst;
+		total += ns;
+	}
+	printf("%-24s %10.1f\n", "mean over buffer", total / (REWIND_TICKS + 1) / 1000);
+	printf("%-24s %10.1f\n", "worst over buffer", worst / 1000);
+
+	// roll back half the buffer and play the same input forward again
+	unsigned int back_to = rewind.newest_tick() - REWIND_TICKS / 2;
+	unsigned int oldest = rewind.oldest_tick();
+	same = rewind.rollback(world, back_to) && rewind.newest_tick() == back_to;
+
+	// the ticks before the rollback point are still there, as they were
+	bool kept = same && rewind.oldest_tick() == oldest;
+	for (unsigned int t = oldest; kept && t < back_to; t++)
+		kept = rewind.restore(restored, t) && world_hash(restored) == hashes[t - first_tick];
+	ok = check(kept, "rollback keeps the ticks before it") && ok;
+
+	while (same && world.tick < first_tick + REWIND_TICKS)
+	{
+		do_game_logic(world, input_at(world.tick));
+		rewind.push(world);
+		same = world_hash(world) == hashes[world.tick - first_tick];
+	}
+	ok = check(same && world_hash(world) == final_hash, "rollback + replay reaches the same state") && ok;
+
+	// and the buffer rewritten after the rollback still restores exactly
+	same = true;
+	for (unsigned int t = rewind.oldest_tick(); t <= rewind.newest_tick(); t++)
+		same = same && rewind.restore(restored, t) && world_hash(restored) == hashes[t - first_tick];
+	ok = check(same, "restore(t) after rollback") && ok;
+
+	// a damaged delta is refused rather than applied
+	std::vector<unsigned char> a(snapshot_max_size(world)), b(a.size()), delta(delta_max_size(a.size()));
+	size_t a_size = save_snapshot(world, a.data());
+	do_game_logic(world, input_at(world.tick));
+	size_t b_size = save_snapshot(world, b.data());
+	size_t d_size = encode_delta(a.data(), a_size, b.data(), b_size, delta.data());
+	ok = check(decode_delta(a.data(), a_size, delta.data(), d_size - 1, b.data(), b.size()) == 0
+		&& !load_snapshot(restored, a.data(), a_size - 4), "truncated delta and snapshot refused") && ok;
+
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,259 @@
+//-----------------------------------------------------------------------------
+// File: bench_sprites.cpp
+//
+// Desc: CPU cost of turning a busy frame into draw calls: one call per
+//       sprite as render_frame() used to do, against the sorted sprite
+//       batch. Reports time per frame, draw calls and texture switches, and
+//       the radix sort against std::sort. The backends only count, so the
+//       times are the CPU side alone; in the game every draw call also goes
+//       through Direct3D and the driver, which is what batching saves.
+//
+//       Also checks that the batch draws every sprite once, in key order and
+//       stable within equal keys, and that radix_sort_keys() agrees with
+//       std::sort; exits non-zero if not.
+//-----------------------------------------------------------------------------
+#include <stdio.h>
+#include <algorithm>
+#include <vector>
+
+#include "Sim.h"
+#include "Rng.h"
+#include "WorldSprites.h"
+#include "BenchUtil.h"
+
+#define SPRITE_ENEMIES 10000
+
+
+// counts what a real backend would be asked to do
+class CountingBackend : public SpriteBackend {
+
+public:
+	CountingBackend() : calls(0), switches(0), quads(0), texture(-1), sum(0) {}
+
+	void draw(int texture_, const SpriteVertex* vertices, int n, const unsigned short* indices)
+	{
+		calls++;
+		switches += texture_ != texture;
+		texture = texture_;
+		quads += n;
+		sum += vertices[4 * n - 1].x + indices[0];
+	}
+
+	int calls;
+	int switches;
+	int quads;
+	int texture;
+	float sum;
+};
+
+
+// keeps a copy of every vertex, in draw order
+class RecordingBackend : public SpriteBackend {
+
+public:
+	void draw(int texture, const SpriteVertex* vertices, int n, const unsigned short*)
+	{
+		for (int i = 0; i < n; i++)
+		{
+			textures.push_back(texture);
+			corners.push_back(vertices[4 * i]);
+		}
+	}
+
+	std::vector<int> textures;
+	std::vector<SpriteVertex> corners;
+};
+
+
+static void quad_vertices(const SpriteFrame& f, float x, float y, SpriteVertex* v)
+{
+	v[0].x = x;       v[0].y = y;       v[0].u = f.u0; v[0].v = f.v0;
+	v[1].x = x + f.w; v[1].y = y;       v[1].u = f.u1; v[1].v = f.v0;
+	v[2].x = x + f.w; v[2].y = y + f.h; v[2].u = f.u1; v[2].v = f.v1;
+	v[3].x = x;       v[3].y = y + f.h; v[3].u = f.u0; v[3].v = f.v1;
+	for (int c = 0; c < 4; c++)
+	{
+		v[c].z = 0.0f;
+		v[c].rhw = 1.0f;
+		v[c].color = SPRITE_WHITE;
+	}
+}
+
+
+// the old way: a call per sprite, each building its own quad
+static void draw_immediate(const World& world, const SpriteFrame* frames, const unsigned short* indices, SpriteBackend& backend)
+{
+	SpriteVertex v[4];
+	const ProjectilePool* pools[] = { &world.bullet, &world.super_bullet };
+	const int pool_kinds[] = { SPRITE_BULLET, SPRITE_SUPER_BULLET };
+
+	quad_vertices(frames[SPRITE_HERO], world.hero.x[0], world.hero.y[0], v);
+	backend.draw(frames[SPRITE_HERO].texture, v, 1, indices);
+	for (int p = 0; p < 2; p++)
+	{
+		const SpriteFrame& f = frames[pool_kinds[p]];
+		for (int i = 0; i < pools[p]->count(); i++)
+		{
+			quad_vertices(f, pools[p]->x[i], pools[p]->y[i], v);
+			backend.draw(f.texture, v, 1, indices);
+		}
+	}
+	for (int i = 0; i < world.enemy.count(); i++)
+	{
+		quad_vertices(frames[SPRITE_ENEMY], world.enemy.x[i], world.enemy.y[i], v);
+		backend.draw(frames[SPRITE_ENEMY].texture, v, 1, indices);
+	}
+	if (world.boss.alive[0])
+	{
+		quad_vertices(frames[SPRITE_BOSS], world.boss.x[0], world.boss.y[0], v);
+		backend.draw(frames[SPRITE_BOSS].texture, v, 1, indices);
+	}
+	for (int i = 0; i < world.enemy_bullet.count(); i++)
+	{
+		quad_vertices(frames[SPRITE_ENEMY_BULLET], world.enemy_bullet.x[i], world.enemy_bullet.y[i], v);
+		backend.draw(frames[SPRITE_ENEMY_BULLET].texture, v, 1, indices);
+	}
+}
+
+
+struct Submitted {
+	unsigned long long order;    // layer, texture, depth
+	int index;
+};
+
+
+static bool by_order(const Submitted& a, const Submitted& b)
+{
+	return a.order < b.order;
+}
+
+
+static bool check_batch()
+{
+	bool ok = true;
+
+	// random keys, with plenty of ties so stability matters
+	Rng rng(5, 5);
+	int n = 50000;
+	SpriteBatch batch;
+	batch.init(n, 0.0f);
+	batch.begin();
+	std::vector<Submitted> expected;
+	for (int i = 0; i < n; i++)
+	{
+		SpriteFrame f = { (int)rng.below(8), 1, 1, 0, 0, 1, 1 };
+		int layer = (int)rng.below(4);
+		int depth = (int)rng.below(3) * 1000;
+		batch.add(f, layer, depth, (float)i, 0.0f, SPRITE_WHITE);
+		Submitted s = { ((unsigned long long)layer << 40) | ((unsigned long long)f.texture << 20) | (unsigned long long)depth, i };
+		expected.push_back(s);
+	}
+	std::stable_sort(expected.begin(), expected.end(), by_order);
+
+	RecordingBackend rec;
+	batch.end(rec);
+	bool same = (int)rec.corners.size() == n;
+	for (int i = 0; same && i < n; i++)
+		same = (int)rec.corners[i].x == expected[i].index && rec.textures[i] == (int)((expected[i].order >> 20) & 0xfff);
+	ok = check(same, "batch draws in key order, stable") && ok;
+	ok = check(batch.stats().draw_calls == 4 * 8 && batch.stats().texture_switches == 4 * 8, "one draw per layer and texture") && ok;
+
+	std::vector<unsigned long long> keys(n), scratch(n);
+	for (int i = 0; i < n; i++)
+		keys[i] = ((unsigned long long)rng.next() << 32) | rng.next();
+	std::vector<unsigned long long> ref = keys;
+	std::sort(ref.begin(), ref.end());
+	unsigned long long* sorted = radix_sort_keys(keys.data(), scratch.data(), n, 0);
+	ok = check(std::equal(ref.begin(), ref.end(), sorted), "radix_sort_keys() == std::sort") && ok;
+
+	return ok;
+}
+
+
+// runs body over and over for about seconds and returns ns per call
+template <typename Body>
+static double time_ns(double seconds, Body body)
+{
+	long long runs = 0;
+	double start = bench_now_ns();
+	double now = start;
+	while (now - start < seconds * 1e9)
+	{
+		body();
+		runs++;
+		now = bench_now_ns();
+	}
+	return (now - start) / runs;
+}
+
+
+int main(int argc, char** argv)
+{
+	double seconds = bench_seconds(argc, argv, 1.0);
+	bool ok = check_batch();
+
+	World world;
+	init_game(world, SPRITE_ENEMIES, 1);
+	SimInput input;
+	input.buttons = BUTTON_FIRE | BUTTON_SUPER_FIRE;
+	for (int i = 0; i < 4 * TICK_RATE; i++)
+		do_game_logic(world, input);
+
+	// the textures the game loads; the boss shares the super bullet's
+	SpriteFrame frames[SPRITE_KIND_NUM] = {
+		{ 0, 64, 64, 0, 0, 1, 1 },
+		{ 1, 64, 64, 0, 0, 1, 1 },
+		{ 2, 100, 100, 0, 0, 1, 1 },
+		{ 3, 64, 64, 0, 0, 1, 1 },
+		{ 2, 100, 100, 0, 0, 1, 1 },
+		{ 4, 64, 64, 0, 0, 1, 1 },
+	};
+
+	SpriteBatch batch;
+	batch.init(world_sprite_capacity(SPRITE_ENEMIES), 0.0f);
+	std::vector<unsigned short> indices(6);
+
+	CountingBackend immediate;
+	double immediate_ns = time_ns(seconds, [&]() {
+		immediate = CountingBackend();
+		draw_immediate(world, frames, indices.data(), immediate);
+	});
+
+	CountingBackend batched;
+	double batch_ns = time_ns(seconds, [&]() {
+		batched = CountingBackend();
+		batch.begin();
+		draw_world(world, frames, batch);
+		batch.end(batched);
+	});
+	ok = check(batched.quads == immediate.quads && batch.stats().draw_calls == batched.calls
+		&& batch.stats().texture_switches == batched.switches, "batch draws what the immediate path draws") && ok;
+
+	printf("%d sprites per frame\n", immediate.quads);
+	printf("%-24s %10s %10s %10s\n", "", "us/frame", "draws", "switches");
+	printf("%-24s %10.1f %10d %10d\n", "one Draw per sprite", immediate_ns / 1000, immediate.calls, immediate.switches);
+	printf("%-24s %10.1f %10d %10d\n", "sprite batch", batch_ns / 1000, batched.calls, batched.switches);
+
+	// the sort on its own, on this frame's keys and on random ones
+	int n = immediate.quads;
+	std::vector<unsigned long long> keys(n), work(n), scratch(n);
+	Rng rng(3, 3);
+	for (int i = 0; i < n; i++)
+		keys[i] = ((unsigned long long)rng.next() << 32) | rng.next();
+
+	double radix_ns = time_ns(seconds / 2, [&]() {
+		work = keys;
+		bench_keep(*radix_sort_keys(work.data(), scratch.data(), n, 0));
+	});
+	double std_ns = time_ns(seconds / 2, [&]() {
+		work = keys;
+		std::sort(work.begin(), work.end());
+		bench_keep(work[0]);
+	});
+	printf("%-24s %10.1f us for %d random keys\n", "radix_sort_keys()", radix_ns / 1000, n);
+	printf("%-24s %10.1f us\n", "std::sort", std_ns / 1000);
+
+	bench_keep(immediate.sum);
+	bench_keep(batched.sum);
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,474 @@
+//-----------------------------------------------------------------------------
+// File: bench_stage.cpp
+//
+// Desc: Compiled stages: how long a stage of half a million spawns takes to
+//       compile from source and to open and set up, what walking its spawns
+//       costs per spawn, and a tick with a stage feeding the enemies.
+//
+//           bench_stage [--quick]
+//
+//       Checks that opening and setting up the big stage takes under a
+//       millisecond, that a small stage reads back exactly as written and
+//       spawns on the right ticks, that spawns with no enemy free are
+//       dropped and counted, that a snapshot taken mid-stage plays on the
+//       same, that play allocates nothing, that broken sources and
+//       damaged files are rejected, and that so are scripts which each fit
+//       a MoveProgram but not all together.
+//-----------------------------------------------------------------------------
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "Sim.h"
+#include "Snapshot.h"
+#include "Stage.h"
+#include "BenchUtil.h"
+
+#define STAGE_FILE "bench_stage.stage"
+#define BIG_WAVES 2000
+#define BIG_WAVE_SIZE 250
+#define PLAY_ENEMIES 2048
+#define PLAY_TICKS 4000
+#define OPEN_RUNS 50
+
+
+static long long g_allocations = 0;
+
+void* operator new(size_t size)
+{
+	g_allocations++;
+	void* p = malloc(size ? size : 1);
+	if (!p)
+		throw std::bad_alloc();
+	return p;
+}
+
+// std::stable_sort() takes its buffer from the nothrow form and hands it
+// back to the delete below, so that has to come from malloc() too
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+	g_allocations++;
+	return malloc(size ? size : 1);
+}
+
+void operator delete(void* p) noexcept
+{
+	free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+	free(p);
+}
+
+
+static const char* g_small_stage =
+	"# two scripts, a wave and two single spawns\n"
+	"script fall\n"
+	"	move 0 80\n"
+	"end\n"
+	"\n"
+	"script sway      # across and back, forever\n"
+	"	weave 40 1 80 1\n"
+	"	loop\n"
+	"end\n"
+	"\n"
+	"at 1 enemy 100 -64 sway\n"
+	"wave 0 3 0.5 enemy 10 -64 20 0 fall\n"
+	"at 0.5 enemy 300 -64 fall\n";
+
+// the records of g_small_stage in tick order; those due on the same tick
+// stay in the order they were written
+static const StageSpawn g_small_spawns[] = {
+	{ 0, STAGE_ENEMY, 0, 10, -64 },
+	{ 20, STAGE_ENEMY, 0, 30, -64 },
+	{ 20, STAGE_ENEMY, 0, 300, -64 },
+	{ 40, STAGE_ENEMY, 1, 100, -64 },
+	{ 40, STAGE_ENEMY, 0, 50, -64 },
+};
+
+#define SMALL_SPAWNS (int)(sizeof(g_small_spawns) / sizeof(g_small_spawns[0]))
+
+
+static bool write_file(const char* path, const std::vector<unsigned char>& bytes)
+{
+	FILE* f = fopen(path, "wb");
+	if (!f)
+		return false;
+	bool ok = fwrite(bytes.data(), 1, bytes.size(), f) == bytes.size();
+	return fclose(f) == 0 && ok;
+}
+
+
+// an hour of waves, one every 1.8 seconds, each running one of three scripts
+static std::string big_stage_source()
+{
+	std::string source =
+		"script fall\n"
+		"	move 0 80\n"
+		"end\n"
+		"script weave\n"
+		"	weave 60 2 70\n"
+		"end\n"
+		"script dive\n"
+		"	wait 0.5\n"
+		"	dive 40 60\n"
+		"end\n";
+	char line[128];
+	for (int k = 0; k < BIG_WAVES; k++)
+	{
+		static const char* scripts[] = { "fall", "weave", "dive" };
+		sprintf(line, "wave %g %d 0.025 enemy %d -64 %g 0 %s\n", k * 1.8, BIG_WAVE_SIZE, (k * 37) % 500,
+			k % 2 ? 0.5 : -0.5, scripts[k % 3]);
+		source += line;
+	}
+	return source;
+}
+
+
+static bool compile_errors()
+{
+	struct Case {
+		const char* source;
+		const char* error;
+	};
+	static const Case cases[] = {
+		{ "at 1 enemy 0 0 nope\n", "line 1: unknown script" },
+		{ "script a\n\tmove 0 80\n", "line 1: script without an end" },
+		{ "script a\n\tfly 1\nend\n", "line 1: in script 'a', line 1: unknown instruction" },
+		{ "script a\n\tmove 0 80\nend\nat -1 enemy 0 0 a\n", "line 4: time out of range" },
+		{ "script a\n\tmove 0 80\nend\nat 1 boss 0 0 a\n", "line 4: unknown archetype" },
+		{ "script a\n\tmove 0 80\nend\nwave 1 0 1 enemy 0 0 0 0 a\n", "line 4: wave count out of range" },
+		{ "script a\n\tmove 0 80\nend\nat 1 enemy 0 x a\n", "line 4: not a number" },
+		{ "script a\n\tmove 0 80\nend\nscript a\n", "line 4: script defined twice" },
+		{ "spawn 1 enemy 0 0 a\n", "line 1: unknown command" },
+	};
+
+	std::vector<unsigned char> bytes;
+	std::string error;
+	for (size_t k = 0; k < sizeof(cases) / sizeof(cases[0]); k++)
+	{
+		if (compile_stage(cases[k].source, TICK_RATE, bytes, error)
+			|| strncmp(error.c_str(), cases[k].error, strlen(cases[k].error)) != 0)
+		{
+			printf("case %d: '%s'\n", (int)k, error.c_str());
+			return false;
+		}
+	}
+	return true;
+}
+
+
+// a script of n timed moves
+static std::string long_script(const char* name, int n)
+{
+	std::string source = std::string("script ") + name + "\n";
+	for (int i = 0; i < n; i++)
+		source += "\tmove 0 10 1\n";
+	return source + "end\n";
+}
+
+
+// scripts that compile one at a time but overflow the one program
+// set_stage() puts them all in: compile_stage() refuses the source, and
+// set_stage() a file that was edited to get there, leaving the world as
+// it was
+static bool oversized_scripts()
+{
+	const int half = MOVE_SCRIPT_MAX_OPS * 3 / 4;
+	std::vector<unsigned char> bytes;
+	std::string error;
+	std::string source = long_script("a", half) + long_script("b", half) + "at 1 enemy 0 0 b\n";
+	char expect[64];
+	sprintf(expect, "line %d: in script 'b', line %d:", half + 3, MOVE_SCRIPT_MAX_OPS - half - 1);
+	if (compile_stage(source.c_str(), TICK_RATE, bytes, error) || strncmp(error.c_str(), expect, strlen(expect)) != 0)
+	{
+		printf("two long scripts: '%s'\n", error.c_str());
+		return false;
+	}
+
+	// the second script pointed at the first: each fits, both don't
+	source = long_script("a", half) + "script b\n\tmove 0 10\nend\nat 1 enemy 0 0 b\n";
+	if (!compile_stage(source.c_str(), TICK_RATE, bytes, error))
+		return false;
+	const StageHeader& h = *(const StageHeader*)bytes.data();
+	StageScript* table = (StageScript*)(bytes.data() + h.script_offset);
+	table[1] = table[0];
+
+	World world;
+	init_game(world, 8, 1);
+	MoveProgram before = world.enemy_script;
+	Stage stage;
+	bool rejected = write_file(STAGE_FILE, bytes) && stage.open(STAGE_FILE, TICK_RATE) && !set_stage(world, stage);
+	return rejected && world.stage == NULL && world.enemy_script.count() == before.count()
+		&& world.enemy_script.count() <= MOVE_SCRIPT_MAX_OPS;
+}
+
+
+static bool reads_back(const Stage& stage)
+{
+	if (stage.spawn_count() != SMALL_SPAWNS || stage.script_count() != 2
+		|| strcmp(stage.script_source(0), "\tmove 0 80\n") != 0)
+		return false;
+	for (int i = 0; i < SMALL_SPAWNS; i++)
+	{
+		const StageSpawn& a = stage.spawn(i);
+		const StageSpawn& b = g_small_spawns[i];
+		if (a.tick != b.tick || a.archetype != b.archetype || a.script != b.script || a.x != b.x || a.y != b.y)
+			return false;
+	}
+	return true;
+}
+
+
+static int alive_enemies(const World& world)
+{
+	int n = 0;
+	for (int i = 0; i < world.enemy.count(); i++)
+		n += world.enemy.alive[i];
+	return n;
+}
+
+
+// every spawn comes in on its tick while there are enemies for it, and is
+// dropped once there aren't; the swaying enemy loops back to the top of its
+// own script
+static bool spawns_on_time(const Stage& stage, int enemies)
+{
+	World world;
+	init_game(world, enemies, 1);
+	if (!set_stage(world, stage) || alive_enemies(world) != 0)
+		return false;
+
+	SimInput input;
+	input.buttons = 0;
+	for (int t = 0; t <= 100; t++)
+	{
+		do_game_logic(world, input);
+		int due = 0;
+		while (due < SMALL_SPAWNS && g_small_spawns[due].tick <= (unsigned int)t)
+			due++;
+		int expect = std::min(due, enemies);
+		if (world.stage_cursor.position() != due || alive_enemies(world) != expect
+			|| world.stage_dropped != due - expect)
+			return false;
+	}
+	return world.stage_cursor.finished() && (enemies < 4 || world.enemy_move.pc[3] == world.stage_entries[1]);
+}
+
+
+// broken headers and tables never open; a damaged record is passed over
+// when play gets to it
+static bool damaged_files(const std::vector<unsigned char>& good)
+{
+	struct Damage {
+		const char* what;
+		size_t offset;
+		unsigned int value;
+	};
+	const StageHeader& h = *(const StageHeader*)good.data();
+	const StageScript* table = (const StageScript*)(good.data() + h.script_offset);
+	const Damage damage[] = {
+		{ "magic", 0, 0x45475453 + 1 },
+		{ "version", 4, STAGE_VERSION + 1 },
+		{ "script count", 12, STAGE_MAX_SCRIPTS + 1 },
+		{ "script table", 16, (unsigned int)good.size() },
+		{ "spawn count", 20, h.spawn_count + 1 },
+		{ "spawn offset", 24, h.spawn_offset + 4 },
+		{ "script offset", h.script_offset, (unsigned int)good.size() },
+		{ "script length", h.script_offset + 4, table[0].length + 1 },
+	};
+
+	bool ok = true;
+	Stage stage;
+	for (size_t k = 0; k < sizeof(damage) / sizeof(damage[0]); k++)
+	{
+		std::vector<unsigned char> bytes = good;
+		memcpy(bytes.data() + damage[k].offset, &damage[k].value, 4);
+		if (!write_file(STAGE_FILE, bytes) || stage.open(STAGE_FILE, TICK_RATE))
+		{
+			printf("damaged %s opened\n", damage[k].what);
+			ok = false;
+		}
+	}
+
+	std::vector<unsigned char> bytes(good.begin(), good.end() - 1);
+	ok = check(write_file(STAGE_FILE, bytes) && !stage.open(STAGE_FILE, TICK_RATE), "truncated stage rejected") && ok;
+	ok = check(write_file(STAGE_FILE, good) && !stage.open(STAGE_FILE, TICK_RATE * 2), "stage for another tick rate rejected") && ok;
+
+	// a script the game can't compile opens, but can't be set
+	bytes = good;
+	bytes[table[0].offset] = '?';
+	World world;
+	init_game(world, 8, 1);
+	ok = check(write_file(STAGE_FILE, bytes) && stage.open(STAGE_FILE, TICK_RATE) && !set_stage(world, stage),
+		"broken script rejected by set_stage()") && ok;
+
+	// the second spawn names a script that isn't there, the fourth is at NaN
+	bytes = good;
+	StageSpawn* spawns = (StageSpawn*)(bytes.data() + h.spawn_offset);
+	spawns[1].script = 7;
+	memset(&spawns[3].x, 0xff, sizeof(float));
+	SimInput input;
+	input.buttons = 0;
+	bool played = write_file(STAGE_FILE, bytes) && stage.open(STAGE_FILE, TICK_RATE) && set_stage(world, stage);
+	for (int t = 0; played && t <= 60; t++)
+		do_game_logic(world, input);
+	ok = check(played && world.stage_cursor.skipped() == 2 && alive_enemies(world) == SMALL_SPAWNS - 2,
+		"damaged spawns skipped and counted") && ok;
+	return check(ok, "damaged headers rejected") && ok;
+}
+
+
+// a snapshot from the middle of a stage plays on into the same state
+static bool snapshot_mid_stage(const Stage& stage)
+{
+	World world;
+	init_game(world, PLAY_ENEMIES, 1);
+	set_stage(world, stage);
+	SimInput input;
+	input.buttons = BUTTON_FIRE | BUTTON_SUPER_FIRE;
+	for (int t = 0; t < 1000; t++)
+		do_game_logic(world, input);
+
+	std::vector<unsigned char> saved(snapshot_max_size(world));
+	saved.resize(save_snapshot(world, saved.data()));
+	for (int t = 0; t < 200; t++)
+		do_game_logic(world, input);
+	unsigned long long live = world_hash(world);
+
+	World restored;
+	init_game(restored, PLAY_ENEMIES, 2);
+	set_stage(restored, stage);
+	if (!load_snapshot(restored, saved.data(), saved.size()))
+		return false;
+	for (int t = 0; t < 200; t++)
+		do_game_logic(restored, input);
+	return world_hash(restored) == live;
+}
+
+
+// us per tick with the stage feeding PLAY_ENEMIES enemies, and the heap
+// allocations made while it does
+static bool play(const Stage& stage, double seconds)
+{
+	World world;
+	init_game(world, PLAY_ENEMIES, 1);
+	set_stage(world, stage);
+	SimInput input;
+	input.buttons = BUTTON_FIRE | BUTTON_SUPER_FIRE | BUTTON_LEFT;
+	do_game_logic(world, input);
+
+	long long allocations = g_allocations;
+	int ticks = 1;
+	double start = bench_now_ns();
+	double now = start;
+	while (ticks < PLAY_TICKS && (now - start < seconds * 1e9 || ticks < PLAY_TICKS / 4))
+	{
+		for (int k = 0; k < 8; k++, ticks++)
+			do_game_logic(world, input);
+		now = bench_now_ns();
+	}
+	allocations = g_allocations - allocations;
+
+	printf("%d ticks of the stage: %.1f us/tick, %d spawns, %d in play, %d dropped, %lld allocations\n",
+		ticks - 1, (now - start) / (ticks - 1) / 1000, world.stage_cursor.position(), alive_enemies(world),
+		world.stage_dropped, allocations);
+	return check(allocations == 0, "no allocations during play");
+}
+
+
+int main(int argc, char** argv)
+{
+	double seconds = bench_seconds(argc, argv, 0.5);
+	bool ok = true;
+
+	// the small stage: round trip, spawn times, damage
+	ok = check(compile_errors(), "broken sources rejected with their line") && ok;
+	ok = check(oversized_scripts(), "scripts too long together rejected") && ok;
+	std::vector<unsigned char> small;
+	std::string error;
+	Stage stage;
+	if (!compile_stage(g_small_stage, TICK_RATE, small, error) || !write_file(STAGE_FILE, small)
+		|| !stage.open(STAGE_FILE, TICK_RATE))
+	{
+		printf("small stage: %s\n", error.c_str());
+		return 1;
+	}
+	ok = check(reads_back(stage), "stage reads back as written") && ok;
+	ok = check(spawns_on_time(stage, 8), "spawns come on their tick") && ok;
+	ok = check(spawns_on_time(stage, 2), "spawns without a free enemy dropped") && ok;
+	ok = damaged_files(small) && ok;
+	stage.close();
+
+	// the big one
+	std::string source = big_stage_source();
+	std::vector<unsigned char> big;
+	double start = bench_now_ns();
+	if (!compile_stage(source.c_str(), TICK_RATE, big, error) || !write_file(STAGE_FILE, big))
+	{
+		printf("big stage: %s\n", error.c_str());
+		return 1;
+	}
+	double compile_ms = (bench_now_ns() - start) / 1e6;
+	printf("\n%d spawns: %.1f KB of source compiled in %.1f ms to %.1f KB\n", BIG_WAVES * BIG_WAVE_SIZE,
+		source.size() / 1024.0, compile_ms, big.size() / 1024.0);
+
+	// open and set up, against a world with room for the whole screen
+	World world;
+	init_game(world, STAGE_ENEMY_NUM, 1);
+	std::vector<double> open_us, setup_us;
+	for (int k = 0; k < OPEN_RUNS; k++)
+	{
+		stage.close();
+		double t0 = bench_now_ns();
+		bool opened = stage.open(STAGE_FILE, TICK_RATE);
+		double t1 = bench_now_ns();
+		bool set = opened && set_stage(world, stage);
+		double t2 = bench_now_ns();
+		if (!set)
+		{
+			printf("big stage doesn't open\n");
+			return 1;
+		}
+		open_us.push_back((t1 - t0) / 1000);
+		setup_us.push_back((t2 - t0) / 1000);
+	}
+	std::sort(open_us.begin(), open_us.end());
+	std::sort(setup_us.begin(), setup_us.end());
+	printf("open %.1f us, open and set_stage() %.1f us (median of %d)\n", open_us[OPEN_RUNS / 2],
+		setup_us[OPEN_RUNS / 2], OPEN_RUNS);
+	ok = check(setup_us[OPEN_RUNS / 2] < 1000, "stage loads in under a millisecond") && ok;
+
+	// every spawn of the hour through the cursor, as play reads them
+	StageCursor cursor;
+	long long walked = 0, runs = 0;
+	unsigned int last = stage.spawn(stage.spawn_count() - 1).tick;
+	start = bench_now_ns();
+	double now = start;
+	while (now - start < seconds * 1e9 || runs < 3)
+	{
+		cursor.start(&stage);
+		for (unsigned int t = 0; t <= last; t++)
+		{
+			for (const StageSpawn* s = cursor.next(t); s; s = cursor.next(t))
+				walked += s->script;
+		}
+		runs++;
+		now = bench_now_ns();
+	}
+	bench_keep(walked);
+	printf("cursor: %.2f ns per spawn over %u ticks\n\n", (now - start) / runs / stage.spawn_count(), last + 1);
+	ok = check(cursor.finished() && cursor.skipped() == 0, "cursor reaches every spawn") && ok;
+
+	ok = check(snapshot_mid_stage(stage), "snapshot mid-stage plays on the same") && ok;
+	ok = play(stage, seconds) && ok;
+
+	stage.close();
+	remove(STAGE_FILE);
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,287 @@
+//-----------------------------------------------------------------------------
+// File: bench_sweep.cpp
+//
+// Desc: Swept circle tests: correctness against finely sub-stepped discrete
+//       checks, what tunnelling they prevent at lower tick rates, and
+//       pairs/sec of every SIMD path next to the plain overlap kernel.
+//
+//           bench_sweep [--quick]
+//
+//       Checks that every SIMD path agrees with swept_collision_check() bit
+//       for bit, that a circle that didn't move gets exactly the overlap
+//       answer, that no contact sub-stepping finds is missed, and that
+//       nothing is hit that the exact distance says was out of reach.
+//-----------------------------------------------------------------------------
+#include <math.h>
+#include <stdio.h>
+#include <vector>
+
+#include "Sim.h"
+#include "Collide.h"
+#include "Cpu.h"
+#include "Rng.h"
+#include "BenchUtil.h"
+
+#define SUB_STEPS 256
+#define TOLERANCE 1e-3      // pixels either side of touching left to rounding
+#define SCENE_BULLETS 2048
+#define SCENE_TARGETS 64
+#define SCENE_SECONDS 1.0
+
+
+static float random_float(Rng& rng, float lo, float hi)
+{
+	return lo + (hi - lo) * (float)(rng.next() >> 8) / 16777216.0f;
+}
+
+
+// circles that end anywhere near (0, 0) after moves of every length up to
+// 150 px, some not moving at all and some ending exactly at the touching
+// distance
+struct Moves {
+	std::vector<float> x, y, vx, vy;
+};
+
+static void make_moves(Moves& m, int n, float dt, Rng& rng)
+{
+	m.x.resize(n);
+	m.y.resize(n);
+	m.vx.resize(n);
+	m.vy.resize(n);
+	for (int i = 0; i < n; i++)
+	{
+		float speed = i % 8 == 0 ? 0.0f : random_float(rng, 0, 150) / dt;
+		float angle = random_float(rng, 0, 6.2831853f);
+		m.vx[i] = speed * cosf(angle);
+		m.vy[i] = speed * sinf(angle);
+		if (i % 8 == 1)
+		{
+			m.x[i] = ENTITY_RADIUS * 2;
+			m.y[i] = 0;
+		}
+		else
+		{
+			m.x[i] = random_float(rng, -200, 200);
+			m.y[i] = random_float(rng, -200, 200);
+		}
+	}
+}
+
+
+static bool mask_bit(const std::vector<unsigned int>& hits, int i)
+{
+	return (hits[i >> 5] >> (i & 31)) & 1;
+}
+
+
+static bool verify(int level)
+{
+	collide_set_simd_level(level);
+	Rng rng(22, 0);
+	Moves m;
+	std::vector<unsigned int> hits, still;
+	std::vector<float> zero;
+
+	for (int n = 0; n <= 300; n++)
+	{
+		float dt = n % 2 ? 1.0f / 40 : 1.0f / 5;
+		make_moves(m, n, dt, rng);
+		int words = collide_mask_words(n);
+		hits.assign(words + 1, 0xdeadbeef);
+		collide_swept_batch(0, 0, ENTITY_RADIUS, m.x.data(), m.y.data(), m.vx.data(), m.vy.data(), dt,
+			ENTITY_RADIUS, n, hits.data());
+		zero.assign(n, 0.0f);
+		still.assign(words + 1, 0);
+		collide_swept_batch(0, 0, ENTITY_RADIUS, m.x.data(), m.y.data(), zero.data(), zero.data(), dt,
+			ENTITY_RADIUS, n, still.data());
+
+		for (int i = 0; i < n; i++)
+		{
+			bool expect = swept_collision_check(m.x[i], m.y[i], m.vx[i] * dt, m.vy[i] * dt, ENTITY_RADIUS, 0, 0, ENTITY_RADIUS);
+			bool overlap = sphere_collision_check(m.x[i], m.y[i], ENTITY_RADIUS, 0, 0, ENTITY_RADIUS);
+			if (mask_bit(hits, i) != expect || mask_bit(still, i) != overlap)
+			{
+				printf("verify %-6s FAILED: n=%d circle %d\n", simd_level_name(level), n, i);
+				return false;
+			}
+		}
+		if (hits[words] != 0xdeadbeef)
+		{
+			printf("verify %-6s FAILED: n=%d wrote past the mask\n", simd_level_name(level), n);
+			return false;
+		}
+	}
+	printf("verify %-6s ok\n", simd_level_name(level));
+	return true;
+}
+
+
+// closest the move from (x - sx, y - sy) to (x, y) comes to the origin
+static double exact_distance(double x, double y, double sx, double sy)
+{
+	double len2 = sx * sx + sy * sy;
+	double t = len2 > 0 ? -((-x) * sx + (-y) * sy) / len2 : 0;
+	t = t < 0 ? 0 : t > 1 ? 1 : t;
+	double qx = x - sx * t, qy = y - sy * t;
+	return sqrt(qx * qx + qy * qy);
+}
+
+
+// sweep against sphere_collision_check() at SUB_STEPS + 1 points of every
+// move; a disagreement only counts when the exact distance isn't within
+// rounding of touching
+static bool against_sub_steps()
+{
+	Rng rng(7, 0);
+	Moves m;
+	const int n = 200000;
+	const float dts[] = { 1.0f / 40, 1.0f / 10, 1.0f / 2 };
+	long long stepped = 0, swept = 0, ended = 0, missed = 0, false_hits = 0;
+	std::vector<unsigned int> hits(collide_mask_words(n));
+
+	for (int d = 0; d < 3; d++)
+	{
+		float dt = dts[d];
+		make_moves(m, n, dt, rng);
+		collide_swept_batch(0, 0, ENTITY_RADIUS, m.x.data(), m.y.data(), m.vx.data(), m.vy.data(), dt,
+			ENTITY_RADIUS, n, hits.data());
+		for (int i = 0; i < n; i++)
+		{
+			float sx = m.vx[i] * dt, sy = m.vy[i] * dt;
+			bool any = false;
+			for (int k = 0; k <= SUB_STEPS && !any; k++)
+			{
+				float back = (float)(SUB_STEPS - k) / SUB_STEPS;
+				any = sphere_collision_check(m.x[i] - back * sx, m.y[i] - back * sy, ENTITY_RADIUS, 0, 0, ENTITY_RADIUS);
+			}
+			bool hit = mask_bit(hits, i);
+			double reach = exact_distance(m.x[i], m.y[i], sx, sy) - 2 * ENTITY_RADIUS;
+			stepped += any;
+			swept += hit;
+			ended += sphere_collision_check(m.x[i], m.y[i], ENTITY_RADIUS, 0, 0, ENTITY_RADIUS);
+			missed += any && !hit && reach < -TOLERANCE;
+			false_hits += hit && reach > TOLERANCE;
+		}
+	}
+
+	printf("%lld moves: %lld hit when sub-stepped, %lld swept, %lld at the end of the tick only\n",
+		(long long)n * 3, stepped, swept, ended);
+	bool ok = check(missed == 0, "no sub-stepped contact missed");
+	ok = check(false_hits == 0, "no hit out of reach") && ok;
+	return ok;
+}
+
+
+// super bullets flying up through a field of enemies for a second: the
+// pairs that touch at a tick rate, found at the end of each tick and swept,
+// against the same flight at 4000 ticks per second
+static void tunnelling()
+{
+	Rng rng(40, 0);
+	std::vector<float> bx(SCENE_BULLETS), by(SCENE_BULLETS), vx(SCENE_BULLETS, 0.0f), vy(SCENE_BULLETS, -SUPER_BULLET_SPEED);
+	std::vector<float> tx(SCENE_TARGETS), ty(SCENE_TARGETS);
+	for (int i = 0; i < SCENE_BULLETS; i++)
+	{
+		bx[i] = random_float(rng, 0, SCREEN_WIDTH);
+		by[i] = random_float(rng, SCREEN_HEIGHT, SCREEN_HEIGHT + 300);
+	}
+	for (int j = 0; j < SCENE_TARGETS; j++)
+	{
+		tx[j] = random_float(rng, 0, SCREEN_WIDTH);
+		ty[j] = random_float(rng, 0, SCREEN_HEIGHT);
+	}
+
+	const int rates[] = { 4000, 40, 20, 10, 5 };
+	long long reference = 0;
+	std::vector<unsigned int> hits(collide_mask_words(SCENE_BULLETS));
+	printf("\nsuper bullets through %d enemies, pairs that touch:\n", SCENE_TARGETS);
+	printf("%8s %10s %10s %10s\n", "ticks/s", "px/tick", "end only", "swept");
+	for (int r = 0; r < 5; r++)
+	{
+		float dt = 1.0f / rates[r];
+		std::vector<unsigned char> end_touch(SCENE_BULLETS * SCENE_TARGETS, 0), swept_touch(SCENE_BULLETS * SCENE_TARGETS, 0);
+		std::vector<float> x = bx, y = by;
+		int ticks = (int)(SCENE_SECONDS * rates[r] + 0.5);
+		for (int t = 0; t < ticks; t++)
+		{
+			for (int i = 0; i < SCENE_BULLETS; i++)
+				y[i] += vy[i] * dt;
+			for (int j = 0; j < SCENE_TARGETS; j++)
+			{
+				collide_circle_batch(tx[j], ty[j], ENTITY_RADIUS, x.data(), y.data(), ENTITY_RADIUS, SCENE_BULLETS, hits.data());
+				for (int i = 0; i < SCENE_BULLETS; i++)
+					end_touch[j * SCENE_BULLETS + i] |= mask_bit(hits, i);
+				collide_swept_batch(tx[j], ty[j], ENTITY_RADIUS, x.data(), y.data(), vx.data(), vy.data(), dt,
+					ENTITY_RADIUS, SCENE_BULLETS, hits.data());
+				for (int i = 0; i < SCENE_BULLETS; i++)
+					swept_touch[j * SCENE_BULLETS + i] |= mask_bit(hits, i);
+			}
+		}
+
+		long long ends = 0, sweeps = 0;
+		for (size_t k = 0; k < end_touch.size(); k++)
+		{
+			ends += end_touch[k];
+			sweeps += swept_touch[k];
+		}
+		if (r == 0)
+			reference = ends;
+		printf("%8d %10.1f %9.1f%% %9.1f%%\n", rates[r], SUPER_BULLET_SPEED * dt,
+			100.0 * ends / reference, 100.0 * sweeps / reference);
+	}
+}
+
+
+// pairs/sec of one target against n moving circles
+static double measure(bool swept, int n, double seconds)
+{
+	Rng rng(1, 0);
+	Moves m;
+	make_moves(m, n, TICK_SECONDS, rng);
+	std::vector<unsigned int> hits(collide_mask_words(n));
+	int reps = 1 + 100000 / n;
+
+	long long pairs = 0;
+	double start = bench_now_ns();
+	double now = start;
+	while (now - start < seconds * 1e9)
+	{
+		for (int k = 0; k < reps; k++)
+		{
+			if (swept)
+				collide_swept_batch(0, 0, ENTITY_RADIUS, m.x.data(), m.y.data(), m.vx.data(), m.vy.data(), TICK_SECONDS,
+					ENTITY_RADIUS, n, hits.data());
+			else
+				collide_circle_batch(0, 0, ENTITY_RADIUS, m.x.data(), m.y.data(), ENTITY_RADIUS, n, hits.data());
+		}
+		pairs += (long long)reps * n;
+		now = bench_now_ns();
+	}
+	bench_keep(hits[0]);
+	return pairs / ((now - start) / 1e9);
+}
+
+
+int main(int argc, char** argv)
+{
+	double seconds = bench_seconds(argc, argv, 0.5);
+	int best = cpu_simd_level();
+	bool ok = true;
+
+	for (int level = SIMD_SCALAR; level <= best; level++)
+		ok = verify(level) && ok;
+	collide_set_simd_level(best);
+	ok = against_sub_steps() && ok;
+
+	tunnelling();
+
+	printf("\n%-8s %18s %18s\n", "isa", "overlap 1x100000", "swept 1x100000");
+	for (int level = SIMD_SCALAR; level <= best; level++)
+	{
+		collide_set_simd_level(level);
+		printf("%-8s", simd_level_name(level));
+		printf(" %13.1f Mp/s", measure(false, 100000, seconds) / 1e6);
+		printf(" %13.1f Mp/s\n", measure(true, 100000, seconds) / 1e6);
+	}
+	return ok ? 0 : 1;
+}
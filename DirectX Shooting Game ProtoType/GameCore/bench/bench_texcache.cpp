@@ -0,0 +1,190 @@
+//-----------------------------------------------------------------------------
+// File: bench_texcache.cpp
+//
+// Desc: Loading the 34-frame "DirectX 2D Sprite" set from PNG against
+//       loading it from baked textures, warm (files in the page cache) and
+//       cold (dropped from it first, where the OS allows that).
+//
+//           bench_texcache [--quick]
+//
+//       A PNG load decodes, applies the color key and premultiplies, which
+//       is what the baked file holds already. A baked load maps the file and
+//       reads every texel once, so both sides touch all the pixels.
+//
+//       Also checks that the baked level 0 matches the PNG path exactly,
+//       that the mip chain has the right sizes, and that a bake is seen as
+//       stale against another source or color key.
+//-----------------------------------------------------------------------------
+#include <algorithm>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "BakedTexture.h"
+#include "ImageFile.h"
+#include "BenchUtil.h"
+
+#define FRAME_COUNT 34
+#define COLOR_KEY 0xff00ff
+
+
+// the PNG path: decode, key, premultiply
+static bool load_from_png(const std::string& path, std::vector<unsigned int>& argb, int& w, int& h)
+{
+	if (!load_png(path.c_str(), argb, w, h))
+		return false;
+	apply_color_key(argb, COLOR_KEY);
+	for (size_t i = 0; i < argb.size(); i++)
+	{
+		unsigned int c = argb[i], a = c >> 24;
+		argb[i] = (a << 24) | (div255(((c >> 16) & 0xff) * a) << 16) | (div255(((c >> 8) & 0xff) * a) << 8) | div255((c & 0xff) * a);
+	}
+	return true;
+}
+
+
+// ask the OS to forget a file's cached pages; false where it can't
+static bool drop_from_cache(const std::string& path)
+{
+#if defined(_WIN32)
+	(void)path;
+	return false;
+#else
+	int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0)
+		return false;
+	bool ok = fdatasync(fd) == 0 && posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED) == 0;
+	::close(fd);
+	return ok;
+#endif
+}
+
+
+// milliseconds to load every file one way or the other
+static double load_set(const std::vector<std::string>& files, bool baked, bool cold, unsigned long long& sum)
+{
+	if (cold)
+	{
+		for (size_t i = 0; i < files.size(); i++)
+			drop_from_cache(files[i]);
+	}
+
+	double start = bench_now_ns();
+	for (size_t i = 0; i < files.size(); i++)
+	{
+		if (baked)
+		{
+			BakedTexture t;
+			if (!t.open(files[i].c_str()))
+				continue;
+			const unsigned int* p = t.pixels(0);
+			for (int k = 0; k < t.width(0) * t.height(0); k++)
+				sum += p[k];
+		}
+		else
+		{
+			std::vector<unsigned int> argb;
+			int w, h;
+			if (!load_from_png(files[i], argb, w, h))
+				continue;
+			for (size_t k = 0; k < argb.size(); k++)
+				sum += argb[k];
+		}
+	}
+	return (bench_now_ns() - start) / 1e6;
+}
+
+
+int main(int argc, char** argv)
+{
+	double seconds = bench_seconds(argc, argv, 1.0);
+	bool ok = true;
+
+	std::vector<std::string> pngs, baked;
+	for (int group = 1; group <= 3; group++)
+	{
+		for (int i = 1; i <= (group == 3 ? 12 : 11); i++)
+		{
+			std::string name = std::to_string(group) + "-" + std::to_string(i);
+			pngs.push_back(std::string(FRAME_SET_DIR) + "/" + name + ".png");
+			baked.push_back("bench_texcache_" + name + ".btex");
+		}
+	}
+
+	double start = bench_now_ns();
+	bool baked_all = true;
+	for (int i = 0; i < FRAME_COUNT; i++)
+		baked_all = bake_texture(pngs[i].c_str(), baked[i].c_str(), COLOR_KEY, true, 0) && baked_all;
+	printf("baked %d textures with full mip chains in %.2f ms\n", FRAME_COUNT, (bench_now_ns() - start) / 1e6);
+	ok = check(baked_all, "every texture baked") && ok;
+
+	// the same pixels both ways, the right mip sizes, stale bakes spotted
+	bool same = true, chain = true;
+	for (int i = 0; ok && i < FRAME_COUNT; i++)
+	{
+		std::vector<unsigned int> argb;
+		int w, h;
+		BakedTexture t;
+		same = same && load_from_png(pngs[i], argb, w, h) && t.open(baked[i].c_str()) && t.width(0) == w && t.height(0) == h
+			&& std::equal(argb.begin(), argb.end(), t.pixels(0)) && t.premultiplied();
+		for (int l = 1; same && l < t.levels(); l++)
+			chain = chain && t.width(l) == std::max(1, t.width(l - 1) / 2) && t.height(l) == std::max(1, t.height(l - 1) / 2);
+		chain = chain && same && t.width(t.levels() - 1) == 1 && t.height(t.levels() - 1) == 1;
+	}
+	ok = check(same, "baked level 0 matches the PNG path") && ok;
+	ok = check(chain, "mip chain halves down to 1x1") && ok;
+
+	BakedTexture first;
+	bool stale = first.open(baked[0].c_str()) && first.matches(pngs[0].c_str(), COLOR_KEY)
+		&& !first.matches(pngs[1].c_str(), COLOR_KEY) && !first.matches(pngs[0].c_str(), -1);
+	first.close();
+	ok = check(stale, "stale bakes are spotted") && ok;
+
+	long long png_bytes = 0, baked_bytes = 0;
+	for (int i = 0; i < FRAME_COUNT; i++)
+	{
+		MappedFile f;
+		if (f.open(pngs[i].c_str()))
+			png_bytes += (long long)f.size();
+		if (f.open(baked[i].c_str()))
+			baked_bytes += (long long)f.size();
+	}
+	printf("on disk: PNG %lld KB, baked %lld KB\n", png_bytes / 1024, baked_bytes / 1024);
+
+	bool can_drop = drop_from_cache(pngs[0]);
+	printf("%-8s %-6s %6s %12s %12s\n", "source", "cache", "runs", "median ms", "best ms");
+	unsigned long long sum_png = 0, sum_baked = 0;
+	for (int cold = 0; cold < 2; cold++)
+	{
+		if (cold && !can_drop)
+		{
+			printf("cold runs skipped: the page cache can't be dropped here\n");
+			break;
+		}
+
+		// the two sources take turns, so neither gets the warmer caches
+		std::vector<double> times[2];
+		double begin = bench_now_ns();
+		while (bench_now_ns() - begin < seconds * 1e9 / 2 || times[0].size() < 3)
+		{
+			times[0].push_back(load_set(pngs, false, cold != 0, sum_png));
+			times[1].push_back(load_set(baked, true, cold != 0, sum_baked));
+		}
+		for (int b = 0; b < 2; b++)
+		{
+			std::sort(times[b].begin(), times[b].end());
+			printf("%-8s %-6s %6d %12.3f %12.3f\n", b ? "baked" : "png", cold ? "cold" : "warm", (int)times[b].size(),
+				times[b][times[b].size() / 2], times[b][0]);
+		}
+	}
+	ok = check(sum_png == sum_baked, "both loads read the same texels") && ok;
+
+	for (int i = 0; i < FRAME_COUNT; i++)
+		remove(baked[i].c_str());
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,135 @@
+//-----------------------------------------------------------------------------
+// File: bench_timestep.cpp
+//
+// Desc: Frame pacing. The FixedStep checks run on a ManualClock, so they need
+//       no wall time: the tick count must follow the clock through slow
+//       frames, stalls and a coarse sleep timer, and the program exits
+//       non-zero if it does not. Then the real clock paces an idle loop at
+//       TICK_RATE, reporting the CPU time used while waiting and the jitter.
+//-----------------------------------------------------------------------------
+#include <stdio.h>
+#include <time.h>
+
+#include "Sim.h"
+#include "Timestep.h"
+#include "BenchUtil.h"
+
+
+// run a simulated game loop for seconds of clock time: each frame does
+// work_seconds of work, plus stall_seconds on frame stall_frame
+static long long run_manual(ManualClock& clock, FixedStep& step, double seconds, double work_seconds,
+	int stall_frame, double stall_seconds, int* most_per_frame)
+{
+	long long ticks = 0;
+	*most_per_frame = 0;
+	double end = clock.now() + seconds;
+
+	for (int frame = 0; clock.now() < end; frame++)
+	{
+		int n = step.advance();
+		ticks += n;
+		if (n > *most_per_frame)
+			*most_per_frame = n;
+
+		clock.advance(work_seconds);
+		if (frame == stall_frame)
+			clock.advance(stall_seconds);
+		step.wait();
+	}
+	return ticks;
+}
+
+
+static bool check_manual()
+{
+	bool ok = true;
+	int most;
+
+	// steady frames: one tick each, on time
+	{
+		ManualClock clock;
+		FixedStep step(clock, 1.0 / TICK_RATE, 8);
+		long long ticks = run_manual(clock, step, 10, 0.005, -1, 0, &most);
+		ok = check(ticks >= 10 * TICK_RATE - 1 && ticks <= 10 * TICK_RATE && most == 1,
+			"steady: one tick per frame, 10 s of ticks in 10 s") && ok;
+		ok = check(step.jitter_max() <= clock.spin_step, "steady: no frame later than one spin step") && ok;
+		ok = check(clock.spins < clock.sleeps * 40, "steady: waits mostly sleep instead of spinning") && ok;
+	}
+
+	// one 100 ms stall: the next frame catches up, nothing is lost
+	{
+		ManualClock clock;
+		FixedStep step(clock, 1.0 / TICK_RATE, 8);
+		long long ticks = run_manual(clock, step, 10, 0.005, 100, 0.1, &most);
+		ok = check(ticks >= 10 * TICK_RATE - 1 && ticks <= 10 * TICK_RATE && most >= 4,
+			"100 ms stall: caught up on the next frame") && ok;
+		ok = check(step.dropped_ticks() == 0, "100 ms stall: no ticks dropped") && ok;
+	}
+
+	// every frame takes longer than a tick: still runs at full game speed
+	{
+		ManualClock clock;
+		FixedStep step(clock, 1.0 / TICK_RATE, 8);
+		long long ticks = run_manual(clock, step, 10, 0.06, -1, 0, &most);
+		ok = check(ticks >= 10 * TICK_RATE - 3 && ticks <= 10 * TICK_RATE && most >= 2,
+			"60 ms frames: game speed unchanged") && ok;
+	}
+
+	// a 2 s stall is more than max_ticks can cover; the excess is dropped
+	{
+		ManualClock clock;
+		FixedStep step(clock, 1.0 / TICK_RATE, 8);
+		long long ticks = run_manual(clock, step, 10, 0.005, 100, 2.0, &most);
+		ok = check(most == 8 && ticks + step.dropped_ticks() >= 10 * TICK_RATE - 1 &&
+			ticks + step.dropped_ticks() <= 10 * TICK_RATE, "2 s stall: capped at 8 ticks, the rest dropped") && ok;
+	}
+
+	// a timer that oversleeps by 3 ms: the margin learns it and frames
+	// stay on time
+	{
+		ManualClock clock;
+		clock.oversleep = 0.003;
+		FixedStep step(clock, 1.0 / TICK_RATE, 8);
+		run_manual(clock, step, 1, 0.005, -1, 0, &most);
+		step.reset_stats();
+		run_manual(clock, step, 10, 0.005, -1, 0, &most);
+		ok = check(step.sleep_margin() >= 0.003 && step.jitter_max() <= clock.spin_step,
+			"3 ms oversleep: margin adapts, frames stay on time") && ok;
+	}
+
+	return ok;
+}
+
+
+// idle loop on the real clock; reports CPU time spent waiting
+static void bench_system(double seconds)
+{
+	SystemClock sys;
+	FixedStep step(sys, 1.0 / TICK_RATE, 8);
+
+	long long ticks = 0;
+	clock_t cpu0 = clock();
+	double start = sys.now();
+	while (sys.now() - start < seconds)
+	{
+		ticks += step.advance();
+		step.wait();
+	}
+	double wall = sys.now() - start;
+	double cpu = (double)(clock() - cpu0) / CLOCKS_PER_SEC;
+
+	printf("system clock, %d Hz for %.2f s: %lld ticks, cpu %.1f%%, sleep margin %.3f ms, jitter mean %.3f ms max %.3f ms\n",
+		TICK_RATE, wall, ticks, cpu / wall * 100, step.sleep_margin() * 1000,
+		step.jitter_mean() * 1000, step.jitter_max() * 1000);
+}
+
+
+int main(int argc, char** argv)
+{
+	double seconds = bench_seconds(argc, argv, 2.0);
+
+	bool ok = check_manual();
+	bench_system(seconds);
+
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,155 @@
+//-----------------------------------------------------------------------------
+// File: atlas_pack.cpp
+//
+// Desc: Packs sprite PNGs onto one atlas page.
+//
+//           atlas_pack [--padding <n>] [--key <RRGGBB>] [--max <size>] <out> <png or directory>...
+//
+//       Writes <out>.png (RGBA) and the sprite table <out>.atlas. Every
+//       .png in a directory is taken, in name order. --key makes pixels of
+//       that opaque color transparent, as the D3DX color key does; the game
+//       packs with --key ff00ff. Prints the page size, density and time.
+//-----------------------------------------------------------------------------
+#include <algorithm>
+#include <chrono>
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <sys/stat.h>
+#endif
+
+#include "Atlas.h"
+#include "ImageFile.h"
+
+
+static double now_ms()
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+
+static bool has_png_extension(const char* name)
+{
+	size_t n = strlen(name);
+	if (n < 4)
+		return false;
+	const char* ext = name + n - 4;
+	return ext[0] == '.' && tolower((unsigned char)ext[1]) == 'p' && tolower((unsigned char)ext[2]) == 'n' && tolower((unsigned char)ext[3]) == 'g';
+}
+
+
+// the PNGs in a directory, or false if path isn't one
+static bool list_directory(const std::string& path, std::vector<std::string>& files)
+{
+	std::vector<std::string> names;
+#if defined(_WIN32)
+	WIN32_FIND_DATAA found;
+	HANDLE h = FindFirstFileA((path + "\\*").c_str(), &found);
+	if (h == INVALID_HANDLE_VALUE)
+		return false;
+	do
+	{
+		if (!(found.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) && has_png_extension(found.cFileName))
+			names.push_back(found.cFileName);
+	} while (FindNextFileA(h, &found));
+	FindClose(h);
+#else
+	struct stat st;
+	if (stat(path.c_str(), &st) != 0 || !S_ISDIR(st.st_mode))
+		return false;
+	DIR* dir = opendir(path.c_str());
+	if (!dir)
+		return false;
+	while (struct dirent* e = readdir(dir))
+	{
+		if (has_png_extension(e->d_name))
+			names.push_back(e->d_name);
+	}
+	closedir(dir);
+#endif
+
+	std::sort(names.begin(), names.end());
+	for (size_t i = 0; i < names.size(); i++)
+		files.push_back(path + "/" + names[i]);
+	return true;
+}
+
+
+int main(int argc, char** argv)
+{
+	int padding = 1;
+	int key = -1;
+	int max_size = ATLAS_MAX_SIZE;
+	std::vector<std::string> inputs;
+	const char* out = NULL;
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--padding") == 0 && i + 1 < argc)
+			padding = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--key") == 0 && i + 1 < argc)
+			key = (int)strtol(argv[++i], NULL, 16);
+		else if (strcmp(argv[i], "--max") == 0 && i + 1 < argc)
+			max_size = atoi(argv[++i]);
+		else if (!out)
+			out = argv[i];
+		else
+			inputs.push_back(argv[i]);
+	}
+	if (!out || inputs.empty() || padding < 0)
+	{
+		fprintf(stderr, "usage: atlas_pack [--padding <n>] [--key <RRGGBB>] [--max <size>] <out> <png or directory>...\n");
+		return 2;
+	}
+
+	std::vector<std::string> files;
+	for (size_t i = 0; i < inputs.size(); i++)
+	{
+		if (!list_directory(inputs[i], files))
+			files.push_back(inputs[i]);
+	}
+
+	double start = now_ms();
+	std::vector<AtlasImage> images(files.size());
+	for (size_t i = 0; i < files.size(); i++)
+	{
+		if (!load_atlas_image(files[i].c_str(), key, images[i]))
+		{
+			fprintf(stderr, "atlas_pack: can't read %s\n", files[i].c_str());
+			return 1;
+		}
+	}
+	double loaded = now_ms();
+
+	AtlasPage page;
+	if (!pack_atlas(images, padding, max_size, page))
+	{
+		fprintf(stderr, "atlas_pack: %d images don't fit on a %dx%d page\n", (int)images.size(), max_size, max_size);
+		return 1;
+	}
+	double packed = now_ms();
+
+	// the table names the page without its directory, as it sits beside it
+	std::string png = std::string(out) + ".png";
+	std::string table = std::string(out) + ".atlas";
+	size_t slash = png.find_last_of("/\\");
+	std::string page_file = slash == std::string::npos ? png : png.substr(slash + 1);
+	if (!save_png_alpha(png.c_str(), page.argb.data(), page.w, page.h)
+		|| !save_atlas_table(table.c_str(), page_file.c_str(), images, page))
+	{
+		fprintf(stderr, "atlas_pack: can't write %s\n", out);
+		return 1;
+	}
+
+	printf("%d sprites on a %dx%d page, %.1f%% used\n", (int)images.size(), page.w, page.h,
+		100.0 * atlas_density(images, page));
+	printf("decode %.2f ms, pack %.2f ms\n", loaded - start, packed - loaded);
+	return 0;
+}
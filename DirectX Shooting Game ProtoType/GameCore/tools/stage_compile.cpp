@@ -0,0 +1,55 @@
+//-----------------------------------------------------------------------------
+// File: stage_compile.cpp
+//
+// Desc: Compiles stage source into the mapped stage format of Stage.h.
+//
+//           stage_compile [--rate <ticks per second>] <in.txt> <out.stage>
+//
+//       --rate is the tick rate the game runs at (default: TICK_RATE); a
+//       stage only opens at the rate it was compiled for.
+//-----------------------------------------------------------------------------
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Sim.h"
+#include "Stage.h"
+
+
+int main(int argc, char** argv)
+{
+	int rate = TICK_RATE;
+	const char* in = NULL;
+	const char* out = NULL;
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--rate") == 0 && i + 1 < argc)
+			rate = atoi(argv[++i]);
+		else if (!in)
+			in = argv[i];
+		else
+			out = argv[i];
+	}
+	if (!in || !out)
+	{
+		fprintf(stderr, "usage: stage_compile [--rate <ticks per second>] <in.txt> <out.stage>\n");
+		return 2;
+	}
+
+	std::string error;
+	if (!compile_stage_file(in, out, rate, error))
+	{
+		fprintf(stderr, "stage_compile: %s: %s\n", in, error.c_str());
+		return 1;
+	}
+
+	Stage stage;
+	if (!stage.open(out, rate))
+	{
+		fprintf(stderr, "stage_compile: %s doesn't read back\n", out);
+		return 1;
+	}
+	unsigned int last = stage.spawn_count() > 0 ? stage.spawn(stage.spawn_count() - 1).tick : 0;
+	printf("%s: %d spawns over %.1f s, %d scripts\n", out, stage.spawn_count(), (double)last / rate, stage.script_count());
+	return 0;
+}
@@ -0,0 +1,71 @@
+//-----------------------------------------------------------------------------
+// File: texture_bake.cpp
+//
+// Desc: Bakes a PNG into the mapped texture format of BakedTexture.h.
+//
+//           texture_bake [--key <RRGGBB>] [--straight] [--levels <n>] <in.png> <out.btex>
+//
+//       --key makes that opaque color transparent, as the D3DX color key
+//       does; --straight keeps straight alpha instead of premultiplying;
+//       --levels caps the mip chain (default: all of it). Does nothing if
+//       out is already baked from the same source with the same options.
+//-----------------------------------------------------------------------------
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "BakedTexture.h"
+
+
+int main(int argc, char** argv)
+{
+	int key = -1;
+	bool premultiply = true;
+	int levels = 0;
+	const char* in = NULL;
+	const char* out = NULL;
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--key") == 0 && i + 1 < argc)
+			key = (int)strtol(argv[++i], NULL, 16);
+		else if (strcmp(argv[i], "--straight") == 0)
+			premultiply = false;
+		else if (strcmp(argv[i], "--levels") == 0 && i + 1 < argc)
+			levels = atoi(argv[++i]);
+		else if (!in)
+			in = argv[i];
+		else
+			out = argv[i];
+	}
+	if (!in || !out)
+	{
+		fprintf(stderr, "usage: texture_bake [--key <RRGGBB>] [--straight] [--levels <n>] <in.png> <out.btex>\n");
+		return 2;
+	}
+
+	BakedTexture current;
+	if (current.open(out) && current.matches(in, key) && current.premultiplied() == premultiply
+		&& (levels > 0 ? current.levels() == levels
+			: current.width(current.levels() - 1) == 1 && current.height(current.levels() - 1) == 1))
+	{
+		printf("%s is up to date\n", out);
+		return 0;
+	}
+	current.close();
+
+	if (!bake_texture(in, out, key, premultiply, levels))
+	{
+		fprintf(stderr, "texture_bake: can't bake %s into %s\n", in, out);
+		return 1;
+	}
+
+	BakedTexture baked;
+	if (!baked.open(out))
+	{
+		fprintf(stderr, "texture_bake: %s doesn't read back\n", out);
+		return 1;
+	}
+	printf("%s: %dx%d, %d levels, %s\n", out, baked.width(0), baked.height(0), baked.levels(),
+		baked.premultiplied() ? "premultiplied" : "straight alpha");
+	return 0;
+}
@@ -4,15 +4,26 @@
 #include <d3d9.h>
 #include <d3dx9.h>
 #include <iostream>
-
-// define the screen resolution and keyboard macros
-#define SCREEN_WIDTH 640
-#define SCREEN_HEIGHT 480
+#include <stdio.h>
+#include <string.h>
+
+#include "GameCore/AssetLoader.h"
+#include "GameCore/Atlas.h"
+#include "GameCore/BakedTexture.h"
+#include "GameCore/Hud.h"
+#include "GameCore/Particles.h"
+#include "GameCore/Profiler.h"
+#include "GameCore/Sim.h"
+#include "GameCore/Replay.h"
+#include "GameCore/SpriteBatch.h"
+#include "GameCore/Stage.h"
+#include "GameCore/Timestep.h"
+#include "GameCore/WorldSprites.h"
+
+// define the keyboard macros
 #define KEY_DOWN(vk_code) ((GetAsyncKeyState(vk_code) & 0x8000) ? 1 : 0)
 #define KEY_UP(vk_code) ((GetAsyncKeyState(vk_code) & 0x8000) ? 0 : 1)
 
-#define ENEMY_NUM 5
-
 
 // include the Direct3D Library file
 #pragma comment (lib, "d3d9.lib")
@@ -22,338 +33,98 @@
 LPDIRECT3D9 d3d;    // the pointer to our Direct3D interface
 LPDIRECT3DDEVICE9 d3ddev;    // the pointer to the device class
 LPD3DXSPRITE d3dspt;    // the pointer to our Direct3D Sprite interface
-ID3DXFont *font; // 
-RECT fRectangle;
-std::string message;
+
+// the HUD: the title, the batch counters and the hit points, drawn from a
+// glyph atlas of 40 pixel Arial baked at startup
+#define HUD_FONT_HEIGHT 40
+GlyphAtlas hud_font;
+Hud hud;
+int hud_stats, hud_hp, hud_boss_hp;
 
 
 
 						// sprite declarations
 LPDIRECT3DTEXTURE9 sprite;    // the pointer to the sprite
-LPDIRECT3DTEXTURE9 sprite_hero;    // the pointer to the sprite
-LPDIRECT3DTEXTURE9 sprite_enemy;    // the pointer to the sprite
-LPDIRECT3DTEXTURE9 sprite_bullet;    // the pointer to the sprite
-LPDIRECT3DTEXTURE9 sprite_superbullet;
-LPDIRECT3DTEXTURE9 sprite_enemybullet;
-
-
-
-									 // function prototypes
-void initD3D(HWND hWnd);    // sets up and initializes Direct3D
-void render_frame(void);    // renders a single frame
-void cleanD3D(void);		// closes Direct3D and releases memory
-
-void init_game(void);
-void do_game_logic(void);
-bool sphere_collision_check(float x0, float y0, float size0, float x1, float y1, float size1);
-
-
-// the WindowProc function prototype
-LRESULT CALLBACK WindowProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam);
-
-using namespace std;
-
 
-enum { MOVE_UP, MOVE_DOWN, MOVE_LEFT, MOVE_RIGHT };
+// the sprite textures by the id the sprite batch sorts on; every game
+// sprite is a rectangle of the one atlas page, built by atlas_pack from
+// Gundam, Enemy2, Bomb, HaroBullet and Boss.png, and the HUD's glyphs
+// are on a page of their own
+enum { TEXTURE_ATLAS, TEXTURE_FONT, TEXTURE_NUM };
+LPDIRECT3DTEXTURE9 textures[TEXTURE_NUM];
+AtlasTable atlas;
+SpriteFrame frames[SPRITE_KIND_NUM];
 
+// hit sparks and explosions, fed by the events of every tick and drawn as
+// the bullet shrunk to 8 pixels, above all the game sprites
+#define PARTICLE_CAPACITY 16384
+#define PARTICLE_SIZE 8
+ParticleSystem particles;
+SpriteFrame particle_frame;
+bool sprites_premultiplied;
 
-//⺻ Ŭ 
-class entity {
-
-public:
-	float x_pos;
-	float y_pos;
-	int status;
-	int HP;
-
-};
-
-
-bool sphere_collision_check(float x0, float y0, float size0, float x1, float y1, float size1)
-{
-
-	if ((x0 - x1)*(x0 - x1) + (y0 - y1)*(y0 - y1) < (size0 + size1) * (size0 + size1))
-		return true;
-	else
-		return false;
-
-}
-
+// images decoded on the job threads at startup: Panel5 and the atlas page
+#define STARTUP_IMAGES 2
+AssetLoader assets;
 
+#define SPRITE_FVF (D3DFVF_XYZRHW | D3DFVF_DIFFUSE | D3DFVF_TEX1)
 
-//ΰ Ŭ 
-class Hero :public entity {
+// draws each texture run of the sprite batch with one call
+class D3DSpriteBackend : public SpriteBackend {
 
 public:
-	void fire();
-	void super_fire();
-	void move(int i);
-	void init(float x, float y);
-
-
-};
-
-void Hero::init(float x, float y)
-{
-
-	x_pos = x;
-	y_pos = y;
-
-}
-
-void Hero::move(int i)
-{
-	switch (i)
+	void draw(int texture, const SpriteVertex* vertices, int quads, const unsigned short* indices)
 	{
-	case MOVE_UP:
-		y_pos -= 5;
-		break;
-
-	case MOVE_DOWN:
-		y_pos += 5;
-		break;
-
-
-	case MOVE_LEFT:
-		x_pos -= 5;
-		break;
-
-
-	case MOVE_RIGHT:
-		x_pos += 5;
-		break;
-
+		d3ddev->SetTexture(0, textures[texture]);
+		d3ddev->DrawIndexedPrimitiveUP(D3DPT_TRIANGLELIST, 0, quads * 4, quads * 2,
+			indices, D3DFMT_INDEX16, vertices, sizeof(SpriteVertex));
 	}
-
-}
-
-
-
-
-//  Ŭ 
-class Enemy :public entity {
-
-public:
-	void fire();
-	void init(float x, float y);
-	void move();
-
 };
 
-void Enemy::init(float x, float y)
-{
-
-	x_pos = x;
-	y_pos = y;
-
-}
-
-
-void Enemy::move()
-{
-	y_pos += 2;
-
-}
-
-
-class EnemyBullet :public entity {
-
-public:
-	bool bShow;
-	void init(float x, float y);
-	void move();
-	bool show();
-	void hide();
-	void active();
-	bool check_collision(float x, float y);
-};
-
-bool EnemyBullet::check_collision(float x, float y)
-{
-
-	//浹 ó  
-	if (sphere_collision_check(x_pos, y_pos, 32, x, y, 32) == true)
-	{
-		bShow = false;
-		return true;
-	}
-	else {
-		return false;
-	}
-}
-
-void EnemyBullet::init(float x, float y)
-{
-	x_pos = x;
-	y_pos = y;
-}
-
-
-
-bool EnemyBullet::show()
-{
-	return bShow;
-}
-
-
-void EnemyBullet::active()
-{
-	bShow = true;
-}
-
-
-
-void EnemyBullet::move()
-{
-	y_pos += 8;
-}
-
-void EnemyBullet::hide()
-{
-	bShow = false;
-}
-
+LPDIRECT3DTEXTURE9 texture_from_argb(const unsigned int* argb, int w, int h);	// uploads one image
 
-
-
-
-
-
-// Ѿ Ŭ 
-class Bullet :public entity {
+// the upload stage of the asset loader: each decoded image becomes a
+// managed texture, on the thread that owns the device
+class D3DTextureSink : public TextureSink {
 
 public:
-	bool bShow;
-
-	void init(float x, float y);
-	void move();
-	bool show();
-	void hide();
-	void active();
-	bool check_collision(float x, float y);
-};
-
-bool Bullet::check_collision(float x, float y)
-{
+	LPDIRECT3DTEXTURE9 loaded[STARTUP_IMAGES];
 
-	//浹 ó  
-	if (sphere_collision_check(x_pos, y_pos, 32, x, y, 32) == true)
+	void upload(int handle, const unsigned int* argb, int w, int h)
 	{
-		bShow = false;
-		return true;
-
+		loaded[handle] = texture_from_argb(argb, w, h);
 	}
-	else {
-		return false;
-	}
-}
-
-void Bullet::init(float x, float y)
-{
-	x_pos = x;
-	y_pos = y;
-
-}
-
-
-
-bool Bullet::show()
-{
-	return bShow;
-
-}
-
-
-void Bullet::active()
-{
-	bShow = true;
-
-}
-
-
-
-void Bullet::move()
-{
-	y_pos -= 10;
-}
-
-void Bullet::hide()
-{
-	bShow = false;
-}
-
-
-class SuperBullet :public entity {
-
-public:
-	bool bShow;
-	void init(float x, float y);
-	void move();
-	bool show();
-	void hide();
-	void active();
-	bool check_collision(float x, float y);
 };
 
 
-bool SuperBullet::check_collision(float x, float y)
-{
-
-	//浹 ó  
-	if (sphere_collision_check(x_pos, y_pos, 32, x, y, 32) == true)
-	{
-		bShow = false;
-		return true;
-
-	}
-	else {
-
-		return false;
-	}
-}
-
-void SuperBullet::init(float x, float y)
-{
-	x_pos = x;
-	y_pos = y;
-
-}
-
-bool SuperBullet::show()
-{
-	return bShow;
-
-}
-
-
-void SuperBullet::active()
-{
-	bShow = true;
-
-}
-
 
+									 // function prototypes
+void initD3D(HWND hWnd);    // sets up and initializes Direct3D
+void render_frame(void);    // renders a single frame
+void cleanD3D(void);		// closes Direct3D and releases memory
+LPDIRECT3DTEXTURE9 texture_from_baked(const BakedTexture& baked);	// uploads every level of a baked texture
+bool bake_hud_font(GlyphAtlas& atlas, const char* face, int height, bool premultiplied);	// rasterizes a GDI font into a glyph atlas
 
-void SuperBullet::move()
-{
-	y_pos -= 20;
-}
-
-void SuperBullet::hide()
-{
-	bShow = false;
-}
+SimInput sample_input(void);	// reads the keyboard for one tick
+SimInput next_input(void);	// input of the next tick, from the keyboard or a replay
 
 
+// the WindowProc function prototype
+LRESULT CALLBACK WindowProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam);
 
+using namespace std;
 
 
 //ü  
-Hero hero;
-Enemy enemy[ENEMY_NUM];
-Bullet bullet;
-SuperBullet Superbullet;
-EnemyBullet enemybullet;
+World world;
+JobSystem jobs;
+ReplayWriter recorder;
+ReplayReader playback;
+SpriteBatch batch;
+SpriteCuller culler;
+Stage stage;
+D3DSpriteBackend sprite_backend;
+D3DTextureSink texture_sink;
 
 
 // the entry point for any Windows program
@@ -382,12 +153,91 @@ int WINAPI WinMain(HINSTANCE hInstance,
 
 	ShowWindow(hWnd, nCmdShow);
 
+	// the job threads decode the startup images, then run the game logic
+	jobs.start(0);
+
 	// set up and initialize Direct3D
 	initD3D(hWnd);
 
+	// -record <file> saves this session's input, -replay <file> plays one back,
+	// -profile <file> saves a Chrome trace of the zones at exit
+	unsigned int seed = 1;
+	const char* record_path = NULL;
+	const char* trace_path = NULL;
+	bool replaying = false;
+	if (strncmp(lpCmdLine, "-replay ", 8) == 0 && playback.open(lpCmdLine + 8))
+	{
+		// set up from the script and stage it was recorded with, and only
+		// if they haven't changed since
+		seed = playback.info().seed;
+		replaying = start_replay(world, playback, stage);
+		if (!replaying)
+		{
+			OutputDebugStringA("replay: its script or stage isn't the one it was recorded with\n");
+			playback.close();
+		}
+	}
+	else if (strncmp(lpCmdLine, "-record ", 8) == 0)
+	{
+		record_path = lpCmdLine + 8;
+	}
+	else if (strncmp(lpCmdLine, "-profile ", 9) == 0)
+	{
+		trace_path = lpCmdLine + 9;
+	}
+
 
 	// Ʈ ʱȭ 
-	init_game();
+	if (!replaying)
+	{
+		// enemies come from stage1.stage when it is there (stage_compile
+		// stage1.txt stage1.stage), with room for a screenful of them
+		bool staged = stage.open("stage1.stage", TICK_RATE);
+		init_game(world, staged ? STAGE_ENEMY_NUM : ENEMY_NUM, seed);
+
+		// enemies move by enemies.move; without it, or if it doesn't compile,
+		// they fall straight down
+		MoveProgram enemy_script;
+		bool scripted = enemy_script.load("enemies.move", TICK_SECONDS);
+		if (scripted)
+			set_enemy_script(world, enemy_script);
+		else
+		{
+			OutputDebugStringA(enemy_script.error());
+			OutputDebugStringA("\n");
+		}
+		if (staged && !set_stage(world, stage))
+		{
+			OutputDebugStringA("stage1.stage: a script doesn't compile\n");
+			staged = false;
+		}
+
+		// the recording names the script and stage that were set, so a
+		// replay of it sets up the same game
+		if (record_path)
+			recorder.open(record_path, seed, world.enemy.count(), scripted ? "enemies.move" : NULL,
+				staged ? "stage1.stage" : NULL);
+	}
+	int enemy_num = world.enemy.count();
+
+	// -0.5 puts pixel centers on texel centers
+	batch.init(world_sprite_capacity(enemy_num) + PARTICLE_CAPACITY, -0.5f);
+
+	// particles fall a little and lose half their speed a second
+	particles.init(PARTICLE_CAPACITY, 300.0f, 0.5f, seed);
+
+	// only what is on screen goes into the draw list
+	culler.reserve(world_sprite_capacity(enemy_num));
+	culler.set_view(screen_view());
+
+	// spread the game logic over every core
+	world.jobs = &jobs;
+
+	// 1 ms sleeps, so the frame limiter can sleep instead of spinning
+	timeBeginPeriod(1);
+
+	SystemClock frame_clock;
+	FixedStep step(frame_clock, TICK_SECONDS, 8);
 
 	// enter the main loop:
 
@@ -395,8 +245,6 @@ int WINAPI WinMain(HINSTANCE hInstance,
 
 	while (TRUE)
 	{
-		DWORD starting_point = GetTickCount();
-
 		if (PeekMessage(&msg, NULL, 0, 0, PM_REMOVE))
 		{
 			if (msg.message == WM_QUIT)
@@ -406,7 +254,14 @@ int WINAPI WinMain(HINSTANCE hInstance,
 			DispatchMessage(&msg);
 		}
 
-		do_game_logic();
+		// run every tick that came due, so a slow frame doesn't slow the game
+		int ticks = step.advance();
+		for (int i = 0; i < ticks; i++)
+		{
+			do_game_logic(world, next_input());
+			emit_effects(world, particles);
+			particles.update(TICK_SECONDS);
+		}
 
 		render_frame();
 
@@ -414,11 +269,18 @@ int WINAPI WinMain(HINSTANCE hInstance,
 		if (KEY_DOWN(VK_ESCAPE))
 			PostMessage(hWnd, WM_DESTROY, 0, 0);
 
+		PROFILE_SCOPE("wait");
+		step.wait();
+	}
 
+	recorder.close();
+	jobs.stop();
 
-
-		while ((GetTickCount() - starting_point) < 25);
-	}
+	// the zone summary goes to stdout, for a console or a redirect
+	profile_print_summary(stdout);
+	if (trace_path)
+		profile_write_trace(trace_path);
+	timeEndPeriod(1);
 
 	// clean up DirectX and COM
 	cleanD3D();
@@ -446,6 +308,16 @@ LRESULT CALLBACK WindowProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lPara
 // this function initializes and prepares Direct3D for use
 void initD3D(HWND hWnd)
 {
+	// start decoding the images; the device is created meanwhile. The atlas
+	// page needs no decoding when sprites.btex is baked from it as it is now
+	// (texture_bake --levels 1 sprites.png sprites.btex).
+	atlas.load("sprites.atlas");
+	BakedTexture baked;
+	bool use_baked = baked.open("sprites.btex") && baked.matches(atlas.page_file(), -1);
+	assets.init(&jobs, STARTUP_IMAGES);
+	int panel_image = assets.load("Panel5.png", 0xff00ff);
+	int atlas_image = use_baked ? -1 : assets.load(atlas.page_file(), -1);
+
 	d3d = Direct3DCreate9(D3D_SDK_VERSION);
 
 	D3DPRESENT_PARAMETERS d3dpp;
@@ -470,252 +342,210 @@ void initD3D(HWND hWnd)
 
 	D3DXCreateSprite(d3ddev, &d3dspt);    // create the Direct3D Sprite object
 
-	D3DXCreateTextureFromFileEx(d3ddev,    // the device pointer
-		L"Panel5.png",    // the file name
-		D3DX_DEFAULT,    // default width
-		D3DX_DEFAULT,    // default height
-		D3DX_DEFAULT,    // no mip mapping
-		NULL,    // regular usage
-		D3DFMT_A8R8G8B8,    // 32-bit pixels with alpha
-		D3DPOOL_MANAGED,    // typical memory handling
-		D3DX_DEFAULT,    // no filtering
-		D3DX_DEFAULT,    // no mip filtering
-		D3DCOLOR_XRGB(255, 0, 255),    // the hot-pink color key
-		NULL,    // no image info struct
-		NULL,    // not using 256 colors
-		&sprite);    // load to sprite
-
-
-	D3DXCreateTextureFromFileEx(d3ddev,    // the device pointer
-		L"Gundam.png",    // the file name
-		D3DX_DEFAULT,    // default width
-		D3DX_DEFAULT,    // default height
-		D3DX_DEFAULT,    // no mip mapping
-		NULL,    // regular usage
-		D3DFMT_A8R8G8B8,    // 32-bit pixels with alpha
-		D3DPOOL_MANAGED,    // typical memory handling
-		D3DX_DEFAULT,    // no filtering
-		D3DX_DEFAULT,    // no mip filtering
-		D3DCOLOR_XRGB(255, 0, 255),    // the hot-pink color key
-		NULL,    // no image info struct
-		NULL,    // not using 256 colors
-		&sprite_hero);    // load to sprite
-
-	D3DXCreateTextureFromFileEx(d3ddev,    // the device pointer
-		L"Enemy2.png",    // the file name
-		D3DX_DEFAULT,    // default width
-		D3DX_DEFAULT,    // default height
-		D3DX_DEFAULT,    // no mip mapping
-		NULL,    // regular usage
-		D3DFMT_A8R8G8B8,    // 32-bit pixels with alpha
-		D3DPOOL_MANAGED,    // typical memory handling
-		D3DX_DEFAULT,    // no filtering
-		D3DX_DEFAULT,    // no mip filtering
-		D3DCOLOR_XRGB(255, 0, 255),    // the hot-pink color key
-		NULL,    // no image info struct
-		NULL,    // not using 256 colors
-		&sprite_enemy);    // load to sprite
-
-	D3DXCreateTextureFromFileEx(d3ddev,    // the device pointer
-		L"bomb.png",    // the file name
-		D3DX_DEFAULT,    // default width
-		D3DX_DEFAULT,    // default height
-		D3DX_DEFAULT,    // no mip mapping
-		NULL,    // regular usage
-		D3DFMT_A8R8G8B8,    // 32-bit pixels with alpha
-		D3DPOOL_MANAGED,    // typical memory handling
-		D3DX_DEFAULT,    // no filtering
-		D3DX_DEFAULT,    // no mip filtering
-		D3DCOLOR_XRGB(255, 0, 255),    // the hot-pink color key
-		NULL,    // no image info struct
-		NULL,    // not using 256 colors
-		&sprite_enemybullet);    // load to sprite
-
-
-	D3DXCreateTextureFromFileEx(d3ddev,    // the device pointer
-		L"HaroBullet.png",    // the file name
-		D3DX_DEFAULT,    // default width
-		D3DX_DEFAULT,    // default height
-		D3DX_DEFAULT,    // no mip mapping
-		NULL,    // regular usage
-		D3DFMT_A8R8G8B8,    // 32-bit pixels with alpha
-		D3DPOOL_MANAGED,    // typical memory handling
-		D3DX_DEFAULT,    // no filtering
-		D3DX_DEFAULT,    // no mip filtering
-		D3DCOLOR_XRGB(255, 0, 255),    // the hot-pink color key
-		NULL,    // no image info struct
-		NULL,    // not using 256 colors
-		&sprite_bullet);    // load to sprite
-
-	D3DXCreateTextureFromFileEx(d3ddev,    // the device pointer
-		L"Boss.png",    // the file name
-		D3DX_DEFAULT,    // default width
-		D3DX_DEFAULT,    // default height
-		D3DX_DEFAULT,    // no mip mapping
-		NULL,    // regular usage
-		D3DFMT_A8R8G8B8,    // 32-bit pixels with alpha
-		D3DPOOL_MANAGED,    // typical memory handling
-		D3DX_DEFAULT,    // no filtering
-		D3DX_DEFAULT,    // no mip filtering
-		D3DCOLOR_XRGB(255, 0, 255),    // the hot-pink color key
-		NULL,    // no image info struct
-		NULL,    // not using 256 colors
-		&sprite_superbullet);    // load to sprite
-
-
-	font = NULL;
-	HRESULT hr = D3DXCreateFont(d3ddev, 40, 0, FW_NORMAL, 1, false, DEFAULT_CHARSET, OUT_DEFAULT_PRECIS, ANTIALIASED_QUALITY,
-		FF_DONTCARE, L"Arial", &font);
-	if (!SUCCEEDED(hr))
-	{
-		return;
-	}
-
-	SetRect(&fRectangle, 0, 0, 300, 200);
-	message = "Shooting Game";
+	// upload the images as they finish decoding. The atlas page already has
+	// its transparency baked in; Panel5 gets the hot-pink color key.
+	assets.finish(texture_sink);
+	sprite = texture_sink.loaded[panel_image];
+	textures[TEXTURE_ATLAS] = use_baked ? texture_from_baked(baked) : texture_sink.loaded[atlas_image];
+	bool premultiplied = use_baked && baked.premultiplied();
+	sprites_premultiplied = premultiplied;
+	baked.close();
+
+	atlas.find("Gundam", TEXTURE_ATLAS, frames[SPRITE_HERO]);
+	atlas.find("HaroBullet", TEXTURE_ATLAS, frames[SPRITE_BULLET]);
+	atlas.find("Boss", TEXTURE_ATLAS, frames[SPRITE_SUPER_BULLET]);
+	atlas.find("Enemy2", TEXTURE_ATLAS, frames[SPRITE_ENEMY]);
+	atlas.find("Boss", TEXTURE_ATLAS, frames[SPRITE_BOSS]);
+	atlas.find("Bomb", TEXTURE_ATLAS, frames[SPRITE_ENEMY_BULLET]);
+	particle_frame = frames[SPRITE_BULLET];
+	particle_frame.w = PARTICLE_SIZE;
+	particle_frame.h = PARTICLE_SIZE;
+
+
+	// the HUD's glyphs go on their own page, blended like the sprite page
+	if (bake_hud_font(hud_font, "Arial", HUD_FONT_HEIGHT, premultiplied))
+		textures[TEXTURE_FONT] = texture_from_argb(hud_font.pixels(), hud_font.width(), hud_font.height());
+	hud.init(&hud_font, TEXTURE_FONT, 8, -0.5f);
+	hud.set_text(hud.add_label(0, 0, SPRITE_WHITE), "Shooting Game");
+	hud_stats = hud.add_label(0, HUD_FONT_HEIGHT, SPRITE_WHITE);
+	hud_hp = hud.add_label(0, SCREEN_HEIGHT - HUD_FONT_HEIGHT, SPRITE_WHITE);
+	hud_boss_hp = hud.add_label(SCREEN_WIDTH / 2, SCREEN_HEIGHT - HUD_FONT_HEIGHT, SPRITE_WHITE);
+
+	// the batch draws pre-transformed quads with alpha blending, the way
+	// ID3DXSprite did; a premultiplied page is already scaled by alpha
+	d3ddev->SetFVF(SPRITE_FVF);
+	d3ddev->SetRenderState(D3DRS_LIGHTING, FALSE);
+	d3ddev->SetRenderState(D3DRS_CULLMODE, D3DCULL_NONE);
+	d3ddev->SetRenderState(D3DRS_ZENABLE, D3DZB_FALSE);
+	d3ddev->SetRenderState(D3DRS_ALPHABLENDENABLE, TRUE);
+	d3ddev->SetRenderState(D3DRS_SRCBLEND, premultiplied ? D3DBLEND_ONE : D3DBLEND_SRCALPHA);
+	d3ddev->SetRenderState(D3DRS_DESTBLEND, D3DBLEND_INVSRCALPHA);
+	d3ddev->SetTextureStageState(0, D3DTSS_COLOROP, D3DTOP_MODULATE);
+	d3ddev->SetTextureStageState(0, D3DTSS_ALPHAOP, D3DTOP_MODULATE);
+	d3ddev->SetSamplerState(0, D3DSAMP_ADDRESSU, D3DTADDRESS_CLAMP);
+	d3ddev->SetSamplerState(0, D3DSAMP_ADDRESSV, D3DTADDRESS_CLAMP);
+	d3ddev->SetSamplerState(0, D3DSAMP_MINFILTER, D3DTEXF_LINEAR);
+	d3ddev->SetSamplerState(0, D3DSAMP_MAGFILTER, D3DTEXF_LINEAR);
 	return;
 }
 
 
-void init_game(void)
+// a managed texture with every level of a baked texture, copied straight
+// out of its mapping
+LPDIRECT3DTEXTURE9 texture_from_baked(const BakedTexture& baked)
 {
-	//ü ʱȭ 
-	hero.init(150, 400);
-
-	//  Ѿ˵ ʱȭ 
-	for (int i = 0; i<ENEMY_NUM; i++)
+	LPDIRECT3DTEXTURE9 texture = NULL;
+	D3DXCreateTexture(d3ddev, baked.width(0), baked.height(0), baked.levels(), 0, D3DFMT_A8R8G8B8, D3DPOOL_MANAGED, &texture);
+	for (int level = 0; texture && level < baked.levels() && level < (int)texture->GetLevelCount(); level++)
 	{
-		enemy[i].init((float)(rand() % 300), rand() % 200 - 300);
-		enemybullet.init(enemy[i].x_pos, enemy[i].y_pos);
+		D3DLOCKED_RECT locked;
+		if (FAILED(texture->LockRect(level, &locked, NULL, 0)))
+			continue;
+		const unsigned int* pixels = baked.pixels(level);
+		for (int y = 0; y < baked.height(level); y++)
+			memcpy((char*)locked.pBits + y * locked.Pitch, pixels + (size_t)y * baked.width(level), baked.width(level) * sizeof(unsigned int));
+		texture->UnlockRect(level);
 	}
-
-	//Ѿ ʱȭ 
-	bullet.init(hero.x_pos, hero.y_pos);
-	Superbullet.init(hero.x_pos, hero.y_pos);
-
+	return texture;
 }
 
 
-void do_game_logic(void)
+// one image as a managed texture; D3DX may round the size up, and the image
+// goes in the top-left corner
+LPDIRECT3DTEXTURE9 texture_from_argb(const unsigned int* argb, int w, int h)
 {
+	LPDIRECT3DTEXTURE9 texture = NULL;
+	D3DXCreateTexture(d3ddev, w, h, 1, 0, D3DFMT_A8R8G8B8, D3DPOOL_MANAGED, &texture);
+	D3DLOCKED_RECT locked;
+	if (texture && SUCCEEDED(texture->LockRect(0, &locked, NULL, 0)))
+	{
+		for (int y = 0; y < h; y++)
+			memcpy((char*)locked.pBits + y * locked.Pitch, argb + (size_t)y * w, w * sizeof(unsigned int));
+		texture->UnlockRect(0);
+	}
+	return texture;
+}
 
-	//ΰ ó 
-	if (KEY_DOWN(VK_UP))
-		hero.move(MOVE_UP);
-
-	if (KEY_DOWN(VK_DOWN))
-		hero.move(MOVE_DOWN);
-
-	if (KEY_DOWN(VK_LEFT))
-		hero.move(MOVE_LEFT);
 
-	if (KEY_DOWN(VK_RIGHT))
-		hero.move(MOVE_RIGHT);
-
-	//ΰ Ѿ ó 
-	if (bullet.show() == false)
+// the printable ASCII glyphs of a GDI font, antialiased, packed into a glyph
+// atlas; false if the font can't be made or a glyph didn't fit
+bool bake_hud_font(GlyphAtlas& atlas, const char* face, int height, bool premultiplied)
+{
+	HDC dc = CreateCompatibleDC(NULL);
+	HFONT gdi_font = CreateFontA(height, 0, 0, 0, FW_NORMAL, FALSE, FALSE, FALSE, DEFAULT_CHARSET, OUT_DEFAULT_PRECIS,
+		CLIP_DEFAULT_PRECIS, ANTIALIASED_QUALITY, FF_DONTCARE, face);
+	if (!dc || !gdi_font)
 	{
-		if (KEY_DOWN(VK_SPACE))
-		{
-			bullet.active();
-			bullet.init(hero.x_pos, hero.y_pos);
-		}
+		if (gdi_font)
+			DeleteObject(gdi_font);
+		if (dc)
+			DeleteDC(dc);
+		return false;
 	}
+	HGDIOBJ old_font = SelectObject(dc, gdi_font);
+
+	TEXTMETRICA metrics;
+	GetTextMetricsA(dc, &metrics);
+	atlas.init(512, 512, metrics.tmHeight, premultiplied);
 
-	if (bullet.show() == true)
+	MAT2 identity = { { 0, 1 }, { 0, 0 }, { 0, 0 }, { 0, 1 } };
+	std::vector<unsigned char> bitmap;
+	bool ok = true;
+	for (int c = GLYPH_FIRST; c <= GLYPH_LAST; c++)
 	{
-		if (bullet.y_pos < -70)
-			bullet.hide();
-		else
-			bullet.move();
+		GLYPHMETRICS gm;
+		DWORD size = GetGlyphOutlineA(dc, c, GGO_GRAY8_BITMAP, &gm, 0, NULL, &identity);
+		if (size == GDI_ERROR)
+			continue;
+
+		// 65 levels of gray, rows padded to 4 bytes; blank glyphs have no bitmap
+		bitmap.assign(size + 1, 0);
+		if (size > 0)
+			GetGlyphOutlineA(dc, c, GGO_GRAY8_BITMAP, &gm, size, &bitmap[0], &identity);
+		for (DWORD i = 0; i < size; i++)
+			bitmap[i] = (unsigned char)(bitmap[i] * 255 / 64);
+
+		int w = size > 0 ? (int)gm.gmBlackBoxX : 0;
+		int h = size > 0 ? (int)gm.gmBlackBoxY : 0;
+		ok = atlas.add(c, &bitmap[0], w, h, (w + 3) & ~3, gm.gmptGlyphOrigin.x, metrics.tmAscent - gm.gmptGlyphOrigin.y,
+			gm.gmCellIncX) && ok;
+	}
 
+	SelectObject(dc, old_font);
+	DeleteObject(gdi_font);
+	DeleteDC(dc);
+	return ok;
+}
 
-		//浹 ó 
-		for (int i = 0; i<ENEMY_NUM; i++)
-		{
-			if (bullet.check_collision(enemy[i].x_pos, enemy[i].y_pos) == true)
-			{
-				enemy[i].init((float)(rand() % 300), rand() % 200 - 300);
 
-			}
-		}
-	}
+// sample the keyboard into the buttons the game logic understands
+SimInput sample_input(void)
+{
+	SimInput input;
+	input.buttons = 0;
 
+	if (KEY_DOWN(VK_UP))
+		input.buttons |= BUTTON_UP;
 
-	// ó 
-	for (int i = 0; i<ENEMY_NUM; i++)
-	{
-		if (enemy[i].y_pos > 500)
-		{
-			enemy[i].init((float)(rand() % 300), rand() % 200 - 300);
-		}
-		else
-		{
-			enemy[i].move();
-		}
-	}
+	if (KEY_DOWN(VK_DOWN))
+		input.buttons |= BUTTON_DOWN;
 
+	if (KEY_DOWN(VK_LEFT))
+		input.buttons |= BUTTON_LEFT;
 
+	if (KEY_DOWN(VK_RIGHT))
+		input.buttons |= BUTTON_RIGHT;
 
+	if (KEY_DOWN(VK_SPACE))
+		input.buttons |= BUTTON_FIRE;
 
+	if (KEY_DOWN(0x5A))
+		input.buttons |= BUTTON_SUPER_FIRE;
 
-	if (Superbullet.show() == false)
-	{
-		if (KEY_DOWN(0x5A))
-		{
-		Superbullet.active();
-		Superbullet.init(hero.x_pos, hero.y_pos);
-		}
-	}
+	if (KEY_DOWN(0x58))
+		input.buttons |= BUTTON_BOMB;
 
-	if (Superbullet.show() == true)
-	{
-		if (Superbullet.y_pos < -70)
-			Superbullet.hide();
-		else
-			Superbullet.move();
+	return input;
+}
 
-		//浹 ó 
-		for (int i = 0; i<ENEMY_NUM; i++)
-		{
-			if (Superbullet.check_collision(enemy[i].x_pos, enemy[i].y_pos) == true)
-			{
-				enemy[i].init((float)(rand() % 400), rand() % 300 - 300);
-			}
-		}
-	}
 
-	//Ѿ ó
-	if (enemybullet.show() == false)
-	{
-		for(int i = 0; i < ENEMY_NUM; i++)
-		{
-			if(enemy[i].y_pos > 50)
-			{
-			enemybullet.active();
-			enemybullet.init(enemy[i].x_pos, enemy[i].y_pos);
-			}
-		}
-	}
-	if(enemybullet.show() == true)
+// this tick's input: the replay while it lasts, the keyboard after that
+SimInput next_input(void)
+{
+	PROFILE_SCOPE("input");
+	SimInput input;
+	if (!playback.next(input))
 	{
-		if (enemybullet.y_pos > 500)
-			enemybullet.hide();
-		else
-			enemybullet.move();
+		playback.close();
+		input = sample_input();
 	}
 
+	recorder.record(input);
+	return input;
 }
 
+
 // this is the function used to render a single frame
 void render_frame(void)
 {
+	PROFILE_SCOPE("render");
+
 	// clear the window to a deep blue
 	d3ddev->Clear(0, NULL, D3DCLEAR_TARGET, D3DCOLOR_XRGB(0, 0, 0), 1.0f, 0);
 
 	d3ddev->BeginScene();    // begins the 3D scene
 
-	d3dspt->Begin(D3DXSPRITE_ALPHABLEND);    // // begin sprite drawing with transparency
+	// every sprite on screen, sorted into one draw per texture
+	{
+		PROFILE_SCOPE("draw list");
+		batch.begin();
+		draw_world(world, frames, culler, batch);
+		draw_particles(particles, particle_frame, SPRITE_KIND_NUM, sprites_premultiplied, batch);
+	}
+	{
+		PROFILE_SCOPE("draw");
+		batch.end(sprite_backend);
+	}
 
 											 //UI â  
 
@@ -735,69 +565,22 @@ void render_frame(void)
 											 d3dspt->Draw(sprite, &part, &center, &position, D3DCOLOR_ARGB(127, 255, 255, 255));
 											 */
 
-    //ΰ 
-	RECT part;
-	SetRect(&part, 0, 0, 64, 64);
-	D3DXVECTOR3 center(0.0f, 0.0f, 0.0f);    // center at the upper-left corner
-	D3DXVECTOR3 position(hero.x_pos, hero.y_pos, 0.0f);    // position at 50, 50 with no depth
-	d3dspt->Draw(sprite_hero, &part, &center, &position, D3DCOLOR_ARGB(255, 255, 255, 255));
-
-	////Ѿ 
-	if (bullet.bShow == true)
+	// the HUD lays out only the labels whose text changed, then draws in one call
 	{
-		RECT part1;
-		SetRect(&part1, 0, 0, 64, 64);
-		D3DXVECTOR3 center1(0.0f, 0.0f, 0.0f);    // center at the upper-left corner
-		D3DXVECTOR3 position1(bullet.x_pos, bullet.y_pos, 0.0f);    // position at 50, 50 with no depth
-		d3dspt->Draw(sprite_bullet, &part1, &center1, &position1, D3DCOLOR_ARGB(255, 255, 255, 255));
+		PROFILE_SCOPE("hud");
+		const SpriteStats& stats = batch.stats();
+		char line[96];
+		sprintf(line, "%d sprites, %d draws, %d texture switches, %d%% culled", stats.quads, stats.draw_calls,
+			stats.texture_switches, (int)(culler.culled_ratio() * 100 + 0.5f));
+		hud.set_text(hud_stats, line);
+		hud.set_number(hud_hp, "HP ", world.hero.hp[0]);
+		hud.set_number(hud_boss_hp, "BOSS ", world.boss.hp[0]);
+		hud.draw(sprite_backend);
 	}
 
-	////Ѿ 
-	if (Superbullet.bShow == true)
-	{
-		RECT part3;
-		SetRect(&part3, 0, 0, 100, 100);
-		D3DXVECTOR3 center3(0.0f, 0.0f, 0.0f);    // center at the upper-left corner
-		D3DXVECTOR3 position3(Superbullet.x_pos, Superbullet.y_pos, 0.0f);    // position at 50, 50 with no depth
-		d3dspt->Draw(sprite_superbullet, &part3, &center3, &position3, D3DCOLOR_ARGB(255, 255, 255, 255));
-	}
-
-
-	////׹ 
-	RECT part2;
-	SetRect(&part2, 0, 0, 64, 64);
-	D3DXVECTOR3 center2(0.0f, 0.0f, 0.0f);    // center at the upper-left corner
-	for (int i = 0; i<ENEMY_NUM; i++)
-	{
-		D3DXVECTOR3 position2(enemy[i].x_pos, enemy[i].y_pos, 0.0f);    // position at 50, 50 with no depth
-		d3dspt->Draw(sprite_enemy, &part2, &center2, &position2, D3DCOLOR_ARGB(255, 255, 255, 255));
-	}
-
-	//Ѿ
-	if(enemybullet.bShow == true)
-	{
-		for (int i = 0; i < ENEMY_NUM; i++)
-		{
-			RECT part4;
-			SetRect(&part4, 0, 0, 64, 64);
-			D3DXVECTOR3 center4(0.0f, 0.0f, 0.0f);    // center at the upper-left corner
-			D3DXVECTOR3 position4(enemybullet.x_pos, enemybullet.y_pos, 0.0f);    // position at 50, 50 with no depth
-			d3dspt->Draw(sprite_enemybullet, &part4, &center4, &position4, D3DCOLOR_ARGB(255, 255, 255, 255));
-		}
-	}
-
-
-	if (font)
-	{
-		font->DrawTextA(NULL, message.c_str(), -1, &fRectangle, DT_LEFT, D3DCOLOR_ARGB(255, 255, 255, 255));
-	}
-
-
-
-	d3dspt->End();    // end sprite drawing
-
 	d3ddev->EndScene();    // ends the 3D scene
 
+	PROFILE_SCOPE("present");
 	d3ddev->Present(NULL, NULL, NULL, NULL);
 
 
@@ -813,13 +596,10 @@ void cleanD3D(void)
 	sprite->Release();
 	d3ddev->Release();
 	d3d->Release();
-	font->Release();
 	//ü  
-	sprite_hero->Release();
-	sprite_enemy->Release();
-	sprite_bullet->Release();
-	sprite_superbullet->Release();
-	sprite_enemybullet->Release();
+	textures[TEXTURE_ATLAS]->Release();
+	if (textures[TEXTURE_FONT])
+		textures[TEXTURE_FONT]->Release();
 
 	return;
 }
@@ -0,0 +1,19 @@
+# How every enemy moves, one instruction per line; the game reads this at
+# startup. Times are in seconds, speeds in pixels per second, +y is down.
+#
+#   wait <seconds>
+#   move <vx> <vy> [seconds]
+#   strafe <vx> [seconds]
+#   weave <amplitude> <period> <vy> [seconds]
+#   dive <vy> <acceleration> [seconds]
+#   loop
+#
+# Without seconds an instruction runs forever. Enemies that leave the bottom
+# of the screen respawn above it and start again from the top.
+#
+# For example, weaving in and then diving:
+#
+#   weave 60 1.5 40 3
+#   dive 60 200
+
+move 0 80